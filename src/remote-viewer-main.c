@@ -29,6 +29,7 @@
 
 #include "remote-viewer.h"
 #include "virt-viewer-util.h"
+#include "virt-viewer-timeline.h"
 
 int
 main(int argc, char **argv)
@@ -36,6 +37,7 @@ main(int argc, char **argv)
     int ret = 1;
     GApplication *app = NULL;
 
+    virt_viewer_timeline_startup();
     virt_viewer_util_init(_("Remote Viewer"));
     app = G_APPLICATION(remote_viewer_new());
 
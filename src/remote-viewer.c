@@ -27,6 +27,7 @@
 #include <gtk/gtk.h>
 #include <glib/gprintf.h>
 #include <glib/gi18n.h>
+#include <string.h>
 #include <libxml/uri.h>
 
 #ifdef HAVE_OVIRT
@@ -158,6 +159,41 @@ remote_viewer_add_option_entries(VirtViewerApp *self, GOptionContext *context, G
 #endif
 }
 
+/*
+ * Starts the TCP connection of a vnc:// URI right away, while GTK starts
+ * and the windows are built, rather than once the session is activated.
+ * SPICE opens a connection per channel on its own, so it is left alone.
+ */
+static void
+remote_viewer_prewarm(VirtViewerApp *app, const gchar *guri)
+{
+    xmlURIPtr uri;
+
+    if (g_file_test(guri, G_FILE_TEST_EXISTS))
+        return;
+
+    uri = xmlParseURI(guri);
+    if (uri == NULL)
+        return;
+
+    if (g_strcmp0(uri->scheme, "vnc") == 0 && uri->server != NULL &&
+        uri->server[0] != '\0' && uri->port > 0) {
+        gchar *host = g_strdup(uri->server);
+        gchar *port = g_strdup_printf("%d", uri->port);
+        gchar *tmp;
+
+        if (host[0] == '[') {
+            memmove(host, host + 1, strlen(host));
+            if ((tmp = strchr(host, ']')))
+                *tmp = '\0';
+        }
+        virt_viewer_app_prewarm_host(app, host, port);
+        g_free(host);
+        g_free(port);
+    }
+    xmlFreeURI(uri);
+}
+
 static gboolean
 remote_viewer_local_command_line (GApplication   *gapp,
                                   gchar        ***args,
@@ -182,6 +218,7 @@ remote_viewer_local_command_line (GApplication   *gapp,
         }
 
         g_object_set(app, "guri", opt_args[0], NULL);
+        remote_viewer_prewarm(app, opt_args[0]);
     }
 
 #ifdef HAVE_SPICE_GTK
@@ -1080,6 +1117,33 @@ remote_viewer_session_connected(VirtViewerSession *session,
     g_free(uri);
 }
 
+/*
+ * gtk-vnc can only connect to hosts, so the socket of a vnc+unix:// URI
+ * is opened by the app and its connection handed to the session.
+ */
+static void
+remote_viewer_set_unix_socket(VirtViewerApp *app, const gchar *guri)
+{
+    gchar *transport = NULL;
+    xmlURIPtr uri;
+
+    if (virt_viewer_util_extract_host(guri, NULL, NULL, &transport, NULL, NULL) < 0 ||
+        g_strcmp0(transport, "unix") != 0) {
+        g_free(transport);
+        return;
+    }
+    g_free(transport);
+
+    uri = xmlParseURI(guri);
+    if (uri == NULL)
+        return;
+
+    if (uri->path != NULL)
+        virt_viewer_app_set_connect_info(app, NULL, NULL, NULL, NULL, NULL,
+                                         uri->path, NULL, 0, guri);
+    xmlFreeURI(uri);
+}
+
 static gboolean
 remote_viewer_start(VirtViewerApp *app, GError **err)
 {
@@ -1162,6 +1226,9 @@ retry_dialog:
         {
             if (!virt_viewer_app_create_session(app, type, &error))
                 goto cleanup;
+
+            if (vvfile == NULL && g_strcmp0(type, "vnc") == 0)
+                remote_viewer_set_unix_socket(app, guri);
         }
 
         g_signal_connect(virt_viewer_app_get_session(app), "session-connected",
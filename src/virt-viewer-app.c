@@ -55,6 +55,12 @@
 #include "virt-viewer-window.h"
 #include "virt-viewer-session.h"
 #include "virt-viewer-util.h"
+#include "virt-viewer-timeline.h"
+#include "virt-viewer-ssh-mux.h"
+#include "virt-viewer-tunnel-pool.h"
+#include "virt-viewer-happy-eyeballs.h"
+#include "virt-viewer-capture.h"
+#include "virt-viewer-recording.h"
 #ifdef HAVE_GTK_VNC
 #include "virt-viewer-session-vnc.h"
 #endif
@@ -130,13 +136,26 @@ struct _VirtViewerAppPrivate {
     gboolean active;
     gboolean connected;
     gboolean cancelled;
+    gboolean first_frame;
+    gboolean tentative; /* the display may not be the one of the guest */
+    gboolean tentative_usbredir; /* auto-usbredir, held back meanwhile */
     char *unixsock;
     char *guri; /* prefered over ghost:gport */
     char *ghost;
     char *gport;
     char *gtlsport;
+    GCancellable *host_race; /* direct TCP connection in progress */
+    GCancellable *prewarm; /* direct TCP connection opened before the UI */
+    gchar *prewarm_host; /* the name it was opened to */
+    GSocketConnection *prewarm_conn;
+    GError *prewarm_error;
+    gboolean prewarm_wanted; /* activated, waiting for the connection */
     char *host; /* ssh */
     int port;/* ssh */
+    VirtViewerSshMux *ssh_mux; /* ssh, NULL unless multiplexing */
+#if defined(HAVE_SOCKETPAIR) && defined(HAVE_FORK)
+    VirtViewerTunnelPool *tunnel_pool; /* ssh */
+#endif
     char *user; /* ssh */
     char *transport;
     char *pretty_address;
@@ -148,12 +167,23 @@ struct _VirtViewerAppPrivate {
     gint focused;
     GKeyFile *config;
     gchar *config_file;
+    VirtViewerMonitorLayoutMode monitor_layout_mode; /* read from config for uuid */
 
     guint insert_smartcard_accel_key;
     GdkModifierType insert_smartcard_accel_mods;
     guint remove_smartcard_accel_key;
     GdkModifierType remove_smartcard_accel_mods;
     gboolean quit_on_disconnect;
+
+    VirtViewerCapture *capture; /* --capture-dir */
+    guint capture_id;
+    VirtViewerRecorder *recorder; /* --record */
+    guint record_id;
+    gint64 record_undamaged_time; /* last grab of the displays without damage reports */
+    guint metrics_id; /* --metrics-file */
+    guint n_connections;
+    gint64 connected_since;
+    gint64 connected_time; /* of the previous connections */
 };
 
 
@@ -161,6 +191,14 @@ G_DEFINE_ABSTRACT_TYPE(VirtViewerApp, virt_viewer_app, GTK_TYPE_APPLICATION)
 #define GET_PRIVATE(o)                                                        \
     (G_TYPE_INSTANCE_GET_PRIVATE ((o), VIRT_VIEWER_TYPE_APP, VirtViewerAppPrivate))
 
+/* seconds after which an unused pre-spawned ssh tunnel is terminated */
+#define TUNNEL_POOL_IDLE_TIMEOUT 60
+/* seconds an ssh master connection outlives its last tunnel, long
+ * enough for the pre-spawned tunnels riding on it */
+#define SSH_MUX_PERSIST TUNNEL_POOL_IDLE_TIMEOUT
+/* ms between two grabs of a display which doesn't report its changes */
+#define RECORD_UNDAMAGED_INTERVAL 1000
+
 enum {
     PROP_0,
     PROP_VERBOSE,
@@ -386,6 +424,263 @@ virt_viewer_app_get_monitor_mapping_for_section(VirtViewerApp *self, const gchar
     return mapping;
 }
 
+static gboolean
+virt_viewer_app_get_monitor_layout_for_section(VirtViewerApp *self,
+                                               const gchar *section,
+                                               VirtViewerMonitorLayoutMode *mode)
+{
+    GError *error = NULL;
+    gchar *layout;
+    gboolean ret = FALSE;
+
+    layout = g_key_file_get_string(self->priv->config, section, "monitor-layout", &error);
+    if (error) {
+        if (error->code != G_KEY_FILE_ERROR_GROUP_NOT_FOUND
+            && error->code != G_KEY_FILE_ERROR_KEY_NOT_FOUND)
+            g_warning("Error reading monitor layout for %s: %s", section, error->message);
+        g_clear_error(&error);
+    } else if (virt_viewer_monitor_layout_mode_from_string(layout, mode)) {
+        ret = TRUE;
+    } else {
+        g_warning("Invalid monitor layout '%s' for %s", layout, section);
+    }
+    g_free(layout);
+
+    return ret;
+}
+
+/*
+ * How the guest displays are arranged when they are not all fullscreen,
+ * as set by the "monitor-layout" key of the guest section of the
+ * settings, or of the fallback section. It is read once per guest, as
+ * it is needed each time the display geometry is applied.
+ */
+static void
+virt_viewer_app_update_monitor_layout_mode(VirtViewerApp *self)
+{
+    VirtViewerMonitorLayoutMode mode = VIRT_VIEWER_MONITOR_LAYOUT_LINEAR;
+
+    if (!(self->priv->uuid != NULL &&
+          virt_viewer_app_get_monitor_layout_for_section(self, self->priv->uuid, &mode)) &&
+        !virt_viewer_app_get_monitor_layout_for_section(self, "fallback", &mode))
+        mode = VIRT_VIEWER_MONITOR_LAYOUT_LINEAR;
+
+    self->priv->monitor_layout_mode = mode;
+}
+
+VirtViewerMonitorLayoutMode
+virt_viewer_app_get_monitor_layout_mode(VirtViewerApp *self)
+{
+    g_return_val_if_fail(VIRT_VIEWER_IS_APP(self), VIRT_VIEWER_MONITOR_LAYOUT_LINEAR);
+
+    return self->priv->monitor_layout_mode;
+}
+
+static gboolean
+virt_viewer_app_get_scaling_mode_for_section(VirtViewerApp *self,
+                                             const gchar *section,
+                                             gint nth,
+                                             VirtViewerScalingMode *mode)
+{
+    GError *error = NULL;
+    gchar **modes;
+    gsize i, nmodes = 0;
+    gboolean ret = FALSE;
+
+    modes = g_key_file_get_string_list(self->priv->config,
+                                       section, "scaling-mode", &nmodes, &error);
+    if (error) {
+        if (error->code != G_KEY_FILE_ERROR_GROUP_NOT_FOUND
+            && error->code != G_KEY_FILE_ERROR_KEY_NOT_FOUND)
+            g_warning("Error reading scaling modes for %s: %s", section, error->message);
+        g_clear_error(&error);
+        return FALSE;
+    }
+
+    for (i = 0; i < nmodes && !ret; i++) {
+        gchar **tokens = g_strsplit(modes[i], ":", 2);
+        gchar *end = NULL;
+        gint64 display;
+
+        if (g_strv_length(tokens) != 2) {
+            g_warning("Invalid scaling mode '%s' for %s", modes[i], section);
+            g_strfreev(tokens);
+            continue;
+        }
+
+        display = g_ascii_strtoll(tokens[0], &end, 10);
+        if (end == tokens[0] || *end != '\0' || display != nth + 1) {
+            g_strfreev(tokens);
+            continue;
+        }
+
+        if (virt_viewer_scaling_mode_from_string(tokens[1], mode))
+            ret = TRUE;
+        else
+            g_warning("Invalid scaling mode '%s' for %s", tokens[1], section);
+        g_strfreev(tokens);
+    }
+    g_strfreev(modes);
+
+    return ret;
+}
+
+/*
+ * How the @nth guest display is scaled, as set by the "scaling-mode"
+ * key of the guest section of the settings, or of the fallback section.
+ * The key is a list of display:mode pairs, eg. "1:nearest;2:box".
+ */
+VirtViewerScalingMode
+virt_viewer_app_get_scaling_mode(VirtViewerApp *self, gint nth)
+{
+    VirtViewerScalingMode mode = VIRT_VIEWER_SCALING_AUTO;
+
+    g_return_val_if_fail(VIRT_VIEWER_IS_APP(self), mode);
+
+    if (self->priv->uuid != NULL &&
+        virt_viewer_app_get_scaling_mode_for_section(self, self->priv->uuid, nth, &mode))
+        return mode;
+
+    if (virt_viewer_app_get_scaling_mode_for_section(self, "fallback", nth, &mode))
+        return mode;
+
+    return VIRT_VIEWER_SCALING_AUTO;
+}
+
+/*
+ * Remembers the scaling mode of the @nth guest display in the guest
+ * section of the settings, saved along with them when quitting.
+ */
+void
+virt_viewer_app_set_scaling_mode(VirtViewerApp *self,
+                                 gint nth,
+                                 VirtViewerScalingMode mode)
+{
+    const gchar *section;
+    gchar **modes;
+    gsize i, nmodes = 0;
+    GPtrArray *list;
+    gchar *prefix;
+
+    g_return_if_fail(VIRT_VIEWER_IS_APP(self));
+
+    section = self->priv->uuid != NULL ? self->priv->uuid : "fallback";
+    prefix = g_strdup_printf("%d:", nth + 1);
+    list = g_ptr_array_new_with_free_func(g_free);
+
+    modes = g_key_file_get_string_list(self->priv->config,
+                                       section, "scaling-mode", &nmodes, NULL);
+    for (i = 0; i < nmodes; i++) {
+        if (!g_str_has_prefix(modes[i], prefix))
+            g_ptr_array_add(list, g_strdup(modes[i]));
+    }
+    g_strfreev(modes);
+
+    if (mode != VIRT_VIEWER_SCALING_AUTO)
+        g_ptr_array_add(list, g_strconcat(prefix, virt_viewer_scaling_mode_to_string(mode), NULL));
+
+    if (list->len > 0)
+        g_key_file_set_string_list(self->priv->config, section, "scaling-mode",
+                                   (const gchar * const *)list->pdata, list->len);
+    else
+        g_key_file_remove_key(self->priv->config, section, "scaling-mode", NULL);
+
+    g_ptr_array_unref(list);
+    g_free(prefix);
+}
+
+static gboolean
+virt_viewer_app_get_integer_scaling_for_section(VirtViewerApp *self,
+                                                const gchar *section,
+                                                gboolean *integer)
+{
+    GError *error = NULL;
+
+    *integer = g_key_file_get_boolean(self->priv->config, section, "integer-scaling", &error);
+    if (error) {
+        if (error->code != G_KEY_FILE_ERROR_GROUP_NOT_FOUND
+            && error->code != G_KEY_FILE_ERROR_KEY_NOT_FOUND)
+            g_warning("Error reading integer scaling for %s: %s", section, error->message);
+        g_clear_error(&error);
+        return FALSE;
+    }
+
+    return TRUE;
+}
+
+/*
+ * Whether the guest displays are only zoomed by integer scales, as set
+ * by the "integer-scaling" key of the guest section of the settings, or
+ * of the fallback section.
+ */
+gboolean
+virt_viewer_app_get_integer_scaling(VirtViewerApp *self)
+{
+    gboolean integer = FALSE;
+
+    g_return_val_if_fail(VIRT_VIEWER_IS_APP(self), FALSE);
+
+    if (self->priv->uuid != NULL &&
+        virt_viewer_app_get_integer_scaling_for_section(self, self->priv->uuid, &integer))
+        return integer;
+
+    if (virt_viewer_app_get_integer_scaling_for_section(self, "fallback", &integer))
+        return integer;
+
+    return FALSE;
+}
+
+void
+virt_viewer_app_set_integer_scaling(VirtViewerApp *self, gboolean integer)
+{
+    g_return_if_fail(VIRT_VIEWER_IS_APP(self));
+
+    g_key_file_set_boolean(self->priv->config,
+                           self->priv->uuid != NULL ? self->priv->uuid : "fallback",
+                           "integer-scaling", integer);
+}
+
+/*
+ * Returns the connection profile saved for the guest @domkey, a name or
+ * a UUID, reached through the libvirt @uri
+ */
+VirtViewerConnectionProfile *
+virt_viewer_app_get_connection_profile(VirtViewerApp *self,
+                                       const gchar *uri,
+                                       const gchar *domkey)
+{
+    g_return_val_if_fail(VIRT_VIEWER_IS_APP(self), NULL);
+    g_return_val_if_fail(domkey != NULL, NULL);
+
+    return virt_viewer_connection_profile_find(self->priv->config, uri, domkey);
+}
+
+/*
+ * Remembers how the display of the current guest was reached, or
+ * forgets it when @profile is NULL. Unlike the other settings, this is
+ * saved right away as the viewer doesn't save them when the guest shuts
+ * down.
+ */
+void
+virt_viewer_app_set_connection_profile(VirtViewerApp *self,
+                                       const VirtViewerConnectionProfile *profile)
+{
+    gboolean changed;
+
+    g_return_if_fail(VIRT_VIEWER_IS_APP(self));
+    g_return_if_fail(profile == NULL || profile->uuid != NULL);
+
+    if (profile != NULL)
+        changed = virt_viewer_connection_profile_save(profile, self->priv->config);
+    else if (self->priv->uuid != NULL)
+        changed = virt_viewer_connection_profile_remove(self->priv->config, self->priv->uuid);
+    else
+        changed = FALSE;
+
+    if (changed)
+        virt_viewer_app_save_config(self);
+}
+
 static
 void virt_viewer_app_apply_monitor_mapping(VirtViewerApp *self)
 {
@@ -430,6 +725,7 @@ void virt_viewer_app_set_uuid_string(VirtViewerApp *self, const gchar *uuid_stri
     g_free(self->priv->uuid);
     self->priv->uuid = g_strdup(uuid_string);
 
+    virt_viewer_app_update_monitor_layout_mode(self);
     virt_viewer_app_apply_monitor_mapping(self);
 }
 
@@ -559,67 +855,55 @@ virt_viewer_app_about_delete(GtkWidget *dialog,
     gtk_widget_destroy(dialog);
 }
 
-#if defined(HAVE_SOCKETPAIR) && defined(HAVE_FORK)
-
-static int
-virt_viewer_app_open_tunnel(const char **cmd)
+/* whether ssh tunnels are spawned ahead of time, see --ssh-pool */
+static gboolean
+virt_viewer_app_has_tunnel_pool(VirtViewerApp *self G_GNUC_UNUSED)
 {
-    int fd[2];
-    pid_t pid;
-
-    if (socketpair(PF_UNIX, SOCK_STREAM, 0, fd) < 0)
-        return -1;
-
-    pid = fork();
-    if (pid == -1) {
-        close(fd[0]);
-        close(fd[1]);
-        return -1;
-    }
-
-    if (pid == 0) { /* child */
-        close(fd[0]);
-        close(0);
-        close(1);
-        if (dup(fd[1]) < 0)
-            _exit(1);
-        if (dup(fd[1]) < 0)
-            _exit(1);
-        close(fd[1]);
-        execvp("ssh", (char *const*)cmd);
-        _exit(1);
-    }
-    close(fd[1]);
-    return fd[0];
+#if defined(HAVE_SOCKETPAIR) && defined(HAVE_FORK)
+    return virt_viewer_tunnel_pool_get_max_idle(self->priv->tunnel_pool) > 0;
+#else
+    return FALSE;
+#endif
 }
 
+#if defined(HAVE_SOCKETPAIR) && defined(HAVE_FORK)
 
 static int
-virt_viewer_app_open_tunnel_ssh(const char *sshhost,
+virt_viewer_app_open_tunnel_ssh(VirtViewerApp *self,
+                                const char *sshhost,
                                 int sshport,
                                 const char *sshuser,
                                 const char *host,
                                 const char *port,
                                 const char *unixsock)
 {
-    const char *cmd[10];
-    char portstr[50];
-    int n = 0;
+    GPtrArray *cmd;
+    int n;
     GString *cat;
+    /* only covers spawning the tunnel, or taking a pre-spawned one, as
+     * the ssh handshake goes on in the background */
+    gint64 start = virt_viewer_timeline_begin("ssh-tunnel");
 
-    cmd[n++] = "ssh";
+    cmd = g_ptr_array_new_with_free_func(g_free);
+    g_ptr_array_add(cmd, g_strdup("ssh"));
     if (sshport) {
-        cmd[n++] = "-p";
-        sprintf(portstr, "%d", sshport);
-        cmd[n++] = portstr;
+        g_ptr_array_add(cmd, g_strdup("-p"));
+        g_ptr_array_add(cmd, g_strdup_printf("%d", sshport));
     }
     if (sshuser) {
-        cmd[n++] = "-l";
-        cmd[n++] = sshuser;
+        g_ptr_array_add(cmd, g_strdup("-l"));
+        g_ptr_array_add(cmd, g_strdup(sshuser));
     }
-    cmd[n++] = sshhost;
+    if (self->priv->ssh_mux)
+        virt_viewer_ssh_mux_add_options(self->priv->ssh_mux, cmd, sshhost, sshport, sshuser);
+    g_ptr_array_add(cmd, g_strdup(sshhost));
 
-    cat = g_string_new("if (command -v socat) >/dev/null 2>&1");
+    cat = g_string_new(NULL);
+    /* the tunnel pool activates pre-spawned tunnels by sending a newline */
+    if (virt_viewer_app_has_tunnel_pool(self))
+        g_string_append(cat, "read -r x || exit 1; ");
+
+    g_string_append(cat, "if (command -v socat) >/dev/null 2>&1");
 
     g_string_append(cat, "; then socat - ");
     if (port)
@@ -635,11 +919,14 @@ virt_viewer_app_open_tunnel_ssh(const char *sshhost,
 
     g_string_append(cat, "; fi");
 
-    cmd[n++] = cat->str;
-    cmd[n++] = NULL;
+    g_ptr_array_add(cmd, g_string_free(cat, FALSE));
+    g_ptr_array_add(cmd, NULL);
+
+    n = virt_viewer_tunnel_pool_open(self->priv->tunnel_pool,
+                                     (const gchar *const *)cmd->pdata);
+    g_ptr_array_unref(cmd);
 
-    n = virt_viewer_app_open_tunnel(cmd);
-    g_string_free(cat, TRUE);
+    virt_viewer_timeline_end("ssh-tunnel", start, sshhost);
 
     return n;
 }
@@ -944,7 +1231,17 @@ display_show_hint(VirtViewerDisplay *display,
         if (win)
             virt_viewer_window_hide(win);
     } else {
-        if (hint & VIRT_VIEWER_DISPLAY_SHOW_HINT_READY) {
+        if ((hint & VIRT_VIEWER_DISPLAY_SHOW_HINT_READY) && self->priv->tentative) {
+            /* neither shown nor given any input until it is known to be
+             * the display of the guest, see virt_viewer_app_set_tentative() */
+            g_debug("Holding display %d back until the guest is confirmed", nth);
+        } else if (hint & VIRT_VIEWER_DISPLAY_SHOW_HINT_READY) {
+            if (!self->priv->first_frame) {
+                gchar *detail = g_strdup_printf("display %d", nth);
+                self->priv->first_frame = TRUE;
+                virt_viewer_timeline_mark("first-frame", detail);
+                g_free(detail);
+            }
             win = ensure_window_for_display(self, display);
             nb = virt_viewer_window_get_notebook(win);
             virt_viewer_notebook_show_display(nb);
@@ -1066,6 +1363,9 @@ virt_viewer_app_create_session(VirtViewerApp *self, const gchar *type, GError **
         return FALSE;
     }
 
+    priv->first_frame = FALSE;
+    virt_viewer_timeline_mark("session-created", type);
+
     g_signal_connect(priv->session, "session-initialized",
                      G_CALLBACK(virt_viewer_app_initialized), self);
     g_signal_connect(priv->session, "session-connected",
@@ -1141,7 +1441,8 @@ virt_viewer_app_channel_open(VirtViewerSession *session,
     priv = self->priv;
     if (priv->transport && g_ascii_strcasecmp(priv->transport, "ssh") == 0 &&
         !priv->direct && fd == -1) {
-        if ((fd = virt_viewer_app_open_tunnel_ssh(priv->host, priv->port, priv->user,
+        if ((fd = virt_viewer_app_open_tunnel_ssh(self,
+                                                  priv->host, priv->port, priv->user,
                                                   priv->ghost, priv->gport, priv->unixsock)) < 0) {
             error_message = g_strdup(_("Connect to ssh failed."));
             g_debug("channel open ssh tunnel: %s", error_message);
@@ -1177,6 +1478,238 @@ virt_viewer_app_channel_open(VirtViewerSession *session G_GNUC_UNUSED,
 }
 #endif
 
+/* Racing the addresses needs a host name resolving to several of them,
+ * and spice-gtk needs that name to check the TLS server certificate, as
+ * does gtk-vnc for VeNCrypt, which only takes it along with the fd since
+ * vnc_display_open_fd_with_hostname() */
+static gboolean
+virt_viewer_app_should_race_host(VirtViewerApp *self)
+{
+    VirtViewerAppPrivate *priv = self->priv;
+
+#if defined(HAVE_GTK_VNC) && !(defined(HAVE_VNC_DISPLAY_OPEN_FD_WITH_HOSTNAME) && !defined(G_OS_WIN32))
+    if (VIRT_VIEWER_IS_SESSION_VNC(priv->session))
+        return FALSE;
+#endif
+
+    return priv->gport != NULL && priv->gtlsport == NULL &&
+        !g_hostname_is_ip_address(priv->ghost);
+}
+
+static void
+virt_viewer_app_host_connected(GObject *source G_GNUC_UNUSED,
+                               GAsyncResult *result,
+                               gpointer user_data)
+{
+    VirtViewerApp *self = user_data;
+    VirtViewerAppPrivate *priv = self->priv;
+    GSocketConnection *conn;
+    GSocketAddress *remote;
+    gchar *address = NULL;
+    gboolean ret = FALSE;
+    GError *error = NULL;
+
+    conn = virt_viewer_happy_eyeballs_connect_finish(result, &error);
+    if (g_error_matches(error, G_IO_ERROR, G_IO_ERROR_CANCELLED)) {
+        g_clear_error(&error);
+        goto end;
+    }
+    g_clear_object(&priv->host_race);
+
+    if (g_error_matches(error, G_IO_ERROR, G_IO_ERROR_NOT_SUPPORTED)) {
+        /* a single address, let spice-gtk connect to it */
+        g_clear_error(&error);
+        virt_viewer_app_trace(self, "Opening direct TCP connection to display at %s:%s:%s",
+                              priv->ghost, priv->gport, "-1");
+        if (!virt_viewer_session_open_host(priv->session, priv->ghost, priv->gport, NULL))
+            virt_viewer_app_disconnected(priv->session, NULL, self);
+        goto end;
+    }
+
+    if (conn == NULL) {
+        g_debug("Cannot connect to %s:%s: %s", priv->ghost, priv->gport, error->message);
+        virt_viewer_app_disconnected(priv->session, error->message, self);
+        g_clear_error(&error);
+        goto end;
+    }
+
+    remote = g_socket_connection_get_remote_address(conn, NULL);
+    if (remote != NULL) {
+        address = g_inet_address_to_string(g_inet_socket_address_get_address(G_INET_SOCKET_ADDRESS(remote)));
+        g_object_unref(remote);
+    }
+    virt_viewer_timeline_mark("display-address", address);
+    virt_viewer_app_trace(self, "Fastest address for display at %s:%s is %s",
+                          priv->ghost, priv->gport, address ? address : "unknown");
+
+#if defined(HAVE_VNC_DISPLAY_OPEN_FD_WITH_HOSTNAME) && !defined(G_OS_WIN32)
+    /* VNC uses a single connection, hand the winning one over */
+    if (VIRT_VIEWER_IS_SESSION_VNC(priv->session)) {
+        int fd = dup(g_socket_get_fd(g_socket_connection_get_socket(conn)));
+
+        if (fd >= 0) {
+            ret = virt_viewer_session_vnc_open_fd_with_hostname(VIRT_VIEWER_SESSION_VNC(priv->session),
+                                                                fd, priv->ghost);
+            goto done;
+        }
+    }
+#endif
+
+    /* SPICE opens a connection per channel, point them all to the
+     * winning address */
+    ret = virt_viewer_session_open_host(priv->session,
+                                        address ? address : priv->ghost,
+                                        priv->gport, priv->gtlsport);
+
+#if defined(HAVE_VNC_DISPLAY_OPEN_FD_WITH_HOSTNAME) && !defined(G_OS_WIN32)
+done:
+#endif
+    if (!ret)
+        virt_viewer_app_disconnected(priv->session, NULL, self);
+    g_object_unref(conn);
+    g_free(address);
+
+end:
+    g_object_unref(self);
+}
+
+static void
+virt_viewer_app_clear_prewarm(VirtViewerApp *self)
+{
+    VirtViewerAppPrivate *priv = self->priv;
+
+    if (priv->prewarm)
+        g_cancellable_cancel(priv->prewarm);
+    g_clear_object(&priv->prewarm);
+    g_clear_pointer(&priv->prewarm_host, g_free);
+    g_clear_object(&priv->prewarm_conn);
+    g_clear_error(&priv->prewarm_error);
+    priv->prewarm_wanted = FALSE;
+}
+
+/* gtk-vnc needs the host name along with the connection, to check the
+ * certificate of the server for VeNCrypt */
+#if defined(HAVE_VNC_DISPLAY_OPEN_FD_WITH_HOSTNAME) && !defined(G_OS_WIN32)
+static gboolean
+virt_viewer_app_has_prewarm(VirtViewerApp *self)
+{
+    VirtViewerAppPrivate *priv = self->priv;
+
+    return (priv->prewarm || priv->prewarm_conn || priv->prewarm_error) &&
+        VIRT_VIEWER_IS_SESSION_VNC(priv->session);
+}
+
+/* Hands the connection opened by virt_viewer_app_prewarm_host() to the
+ * VNC session, the only one using a single connection */
+static gboolean
+virt_viewer_app_use_prewarm(VirtViewerApp *self, GError **error)
+{
+    VirtViewerAppPrivate *priv = self->priv;
+    gboolean ret = FALSE;
+    GSocketAddress *remote;
+    gchar *address = NULL;
+    int fd;
+
+    if (priv->prewarm_conn == NULL) {
+        g_propagate_error(error, priv->prewarm_error);
+        priv->prewarm_error = NULL;
+        goto end;
+    }
+
+    remote = g_socket_connection_get_remote_address(priv->prewarm_conn, NULL);
+    if (remote != NULL) {
+        address = g_inet_address_to_string(g_inet_socket_address_get_address(G_INET_SOCKET_ADDRESS(remote)));
+        g_object_unref(remote);
+    }
+    virt_viewer_timeline_mark("display-address", address);
+    virt_viewer_app_trace(self, "Using the connection to display at %s opened at startup",
+                          address ? address : "unknown");
+    g_free(address);
+
+    fd = dup(g_socket_get_fd(g_socket_connection_get_socket(priv->prewarm_conn)));
+    if (fd < 0) {
+        g_set_error(error, VIRT_VIEWER_ERROR, VIRT_VIEWER_ERROR_FAILED,
+                    _("Unable to connect: %s"), g_strerror(errno));
+        goto end;
+    }
+    ret = virt_viewer_session_vnc_open_fd_with_hostname(VIRT_VIEWER_SESSION_VNC(priv->session),
+                                                        fd, priv->prewarm_host);
+
+end:
+    virt_viewer_app_clear_prewarm(self);
+    return ret;
+}
+
+static void
+virt_viewer_app_prewarm_connected(GObject *source G_GNUC_UNUSED,
+                                  GAsyncResult *result,
+                                  gpointer user_data)
+{
+    VirtViewerApp *self = user_data;
+    VirtViewerAppPrivate *priv = self->priv;
+    GSocketConnection *conn;
+    GError *error = NULL;
+
+    conn = virt_viewer_happy_eyeballs_connect_finish(result, &error);
+    if (g_error_matches(error, G_IO_ERROR, G_IO_ERROR_CANCELLED)) {
+        g_clear_error(&error);
+        goto end;
+    }
+
+    priv->prewarm_conn = conn;
+    priv->prewarm_error = error;
+    g_clear_object(&priv->prewarm);
+    g_debug("Connection opened at startup is %s", conn ? "ready" : "failed");
+
+    if (priv->prewarm_wanted) {
+        if (!virt_viewer_app_use_prewarm(self, &error)) {
+            virt_viewer_app_disconnected(priv->session, error ? error->message : NULL, self);
+            g_clear_error(&error);
+        }
+    }
+
+end:
+    g_object_unref(self);
+}
+
+/**
+ * virt_viewer_app_prewarm_host:
+ * @self: a #VirtViewerApp
+ * @host: the host of the display
+ * @port: its port
+ *
+ * Starts connecting to a VNC display before the windows are built, so
+ * that the name resolution and TCP handshake happen meanwhile. The next
+ * activation of a VNC session uses that connection.
+ */
+void
+virt_viewer_app_prewarm_host(VirtViewerApp *self, const gchar *host, const gchar *port)
+{
+    VirtViewerAppPrivate *priv;
+
+    g_return_if_fail(VIRT_VIEWER_IS_APP(self));
+    g_return_if_fail(host != NULL);
+    g_return_if_fail(port != NULL);
+
+    priv = self->priv;
+    virt_viewer_app_clear_prewarm(self);
+
+    g_debug("Connecting to %s:%s ahead of the session", host, port);
+    priv->prewarm = g_cancellable_new();
+    priv->prewarm_host = g_strdup(host);
+    virt_viewer_happy_eyeballs_connect_async(host, atoi(port), FALSE, priv->prewarm,
+                                             virt_viewer_app_prewarm_connected,
+                                             g_object_ref(self));
+}
+#else
+void
+virt_viewer_app_prewarm_host(VirtViewerApp *self G_GNUC_UNUSED,
+                             const gchar *host G_GNUC_UNUSED,
+                             const gchar *port G_GNUC_UNUSED)
+{
+}
+#endif
+
 static gboolean
 virt_viewer_app_default_activate(VirtViewerApp *self, GError **error)
 {
@@ -1211,7 +1744,8 @@ virt_viewer_app_default_activate(VirtViewerApp *self, GError **error)
                               priv->host, p ? p : "");
         g_free(p);
 
-        if ((fd = virt_viewer_app_open_tunnel_ssh(priv->host, priv->port,
+        if ((fd = virt_viewer_app_open_tunnel_ssh(self,
+                                                  priv->host, priv->port,
                                                   priv->user, priv->ghost,
                                                   priv->gport, priv->unixsock)) < 0)
             return FALSE;
@@ -1225,9 +1759,33 @@ virt_viewer_app_default_activate(VirtViewerApp *self, GError **error)
 
     if (fd >= 0) {
         return virt_viewer_session_open_fd(VIRT_VIEWER_SESSION(priv->session), fd);
+#if defined(HAVE_VNC_DISPLAY_OPEN_FD_WITH_HOSTNAME) && !defined(G_OS_WIN32)
+    } else if (virt_viewer_app_has_prewarm(self)) {
+        if (priv->prewarm == NULL)
+            return virt_viewer_app_use_prewarm(self, error);
+        virt_viewer_app_trace(self, "Waiting for the connection to display opened at startup");
+        priv->prewarm_wanted = TRUE;
+        return TRUE;
+#endif
     } else if (priv->guri) {
         virt_viewer_app_trace(self, "Opening connection to display at %s", priv->guri);
         return virt_viewer_session_open_uri(VIRT_VIEWER_SESSION(priv->session), priv->guri, error);
+    } else if (priv->ghost && virt_viewer_app_should_race_host(self)) {
+        /* SPICE would only add a connection to a single address, VNC
+         * keeps it */
+        gboolean race_only = TRUE;
+#ifdef HAVE_GTK_VNC
+        race_only = !VIRT_VIEWER_IS_SESSION_VNC(priv->session);
+#endif
+
+        virt_viewer_app_trace(self, "Racing direct TCP connections to the addresses of display at %s:%s",
+                              priv->ghost, priv->gport);
+        priv->host_race = g_cancellable_new();
+        virt_viewer_happy_eyeballs_connect_async(priv->ghost, atoi(priv->gport), race_only,
+                                                 priv->host_race,
+                                                 virt_viewer_app_host_connected,
+                                                 g_object_ref(self));
+        return TRUE;
     } else if (priv->ghost) {
         virt_viewer_app_trace(self, "Opening direct TCP connection to display at %s:%s:%s",
                               priv->ghost, priv->gport, priv->gtlsport ? priv->gtlsport : "-1");
@@ -1256,11 +1814,16 @@ virt_viewer_app_activate(VirtViewerApp *self, GError **error)
     ret = VIRT_VIEWER_APP_GET_CLASS(self)->activate(self, error);
 
     if (ret == FALSE) {
-        if(error != NULL && *error != NULL)
+        if (priv->tentative) {
+            /* the caller looks the display up again */
+            g_clear_object(&priv->session);
+        } else if (error != NULL && *error != NULL) {
             virt_viewer_app_show_status(self, (*error)->message);
+        }
         priv->connected = FALSE;
     } else {
         virt_viewer_app_show_status(self, _("Connecting to graphic server"));
+        virt_viewer_timeline_mark("activate", NULL);
         priv->cancelled = FALSE;
         priv->active = TRUE;
     }
@@ -1340,6 +1903,8 @@ virt_viewer_app_initial_connect(VirtViewerApp *self, GError **error)
     g_return_val_if_fail(VIRT_VIEWER_IS_APP(self), FALSE);
     klass = VIRT_VIEWER_APP_GET_CLASS(self);
 
+    virt_viewer_timeline_mark("initial-connect", NULL);
+
     return klass->initial_connect(self, error);
 }
 
@@ -1385,10 +1950,25 @@ virt_viewer_app_deactivate(VirtViewerApp *self, gboolean connect_error)
     if (!priv->active)
         return;
 
+    if (priv->host_race) {
+        g_cancellable_cancel(priv->host_race);
+        g_clear_object(&priv->host_race);
+    }
+    virt_viewer_app_clear_prewarm(self);
+
     if (priv->session) {
         virt_viewer_session_close(VIRT_VIEWER_SESSION(priv->session));
     }
 
+    /* the pre-spawned tunnels ride on the master connections, which
+     * then exit after SSH_MUX_PERSIST seconds without any tunnel */
+    if (priv->ssh_mux && !virt_viewer_app_has_tunnel_pool(self))
+        virt_viewer_ssh_mux_close_all(priv->ssh_mux);
+
+    if (priv->connected_since != 0) {
+        priv->connected_time += g_get_monotonic_time() - priv->connected_since;
+        priv->connected_since = 0;
+    }
     priv->connected = FALSE;
     priv->active = FALSE;
     priv->started = FALSE;
@@ -1416,6 +1996,9 @@ virt_viewer_app_connected(VirtViewerSession *session G_GNUC_UNUSED,
     VirtViewerAppPrivate *priv = self->priv;
 
     priv->connected = TRUE;
+    priv->n_connections++;
+    priv->connected_since = g_get_monotonic_time();
+    virt_viewer_timeline_mark("session-connected", NULL);
 
     if (self->priv->kiosk)
         virt_viewer_app_show_status(self, "");
@@ -1439,7 +2022,7 @@ virt_viewer_app_disconnected(VirtViewerSession *session G_GNUC_UNUSED, const gch
     VirtViewerAppPrivate *priv = self->priv;
     gboolean connect_error = !priv->connected && !priv->cancelled;
 
-    if (!priv->kiosk)
+    if (!priv->kiosk && !(connect_error && priv->tentative))
         virt_viewer_app_hide_all_windows(self);
     else if (priv->cancelled)
         priv->authretry = TRUE;
@@ -1447,7 +2030,7 @@ virt_viewer_app_disconnected(VirtViewerSession *session G_GNUC_UNUSED, const gch
     if (priv->quitting)
         g_application_quit(G_APPLICATION(self));
 
-    if (connect_error) {
+    if (connect_error && !priv->tentative) {
         GtkWidget *dialog = virt_viewer_app_make_message_dialog(self,
             _("Unable to connect to the graphic server %s"), priv->pretty_address);
 
@@ -1459,6 +2042,63 @@ virt_viewer_app_disconnected(VirtViewerSession *session G_GNUC_UNUSED, const gch
     virt_viewer_app_deactivate(self, connect_error);
 }
 
+/*
+ * While the display being connected to is only assumed to be the one
+ * of the guest, failing to connect to it is left to the deactivated
+ * vfunc instead of being reported, and a session which can't even be
+ * activated is dropped. Its displays are not put in the windows, and no
+ * USB device is redirected to it, until it is no longer tentative.
+ */
+void
+virt_viewer_app_set_tentative(VirtViewerApp *self, gboolean tentative)
+{
+    VirtViewerAppPrivate *priv;
+    GHashTableIter iter;
+    gpointer value;
+
+    g_return_if_fail(VIRT_VIEWER_IS_APP(self));
+
+    priv = self->priv;
+    if (priv->tentative == tentative)
+        return;
+
+    priv->tentative = tentative;
+    if (priv->session == NULL)
+        return;
+
+    if (tentative) {
+        priv->tentative_usbredir = virt_viewer_session_get_auto_usbredir(priv->session);
+        virt_viewer_session_set_auto_usbredir(priv->session, FALSE);
+        return;
+    }
+
+    virt_viewer_session_set_auto_usbredir(priv->session, priv->tentative_usbredir);
+
+    /* confirmed, show the displays which are ready */
+    if (!priv->active)
+        return;
+    g_hash_table_iter_init(&iter, priv->displays);
+    while (g_hash_table_iter_next(&iter, NULL, &value))
+        g_object_notify(G_OBJECT(value), "show-hint"); /* call display_show_hint */
+}
+
+/* Tears the session down right away, as if it was disconnected */
+void
+virt_viewer_app_close_session(VirtViewerApp *self)
+{
+    VirtViewerAppPrivate *priv;
+
+    g_return_if_fail(VIRT_VIEWER_IS_APP(self));
+
+    priv = self->priv;
+    if (!priv->active)
+        return;
+
+    /* the session won't report its disconnection later */
+    g_signal_handlers_disconnect_by_data(priv->session, self);
+    virt_viewer_app_disconnected(priv->session, NULL, self);
+}
+
 static void virt_viewer_app_cancelled(VirtViewerSession *session,
                                       VirtViewerApp *self)
 {
@@ -1669,6 +2309,11 @@ virt_viewer_app_dispose (GObject *object)
     }
 
     priv->resource = NULL;
+    if (priv->host_race) {
+        g_cancellable_cancel(priv->host_race);
+        g_clear_object(&priv->host_race);
+    }
+    virt_viewer_app_clear_prewarm(self);
     g_clear_object(&priv->session);
     g_free(priv->title);
     priv->title = NULL;
@@ -1686,6 +2331,24 @@ virt_viewer_app_dispose (GObject *object)
     priv->config_file = NULL;
     g_clear_pointer(&priv->config, g_key_file_free);
     g_clear_pointer(&priv->initial_display_map, g_hash_table_unref);
+#if defined(HAVE_SOCKETPAIR) && defined(HAVE_FORK)
+    g_clear_pointer(&priv->tunnel_pool, virt_viewer_tunnel_pool_free);
+#endif
+    g_clear_pointer(&priv->ssh_mux, virt_viewer_ssh_mux_free);
+    if (priv->capture_id) {
+        g_source_remove(priv->capture_id);
+        priv->capture_id = 0;
+    }
+    g_clear_pointer(&priv->capture, virt_viewer_capture_free);
+    if (priv->record_id) {
+        g_source_remove(priv->record_id);
+        priv->record_id = 0;
+    }
+    g_clear_pointer(&priv->recorder, virt_viewer_recorder_free);
+    if (priv->metrics_id) {
+        g_source_remove(priv->metrics_id);
+        priv->metrics_id = 0;
+    }
 
     virt_viewer_app_free_connect_info(self);
 
@@ -1720,6 +2383,14 @@ static gboolean opt_debug = FALSE;
 static gboolean opt_fullscreen = FALSE;
 static gboolean opt_kiosk = FALSE;
 static gboolean opt_kiosk_quit = FALSE;
+static gchar *opt_capture_dir = NULL;
+static gint opt_capture_interval = 60;
+static gint opt_capture_keep = 1440;
+static gchar *opt_record = NULL;
+static gint opt_record_interval = 200;
+static gchar *opt_export_recording = NULL;
+static gchar *opt_metrics_file = NULL;
+static gint opt_metrics_interval = 15;
 
 static void
 title_maybe_changed(VirtViewerApp *self, GParamSpec* pspec G_GNUC_UNUSED, gpointer user_data G_GNUC_UNUSED)
@@ -1736,6 +2407,9 @@ virt_viewer_app_init(VirtViewerApp *self)
     gtk_window_set_default_icon_name("virt-viewer");
 
     self->priv->displays = g_hash_table_new_full(g_direct_hash, g_direct_equal, NULL, g_object_unref);
+#if defined(HAVE_SOCKETPAIR) && defined(HAVE_FORK)
+    self->priv->tunnel_pool = virt_viewer_tunnel_pool_new(0, TUNNEL_POOL_IDLE_TIMEOUT);
+#endif
     self->priv->config = g_key_file_new();
     self->priv->config_file = g_build_filename(g_get_user_config_dir(),
                                                "virt-viewer", "settings", NULL);
@@ -1748,6 +2422,7 @@ virt_viewer_app_init(VirtViewerApp *self)
         g_warning("Couldn't load configuration: %s", error->message);
 
     g_clear_error(&error);
+    virt_viewer_app_update_monitor_layout_mode(self);
 
     g_signal_connect(self, "notify::guest-name", G_CALLBACK(title_maybe_changed), NULL);
     g_signal_connect(self, "notify::title", G_CALLBACK(title_maybe_changed), NULL);
@@ -1806,6 +2481,201 @@ virt_viewer_update_smartcard_accels(VirtViewerApp *self)
     }
 }
 
+static gboolean
+virt_viewer_app_capture_displays(gpointer user_data)
+{
+    VirtViewerApp *self = VIRT_VIEWER_APP(user_data);
+    GHashTableIter iter;
+    gpointer key, value;
+
+    /* the display may be the one of another guest */
+    if (self->priv->displays == NULL || self->priv->tentative)
+        return G_SOURCE_CONTINUE;
+
+    g_hash_table_iter_init(&iter, self->priv->displays);
+    while (g_hash_table_iter_next(&iter, &key, &value)) {
+        VirtViewerDisplay *display = VIRT_VIEWER_DISPLAY(value);
+        GdkPixbuf *pixbuf;
+
+        if (!(virt_viewer_display_get_show_hint(display) & VIRT_VIEWER_DISPLAY_SHOW_HINT_READY))
+            continue;
+
+        pixbuf = virt_viewer_display_get_pixbuf(display);
+        if (pixbuf == NULL)
+            continue;
+
+        virt_viewer_capture_add_frame(self->priv->capture, GPOINTER_TO_INT(key), pixbuf);
+        g_object_unref(pixbuf);
+    }
+
+    return G_SOURCE_CONTINUE;
+}
+
+/* Captures the displays every --capture-interval seconds, for monitoring
+ * a guest unattended */
+static gboolean
+virt_viewer_app_start_capture(VirtViewerApp *self, GError **error)
+{
+    if (opt_capture_interval < 1) {
+        g_set_error(error, VIRT_VIEWER_ERROR, VIRT_VIEWER_ERROR_FAILED,
+                    _("Capture interval must be at least 1 second"));
+        return FALSE;
+    }
+
+    if (opt_capture_keep < 0) {
+        g_set_error(error, VIRT_VIEWER_ERROR, VIRT_VIEWER_ERROR_FAILED,
+                    _("Invalid number of captures to keep: %d"), opt_capture_keep);
+        return FALSE;
+    }
+
+    if (g_mkdir_with_parents(opt_capture_dir, 0755) < 0) {
+        g_set_error(error, VIRT_VIEWER_ERROR, VIRT_VIEWER_ERROR_FAILED,
+                    _("Unable to create capture directory %s: %s"),
+                    opt_capture_dir, g_strerror(errno));
+        return FALSE;
+    }
+
+    g_debug("Capturing the displays to %s every %d s, keeping %d files per display",
+            opt_capture_dir, opt_capture_interval, opt_capture_keep);
+    self->priv->capture = virt_viewer_capture_new(opt_capture_dir, opt_capture_keep);
+    self->priv->capture_id = g_timeout_add_seconds(opt_capture_interval,
+                                                   virt_viewer_app_capture_displays,
+                                                   self);
+
+    return TRUE;
+}
+
+/* Only the displays whose content changed are grabbed, and none while
+ * the recorder is still busy with the previous frames. The displays
+ * which don't tell when they change, such as VNC ones, would need a
+ * full copy on each tick, they are grabbed every
+ * RECORD_UNDAMAGED_INTERVAL ms at most instead. */
+static gboolean
+virt_viewer_app_record_displays(gpointer user_data)
+{
+    VirtViewerApp *self = VIRT_VIEWER_APP(user_data);
+    GHashTableIter iter;
+    gpointer key, value;
+    gint64 now;
+    gboolean undamaged_due;
+
+    if (self->priv->displays == NULL || self->priv->tentative ||
+        virt_viewer_recorder_is_busy(self->priv->recorder))
+        return G_SOURCE_CONTINUE;
+
+    now = g_get_monotonic_time();
+    undamaged_due = now - self->priv->record_undamaged_time >=
+        RECORD_UNDAMAGED_INTERVAL * G_TIME_SPAN_MILLISECOND;
+    if (undamaged_due)
+        self->priv->record_undamaged_time = now;
+
+    g_hash_table_iter_init(&iter, self->priv->displays);
+    while (g_hash_table_iter_next(&iter, &key, &value)) {
+        VirtViewerDisplay *display = VIRT_VIEWER_DISPLAY(value);
+        GdkPixbuf *pixbuf;
+
+        if (!(virt_viewer_display_get_show_hint(display) & VIRT_VIEWER_DISPLAY_SHOW_HINT_READY) ||
+            (!virt_viewer_display_reports_damage(display) && !undamaged_due) ||
+            !virt_viewer_display_take_damage(display))
+            continue;
+
+        pixbuf = virt_viewer_display_get_pixbuf(display);
+        if (pixbuf == NULL)
+            continue;
+
+        virt_viewer_recorder_add_frame(self->priv->recorder, GPOINTER_TO_UINT(key), pixbuf);
+        g_object_unref(pixbuf);
+    }
+
+    return G_SOURCE_CONTINUE;
+}
+
+static gboolean
+virt_viewer_app_start_recording(VirtViewerApp *self, GError **error)
+{
+    if (opt_record_interval < 10) {
+        g_set_error(error, VIRT_VIEWER_ERROR, VIRT_VIEWER_ERROR_FAILED,
+                    _("Recording interval must be at least 10 ms"));
+        return FALSE;
+    }
+
+    self->priv->recorder = virt_viewer_recorder_new(opt_record, error);
+    if (self->priv->recorder == NULL)
+        return FALSE;
+
+    g_debug("Recording the displays to %s every %d ms", opt_record, opt_record_interval);
+    self->priv->record_id = g_timeout_add(opt_record_interval,
+                                          virt_viewer_app_record_displays,
+                                          self);
+
+    return TRUE;
+}
+
+static gboolean
+virt_viewer_app_write_metrics(gpointer user_data)
+{
+    VirtViewerApp *self = VIRT_VIEWER_APP(user_data);
+    VirtViewerAppPrivate *priv = self->priv;
+    VirtViewerMetrics *metrics = virt_viewer_metrics_new();
+    gint64 connected_time = priv->connected_time;
+    GError *error = NULL;
+
+    if (priv->connected_since != 0)
+        connected_time += g_get_monotonic_time() - priv->connected_since;
+
+    virt_viewer_metrics_describe(metrics, "virt_viewer_connections_total",
+                                 VIRT_VIEWER_METRIC_COUNTER,
+                                 "Connections established to the graphic server");
+    virt_viewer_metrics_set(metrics, "virt_viewer_connections_total",
+                            priv->n_connections, NULL);
+    virt_viewer_metrics_describe(metrics, "virt_viewer_reconnections_total",
+                                 VIRT_VIEWER_METRIC_COUNTER,
+                                 "Connections established after the first one");
+    virt_viewer_metrics_set(metrics, "virt_viewer_reconnections_total",
+                            priv->n_connections > 0 ? priv->n_connections - 1 : 0, NULL);
+    virt_viewer_metrics_describe(metrics, "virt_viewer_connected",
+                                 VIRT_VIEWER_METRIC_GAUGE,
+                                 "Whether the graphic server is connected");
+    virt_viewer_metrics_set(metrics, "virt_viewer_connected",
+                            priv->connected_since != 0, NULL);
+    virt_viewer_metrics_describe(metrics, "virt_viewer_connected_seconds_total",
+                                 VIRT_VIEWER_METRIC_COUNTER,
+                                 "Time spent connected to the graphic server");
+    virt_viewer_metrics_set(metrics, "virt_viewer_connected_seconds_total",
+                            (gdouble)connected_time / G_USEC_PER_SEC, NULL);
+
+    if (priv->session != NULL)
+        virt_viewer_session_collect_metrics(priv->session, metrics);
+
+    if (!virt_viewer_metrics_write(metrics, opt_metrics_file, &error)) {
+        g_warning("Unable to write the metrics: %s", error->message);
+        g_clear_error(&error);
+    }
+    virt_viewer_metrics_free(metrics);
+
+    return G_SOURCE_CONTINUE;
+}
+
+/* Rewrites --metrics-file every --metrics-interval seconds, for
+ * monitoring long running viewers */
+static gboolean
+virt_viewer_app_start_metrics(VirtViewerApp *self, GError **error)
+{
+    if (opt_metrics_interval < 1) {
+        g_set_error(error, VIRT_VIEWER_ERROR, VIRT_VIEWER_ERROR_FAILED,
+                    _("Metrics interval must be at least 1 second"));
+        return FALSE;
+    }
+
+    g_debug("Writing the metrics to %s every %d s", opt_metrics_file, opt_metrics_interval);
+    virt_viewer_app_write_metrics(self);
+    self->priv->metrics_id = g_timeout_add_seconds(opt_metrics_interval,
+                                                   virt_viewer_app_write_metrics,
+                                                   self);
+
+    return TRUE;
+}
+
 static void
 virt_viewer_app_on_application_startup(GApplication *app)
 {
@@ -1844,8 +2714,18 @@ virt_viewer_app_on_application_startup(GApplication *app)
     gtk_accel_map_add_entry("<virt-viewer>/view/zoom-reset", GDK_KEY_0, GDK_CONTROL_MASK);
     gtk_accel_map_add_entry("<virt-viewer>/view/zoom-out", GDK_KEY_minus, GDK_CONTROL_MASK);
     gtk_accel_map_add_entry("<virt-viewer>/view/zoom-in", GDK_KEY_plus, GDK_CONTROL_MASK);
+    gtk_accel_map_add_entry("<virt-viewer>/view/toggle-hud", GDK_KEY_F7, GDK_SHIFT_MASK);
     gtk_accel_map_add_entry("<virt-viewer>/send/secure-attention", GDK_KEY_End, GDK_CONTROL_MASK | GDK_MOD1_MASK);
 
+    if ((opt_capture_dir != NULL && !virt_viewer_app_start_capture(self, &error)) ||
+        (opt_record != NULL && !virt_viewer_app_start_recording(self, &error)) ||
+        (opt_metrics_file != NULL && !virt_viewer_app_start_metrics(self, &error))) {
+        virt_viewer_app_simple_message_dialog(self, error->message);
+        g_clear_error(&error);
+        g_application_quit(app);
+        return;
+    }
+
     if (!virt_viewer_app_start(self, &error)) {
         if (error && !g_error_matches(error, VIRT_VIEWER_ERROR, VIRT_VIEWER_ERROR_CANCELLED))
             virt_viewer_app_simple_message_dialog(self, error->message);
@@ -1893,6 +2773,23 @@ virt_viewer_app_local_command_line (GApplication   *gapp,
         goto end;
     }
 
+    if (opt_export_recording) {
+        if (opt_capture_dir == NULL) {
+            g_printerr(_("--export-recording requires --capture-dir\n"));
+            *status = 1;
+        } else if (g_mkdir_with_parents(opt_capture_dir, 0755) < 0) {
+            g_printerr(_("Unable to create capture directory %s: %s\n"),
+                       opt_capture_dir, g_strerror(errno));
+            *status = 1;
+        } else if (!virt_viewer_recording_export(opt_export_recording, opt_capture_dir, &error)) {
+            g_printerr(_("%s\n"), error->message);
+            g_clear_error(&error);
+            *status = 1;
+        }
+        ret = TRUE;
+        goto end;
+    }
+
     if (opt_version) {
         g_print(_("%s version %s"), g_get_prgname(), VERSION BUILDID);
 #ifdef REMOTE_VIEWER_OS_ID
@@ -2051,6 +2948,31 @@ gboolean virt_viewer_app_get_direct(VirtViewerApp *self)
     return self->priv->direct;
 }
 
+void
+virt_viewer_app_set_tunnel_pool_size(VirtViewerApp *self, guint size)
+{
+    g_return_if_fail(VIRT_VIEWER_IS_APP(self));
+
+#if defined(HAVE_SOCKETPAIR) && defined(HAVE_FORK)
+    virt_viewer_tunnel_pool_set_max_idle(self->priv->tunnel_pool, size);
+#else
+    if (size > 0)
+        g_warning("SSH tunnels are not supported on this platform");
+#endif
+}
+
+void
+virt_viewer_app_set_ssh_multiplex(VirtViewerApp *self, gboolean multiplex)
+{
+    g_return_if_fail(VIRT_VIEWER_IS_APP(self));
+
+    if (!multiplex) {
+        g_clear_pointer(&self->priv->ssh_mux, virt_viewer_ssh_mux_free);
+    } else if (self->priv->ssh_mux == NULL) {
+        self->priv->ssh_mux = virt_viewer_ssh_mux_new(SSH_MUX_PERSIST);
+    }
+}
+
 void
 virt_viewer_app_clear_hotkeys(VirtViewerApp *self)
 {
@@ -2060,6 +2982,7 @@ virt_viewer_app_clear_hotkeys(VirtViewerApp *self)
     gtk_accel_map_change_entry("<virt-viewer>/view/zoom-reset", 0, 0, TRUE);
     gtk_accel_map_change_entry("<virt-viewer>/view/zoom-in", 0, 0, TRUE);
     gtk_accel_map_change_entry("<virt-viewer>/view/zoom-out", 0, 0, TRUE);
+    gtk_accel_map_change_entry("<virt-viewer>/view/toggle-hud", 0, 0, TRUE);
     gtk_accel_map_change_entry("<virt-viewer>/send/secure-attention", 0, 0, TRUE);
     virt_viewer_set_insert_smartcard_accel(self, 0, 0);
     virt_viewer_set_remove_smartcard_accel(self, 0, 0);
@@ -2113,6 +3036,8 @@ virt_viewer_app_set_hotkeys(VirtViewerApp *self, const gchar *hotkeys_str)
             gtk_accel_map_change_entry("<virt-viewer>/view/toggle-fullscreen", accel_key, accel_mods, TRUE);
         } else if (g_str_equal(*hotkey, "release-cursor")) {
             gtk_accel_map_change_entry("<virt-viewer>/view/release-cursor", accel_key, accel_mods, TRUE);
+        } else if (g_str_equal(*hotkey, "toggle-hud")) {
+            gtk_accel_map_change_entry("<virt-viewer>/view/toggle-hud", accel_key, accel_mods, TRUE);
         } else if (g_str_equal(*hotkey, "secure-attention")) {
             gtk_accel_map_change_entry("<virt-viewer>/send/secure-attention", accel_key, accel_mods, TRUE);
         } else if (g_str_equal(*hotkey, "smartcard-insert")) {
@@ -2335,6 +3260,8 @@ window_update_menu_displays_cb(gpointer value,
             if (virt_viewer_display_get_selectable(display))
                 sensitive = TRUE;
         }
+        if (self->priv->tentative)
+            sensitive = FALSE;
         gtk_widget_set_sensitive(item, sensitive);
 
         virt_viewer_signal_connect_object(G_OBJECT(item), "toggled",
@@ -2578,6 +3505,21 @@ option_kiosk_quit(G_GNUC_UNUSED const gchar *option_name,
     return FALSE;
 }
 
+static gboolean
+option_timeline(G_GNUC_UNUSED const gchar *option_name,
+                const gchar *value,
+                G_GNUC_UNUSED gpointer data, GError **error)
+{
+    GError *err = NULL;
+
+    if (virt_viewer_timeline_open(value, &err))
+        return TRUE;
+
+    g_set_error_literal(error, G_OPTION_ERROR, G_OPTION_ERROR_FAILED, err->message);
+    g_error_free(err);
+    return FALSE;
+}
+
 static void
 virt_viewer_app_add_option_entries(G_GNUC_UNUSED VirtViewerApp *self,
                                    G_GNUC_UNUSED GOptionContext *context,
@@ -2600,6 +3542,24 @@ virt_viewer_app_add_option_entries(G_GNUC_UNUSED VirtViewerApp *self,
           N_("Display verbose information"), NULL },
         { "debug", '\0', 0, G_OPTION_ARG_NONE, &opt_debug,
           N_("Display debugging information"), NULL },
+        { "timeline", '\0', 0, G_OPTION_ARG_CALLBACK, option_timeline,
+          N_("Write connection timing events as JSON lines to FILE or fd:N"), N_("<FILE|fd:N>") },
+        { "capture-dir", '\0', 0, G_OPTION_ARG_FILENAME, &opt_capture_dir,
+          N_("Periodically save the displays as PNG images to DIRECTORY"), N_("DIRECTORY") },
+        { "capture-interval", '\0', 0, G_OPTION_ARG_INT, &opt_capture_interval,
+          N_("Seconds between two display captures"), N_("SECONDS") },
+        { "capture-keep", '\0', 0, G_OPTION_ARG_INT, &opt_capture_keep,
+          N_("Number of captures to keep per display, 0 to keep them all"), N_("COUNT") },
+        { "record", '\0', 0, G_OPTION_ARG_FILENAME, &opt_record,
+          N_("Record the changes of the displays to FILE"), N_("FILE") },
+        { "record-interval", '\0', 0, G_OPTION_ARG_INT, &opt_record_interval,
+          N_("Milliseconds between two recorded frames"), N_("MS") },
+        { "export-recording", '\0', 0, G_OPTION_ARG_FILENAME, &opt_export_recording,
+          N_("Export the frames of a recording as PNG images to the --capture-dir directory, and exit"), N_("FILE") },
+        { "metrics-file", '\0', 0, G_OPTION_ARG_FILENAME, &opt_metrics_file,
+          N_("Periodically write the session metrics to FILE in Prometheus text format"), N_("FILE") },
+        { "metrics-interval", '\0', 0, G_OPTION_ARG_INT, &opt_metrics_interval,
+          N_("Seconds between two writes of the metrics"), N_("SECONDS") },
         { NULL, 0, 0, G_OPTION_ARG_NONE, NULL, NULL, NULL }
     };
 
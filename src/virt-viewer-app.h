@@ -26,6 +26,8 @@
 #include <glib-object.h>
 #include <gtk/gtk.h>
 #include "virt-viewer-window.h"
+#include "virt-viewer-util.h"
+#include "virt-viewer-connection-profile.h"
 
 G_BEGIN_DECLS
 
@@ -70,6 +72,8 @@ gboolean virt_viewer_app_activate(VirtViewerApp *self, GError **error);
 gboolean virt_viewer_app_initial_connect(VirtViewerApp *self, GError **error);
 gboolean virt_viewer_app_get_direct(VirtViewerApp *self);
 void virt_viewer_app_set_direct(VirtViewerApp *self, gboolean direct);
+void virt_viewer_app_set_ssh_multiplex(VirtViewerApp *self, gboolean multiplex);
+void virt_viewer_app_set_tunnel_pool_size(VirtViewerApp *self, guint size);
 void virt_viewer_app_set_hotkeys(VirtViewerApp *self, const gchar *hotkeys);
 void virt_viewer_app_set_attach(VirtViewerApp *self, gboolean attach);
 gboolean virt_viewer_app_get_attach(VirtViewerApp *self);
@@ -84,6 +88,14 @@ void virt_viewer_app_set_connect_info(VirtViewerApp *self,
                                       const gchar *user,
                                       gint port,
                                       const gchar *guri);
+void virt_viewer_app_set_tentative(VirtViewerApp *self, gboolean tentative);
+void virt_viewer_app_close_session(VirtViewerApp *self);
+VirtViewerConnectionProfile *virt_viewer_app_get_connection_profile(VirtViewerApp *self,
+                                                                    const gchar *uri,
+                                                                    const gchar *domkey);
+void virt_viewer_app_set_connection_profile(VirtViewerApp *self,
+                                            const VirtViewerConnectionProfile *profile);
+void virt_viewer_app_prewarm_host(VirtViewerApp *self, const gchar *host, const gchar *port);
 gboolean virt_viewer_app_window_set_visible(VirtViewerApp *self, VirtViewerWindow *window, gboolean visible);
 void virt_viewer_app_show_status(VirtViewerApp *self, const gchar *fmt, ...);
 void virt_viewer_app_show_display(VirtViewerApp *self);
@@ -94,6 +106,11 @@ gboolean virt_viewer_app_get_fullscreen(VirtViewerApp *app);
 void virt_viewer_app_clear_hotkeys(VirtViewerApp *app);
 GList* virt_viewer_app_get_initial_displays(VirtViewerApp* self);
 gint virt_viewer_app_get_initial_monitor_for_display(VirtViewerApp* self, gint display);
+VirtViewerMonitorLayoutMode virt_viewer_app_get_monitor_layout_mode(VirtViewerApp *self);
+VirtViewerScalingMode virt_viewer_app_get_scaling_mode(VirtViewerApp *self, gint nth);
+void virt_viewer_app_set_scaling_mode(VirtViewerApp *self, gint nth, VirtViewerScalingMode mode);
+gboolean virt_viewer_app_get_integer_scaling(VirtViewerApp *self);
+void virt_viewer_app_set_integer_scaling(VirtViewerApp *self, gboolean integer);
 void virt_viewer_app_set_enable_accel(VirtViewerApp *app, gboolean enable);
 void virt_viewer_app_show_preferences(VirtViewerApp *app, GtkWidget *parent);
 void virt_viewer_app_set_menus_sensitive(VirtViewerApp *self, gboolean sensitive);
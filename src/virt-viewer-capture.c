@@ -0,0 +1,347 @@
+/*
+ * Virt Viewer: A virtual machine console viewer
+ *
+ * Copyright (C) 2016 Red Hat, Inc.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#include <config.h>
+
+#include <errno.h>
+#include <string.h>
+#include <glib.h>
+#include <glib/gstdio.h>
+#include <gio/gio.h>
+
+#include "virt-viewer-capture.h"
+#include "virt-viewer-screenshot.h"
+
+/*
+ * Periodic capture of the guest displays: each frame handed over is
+ * compared to the previous one of the same display using a hash of its
+ * pixels, and only written when it changed, as
+ * <directory>/display-<nth>-<UTC timestamp>.png. Once written, the
+ * oldest files of the display beyond the retention count are removed,
+ * including the ones of a previous run.
+ */
+
+struct _VirtViewerCapture {
+    gint refs;
+    gchar *directory;
+    guint keep; /* files kept per display, 0 for all */
+    GHashTable *displays; /* nth -> CaptureDisplay */
+    GCancellable *cancellable;
+    guint written;
+    guint unchanged;
+};
+
+typedef struct {
+    gboolean has_hash;
+    guint64 hash;
+    gint width;
+    gint height;
+    gboolean saving;
+} CaptureDisplay;
+
+typedef struct {
+    VirtViewerCapture *capture;
+    gint nth;
+    gchar *filename;
+} CaptureSave;
+
+static VirtViewerCapture *
+capture_ref(VirtViewerCapture *capture)
+{
+    capture->refs++;
+    return capture;
+}
+
+static void
+capture_unref(VirtViewerCapture *capture)
+{
+    if (--capture->refs > 0)
+        return;
+
+    g_hash_table_unref(capture->displays);
+    g_object_unref(capture->cancellable);
+    g_free(capture->directory);
+    g_free(capture);
+}
+
+/**
+ * virt_viewer_capture_new:
+ * @directory: where to write the captured frames, must exist
+ * @keep: the number of files to keep per display, or 0 to keep them all
+ */
+VirtViewerCapture *
+virt_viewer_capture_new(const gchar *directory, guint keep)
+{
+    VirtViewerCapture *capture;
+
+    g_return_val_if_fail(directory != NULL, NULL);
+
+    capture = g_new0(VirtViewerCapture, 1);
+    capture->refs = 1;
+    capture->directory = g_strdup(directory);
+    capture->keep = keep;
+    capture->displays = g_hash_table_new_full(g_direct_hash, g_direct_equal,
+                                              NULL, g_free);
+    capture->cancellable = g_cancellable_new();
+
+    return capture;
+}
+
+void
+virt_viewer_capture_free(VirtViewerCapture *capture)
+{
+    if (capture == NULL)
+        return;
+
+    /* the saves in progress hold a reference until they complete */
+    g_cancellable_cancel(capture->cancellable);
+    capture_unref(capture);
+}
+
+/**
+ * virt_viewer_capture_hash_pixbuf:
+ * @pixbuf: a #GdkPixbuf
+ *
+ * Returns: a 64-bit FNV-1a style hash of the pixels of @pixbuf, the
+ * row padding excluded. It is a lot cheaper than encoding the image.
+ */
+guint64
+virt_viewer_capture_hash_pixbuf(GdkPixbuf *pixbuf)
+{
+    const guint64 prime = G_GUINT64_CONSTANT(0x100000001b3);
+    guint64 hash = G_GUINT64_CONSTANT(0xcbf29ce484222325);
+    const guchar *pixels;
+    gint width, height, rowstride, y;
+    gsize row_size;
+
+    g_return_val_if_fail(GDK_IS_PIXBUF(pixbuf), 0);
+
+    width = gdk_pixbuf_get_width(pixbuf);
+    height = gdk_pixbuf_get_height(pixbuf);
+    rowstride = gdk_pixbuf_get_rowstride(pixbuf);
+    pixels = gdk_pixbuf_get_pixels(pixbuf);
+    row_size = (gsize)width * gdk_pixbuf_get_n_channels(pixbuf) *
+        gdk_pixbuf_get_bits_per_sample(pixbuf) / 8;
+
+    for (y = 0; y < height; y++) {
+        const guchar *row = pixels + (gsize)y * rowstride;
+        gsize i = 0;
+
+        /* a word at a time, the frames are several megabytes */
+        for (; i + sizeof(guint64) <= row_size; i += sizeof(guint64)) {
+            guint64 word;
+            memcpy(&word, row + i, sizeof(word));
+            hash = (hash ^ word) * prime;
+        }
+        for (; i < row_size; i++)
+            hash = (hash ^ row[i]) * prime;
+    }
+
+    return hash;
+}
+
+static gchar *
+capture_display_prefix(gint nth)
+{
+    return g_strdup_printf("display-%d-", nth);
+}
+
+/* the file names sort by date, the oldest ones come first */
+static gint
+capture_compare_names(gconstpointer a, gconstpointer b)
+{
+    return strcmp(*(const gchar * const *)a, *(const gchar * const *)b);
+}
+
+static void
+capture_prune(VirtViewerCapture *capture, gint nth)
+{
+    GPtrArray *files;
+    GError *error = NULL;
+    const gchar *name;
+    gchar *prefix;
+    GDir *dir;
+    guint i;
+
+    if (capture->keep == 0)
+        return;
+
+    dir = g_dir_open(capture->directory, 0, &error);
+    if (dir == NULL) {
+        g_warning("Unable to list capture directory: %s", error->message);
+        g_error_free(error);
+        return;
+    }
+
+    prefix = capture_display_prefix(nth);
+    files = g_ptr_array_new_with_free_func(g_free);
+    while ((name = g_dir_read_name(dir)) != NULL) {
+        if (g_str_has_prefix(name, prefix) && g_str_has_suffix(name, ".png"))
+            g_ptr_array_add(files, g_strdup(name));
+    }
+    g_dir_close(dir);
+
+    if (files->len > capture->keep) {
+        g_ptr_array_sort(files, capture_compare_names);
+        for (i = 0; i < files->len - capture->keep; i++) {
+            gchar *path = g_build_filename(capture->directory,
+                                           g_ptr_array_index(files, i), NULL);
+            g_debug("Removing old capture %s", path);
+            if (g_unlink(path) < 0)
+                g_warning("Unable to remove %s: %s", path, g_strerror(errno));
+            g_free(path);
+        }
+    }
+
+    g_ptr_array_unref(files);
+    g_free(prefix);
+}
+
+static void
+capture_saved(GObject *source G_GNUC_UNUSED,
+              GAsyncResult *result,
+              gpointer user_data)
+{
+    CaptureSave *save = user_data;
+    VirtViewerCapture *capture = save->capture;
+    CaptureDisplay *display;
+    GError *error = NULL;
+
+    display = g_hash_table_lookup(capture->displays, GINT_TO_POINTER(save->nth));
+    if (display != NULL)
+        display->saving = FALSE;
+
+    if (!virt_viewer_screenshot_save_finish(result, &error)) {
+        if (!g_error_matches(error, G_IO_ERROR, G_IO_ERROR_CANCELLED)) {
+            g_warning("Unable to save capture %s: %s", save->filename, error->message);
+            /* try again with the next frame */
+            if (display != NULL)
+                display->has_hash = FALSE;
+        }
+        g_error_free(error);
+    } else {
+        capture->written++;
+        if (!g_cancellable_is_cancelled(capture->cancellable))
+            capture_prune(capture, save->nth);
+    }
+
+    capture_unref(capture);
+    g_free(save->filename);
+    g_free(save);
+}
+
+static gchar *
+capture_filename(VirtViewerCapture *capture, gint nth)
+{
+    GDateTime *now = g_date_time_new_now_utc();
+    gchar *date = g_date_time_format(now, "%Y%m%d-%H%M%S");
+    gchar *name = g_strdup_printf("display-%d-%s.%03d.png", nth, date,
+                                  g_date_time_get_microsecond(now) / 1000);
+    gchar *filename = g_build_filename(capture->directory, name, NULL);
+
+    g_date_time_unref(now);
+    g_free(date);
+    g_free(name);
+
+    return filename;
+}
+
+/**
+ * virt_viewer_capture_add_frame:
+ * @capture: a #VirtViewerCapture
+ * @nth: the display the frame comes from
+ * @pixbuf: the frame, it must not be modified afterwards
+ *
+ * Writes @pixbuf in the background, unless it is the same as the
+ * previous frame of the display or the previous frame is still being
+ * written.
+ *
+ * Returns: TRUE if the frame is being written
+ */
+gboolean
+virt_viewer_capture_add_frame(VirtViewerCapture *capture,
+                              gint nth,
+                              GdkPixbuf *pixbuf)
+{
+    CaptureDisplay *display;
+    CaptureSave *save;
+    guint64 hash;
+
+    g_return_val_if_fail(capture != NULL, FALSE);
+    g_return_val_if_fail(GDK_IS_PIXBUF(pixbuf), FALSE);
+
+    display = g_hash_table_lookup(capture->displays, GINT_TO_POINTER(nth));
+    if (display == NULL) {
+        display = g_new0(CaptureDisplay, 1);
+        g_hash_table_insert(capture->displays, GINT_TO_POINTER(nth), display);
+    }
+
+    if (display->saving) {
+        g_debug("Previous capture of display %d still being written, skipping", nth);
+        return FALSE;
+    }
+
+    hash = virt_viewer_capture_hash_pixbuf(pixbuf);
+    if (display->has_hash &&
+        display->hash == hash &&
+        display->width == gdk_pixbuf_get_width(pixbuf) &&
+        display->height == gdk_pixbuf_get_height(pixbuf)) {
+        capture->unchanged++;
+        return FALSE;
+    }
+
+    display->has_hash = TRUE;
+    display->hash = hash;
+    display->width = gdk_pixbuf_get_width(pixbuf);
+    display->height = gdk_pixbuf_get_height(pixbuf);
+    display->saving = TRUE;
+
+    save = g_new0(CaptureSave, 1);
+    save->capture = capture_ref(capture);
+    save->nth = nth;
+    save->filename = capture_filename(capture, nth);
+    g_debug("Capturing display %d to %s", nth, save->filename);
+
+    virt_viewer_screenshot_save_async(pixbuf, save->filename, capture->cancellable,
+                                      capture_saved, save);
+
+    return TRUE;
+}
+
+void
+virt_viewer_capture_get_stats(VirtViewerCapture *capture,
+                              guint *written,
+                              guint *unchanged)
+{
+    g_return_if_fail(capture != NULL);
+
+    if (written)
+        *written = capture->written;
+    if (unchanged)
+        *unchanged = capture->unchanged;
+}
+
+/*
+ * Local variables:
+ *  c-indent-level: 4
+ *  c-basic-offset: 4
+ *  indent-tabs-mode: nil
+ * End:
+ */
@@ -0,0 +1,309 @@
+/*
+ * Virt Viewer: A virtual machine console viewer
+ *
+ * Copyright (C) 2016 Red Hat, Inc.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#include <config.h>
+
+#include <glib.h>
+
+#include "virt-viewer-connection-profile.h"
+
+/*
+ * Connection profiles are kept in the per-guest groups of the settings
+ * key file, next to the other per-guest settings, so that the display
+ * of a guest can be opened on the next launch without waiting for
+ * libvirt to find the guest and describe its graphics.
+ */
+
+VirtViewerConnectionProfile *
+virt_viewer_connection_profile_copy(const VirtViewerConnectionProfile *profile)
+{
+    VirtViewerConnectionProfile *copy;
+
+    g_return_val_if_fail(profile != NULL, NULL);
+
+    copy = g_new0(VirtViewerConnectionProfile, 1);
+    copy->uuid = g_strdup(profile->uuid);
+    copy->name = g_strdup(profile->name);
+    copy->uri = g_strdup(profile->uri);
+    copy->type = g_strdup(profile->type);
+    copy->ghost = g_strdup(profile->ghost);
+    copy->gport = g_strdup(profile->gport);
+    copy->gtlsport = g_strdup(profile->gtlsport);
+    copy->unixsock = g_strdup(profile->unixsock);
+    copy->host = g_strdup(profile->host);
+    copy->transport = g_strdup(profile->transport);
+    copy->user = g_strdup(profile->user);
+    copy->port = profile->port;
+
+    return copy;
+}
+
+void
+virt_viewer_connection_profile_free(VirtViewerConnectionProfile *profile)
+{
+    if (profile == NULL)
+        return;
+
+    g_free(profile->uuid);
+    g_free(profile->name);
+    g_free(profile->uri);
+    g_free(profile->type);
+    g_free(profile->ghost);
+    g_free(profile->gport);
+    g_free(profile->gtlsport);
+    g_free(profile->unixsock);
+    g_free(profile->host);
+    g_free(profile->transport);
+    g_free(profile->user);
+    g_free(profile);
+}
+
+/**
+ * virt_viewer_connection_profile_equal:
+ *
+ * Returns: whether @a and @b lead to the same display, regardless of
+ * the guest name and of how the guest was looked up
+ */
+gboolean
+virt_viewer_connection_profile_equal(const VirtViewerConnectionProfile *a,
+                                     const VirtViewerConnectionProfile *b)
+{
+    if (a == NULL || b == NULL)
+        return a == b;
+
+    return g_strcmp0(a->uuid, b->uuid) == 0 &&
+        g_strcmp0(a->type, b->type) == 0 &&
+        g_strcmp0(a->ghost, b->ghost) == 0 &&
+        g_strcmp0(a->gport, b->gport) == 0 &&
+        g_strcmp0(a->gtlsport, b->gtlsport) == 0 &&
+        g_strcmp0(a->unixsock, b->unixsock) == 0 &&
+        g_strcmp0(a->host, b->host) == 0 &&
+        g_strcmp0(a->transport, b->transport) == 0 &&
+        g_strcmp0(a->user, b->user) == 0 &&
+        a->port == b->port;
+}
+
+static gchar *
+profile_get_string(GKeyFile *keyfile, const gchar *uuid, const gchar *key)
+{
+    gchar *value = g_key_file_get_string(keyfile, uuid, key, NULL);
+
+    if (value != NULL && *value == '\0')
+        g_clear_pointer(&value, g_free);
+
+    return value;
+}
+
+static void
+profile_set_string(GKeyFile *keyfile, const gchar *uuid,
+                   const gchar *key, const gchar *value)
+{
+    if (value != NULL)
+        g_key_file_set_string(keyfile, uuid, key, value);
+    else
+        g_key_file_remove_key(keyfile, uuid, key, NULL);
+}
+
+/**
+ * virt_viewer_connection_profile_load:
+ * @keyfile: the settings
+ * @uuid: the guest UUID
+ *
+ * Returns: the connection profile saved for @uuid, or NULL if there is
+ * none or it is incomplete
+ */
+VirtViewerConnectionProfile *
+virt_viewer_connection_profile_load(GKeyFile *keyfile, const gchar *uuid)
+{
+    VirtViewerConnectionProfile *profile;
+
+    g_return_val_if_fail(keyfile != NULL, NULL);
+    g_return_val_if_fail(uuid != NULL, NULL);
+
+    if (!g_key_file_has_key(keyfile, uuid, "connection-type", NULL))
+        return NULL;
+
+    profile = g_new0(VirtViewerConnectionProfile, 1);
+    profile->uuid = g_strdup(uuid);
+    profile->name = profile_get_string(keyfile, uuid, "connection-guest-name");
+    profile->uri = profile_get_string(keyfile, uuid, "connection-libvirt-uri");
+    profile->type = profile_get_string(keyfile, uuid, "connection-type");
+    profile->ghost = profile_get_string(keyfile, uuid, "connection-graphics-host");
+    profile->gport = profile_get_string(keyfile, uuid, "connection-graphics-port");
+    profile->gtlsport = profile_get_string(keyfile, uuid, "connection-graphics-tls-port");
+    profile->unixsock = profile_get_string(keyfile, uuid, "connection-graphics-socket");
+    profile->host = profile_get_string(keyfile, uuid, "connection-host");
+    profile->transport = profile_get_string(keyfile, uuid, "connection-transport");
+    profile->user = profile_get_string(keyfile, uuid, "connection-user");
+    profile->port = g_key_file_get_integer(keyfile, uuid, "connection-port", NULL);
+
+    if (profile->type == NULL ||
+        !((profile->ghost && profile->gport) || profile->unixsock)) {
+        g_debug("Ignoring incomplete connection profile of %s", uuid);
+        g_clear_pointer(&profile, virt_viewer_connection_profile_free);
+    }
+
+    return profile;
+}
+
+/**
+ * virt_viewer_connection_profile_save:
+ * @profile: the profile to remember, with its uuid set
+ * @keyfile: the settings
+ *
+ * Returns: whether @keyfile was modified
+ */
+gboolean
+virt_viewer_connection_profile_save(const VirtViewerConnectionProfile *profile,
+                                    GKeyFile *keyfile)
+{
+    VirtViewerConnectionProfile *saved;
+    const gchar *uuid;
+    gboolean unchanged;
+
+    g_return_val_if_fail(profile != NULL, FALSE);
+    g_return_val_if_fail(profile->uuid != NULL, FALSE);
+    g_return_val_if_fail(profile->type != NULL, FALSE);
+    g_return_val_if_fail(keyfile != NULL, FALSE);
+
+    uuid = profile->uuid;
+    saved = virt_viewer_connection_profile_load(keyfile, uuid);
+    unchanged = virt_viewer_connection_profile_equal(saved, profile) &&
+        g_strcmp0(saved->name, profile->name) == 0 &&
+        g_strcmp0(saved->uri, profile->uri) == 0;
+    virt_viewer_connection_profile_free(saved);
+    if (unchanged)
+        return FALSE;
+
+    profile_set_string(keyfile, uuid, "connection-guest-name", profile->name);
+    profile_set_string(keyfile, uuid, "connection-libvirt-uri", profile->uri);
+    profile_set_string(keyfile, uuid, "connection-type", profile->type);
+    profile_set_string(keyfile, uuid, "connection-graphics-host", profile->ghost);
+    profile_set_string(keyfile, uuid, "connection-graphics-port", profile->gport);
+    profile_set_string(keyfile, uuid, "connection-graphics-tls-port", profile->gtlsport);
+    profile_set_string(keyfile, uuid, "connection-graphics-socket", profile->unixsock);
+    profile_set_string(keyfile, uuid, "connection-host", profile->host);
+    profile_set_string(keyfile, uuid, "connection-transport", profile->transport);
+    profile_set_string(keyfile, uuid, "connection-user", profile->user);
+    g_key_file_set_integer(keyfile, uuid, "connection-port", profile->port);
+
+    return TRUE;
+}
+
+static const gchar *profile_keys[] = {
+    "connection-guest-name",
+    "connection-libvirt-uri",
+    "connection-type",
+    "connection-graphics-host",
+    "connection-graphics-port",
+    "connection-graphics-tls-port",
+    "connection-graphics-socket",
+    "connection-host",
+    "connection-transport",
+    "connection-user",
+    "connection-port",
+};
+
+/**
+ * virt_viewer_connection_profile_remove:
+ * @keyfile: the settings
+ * @uuid: the guest UUID
+ *
+ * Returns: whether @keyfile was modified
+ */
+gboolean
+virt_viewer_connection_profile_remove(GKeyFile *keyfile, const gchar *uuid)
+{
+    gboolean removed = FALSE;
+    gsize i;
+
+    g_return_val_if_fail(keyfile != NULL, FALSE);
+    g_return_val_if_fail(uuid != NULL, FALSE);
+
+    for (i = 0; i < G_N_ELEMENTS(profile_keys); i++)
+        removed |= g_key_file_remove_key(keyfile, uuid, profile_keys[i], NULL);
+
+    return removed;
+}
+
+/**
+ * virt_viewer_connection_profile_find:
+ * @keyfile: the settings
+ * @uri: (allow-none): the libvirt URI, NULL for the default one
+ * @domkey: the guest UUID or name, as given on the command line
+ *
+ * Returns: the connection profile of the guest @domkey reached through
+ * @uri, or NULL if there is none or @domkey names several guests
+ */
+VirtViewerConnectionProfile *
+virt_viewer_connection_profile_find(GKeyFile *keyfile,
+                                    const gchar *uri,
+                                    const gchar *domkey)
+{
+    VirtViewerConnectionProfile *found = NULL;
+    guint n_named = 0;
+    gchar **groups;
+    gsize i;
+
+    g_return_val_if_fail(keyfile != NULL, NULL);
+    g_return_val_if_fail(domkey != NULL, NULL);
+
+    groups = g_key_file_get_groups(keyfile, NULL);
+    for (i = 0; groups[i] != NULL; i++) {
+        VirtViewerConnectionProfile *profile;
+
+        profile = virt_viewer_connection_profile_load(keyfile, groups[i]);
+        if (profile == NULL)
+            continue;
+
+        if (g_strcmp0(profile->uri, uri) == 0 &&
+            g_ascii_strcasecmp(profile->uuid, domkey) == 0) {
+            virt_viewer_connection_profile_free(found);
+            found = profile;
+            n_named = 0;
+            break;
+        }
+
+        if (g_strcmp0(profile->uri, uri) == 0 &&
+            g_strcmp0(profile->name, domkey) == 0 && n_named++ == 0) {
+            found = profile;
+            continue;
+        }
+
+        virt_viewer_connection_profile_free(profile);
+    }
+    g_strfreev(groups);
+
+    /* the guest was redefined or renamed, don't guess */
+    if (n_named > 1) {
+        g_debug("Several connection profiles for guest %s", domkey);
+        g_clear_pointer(&found, virt_viewer_connection_profile_free);
+    }
+
+    return found;
+}
+
+/*
+ * Local variables:
+ *  c-indent-level: 4
+ *  c-basic-offset: 4
+ *  indent-tabs-mode: nil
+ * End:
+ */
@@ -0,0 +1,71 @@
+/*
+ * Virt Viewer: A virtual machine console viewer
+ *
+ * Copyright (C) 2016 Red Hat, Inc.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#ifndef VIRT_VIEWER_CONNECTION_PROFILE_H
+#define VIRT_VIEWER_CONNECTION_PROFILE_H
+
+#include <glib.h>
+
+G_BEGIN_DECLS
+
+/* How the display of a guest was reached, as given to
+ * virt_viewer_app_set_connect_info(). Either ghost and gport, or
+ * unixsock are set; host, transport, user and port describe the
+ * libvirt connection the display may be tunnelled through. */
+typedef struct {
+    gchar *uuid;
+    gchar *name;
+    gchar *uri;     /* the libvirt URI, NULL for the default one */
+    gchar *type;
+    gchar *ghost;
+    gchar *gport;
+    gchar *gtlsport;
+    gchar *unixsock;
+    gchar *host;
+    gchar *transport;
+    gchar *user;
+    gint port;
+} VirtViewerConnectionProfile;
+
+VirtViewerConnectionProfile *virt_viewer_connection_profile_copy(const VirtViewerConnectionProfile *profile);
+void virt_viewer_connection_profile_free(VirtViewerConnectionProfile *profile);
+gboolean virt_viewer_connection_profile_equal(const VirtViewerConnectionProfile *a,
+                                              const VirtViewerConnectionProfile *b);
+
+VirtViewerConnectionProfile *virt_viewer_connection_profile_load(GKeyFile *keyfile,
+                                                                 const gchar *uuid);
+gboolean virt_viewer_connection_profile_save(const VirtViewerConnectionProfile *profile,
+                                             GKeyFile *keyfile);
+gboolean virt_viewer_connection_profile_remove(GKeyFile *keyfile, const gchar *uuid);
+VirtViewerConnectionProfile *virt_viewer_connection_profile_find(GKeyFile *keyfile,
+                                                                 const gchar *uri,
+                                                                 const gchar *domkey);
+
+G_END_DECLS
+
+#endif /* VIRT_VIEWER_CONNECTION_PROFILE_H */
+
+/*
+ * Local variables:
+ *  c-indent-level: 4
+ *  c-basic-offset: 4
+ *  indent-tabs-mode: nil
+ * End:
+ */
@@ -47,6 +47,25 @@ struct _VirtViewerDisplaySpicePrivate {
     AutoResizeState auto_resize;
     guint x;
     guint y;
+
+    /* the primary surface, drawn through the scaler unless the scaling
+     * mode is automatic */
+    VirtViewerScaler *scaler;
+    gulong draw_id;
+    guchar *primary_data; /* owned by spice-gtk */
+    gint primary_width;
+    gint primary_height;
+    gint primary_stride;
+
+    /* the server mode cursor, which spice-gtk draws along with the
+     * primary surface */
+    GdkPixbuf *cursor;
+    gint cursor_hot_x;
+    gint cursor_hot_y;
+    gint cursor_x;
+    gint cursor_y;
+    gboolean cursor_hidden;
+    gboolean mouse_grabbed;
 };
 
 #define VIRT_VIEWER_DISPLAY_SPICE_GET_PRIVATE(o) (G_TYPE_INSTANCE_GET_PRIVATE((o), VIRT_VIEWER_TYPE_DISPLAY_SPICE, VirtViewerDisplaySpicePrivate))
@@ -60,11 +79,17 @@ static void virt_viewer_display_spice_close(VirtViewerDisplay *display G_GNUC_UN
 static gboolean virt_viewer_display_spice_selectable(VirtViewerDisplay *display);
 static void virt_viewer_display_spice_enable(VirtViewerDisplay *display);
 static void virt_viewer_display_spice_disable(VirtViewerDisplay *display);
+static void virt_viewer_display_spice_set_scaling_mode(VirtViewerDisplay *display,
+                                                       VirtViewerScalingMode mode);
+static void virt_viewer_display_spice_finalize(GObject *object);
 
 static void
 virt_viewer_display_spice_class_init(VirtViewerDisplaySpiceClass *klass)
 {
     VirtViewerDisplayClass *dclass = VIRT_VIEWER_DISPLAY_CLASS(klass);
+    GObjectClass *oclass = G_OBJECT_CLASS(klass);
+
+    oclass->finalize = virt_viewer_display_spice_finalize;
 
     dclass->send_keys = virt_viewer_display_spice_send_keys;
     dclass->get_pixbuf = virt_viewer_display_spice_get_pixbuf;
@@ -73,6 +98,7 @@ virt_viewer_display_spice_class_init(VirtViewerDisplaySpiceClass *klass)
     dclass->selectable = virt_viewer_display_spice_selectable;
     dclass->enable = virt_viewer_display_spice_enable;
     dclass->disable = virt_viewer_display_spice_disable;
+    dclass->set_scaling_mode = virt_viewer_display_spice_set_scaling_mode;
 
     g_type_class_add_private(klass, sizeof(VirtViewerDisplaySpicePrivate));
 }
@@ -130,6 +156,8 @@ virt_viewer_display_spice_init(VirtViewerDisplaySpice *self G_GNUC_UNUSED)
 {
     self->priv = VIRT_VIEWER_DISPLAY_SPICE_GET_PRIVATE(self);
     self->priv->auto_resize = AUTO_RESIZE_ALWAYS;
+    self->priv->cursor_x = -1;
+    self->priv->cursor_y = -1;
 
     g_signal_connect(self, "notify::show-hint", G_CALLBACK(show_hint_changed), NULL);
 }
@@ -186,6 +214,10 @@ virt_viewer_display_spice_mouse_grab(SpiceDisplay *display G_GNUC_UNUSED,
                                      int grabbed,
                                      VirtViewerDisplaySpice *self)
 {
+    self->priv->mouse_grabbed = grabbed;
+    if (self->priv->scaler != NULL)
+        gtk_widget_queue_draw(GTK_WIDGET(self->priv->display));
+
     if (grabbed)
         g_signal_emit_by_name(self, "display-pointer-grab");
     else
@@ -273,6 +305,285 @@ fullscreen_changed(VirtViewerDisplaySpice *self,
         self->priv->auto_resize = AUTO_RESIZE_ALWAYS;
 }
 
+static void
+virt_viewer_display_spice_finalize(GObject *object)
+{
+    VirtViewerDisplaySpice *self = VIRT_VIEWER_DISPLAY_SPICE(object);
+
+    virt_viewer_scaler_free(self->priv->scaler);
+    g_clear_object(&self->priv->cursor);
+
+    G_OBJECT_CLASS(virt_viewer_display_spice_parent_class)->finalize(object);
+}
+
+/*
+ * Points the scaler at the part of the primary surface shown by this
+ * display, which is only a monitor of it with multi-head guests.
+ */
+static void
+update_scaler_source(VirtViewerDisplaySpice *self)
+{
+    VirtViewerDisplaySpicePrivate *priv = self->priv;
+    cairo_surface_t *surface;
+    guint width, height;
+
+    if (priv->scaler == NULL)
+        return;
+
+    virt_viewer_display_get_desktop_size(VIRT_VIEWER_DISPLAY(self), &width, &height);
+    if (priv->primary_data == NULL ||
+        priv->x + width > (guint)priv->primary_width ||
+        priv->y + height > (guint)priv->primary_height) {
+        virt_viewer_scaler_set_source(priv->scaler, NULL);
+        return;
+    }
+
+    surface = cairo_image_surface_create_for_data(priv->primary_data +
+                                                  priv->y * priv->primary_stride +
+                                                  priv->x * 4,
+                                                  CAIRO_FORMAT_RGB24,
+                                                  width, height,
+                                                  priv->primary_stride);
+    virt_viewer_scaler_set_source(priv->scaler, surface);
+    cairo_surface_destroy(surface);
+}
+
+static void
+display_primary_create(SpiceChannel *channel G_GNUC_UNUSED,
+                       gint format,
+                       gint width,
+                       gint height,
+                       gint stride,
+                       gint shmid G_GNUC_UNUSED,
+                       gpointer imgdata,
+                       VirtViewerDisplaySpice *self)
+{
+    VirtViewerDisplaySpicePrivate *priv = self->priv;
+
+    /* the other formats are left to spice-gtk */
+    priv->primary_data = format == SPICE_SURFACE_FMT_32_xRGB ? imgdata : NULL;
+    priv->primary_width = width;
+    priv->primary_height = height;
+    priv->primary_stride = stride;
+    update_scaler_source(self);
+}
+
+static void
+display_primary_destroy(SpiceChannel *channel G_GNUC_UNUSED,
+                        VirtViewerDisplaySpice *self)
+{
+    self->priv->primary_data = NULL;
+    update_scaler_source(self);
+}
+
+static void
+display_invalidate(SpiceChannel *channel G_GNUC_UNUSED,
+                   gint x,
+                   gint y,
+                   gint width,
+                   gint height,
+                   VirtViewerDisplay *display)
+{
+    VirtViewerDisplaySpice *self = VIRT_VIEWER_DISPLAY_SPICE(display);
+
+    virt_viewer_display_damage(display);
+
+    if (self->priv->scaler != NULL) {
+        GdkRectangle area = {
+            x - (gint)self->priv->x, y - (gint)self->priv->y, width, height
+        };
+
+        virt_viewer_scaler_invalidate(self->priv->scaler, &area);
+    }
+}
+
+static void
+cursor_queue_draw(VirtViewerDisplaySpice *self)
+{
+    if (self->priv->scaler != NULL)
+        gtk_widget_queue_draw(GTK_WIDGET(self->priv->display));
+}
+
+static void
+cursor_set(SpiceCursorChannel *channel G_GNUC_UNUSED,
+           gint width,
+           gint height,
+           gint hot_x,
+           gint hot_y,
+           gpointer rgba,
+           VirtViewerDisplaySpice *self)
+{
+    VirtViewerDisplaySpicePrivate *priv = self->priv;
+
+    g_clear_object(&priv->cursor);
+    if (rgba != NULL) {
+        GdkPixbuf *pixbuf = gdk_pixbuf_new_from_data(rgba, GDK_COLORSPACE_RGB, TRUE, 8,
+                                                     width, height, width * 4,
+                                                     NULL, NULL);
+        priv->cursor = gdk_pixbuf_copy(pixbuf);
+        g_object_unref(pixbuf);
+    }
+    priv->cursor_hot_x = hot_x;
+    priv->cursor_hot_y = hot_y;
+    priv->cursor_hidden = FALSE;
+    cursor_queue_draw(self);
+}
+
+static void
+cursor_move(SpiceCursorChannel *channel G_GNUC_UNUSED,
+            gint x,
+            gint y,
+            VirtViewerDisplaySpice *self)
+{
+    self->priv->cursor_x = x;
+    self->priv->cursor_y = y;
+    cursor_queue_draw(self);
+}
+
+static void
+cursor_hide(SpiceCursorChannel *channel G_GNUC_UNUSED,
+            VirtViewerDisplaySpice *self)
+{
+    self->priv->cursor_hidden = TRUE;
+    cursor_queue_draw(self);
+}
+
+static void
+cursor_reset(SpiceCursorChannel *channel G_GNUC_UNUSED,
+             VirtViewerDisplaySpice *self)
+{
+    g_clear_object(&self->priv->cursor);
+    cursor_queue_draw(self);
+}
+
+static void
+session_channel_new(SpiceSession *session G_GNUC_UNUSED,
+                    SpiceChannel *channel,
+                    VirtViewerDisplaySpice *self)
+{
+    gint id, display_id;
+
+    if (!SPICE_IS_CURSOR_CHANNEL(channel) || self->priv->channel == NULL)
+        return;
+
+    g_object_get(channel, "channel-id", &id, NULL);
+    g_object_get(self->priv->channel, "channel-id", &display_id, NULL);
+    if (id != display_id)
+        return;
+
+    virt_viewer_signal_connect_object(channel, "cursor-set",
+                                      G_CALLBACK(cursor_set), self, 0);
+    virt_viewer_signal_connect_object(channel, "cursor-move",
+                                      G_CALLBACK(cursor_move), self, 0);
+    virt_viewer_signal_connect_object(channel, "cursor-hide",
+                                      G_CALLBACK(cursor_hide), self, 0);
+    virt_viewer_signal_connect_object(channel, "cursor-reset",
+                                      G_CALLBACK(cursor_reset), self, 0);
+}
+
+/*
+ * Draws the guest cursor over the scaled display, where spice-gtk would
+ * have drawn it: in server mouse mode, while the pointer is grabbed.
+ */
+static void
+draw_cursor(VirtViewerDisplaySpice *self,
+            cairo_t *cr,
+            const GdkRectangle *dest,
+            gdouble scale)
+{
+    VirtViewerDisplaySpicePrivate *priv = self->priv;
+    SpiceMainChannel *main_channel;
+    gint mouse_mode;
+
+    if (priv->cursor == NULL || priv->cursor_hidden || !priv->mouse_grabbed ||
+        priv->cursor_x < 0 || priv->cursor_y < 0)
+        return;
+
+    main_channel = get_main(VIRT_VIEWER_DISPLAY(self));
+    if (main_channel == NULL)
+        return;
+
+    g_object_get(main_channel, "mouse-mode", &mouse_mode, NULL);
+    if (mouse_mode != SPICE_MOUSE_MODE_SERVER)
+        return;
+
+    cairo_save(cr);
+    cairo_rectangle(cr, dest->x, dest->y, dest->width, dest->height);
+    cairo_clip(cr);
+    cairo_translate(cr,
+                    dest->x + (priv->cursor_x - (gint)priv->x - priv->cursor_hot_x) * scale,
+                    dest->y + (priv->cursor_y - (gint)priv->y - priv->cursor_hot_y) * scale);
+    cairo_scale(cr, scale, scale);
+    gdk_cairo_set_source_pixbuf(cr, priv->cursor, 0, 0);
+    cairo_paint(cr);
+    cairo_restore(cr);
+}
+
+/*
+ * Replaces the drawing of the SpiceDisplay when a scaling mode is set,
+ * the cursor included.
+ */
+static gboolean
+spice_display_draw(GtkWidget *widget,
+                   cairo_t *cr,
+                   VirtViewerDisplaySpice *self)
+{
+    cairo_surface_t *source = virt_viewer_scaler_get_source(self->priv->scaler);
+    GtkAllocation allocation;
+    GdkRectangle dest;
+    gint width, height;
+
+    if (source == NULL)
+        return FALSE;
+
+    gtk_widget_get_allocation(widget, &allocation);
+    width = cairo_image_surface_get_width(source);
+    height = cairo_image_surface_get_height(source);
+
+    /* scaled to fit, keeping the aspect ratio, like spice-gtk does */
+    if ((gint64)allocation.width * height > (gint64)allocation.height * width) {
+        dest.height = allocation.height;
+        dest.width = ((gint64)allocation.height * width + height / 2) / height;
+    } else {
+        dest.width = allocation.width;
+        dest.height = ((gint64)allocation.width * height + width / 2) / width;
+    }
+    dest.x = (allocation.width - dest.width) / 2;
+    dest.y = (allocation.height - dest.height) / 2;
+
+    cairo_set_source_rgb(cr, 0, 0, 0);
+    cairo_paint(cr);
+    virt_viewer_scaler_draw(self->priv->scaler, cr,
+                            virt_viewer_display_get_scaling_mode(VIRT_VIEWER_DISPLAY(self)),
+                            &dest);
+    draw_cursor(self, cr, &dest, (gdouble)dest.width / width);
+
+    return TRUE;
+}
+
+static void
+virt_viewer_display_spice_set_scaling_mode(VirtViewerDisplay *display,
+                                           VirtViewerScalingMode mode)
+{
+    VirtViewerDisplaySpice *self = VIRT_VIEWER_DISPLAY_SPICE(display);
+    VirtViewerDisplaySpicePrivate *priv = self->priv;
+
+    if (mode == VIRT_VIEWER_SCALING_AUTO) {
+        if (priv->draw_id != 0) {
+            g_signal_handler_disconnect(priv->display, priv->draw_id);
+            priv->draw_id = 0;
+        }
+        g_clear_pointer(&priv->scaler, virt_viewer_scaler_free);
+    } else if (priv->scaler == NULL) {
+        priv->scaler = virt_viewer_scaler_new();
+        update_scaler_source(self);
+        priv->draw_id = g_signal_connect(priv->display, "draw",
+                                         G_CALLBACK(spice_display_draw), self);
+    }
+
+    gtk_widget_queue_draw(GTK_WIDGET(priv->display));
+}
+
 GtkWidget *
 virt_viewer_display_spice_new(VirtViewerSessionSpice *session,
                               SpiceChannel *channel,
@@ -282,6 +593,7 @@ virt_viewer_display_spice_new(VirtViewerSessionSpice *session,
     VirtViewerApp *app;
     gint channelid;
     SpiceSession *s;
+    GList *l, *channels;
 
     g_return_val_if_fail(SPICE_IS_DISPLAY_CHANNEL(channel), NULL);
 
@@ -303,6 +615,13 @@ virt_viewer_display_spice_new(VirtViewerSessionSpice *session,
 
     g_object_get(session, "spice-session", &s, NULL);
     self->priv->display = spice_display_new_with_monitor(s, channelid, monitorid);
+
+    virt_viewer_signal_connect_object(s, "channel-new",
+                                      G_CALLBACK(session_channel_new), self, 0);
+    channels = spice_session_get_channels(s);
+    for (l = channels; l != NULL; l = l->next)
+        session_channel_new(s, l->data, self);
+    g_list_free(channels);
     g_object_unref(s);
 
     virt_viewer_signal_connect_object(self->priv->display, "notify::ready",
@@ -319,6 +638,12 @@ virt_viewer_display_spice_new(VirtViewerSessionSpice *session,
                  "scaling", TRUE,
                  NULL);
 
+    virt_viewer_signal_connect_object(channel, "display-invalidate",
+                                      G_CALLBACK(display_invalidate), self, 0);
+    virt_viewer_signal_connect_object(channel, "display-primary-create",
+                                      G_CALLBACK(display_primary_create), self, 0);
+    virt_viewer_signal_connect_object(channel, "display-primary-destroy",
+                                      G_CALLBACK(display_primary_destroy), self, 0);
     virt_viewer_signal_connect_object(self->priv->display, "keyboard-grab",
                                       G_CALLBACK(virt_viewer_display_spice_keyboard_grab), self, 0);
     virt_viewer_signal_connect_object(self->priv->display, "mouse-grab",
@@ -388,10 +713,9 @@ virt_viewer_display_spice_set_desktop(VirtViewerDisplay *display,
     g_object_set(G_OBJECT(display), "desktop-width", width, "desktop-height", height, NULL);
     priv->x = x;
     priv->y = y;
+    update_scaler_source(VIRT_VIEWER_DISPLAY_SPICE(display));
 
-    virt_viewer_display_queue_resize(display);
-
-    g_signal_emit_by_name(display, "display-desktop-resize");
+    virt_viewer_display_desktop_resized(display);
 }
 
 /*
@@ -41,12 +41,16 @@ struct _VirtViewerDisplayVncPrivate {
 static void virt_viewer_display_vnc_send_keys(VirtViewerDisplay* display, const guint *keyvals, int nkeyvals);
 static GdkPixbuf *virt_viewer_display_vnc_get_pixbuf(VirtViewerDisplay* display);
 static void virt_viewer_display_vnc_close(VirtViewerDisplay *display);
+static void virt_viewer_display_vnc_set_scaling_mode(VirtViewerDisplay *display,
+                                                     VirtViewerScalingMode mode);
 
 static void
 virt_viewer_display_vnc_finalize(GObject *obj)
 {
     VirtViewerDisplayVnc *vnc = VIRT_VIEWER_DISPLAY_VNC(obj);
 
+    /* the session keeps the VncDisplay */
+    g_signal_handlers_disconnect_by_data(vnc->priv->vnc, vnc);
     g_object_unref(vnc->priv->vnc);
 
     G_OBJECT_CLASS(virt_viewer_display_vnc_parent_class)->finalize(obj);
@@ -73,6 +77,7 @@ virt_viewer_display_vnc_class_init(VirtViewerDisplayVncClass *klass)
     dclass->get_pixbuf = virt_viewer_display_vnc_get_pixbuf;
     dclass->close = virt_viewer_display_vnc_close;
     dclass->release_cursor = virt_viewer_display_vnc_release_cursor;
+    dclass->set_scaling_mode = virt_viewer_display_vnc_set_scaling_mode;
 
     g_type_class_add_private(klass, sizeof(VirtViewerDisplayVncPrivate));
 }
@@ -157,6 +162,26 @@ virt_viewer_display_vnc_send_keys(VirtViewerDisplay* display,
 }
 
 
+/*
+ * gtk-vnc only lets us pick between nearest and smoothed scaling, and
+ * only with the versions which have the "smoothing" property.
+ */
+static void
+virt_viewer_display_vnc_set_scaling_mode(VirtViewerDisplay *display,
+                                         VirtViewerScalingMode mode)
+{
+    VirtViewerDisplayVnc *self = VIRT_VIEWER_DISPLAY_VNC(display);
+
+    g_return_if_fail(self->priv->vnc != NULL);
+
+    if (!g_object_class_find_property(G_OBJECT_GET_CLASS(self->priv->vnc), "smoothing")) {
+        g_debug("gtk-vnc can't change its scaling mode");
+        return;
+    }
+
+    g_object_set(self->priv->vnc, "smoothing", mode != VIRT_VIEWER_SCALING_NEAREST, NULL);
+}
+
 static GdkPixbuf *
 virt_viewer_display_vnc_get_pixbuf(VirtViewerDisplay* display)
 {
@@ -26,10 +26,16 @@
 
 #include <locale.h>
 #include <math.h>
+#include <string.h>
 
 #include "virt-viewer-session.h"
 #include "virt-viewer-display.h"
 #include "virt-viewer-util.h"
+#include "virt-viewer-frame-stats.h"
+
+#define HUD_REFRESH_INTERVAL 500 /* ms */
+#define HUD_MARGIN 8
+#define HUD_PADDING 4
 
 #define VIRT_VIEWER_DISPLAY_GET_PRIVATE(o) (G_TYPE_INSTANCE_GET_PRIVATE((o), VIRT_VIEWER_TYPE_DISPLAY, VirtViewerDisplayPrivate))
 
@@ -43,6 +49,25 @@ struct _VirtViewerDisplayPrivate
     guint show_hint;
     VirtViewerSession *session;
     gboolean fullscreen;
+    gboolean reports_damage;
+    gboolean damaged;
+    guint resizes; /* desktop size changes */
+    guint resizes_coalesced;
+    guint relayout_id; /* tick callback */
+    guint allocations;
+    gint64 allocation_time; /* us */
+    gint64 allocation_time_max;
+    VirtViewerScalingMode scaling_mode;
+    gboolean integer_scaling;
+
+    /* only set while the HUD is shown */
+    VirtViewerFrameStats *hud_stats;
+    PangoLayout *hud_layout;
+    GdkRectangle hud_area;
+    GtkWidget *hud_child;
+    gulong hud_draw_id;
+    gulong hud_key_press_id;
+    guint hud_timeout_id;
 };
 
 static void virt_viewer_display_get_preferred_width(GtkWidget *widget,
@@ -62,6 +87,8 @@ static void virt_viewer_display_get_property(GObject *object,
                                              GValue *value,
                                              GParamSpec *pspec);
 static void virt_viewer_display_grab_focus(GtkWidget *widget);
+static gboolean virt_viewer_display_draw(GtkWidget *widget, cairo_t *cr);
+static void virt_viewer_display_dispose(GObject *object);
 
 G_DEFINE_ABSTRACT_TYPE(VirtViewerDisplay, virt_viewer_display, GTK_TYPE_BIN)
 
@@ -88,11 +115,13 @@ virt_viewer_display_class_init(VirtViewerDisplayClass *class)
 
     object_class->set_property = virt_viewer_display_set_property;
     object_class->get_property = virt_viewer_display_get_property;
+    object_class->dispose = virt_viewer_display_dispose;
 
     widget_class->get_preferred_width = virt_viewer_display_get_preferred_width;
     widget_class->get_preferred_height = virt_viewer_display_get_preferred_height;
     widget_class->size_allocate = virt_viewer_display_size_allocate;
     widget_class->grab_focus = virt_viewer_display_grab_focus;
+    widget_class->draw = virt_viewer_display_draw;
 
     g_object_class_install_property(object_class,
                                     PROP_DESKTOP_WIDTH,
@@ -254,6 +283,21 @@ virt_viewer_display_init(VirtViewerDisplay *display)
     display->priv->desktopWidth = MIN_DISPLAY_WIDTH;
     display->priv->desktopHeight = MIN_DISPLAY_HEIGHT;
     display->priv->zoom_level = NORMAL_ZOOM_LEVEL;
+    display->priv->damaged = TRUE;
+}
+
+static void
+virt_viewer_display_dispose(GObject *object)
+{
+    VirtViewerDisplay *display = VIRT_VIEWER_DISPLAY(object);
+
+    virt_viewer_display_set_hud(display, FALSE);
+    if (display->priv->relayout_id != 0) {
+        gtk_widget_remove_tick_callback(GTK_WIDGET(display), display->priv->relayout_id);
+        display->priv->relayout_id = 0;
+    }
+
+    G_OBJECT_CLASS(virt_viewer_display_parent_class)->dispose(object);
 }
 
 GtkWidget*
@@ -353,7 +397,19 @@ static void virt_viewer_display_get_preferred_dimension_from_desktop(VirtViewerD
 {
     int border_width = gtk_container_get_border_width(GTK_CONTAINER(display));
 
-    if (virt_viewer_display_get_zoom(display)) {
+    if (display->priv->integer_scaling) {
+        guint zoom_level = virt_viewer_display_get_zoom_level(display);
+        gint scale_factor = gtk_widget_get_scale_factor(GTK_WIDGET(display));
+        double scale = (double) zoom_level * scale_factor / NORMAL_ZOOM_LEVEL;
+
+        /* the closest whole number of device pixels per guest pixel, or
+         * of guest pixels per device pixel */
+        if (scale >= 1)
+            *preferred_dim = round(desktop_dim * round(scale) / scale_factor);
+        else
+            *preferred_dim = round(desktop_dim / (round(1 / scale) * scale_factor));
+        *minimal_dim = round(minimal_size * zoom_level / (double) NORMAL_ZOOM_LEVEL);
+    } else if (virt_viewer_display_get_zoom(display)) {
         guint zoom_level = virt_viewer_display_get_zoom_level(display);
         *preferred_dim = round(desktop_dim * zoom_level / (double) NORMAL_ZOOM_LEVEL);
         *minimal_dim = round(minimal_size * zoom_level / (double) NORMAL_ZOOM_LEVEL);
@@ -406,11 +462,10 @@ virt_viewer_display_size_allocate(GtkWidget *widget,
     GtkAllocation child_allocation;
     gint width, height;
     gint border_width;
-    double desktopAspect;
-    double actualAspect;
     GtkWidget *child = gtk_bin_get_child(bin);
+    gint64 start = g_get_monotonic_time();
+    gint64 elapsed;
 
-    g_debug("Allocated %dx%d", allocation->width, allocation->height);
     gtk_widget_set_allocation(widget, allocation);
 
     if (priv->desktopWidth == 0 || priv->desktopHeight == 0 ||
@@ -422,24 +477,70 @@ virt_viewer_display_size_allocate(GtkWidget *widget,
     width  = MAX(MIN_DISPLAY_WIDTH, allocation->width - 2 * border_width);
     height = MAX(MIN_DISPLAY_HEIGHT, allocation->height - 2 * border_width);
 
-    desktopAspect = (double) priv->desktopWidth / (double) priv->desktopHeight;
-    actualAspect = (double) width / (double) height;
+    virt_viewer_fit_desktop(priv->desktopWidth, priv->desktopHeight, width, height,
+                            gtk_widget_get_scale_factor(widget), priv->integer_scaling,
+                            &child_allocation.width, &child_allocation.height);
 
-    if (actualAspect > desktopAspect) {
-        child_allocation.width = round(height * desktopAspect);
-        child_allocation.height = height;
-    } else {
-        child_allocation.width = width;
-        child_allocation.height = round(width / desktopAspect);
-    }
+    child_allocation.x = (width - child_allocation.width) / 2 + allocation->x + border_width;
+    child_allocation.y = (height - child_allocation.height) / 2 + allocation->y + border_width;
 
-    child_allocation.x = 0.5 * (width - child_allocation.width) + allocation->x + border_width;
-    child_allocation.y = 0.5 * (height - child_allocation.height) + allocation->y + border_width;
-
-    g_debug("Child allocate %dx%d", child_allocation.width, child_allocation.height);
     gtk_widget_size_allocate(child, &child_allocation);
+
+    elapsed = g_get_monotonic_time() - start;
+    priv->allocations++;
+    priv->allocation_time += elapsed;
+    priv->allocation_time_max = MAX(priv->allocation_time_max, elapsed);
 }
 
+static void
+virt_viewer_display_relayout(VirtViewerDisplay *display)
+{
+    virt_viewer_display_queue_resize(display);
+
+    g_signal_emit_by_name(display, "display-desktop-resize");
+}
+
+static gboolean
+relayout_tick(GtkWidget *widget,
+              GdkFrameClock *frame_clock G_GNUC_UNUSED,
+              gpointer user_data G_GNUC_UNUSED)
+{
+    VirtViewerDisplay *display = VIRT_VIEWER_DISPLAY(widget);
+
+    display->priv->relayout_id = 0;
+    virt_viewer_display_relayout(display);
+
+    return G_SOURCE_REMOVE;
+}
+
+/*
+ * Called by the implementations once the desktop size changed. Guests
+ * may change their resolution several times in a row, while booting
+ * for instance: the changes happening within one frame of a shown
+ * display only cause one relayout, on the next frame.
+ */
+void virt_viewer_display_desktop_resized(VirtViewerDisplay *display)
+{
+    VirtViewerDisplayPrivate *priv;
+
+    g_return_if_fail(VIRT_VIEWER_IS_DISPLAY(display));
+
+    priv = display->priv;
+    priv->resizes++;
+
+    if (priv->relayout_id != 0) {
+        priv->resizes_coalesced++;
+        return;
+    }
+
+    if (!gtk_widget_get_mapped(GTK_WIDGET(display))) {
+        virt_viewer_display_relayout(display);
+        return;
+    }
+
+    priv->relayout_id = gtk_widget_add_tick_callback(GTK_WIDGET(display),
+                                                     relayout_tick, NULL, NULL);
+}
 
 void virt_viewer_display_set_desktop_size(VirtViewerDisplay *display,
                                           guint width,
@@ -453,9 +554,7 @@ void virt_viewer_display_set_desktop_size(VirtViewerDisplay *display,
     priv->desktopWidth = width;
     priv->desktopHeight = height;
 
-    virt_viewer_display_queue_resize(display);
-
-    g_signal_emit_by_name(display, "display-desktop-resize");
+    virt_viewer_display_desktop_resized(display);
 }
 
 
@@ -637,6 +736,137 @@ void virt_viewer_display_release_cursor(VirtViewerDisplay *self)
     klass->release_cursor(self);
 }
 
+/*
+ * Called by the implementations which know when the content of the
+ * display changes. For the others, the display is always considered as
+ * damaged.
+ */
+void virt_viewer_display_damage(VirtViewerDisplay *self)
+{
+    g_return_if_fail(VIRT_VIEWER_IS_DISPLAY(self));
+
+    self->priv->reports_damage = TRUE;
+    self->priv->damaged = TRUE;
+}
+
+/* Whether the content of the display changed since the last call */
+gboolean virt_viewer_display_take_damage(VirtViewerDisplay *self)
+{
+    gboolean damaged;
+
+    g_return_val_if_fail(VIRT_VIEWER_IS_DISPLAY(self), FALSE);
+
+    damaged = self->priv->damaged || !self->priv->reports_damage;
+    self->priv->damaged = FALSE;
+
+    return damaged;
+}
+
+/* Whether the implementation tells when the content of the display
+ * changes, see virt_viewer_display_damage() */
+gboolean virt_viewer_display_reports_damage(VirtViewerDisplay *self)
+{
+    g_return_val_if_fail(VIRT_VIEWER_IS_DISPLAY(self), FALSE);
+
+    return self->priv->reports_damage;
+}
+
+/* The number of times the guest changed the size of the display */
+guint virt_viewer_display_get_resize_count(VirtViewerDisplay *self)
+{
+    g_return_val_if_fail(VIRT_VIEWER_IS_DISPLAY(self), 0);
+
+    return self->priv->resizes;
+}
+
+/**
+ * virt_viewer_display_set_scaling_mode:
+ * @mode: how to scale the guest display to the size of the widget
+ *
+ * Displays which can't honour @mode keep scaling the way their widget
+ * does.
+ */
+void virt_viewer_display_set_scaling_mode(VirtViewerDisplay *self,
+                                          VirtViewerScalingMode mode)
+{
+    VirtViewerDisplayClass *klass;
+
+    g_return_if_fail(VIRT_VIEWER_IS_DISPLAY(self));
+
+    if (self->priv->scaling_mode == mode)
+        return;
+
+    self->priv->scaling_mode = mode;
+    klass = VIRT_VIEWER_DISPLAY_GET_CLASS(self);
+    if (klass->set_scaling_mode)
+        klass->set_scaling_mode(self, mode);
+}
+
+VirtViewerScalingMode virt_viewer_display_get_scaling_mode(VirtViewerDisplay *self)
+{
+    g_return_val_if_fail(VIRT_VIEWER_IS_DISPLAY(self), VIRT_VIEWER_SCALING_AUTO);
+
+    return self->priv->scaling_mode;
+}
+
+/**
+ * virt_viewer_display_set_integer_scaling:
+ * @integer: whether to only scale the guest display by whole numbers of
+ * device pixels per guest pixel, or guest pixels per device pixel
+ *
+ * The zoom level then only gives the closest of those scales, and the
+ * guest display is not stretched to the allocation, so that it is drawn
+ * unscaled whenever it fits.
+ */
+void virt_viewer_display_set_integer_scaling(VirtViewerDisplay *self,
+                                             gboolean integer)
+{
+    g_return_if_fail(VIRT_VIEWER_IS_DISPLAY(self));
+
+    if (self->priv->integer_scaling == integer)
+        return;
+
+    self->priv->integer_scaling = integer;
+    virt_viewer_display_queue_resize(self);
+}
+
+gboolean virt_viewer_display_get_integer_scaling(VirtViewerDisplay *self)
+{
+    g_return_val_if_fail(VIRT_VIEWER_IS_DISPLAY(self), FALSE);
+
+    return self->priv->integer_scaling;
+}
+
+/**
+ * virt_viewer_display_get_relayout_stats:
+ * @allocations: (out) (allow-none): the number of size allocations
+ * @allocation_time: (out) (allow-none): the time spent allocating the
+ * display and the widget it wraps, in microseconds
+ * @allocation_time_max: (out) (allow-none): the longest allocation
+ * @coalesced: (out) (allow-none): the number of desktop size changes
+ * which did not cause a relayout of their own
+ */
+void virt_viewer_display_get_relayout_stats(VirtViewerDisplay *self,
+                                            guint *allocations,
+                                            gint64 *allocation_time,
+                                            gint64 *allocation_time_max,
+                                            guint *coalesced)
+{
+    VirtViewerDisplayPrivate *priv;
+
+    g_return_if_fail(VIRT_VIEWER_IS_DISPLAY(self));
+
+    priv = self->priv;
+    if (allocations)
+        *allocations = priv->allocations;
+    if (allocation_time)
+        *allocation_time = priv->allocation_time;
+    if (allocation_time_max)
+        *allocation_time_max = priv->allocation_time_max;
+    if (coalesced)
+        *coalesced = priv->resizes_coalesced;
+}
+
 gboolean virt_viewer_display_get_selectable(VirtViewerDisplay *self)
 {
     VirtViewerDisplayClass *klass;
@@ -733,6 +963,165 @@ virt_viewer_display_get_nth(VirtViewerDisplay *self)
     return self->priv->nth_display;
 }
 
+/*
+ * The HUD is drawn over the top left corner of the guest display. While
+ * it is hidden, no handler is connected and no timer is running.
+ */
+static gboolean
+virt_viewer_display_draw(GtkWidget *widget, cairo_t *cr)
+{
+    VirtViewerDisplayPrivate *priv = VIRT_VIEWER_DISPLAY(widget)->priv;
+
+    GTK_WIDGET_CLASS(virt_viewer_display_parent_class)->draw(widget, cr);
+
+    if (priv->hud_layout == NULL)
+        return FALSE;
+
+    cairo_save(cr);
+    cairo_set_source_rgba(cr, 0, 0, 0, 0.6);
+    gdk_cairo_rectangle(cr, &priv->hud_area);
+    cairo_fill(cr);
+    cairo_set_source_rgb(cr, 1, 1, 1);
+    cairo_move_to(cr, priv->hud_area.x + HUD_PADDING, priv->hud_area.y + HUD_PADDING);
+    pango_cairo_show_layout(cr, priv->hud_layout);
+    cairo_restore(cr);
+
+    return FALSE;
+}
+
+static gboolean
+hud_child_draw(GtkWidget *child,
+               cairo_t *cr,
+               VirtViewerDisplay *self)
+{
+    VirtViewerDisplayPrivate *priv = self->priv;
+    GtkAllocation allocation, child_allocation;
+    GdkRectangle clip, hud;
+
+    gtk_widget_get_allocation(GTK_WIDGET(self), &allocation);
+    gtk_widget_get_allocation(child, &child_allocation);
+
+    /* the periodic refresh of the HUD itself is not a frame */
+    if (gdk_cairo_get_clip_rectangle(cr, &clip)) {
+        clip.x += child_allocation.x - allocation.x;
+        clip.y += child_allocation.y - allocation.y;
+        gdk_rectangle_union(&clip, &priv->hud_area, &hud);
+        if (hud.x == priv->hud_area.x && hud.y == priv->hud_area.y &&
+            hud.width == priv->hud_area.width && hud.height == priv->hud_area.height)
+            return FALSE;
+    }
+
+    virt_viewer_frame_stats_add_frame(priv->hud_stats, g_get_monotonic_time());
+
+    return FALSE;
+}
+
+static gboolean
+hud_child_key_press(GtkWidget *child G_GNUC_UNUSED,
+                    GdkEvent *event G_GNUC_UNUSED,
+                    VirtViewerDisplay *self)
+{
+    virt_viewer_frame_stats_key_press(self->priv->hud_stats, g_get_monotonic_time());
+
+    return FALSE;
+}
+
+static gboolean
+hud_refresh(gpointer user_data)
+{
+    VirtViewerDisplay *self = user_data;
+    VirtViewerDisplayPrivate *priv = self->priv;
+    GtkWidget *widget = GTK_WIDGET(self);
+    GtkAllocation allocation, child_allocation;
+    GdkRectangle old = priv->hud_area;
+    gint64 now = g_get_monotonic_time();
+    guint64 bytes;
+    gchar *text;
+
+    if (priv->session != NULL &&
+        virt_viewer_session_get_bytes_received(priv->session, &bytes))
+        virt_viewer_frame_stats_set_bytes(priv->hud_stats, bytes, now);
+
+    text = virt_viewer_frame_stats_format(priv->hud_stats, now);
+    if (priv->hud_layout == NULL)
+        priv->hud_layout = gtk_widget_create_pango_layout(widget, text);
+    else
+        pango_layout_set_text(priv->hud_layout, text, -1);
+    g_free(text);
+
+    gtk_widget_get_allocation(widget, &allocation);
+    priv->hud_area.x = HUD_MARGIN;
+    priv->hud_area.y = HUD_MARGIN;
+    if (priv->hud_child != NULL) {
+        gtk_widget_get_allocation(priv->hud_child, &child_allocation);
+        priv->hud_area.x += MAX(0, child_allocation.x - allocation.x);
+        priv->hud_area.y += MAX(0, child_allocation.y - allocation.y);
+    }
+    pango_layout_get_pixel_size(priv->hud_layout,
+                                &priv->hud_area.width, &priv->hud_area.height);
+    priv->hud_area.width += 2 * HUD_PADDING;
+    priv->hud_area.height += 2 * HUD_PADDING;
+
+    if (old.width > 0 && old.height > 0)
+        gtk_widget_queue_draw_area(widget, old.x, old.y, old.width, old.height);
+    gtk_widget_queue_draw_area(widget, priv->hud_area.x, priv->hud_area.y,
+                               priv->hud_area.width, priv->hud_area.height);
+
+    return G_SOURCE_CONTINUE;
+}
+
+/**
+ * virt_viewer_display_set_hud:
+ * @hud: whether to show the frame rate, frame intervals, input latency
+ * and session traffic over the display
+ */
+void virt_viewer_display_set_hud(VirtViewerDisplay *self, gboolean hud)
+{
+    VirtViewerDisplayPrivate *priv;
+
+    g_return_if_fail(VIRT_VIEWER_IS_DISPLAY(self));
+
+    priv = self->priv;
+    if (hud == (priv->hud_stats != NULL))
+        return;
+
+    if (hud) {
+        GtkWidget *child = gtk_bin_get_child(GTK_BIN(self));
+
+        priv->hud_stats = virt_viewer_frame_stats_new();
+        if (child != NULL) {
+            priv->hud_child = g_object_ref(child);
+            priv->hud_draw_id = g_signal_connect_after(child, "draw",
+                                                       G_CALLBACK(hud_child_draw), self);
+            priv->hud_key_press_id = g_signal_connect(child, "key-press-event",
+                                                      G_CALLBACK(hud_child_key_press), self);
+        }
+        priv->hud_timeout_id = g_timeout_add(HUD_REFRESH_INTERVAL, hud_refresh, self);
+        hud_refresh(self);
+        return;
+    }
+
+    if (priv->hud_child != NULL) {
+        g_signal_handler_disconnect(priv->hud_child, priv->hud_draw_id);
+        g_signal_handler_disconnect(priv->hud_child, priv->hud_key_press_id);
+        g_clear_object(&priv->hud_child);
+    }
+    g_source_remove(priv->hud_timeout_id);
+    priv->hud_timeout_id = 0;
+    g_clear_pointer(&priv->hud_stats, virt_viewer_frame_stats_free);
+    g_clear_object(&priv->hud_layout);
+    gtk_widget_queue_draw_area(GTK_WIDGET(self), priv->hud_area.x, priv->hud_area.y,
+                               priv->hud_area.width, priv->hud_area.height);
+    memset(&priv->hud_area, 0, sizeof(priv->hud_area));
+}
+
+gboolean virt_viewer_display_get_hud(VirtViewerDisplay *self)
+{
+    g_return_val_if_fail(VIRT_VIEWER_IS_DISPLAY(self), FALSE);
+
+    return self->priv->hud_stats != NULL;
+}
+
 /*
  * Local variables:
  *  c-indent-level: 4
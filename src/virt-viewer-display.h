@@ -26,6 +26,7 @@
 
 #include <gtk/gtk.h>
 #include "virt-viewer-enums.h"
+#include "virt-viewer-scaler.h"
 
 G_BEGIN_DECLS
 
@@ -82,6 +83,7 @@ struct _VirtViewerDisplayClass {
 
     void (*close)(VirtViewerDisplay *display);
     gboolean (*selectable)(VirtViewerDisplay *display);
+    void (*set_scaling_mode)(VirtViewerDisplay *display, VirtViewerScalingMode mode);
 
     /* signals */
     void (*display_pointer_grab)(VirtViewerDisplay *display);
@@ -131,6 +133,22 @@ void virt_viewer_display_enable(VirtViewerDisplay *display);
 void virt_viewer_display_disable(VirtViewerDisplay *display);
 gboolean virt_viewer_display_get_enabled(VirtViewerDisplay *display);
 gboolean virt_viewer_display_get_selectable(VirtViewerDisplay *display);
+void virt_viewer_display_damage(VirtViewerDisplay *display);
+gboolean virt_viewer_display_take_damage(VirtViewerDisplay *display);
+gboolean virt_viewer_display_reports_damage(VirtViewerDisplay *display);
+guint virt_viewer_display_get_resize_count(VirtViewerDisplay *display);
+void virt_viewer_display_get_relayout_stats(VirtViewerDisplay *display,
+                                            guint *allocations,
+                                            gint64 *allocation_time,
+                                            gint64 *allocation_time_max,
+                                            guint *coalesced);
+void virt_viewer_display_desktop_resized(VirtViewerDisplay *display);
+void virt_viewer_display_set_scaling_mode(VirtViewerDisplay *display, VirtViewerScalingMode mode);
+VirtViewerScalingMode virt_viewer_display_get_scaling_mode(VirtViewerDisplay *display);
+void virt_viewer_display_set_integer_scaling(VirtViewerDisplay *display, gboolean integer);
+gboolean virt_viewer_display_get_integer_scaling(VirtViewerDisplay *display);
+void virt_viewer_display_set_hud(VirtViewerDisplay *display, gboolean hud);
+gboolean virt_viewer_display_get_hud(VirtViewerDisplay *display);
 void virt_viewer_display_queue_resize(VirtViewerDisplay *display);
 void virt_viewer_display_get_preferred_monitor_geometry(VirtViewerDisplay *self, GdkRectangle* preferred);
 gint virt_viewer_display_get_nth(VirtViewerDisplay *self);
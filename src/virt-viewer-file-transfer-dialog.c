@@ -35,6 +35,13 @@ struct _VirtViewerFileTransferDialogPrivate
     guint64 completed_transfer_size;
     GtkWidget *transfer_summary;
     GtkWidget *progressbar;
+
+    /* since the creation of the dialog */
+    guint finished_files;
+    guint failed_files;
+    guint64 finished_bytes;
+    gint64 busy_since; /* while there are transfers */
+    gint64 busy_time;
 };
 
 G_DEFINE_TYPE_WITH_PRIVATE(VirtViewerFileTransferDialog, virt_viewer_file_transfer_dialog, GTK_TYPE_DIALOG)
@@ -248,11 +255,17 @@ static void task_finished(SpiceFileTransferTask *task,
 
     self->priv->file_transfers = g_slist_remove(self->priv->file_transfers, task);
     self->priv->completed_transfer_size += spice_file_transfer_task_get_total_bytes(task);
+    self->priv->finished_bytes += spice_file_transfer_task_get_transferred_bytes(task);
+    if (error)
+        self->priv->failed_files++;
+    else
+        self->priv->finished_files++;
     g_object_unref(task);
     update_global_progress(self);
 
     /* if this is the last transfer, close the dialog */
     if (self->priv->file_transfers == NULL) {
+        self->priv->busy_time += g_get_monotonic_time() - self->priv->busy_since;
         self->priv->num_files = 0;
         self->priv->total_transfer_size = 0;
         self->priv->completed_transfer_size = 0;
@@ -301,6 +314,8 @@ static void show_transfer_dialog(VirtViewerFileTransferDialog *self)
 void virt_viewer_file_transfer_dialog_add_task(VirtViewerFileTransferDialog *self,
                                                SpiceFileTransferTask *task)
 {
+    if (self->priv->file_transfers == NULL)
+        self->priv->busy_since = g_get_monotonic_time();
     self->priv->file_transfers = g_slist_prepend(self->priv->file_transfers, g_object_ref(task));
     g_signal_connect(task, "notify::progress", G_CALLBACK(task_progress_notify), self);
     g_signal_connect(task, "notify::total-bytes", G_CALLBACK(task_total_bytes_notify), self);
@@ -308,3 +323,41 @@ void virt_viewer_file_transfer_dialog_add_task(VirtViewerFileTransferDialog *sel
 
     show_transfer_dialog(self);
 }
+
+/**
+ * virt_viewer_file_transfer_dialog_get_stats:
+ * @files: (out) (allow-none): the number of transfers which completed
+ * @failed: (out) (allow-none): the number of transfers which failed or
+ * were cancelled
+ * @bytes: (out) (allow-none): the number of bytes sent, including the
+ * transfers in progress
+ * @seconds: (out) (allow-none): for how long there were transfers in
+ * progress
+ */
+void virt_viewer_file_transfer_dialog_get_stats(VirtViewerFileTransferDialog *self,
+                                                guint *files,
+                                                guint *failed,
+                                                guint64 *bytes,
+                                                gdouble *seconds)
+{
+    GSList *slist;
+
+    g_return_if_fail(VIRT_VIEWER_IS_FILE_TRANSFER_DIALOG(self));
+
+    if (files)
+        *files = self->priv->finished_files;
+    if (failed)
+        *failed = self->priv->failed_files;
+    if (bytes) {
+        *bytes = self->priv->finished_bytes;
+        for (slist = self->priv->file_transfers; slist != NULL; slist = g_slist_next(slist))
+            *bytes += spice_file_transfer_task_get_transferred_bytes(slist->data);
+    }
+    if (seconds) {
+        gint64 busy_time = self->priv->busy_time;
+
+        if (self->priv->file_transfers != NULL)
+            busy_time += g_get_monotonic_time() - self->priv->busy_since;
+        *seconds = (gdouble)busy_time / G_USEC_PER_SEC;
+    }
+}
@@ -55,6 +55,11 @@ GType virt_viewer_file_transfer_dialog_get_type(void) G_GNUC_CONST;
 VirtViewerFileTransferDialog *virt_viewer_file_transfer_dialog_new(GtkWindow *parent);
 void virt_viewer_file_transfer_dialog_add_task(VirtViewerFileTransferDialog *self,
                                                SpiceFileTransferTask *task);
+void virt_viewer_file_transfer_dialog_get_stats(VirtViewerFileTransferDialog *self,
+                                                guint *files,
+                                                guint *failed,
+                                                guint64 *bytes,
+                                                gdouble *seconds);
 
 G_END_DECLS
 
@@ -0,0 +1,260 @@
+/*
+ * Virt Viewer: A virtual machine console viewer
+ *
+ * Copyright (C) 2016 Red Hat, Inc.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#include <config.h>
+
+#include <string.h>
+
+#include "virt-viewer-frame-stats.h"
+
+/*
+ * The measurements behind the display HUD: the frame rate over the last
+ * second, a histogram of the intervals between frames, the delay between
+ * a key press and the next frame, and the rate at which the session
+ * receives data. Nothing here is sampled when the HUD is hidden.
+ */
+
+#define FRAME_STATS_N_TIMES 512
+
+/* upper bounds of the frame interval buckets, in milliseconds */
+static const guint bucket_limits[VIRT_VIEWER_FRAME_STATS_N_BUCKETS] = {
+    16, 33, 50, 100, 250, G_MAXUINT
+};
+
+struct _VirtViewerFrameStats {
+    gint64 times[FRAME_STATS_N_TIMES]; /* ring of the last frame times */
+    guint n_times;
+    guint next_time;
+
+    guint histogram[VIRT_VIEWER_FRAME_STATS_N_BUCKETS];
+
+    gint64 key_press;        /* oldest key press not followed by a frame */
+    gint64 latency_last;
+    gint64 latency_max;
+    gint64 latency_sum;
+    guint n_latencies;
+
+    gboolean has_bytes;
+    guint64 bytes_total;
+    gint64 bytes_time;
+    gdouble byte_rate;
+};
+
+VirtViewerFrameStats *
+virt_viewer_frame_stats_new(void)
+{
+    return g_new0(VirtViewerFrameStats, 1);
+}
+
+void
+virt_viewer_frame_stats_free(VirtViewerFrameStats *stats)
+{
+    g_free(stats);
+}
+
+void
+virt_viewer_frame_stats_reset(VirtViewerFrameStats *stats)
+{
+    g_return_if_fail(stats != NULL);
+
+    memset(stats, 0, sizeof(*stats));
+}
+
+void
+virt_viewer_frame_stats_add_frame(VirtViewerFrameStats *stats, gint64 now)
+{
+    guint i;
+
+    g_return_if_fail(stats != NULL);
+
+    if (stats->n_times > 0) {
+        guint prev = (stats->next_time + FRAME_STATS_N_TIMES - 1) % FRAME_STATS_N_TIMES;
+        gint64 interval = (now - stats->times[prev]) / 1000;
+
+        for (i = 0; i < VIRT_VIEWER_FRAME_STATS_N_BUCKETS - 1; i++)
+            if (interval < (gint64)bucket_limits[i])
+                break;
+        stats->histogram[i]++;
+    }
+
+    stats->times[stats->next_time] = now;
+    stats->next_time = (stats->next_time + 1) % FRAME_STATS_N_TIMES;
+    if (stats->n_times < FRAME_STATS_N_TIMES)
+        stats->n_times++;
+
+    if (stats->key_press != 0) {
+        gint64 latency = now - stats->key_press;
+
+        stats->latency_last = latency;
+        stats->latency_max = MAX(stats->latency_max, latency);
+        stats->latency_sum += latency;
+        stats->n_latencies++;
+        stats->key_press = 0;
+    }
+}
+
+/*
+ * Only the first key press until the next frame is kept: typing faster
+ * than the display updates must not make the latency look shorter.
+ */
+void
+virt_viewer_frame_stats_key_press(VirtViewerFrameStats *stats, gint64 now)
+{
+    g_return_if_fail(stats != NULL);
+
+    if (stats->key_press == 0)
+        stats->key_press = now;
+}
+
+void
+virt_viewer_frame_stats_set_bytes(VirtViewerFrameStats *stats,
+                                  guint64 total,
+                                  gint64 now)
+{
+    g_return_if_fail(stats != NULL);
+
+    if (stats->has_bytes) {
+        if (now - stats->bytes_time < G_USEC_PER_SEC / 2)
+            return;
+        /* the counters restart with the channels on reconnection */
+        if (total >= stats->bytes_total)
+            stats->byte_rate = (gdouble)(total - stats->bytes_total) *
+                G_USEC_PER_SEC / (now - stats->bytes_time);
+    }
+
+    stats->has_bytes = TRUE;
+    stats->bytes_total = total;
+    stats->bytes_time = now;
+}
+
+/* The number of frames during the second before @now */
+gdouble
+virt_viewer_frame_stats_get_fps(VirtViewerFrameStats *stats, gint64 now)
+{
+    guint i, n = 0;
+
+    g_return_val_if_fail(stats != NULL, 0);
+
+    for (i = 0; i < stats->n_times; i++) {
+        guint idx = (stats->next_time + FRAME_STATS_N_TIMES - 1 - i) % FRAME_STATS_N_TIMES;
+
+        if (now - stats->times[idx] > G_USEC_PER_SEC)
+            break;
+        n++;
+    }
+
+    return n;
+}
+
+/* Returns: the exclusive upper bound of @bucket, in milliseconds */
+guint
+virt_viewer_frame_stats_get_bucket_limit(guint bucket)
+{
+    g_return_val_if_fail(bucket < VIRT_VIEWER_FRAME_STATS_N_BUCKETS, G_MAXUINT);
+
+    return bucket_limits[bucket];
+}
+
+const guint *
+virt_viewer_frame_stats_get_histogram(VirtViewerFrameStats *stats)
+{
+    g_return_val_if_fail(stats != NULL, NULL);
+
+    return stats->histogram;
+}
+
+/* Returns: FALSE if no key press was followed by a frame yet. The
+ * latencies are in milliseconds. */
+gboolean
+virt_viewer_frame_stats_get_latency(VirtViewerFrameStats *stats,
+                                    gdouble *last,
+                                    gdouble *average,
+                                    gdouble *max)
+{
+    g_return_val_if_fail(stats != NULL, FALSE);
+
+    if (stats->n_latencies == 0)
+        return FALSE;
+
+    if (last)
+        *last = stats->latency_last / 1000.0;
+    if (average)
+        *average = stats->latency_sum / 1000.0 / stats->n_latencies;
+    if (max)
+        *max = stats->latency_max / 1000.0;
+
+    return TRUE;
+}
+
+/* Returns: the bytes received per second, or a negative value if unknown */
+gdouble
+virt_viewer_frame_stats_get_byte_rate(VirtViewerFrameStats *stats)
+{
+    g_return_val_if_fail(stats != NULL, -1);
+
+    return stats->has_bytes ? stats->byte_rate : -1;
+}
+
+gchar *
+virt_viewer_frame_stats_format(VirtViewerFrameStats *stats, gint64 now)
+{
+    GString *str;
+    guint i, total = 0;
+    gdouble last, average, max, rate;
+
+    g_return_val_if_fail(stats != NULL, NULL);
+
+    str = g_string_new(NULL);
+    g_string_append_printf(str, "%.0f fps\n",
+                           virt_viewer_frame_stats_get_fps(stats, now));
+
+    for (i = 0; i < VIRT_VIEWER_FRAME_STATS_N_BUCKETS; i++)
+        total += stats->histogram[i];
+    for (i = 0; i < VIRT_VIEWER_FRAME_STATS_N_BUCKETS; i++) {
+        guint percent = total ? stats->histogram[i] * 100 / total : 0;
+
+        if (bucket_limits[i] == G_MAXUINT)
+            g_string_append_printf(str, ">=%u ms %3u%%\n", bucket_limits[i - 1], percent);
+        else
+            g_string_append_printf(str, "<%u ms %3u%%\n", bucket_limits[i], percent);
+    }
+
+    if (virt_viewer_frame_stats_get_latency(stats, &last, &average, &max))
+        g_string_append_printf(str, "input %.0f ms (avg %.0f, max %.0f)\n",
+                               last, average, max);
+    else
+        g_string_append(str, "input n/a\n");
+
+    rate = virt_viewer_frame_stats_get_byte_rate(stats);
+    if (rate < 0)
+        g_string_append(str, "rx n/a");
+    else
+        g_string_append_printf(str, "rx %.1f KiB/s", rate / 1024);
+
+    return g_string_free(str, FALSE);
+}
+
+/*
+ * Local variables:
+ *  c-indent-level: 4
+ *  c-basic-offset: 4
+ *  indent-tabs-mode: nil
+ * End:
+ */
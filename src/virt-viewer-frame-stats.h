@@ -0,0 +1,66 @@
+/*
+ * Virt Viewer: A virtual machine console viewer
+ *
+ * Copyright (C) 2016 Red Hat, Inc.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+
+#ifndef VIRT_VIEWER_FRAME_STATS_H
+#define VIRT_VIEWER_FRAME_STATS_H
+
+#include <glib.h>
+
+G_BEGIN_DECLS
+
+#define VIRT_VIEWER_FRAME_STATS_N_BUCKETS 6
+
+typedef struct _VirtViewerFrameStats VirtViewerFrameStats;
+
+/* All the timestamps are in microseconds, as returned by
+ * g_get_monotonic_time() */
+VirtViewerFrameStats *virt_viewer_frame_stats_new(void);
+void virt_viewer_frame_stats_free(VirtViewerFrameStats *stats);
+void virt_viewer_frame_stats_reset(VirtViewerFrameStats *stats);
+
+void virt_viewer_frame_stats_add_frame(VirtViewerFrameStats *stats, gint64 now);
+void virt_viewer_frame_stats_key_press(VirtViewerFrameStats *stats, gint64 now);
+void virt_viewer_frame_stats_set_bytes(VirtViewerFrameStats *stats,
+                                       guint64 total,
+                                       gint64 now);
+
+gdouble virt_viewer_frame_stats_get_fps(VirtViewerFrameStats *stats, gint64 now);
+guint virt_viewer_frame_stats_get_bucket_limit(guint bucket);
+const guint *virt_viewer_frame_stats_get_histogram(VirtViewerFrameStats *stats);
+gboolean virt_viewer_frame_stats_get_latency(VirtViewerFrameStats *stats,
+                                             gdouble *last,
+                                             gdouble *average,
+                                             gdouble *max);
+gdouble virt_viewer_frame_stats_get_byte_rate(VirtViewerFrameStats *stats);
+
+gchar *virt_viewer_frame_stats_format(VirtViewerFrameStats *stats, gint64 now);
+
+G_END_DECLS
+
+#endif /* VIRT_VIEWER_FRAME_STATS_H */
+
+/*
+ * Local variables:
+ *  c-indent-level: 4
+ *  c-basic-offset: 4
+ *  indent-tabs-mode: nil
+ * End:
+ */
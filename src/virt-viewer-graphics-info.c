@@ -0,0 +1,301 @@
+/*
+ * Virt Viewer: A virtual machine console viewer
+ *
+ * Copyright (C) 2016 Red Hat, Inc.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#include <config.h>
+
+#include <string.h>
+#include <glib.h>
+#include <libxml/parser.h>
+#include <libxml/tree.h>
+
+#include "virt-viewer-graphics-info.h"
+
+/*
+ * Extracting the graphics attributes used to be done with one XPath
+ * query per attribute, each of them parsing the whole domain XML again.
+ * Here the document is parsed once and the <graphics> elements are
+ * walked once, keeping the XPath semantics of the previous queries:
+ * the type is the one of the first <graphics> element, and each
+ * attribute is taken from the first element of that type which has it.
+ */
+
+typedef struct {
+    gboolean port;
+    gboolean tls_port;
+    gboolean listen;
+    gboolean listen_address;
+    gboolean socket;
+    gboolean listen_socket;
+} GraphicsInfoFound;
+
+static gboolean
+is_element(xmlNodePtr node, const char *name)
+{
+    return node->type == XML_ELEMENT_NODE &&
+        strcmp((const char *)node->name, name) == 0;
+}
+
+static void
+take_attr(xmlNodePtr node, const char *name, gboolean *found, gchar **value)
+{
+    xmlChar *attr;
+
+    if (*found)
+        return;
+
+    attr = xmlGetProp(node, (const xmlChar *)name);
+    if (attr == NULL)
+        return;
+
+    *found = TRUE;
+    if (attr[0] != '\0' && strcmp((const char *)attr, "-1") != 0)
+        *value = g_strdup((const char *)attr);
+    xmlFree(attr);
+}
+
+static void
+graphics_info_parse_node(VirtViewerGraphicsInfo *info,
+                         GraphicsInfoFound *found,
+                         gchar **listen_address,
+                         gchar **listen_socket,
+                         xmlNodePtr graphics)
+{
+    xmlNodePtr child;
+
+    take_attr(graphics, "port", &found->port, &info->port);
+    take_attr(graphics, "tlsPort", &found->tls_port, &info->tls_port);
+    take_attr(graphics, "listen", &found->listen, &info->listen);
+    take_attr(graphics, "socket", &found->socket, &info->socket);
+
+    for (child = graphics->children; child != NULL; child = child->next) {
+        if (!is_element(child, "listen"))
+            continue;
+        take_attr(child, "address", &found->listen_address, listen_address);
+        take_attr(child, "socket", &found->listen_socket, listen_socket);
+    }
+}
+
+/**
+ * virt_viewer_graphics_info_parse:
+ * @xmldesc: a libvirt domain XML description
+ *
+ * Returns: the attributes of the domain graphics, or NULL if the XML
+ * can't be parsed or the domain has no graphics
+ */
+VirtViewerGraphicsInfo *
+virt_viewer_graphics_info_parse(const gchar *xmldesc)
+{
+    VirtViewerGraphicsInfo *info = NULL;
+    GraphicsInfoFound found = { 0, };
+    gchar *listen_address = NULL;
+    gchar *listen_socket = NULL;
+    xmlDocPtr xml;
+    xmlNodePtr root, devices, node;
+
+    g_return_val_if_fail(xmldesc != NULL, NULL);
+
+    xml = xmlReadMemory(xmldesc, strlen(xmldesc), "domain.xml", NULL,
+                        XML_PARSE_NONET | XML_PARSE_NOWARNING);
+    if (xml == NULL)
+        return NULL;
+
+    root = xmlDocGetRootElement(xml);
+    if (root == NULL || !is_element(root, "domain"))
+        goto end;
+
+    info = g_new0(VirtViewerGraphicsInfo, 1);
+    for (devices = root->children; devices != NULL; devices = devices->next) {
+        if (!is_element(devices, "devices"))
+            continue;
+
+        for (node = devices->children; node != NULL; node = node->next) {
+            xmlChar *type;
+
+            if (!is_element(node, "graphics"))
+                continue;
+
+            type = xmlGetProp(node, (const xmlChar *)"type");
+            if (type == NULL)
+                continue;
+
+            if (info->type == NULL) {
+                if (type[0] == '\0') {
+                    xmlFree(type);
+                    goto end;
+                }
+                info->type = g_strdup((const char *)type);
+            }
+
+            if (strcmp(info->type, (const char *)type) == 0)
+                graphics_info_parse_node(info, &found,
+                                         &listen_address, &listen_socket, node);
+            xmlFree(type);
+        }
+    }
+
+    /* the <listen> child element takes precedence over the legacy attributes */
+    if (listen_address != NULL) {
+        g_free(info->listen);
+        info->listen = listen_address;
+        listen_address = NULL;
+    }
+    if (listen_socket != NULL) {
+        g_free(info->socket);
+        info->socket = listen_socket;
+        listen_socket = NULL;
+    }
+
+end:
+    if (info != NULL && info->type == NULL)
+        g_clear_pointer(&info, virt_viewer_graphics_info_free);
+    g_free(listen_address);
+    g_free(listen_socket);
+    xmlFreeDoc(xml);
+    return info;
+}
+
+VirtViewerGraphicsInfo *
+virt_viewer_graphics_info_copy(const VirtViewerGraphicsInfo *info)
+{
+    VirtViewerGraphicsInfo *copy;
+
+    g_return_val_if_fail(info != NULL, NULL);
+
+    copy = g_new0(VirtViewerGraphicsInfo, 1);
+    copy->type = g_strdup(info->type);
+    copy->port = g_strdup(info->port);
+    copy->tls_port = g_strdup(info->tls_port);
+    copy->listen = g_strdup(info->listen);
+    copy->socket = g_strdup(info->socket);
+
+    return copy;
+}
+
+void
+virt_viewer_graphics_info_free(VirtViewerGraphicsInfo *info)
+{
+    if (info == NULL)
+        return;
+
+    g_free(info->type);
+    g_free(info->port);
+    g_free(info->tls_port);
+    g_free(info->listen);
+    g_free(info->socket);
+    g_free(info);
+}
+
+/*
+ * Remembers the graphics attributes of each domain along with a
+ * checksum of the XML they were extracted from, so that reconnecting
+ * to a domain whose definition did not change skips the parsing.
+ */
+struct _VirtViewerGraphicsInfoCache {
+    GHashTable *entries; /* uuid -> GraphicsInfoCacheEntry */
+};
+
+typedef struct {
+    gchar *checksum;
+    VirtViewerGraphicsInfo *info;
+} GraphicsInfoCacheEntry;
+
+static void
+graphics_info_cache_entry_free(GraphicsInfoCacheEntry *entry)
+{
+    g_free(entry->checksum);
+    virt_viewer_graphics_info_free(entry->info);
+    g_free(entry);
+}
+
+VirtViewerGraphicsInfoCache *
+virt_viewer_graphics_info_cache_new(void)
+{
+    VirtViewerGraphicsInfoCache *cache = g_new0(VirtViewerGraphicsInfoCache, 1);
+
+    cache->entries = g_hash_table_new_full(g_str_hash, g_str_equal, g_free,
+                                           (GDestroyNotify)graphics_info_cache_entry_free);
+
+    return cache;
+}
+
+void
+virt_viewer_graphics_info_cache_free(VirtViewerGraphicsInfoCache *cache)
+{
+    if (cache == NULL)
+        return;
+
+    g_hash_table_unref(cache->entries);
+    g_free(cache);
+}
+
+/**
+ * virt_viewer_graphics_info_cache_get:
+ * @cache: a #VirtViewerGraphicsInfoCache
+ * @uuid: (allow-none): the domain UUID, or NULL to bypass the cache
+ * @xmldesc: the current domain XML description
+ *
+ * Returns: the graphics attributes of @xmldesc, to be freed with
+ * virt_viewer_graphics_info_free(), or NULL if it has no graphics
+ */
+VirtViewerGraphicsInfo *
+virt_viewer_graphics_info_cache_get(VirtViewerGraphicsInfoCache *cache,
+                                    const gchar *uuid,
+                                    const gchar *xmldesc)
+{
+    GraphicsInfoCacheEntry *entry;
+    VirtViewerGraphicsInfo *info;
+    gchar *checksum;
+
+    g_return_val_if_fail(cache != NULL, NULL);
+    g_return_val_if_fail(xmldesc != NULL, NULL);
+
+    if (uuid == NULL)
+        return virt_viewer_graphics_info_parse(xmldesc);
+
+    checksum = g_compute_checksum_for_string(G_CHECKSUM_SHA256, xmldesc, -1);
+    entry = g_hash_table_lookup(cache->entries, uuid);
+    if (entry != NULL && g_str_equal(entry->checksum, checksum)) {
+        g_debug("Domain %s XML did not change, using cached graphics info", uuid);
+        g_free(checksum);
+        return virt_viewer_graphics_info_copy(entry->info);
+    }
+
+    info = virt_viewer_graphics_info_parse(xmldesc);
+    if (info == NULL) {
+        g_hash_table_remove(cache->entries, uuid);
+        g_free(checksum);
+        return NULL;
+    }
+
+    entry = g_new0(GraphicsInfoCacheEntry, 1);
+    entry->checksum = checksum;
+    entry->info = virt_viewer_graphics_info_copy(info);
+    g_hash_table_replace(cache->entries, g_strdup(uuid), entry);
+
+    return info;
+}
+
+/*
+ * Local variables:
+ *  c-indent-level: 4
+ *  c-basic-offset: 4
+ *  indent-tabs-mode: nil
+ * End:
+ */
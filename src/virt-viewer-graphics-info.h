@@ -0,0 +1,60 @@
+/*
+ * Virt Viewer: A virtual machine console viewer
+ *
+ * Copyright (C) 2016 Red Hat, Inc.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#ifndef VIRT_VIEWER_GRAPHICS_INFO_H
+#define VIRT_VIEWER_GRAPHICS_INFO_H
+
+#include <glib.h>
+
+G_BEGIN_DECLS
+
+/* The graphics attributes of a libvirt domain XML description. All the
+ * fields but type may be NULL, and "-1" ports are reported as NULL. */
+typedef struct {
+    gchar *type;
+    gchar *port;
+    gchar *tls_port;
+    gchar *listen;  /* listen/@address, or the legacy @listen */
+    gchar *socket;  /* listen/@socket, or the legacy @socket */
+} VirtViewerGraphicsInfo;
+
+VirtViewerGraphicsInfo *virt_viewer_graphics_info_parse(const gchar *xmldesc);
+VirtViewerGraphicsInfo *virt_viewer_graphics_info_copy(const VirtViewerGraphicsInfo *info);
+void virt_viewer_graphics_info_free(VirtViewerGraphicsInfo *info);
+
+typedef struct _VirtViewerGraphicsInfoCache VirtViewerGraphicsInfoCache;
+
+VirtViewerGraphicsInfoCache *virt_viewer_graphics_info_cache_new(void);
+void virt_viewer_graphics_info_cache_free(VirtViewerGraphicsInfoCache *cache);
+VirtViewerGraphicsInfo *virt_viewer_graphics_info_cache_get(VirtViewerGraphicsInfoCache *cache,
+                                                            const gchar *uuid,
+                                                            const gchar *xmldesc);
+
+G_END_DECLS
+
+#endif /* VIRT_VIEWER_GRAPHICS_INFO_H */
+
+/*
+ * Local variables:
+ *  c-indent-level: 4
+ *  c-basic-offset: 4
+ *  indent-tabs-mode: nil
+ * End:
+ */
@@ -0,0 +1,306 @@
+/*
+ * Virt Viewer: A virtual machine console viewer
+ *
+ * Copyright (C) 2016 Red Hat, Inc.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#include <config.h>
+
+#include "virt-viewer-happy-eyeballs.h"
+
+/*
+ * Connects to a host name resolving to several addresses by racing
+ * TCP connections to them, as described in RFC 8305 "Happy Eyeballs":
+ * the addresses are tried in the resolver order, alternating address
+ * families, a new attempt being started every ATTEMPT_DELAY ms or as
+ * soon as the previous one failed. The first established connection
+ * wins and the other attempts are cancelled, so an unreachable address
+ * no longer costs a full TCP timeout.
+ */
+
+typedef struct {
+    guint16 port;
+    gboolean race_only; /* don't connect to a single address */
+    GList *addresses; /* GInetAddress, in attempt order */
+    GList *next;
+    guint pending; /* attempts in flight */
+    guint delay_id;
+    GCancellable *attempts; /* cancels the attempts still running */
+    GCancellable *cancellable; /* the caller's */
+    gulong cancelled_id;
+    GError *error; /* the last attempt error */
+    gboolean done;
+} HappyEyeballs;
+
+static void
+happy_eyeballs_free(HappyEyeballs *he)
+{
+    g_warn_if_fail(he->delay_id == 0);
+
+    if (he->cancellable) {
+        g_cancellable_disconnect(he->cancellable, he->cancelled_id);
+        g_object_unref(he->cancellable);
+    }
+    g_object_unref(he->attempts);
+    g_resolver_free_addresses(he->addresses);
+    g_clear_error(&he->error);
+    g_free(he);
+}
+
+static void
+happy_eyeballs_cancelled(GCancellable *cancellable G_GNUC_UNUSED,
+                         gpointer user_data)
+{
+    g_cancellable_cancel(G_CANCELLABLE(user_data));
+}
+
+/**
+ * virt_viewer_happy_eyeballs_sort_addresses:
+ * @addresses: (transfer full): a list of #GInetAddress, in the resolver order
+ *
+ * Interleaves the address families, starting with the family of the
+ * first address, and otherwise keeps the resolver order.
+ *
+ * Returns: (transfer full): the sorted list
+ */
+GList *
+virt_viewer_happy_eyeballs_sort_addresses(GList *addresses)
+{
+    GList *first = NULL, *other = NULL, *sorted = NULL;
+    GSocketFamily family;
+    GList *l;
+
+    if (addresses == NULL)
+        return NULL;
+
+    family = g_inet_address_get_family(addresses->data);
+    for (l = addresses; l != NULL; l = l->next) {
+        if (g_inet_address_get_family(l->data) == family)
+            first = g_list_prepend(first, l->data);
+        else
+            other = g_list_prepend(other, l->data);
+    }
+    g_list_free(addresses);
+    first = g_list_reverse(first);
+    other = g_list_reverse(other);
+
+    while (first != NULL || other != NULL) {
+        if (first != NULL) {
+            sorted = g_list_prepend(sorted, first->data);
+            first = g_list_delete_link(first, first);
+        }
+        if (other != NULL) {
+            sorted = g_list_prepend(sorted, other->data);
+            other = g_list_delete_link(other, other);
+        }
+    }
+
+    return g_list_reverse(sorted);
+}
+
+static void happy_eyeballs_start_next(GTask *task);
+
+static gboolean
+happy_eyeballs_delay_expired(gpointer user_data)
+{
+    GTask *task = user_data;
+    HappyEyeballs *he = g_task_get_task_data(task);
+
+    he->delay_id = 0;
+    happy_eyeballs_start_next(task);
+
+    return G_SOURCE_REMOVE;
+}
+
+static void
+happy_eyeballs_attempt_done(GObject *source,
+                            GAsyncResult *result,
+                            gpointer user_data)
+{
+    GTask *task = user_data;
+    HappyEyeballs *he = g_task_get_task_data(task);
+    GSocketConnection *conn;
+    GError *error = NULL;
+
+    conn = g_socket_client_connect_finish(G_SOCKET_CLIENT(source), result, &error);
+    he->pending--;
+
+    if (he->done) {
+        /* lost the race */
+        g_clear_object(&conn);
+        g_clear_error(&error);
+    } else if (conn != NULL) {
+        he->done = TRUE;
+        if (he->delay_id) {
+            g_source_remove(he->delay_id);
+            he->delay_id = 0;
+        }
+        g_cancellable_cancel(he->attempts);
+        g_task_return_pointer(task, conn, g_object_unref);
+    } else {
+        g_debug("Connection attempt failed: %s", error->message);
+        g_clear_error(&he->error);
+        he->error = error;
+        if (g_cancellable_is_cancelled(he->attempts))
+            he->next = NULL;
+        happy_eyeballs_start_next(task);
+    }
+
+    g_object_unref(task);
+}
+
+static void
+happy_eyeballs_start_next(GTask *task)
+{
+    HappyEyeballs *he = g_task_get_task_data(task);
+    GSocketAddress *address;
+    GSocketClient *client;
+    gchar *str;
+
+    if (he->delay_id) {
+        g_source_remove(he->delay_id);
+        he->delay_id = 0;
+    }
+
+    if (he->next == NULL) {
+        if (he->pending == 0 && !he->done) {
+            he->done = TRUE;
+            g_task_return_error(task, he->error);
+            he->error = NULL;
+        }
+        return;
+    }
+
+    str = g_inet_address_to_string(he->next->data);
+    g_debug("Trying %s port %u", str, he->port);
+    g_free(str);
+
+    address = g_inet_socket_address_new(he->next->data, he->port);
+    he->next = he->next->next;
+
+    client = g_socket_client_new();
+    g_socket_client_connect_async(client, G_SOCKET_CONNECTABLE(address), he->attempts,
+                                  happy_eyeballs_attempt_done, g_object_ref(task));
+    he->pending++;
+    g_object_unref(client);
+    g_object_unref(address);
+
+    if (he->next != NULL)
+        he->delay_id = g_timeout_add(VIRT_VIEWER_HAPPY_EYEBALLS_ATTEMPT_DELAY,
+                                     happy_eyeballs_delay_expired, task);
+}
+
+static void
+happy_eyeballs_resolved(GObject *source,
+                        GAsyncResult *result,
+                        gpointer user_data)
+{
+    GTask *task = user_data;
+    HappyEyeballs *he = g_task_get_task_data(task);
+    GError *error = NULL;
+    GList *addresses;
+
+    addresses = g_resolver_lookup_by_name_finish(G_RESOLVER(source), result, &error);
+    if (addresses == NULL) {
+        g_task_return_error(task, error);
+        g_object_unref(task);
+        return;
+    }
+
+    if (he->race_only && addresses->next == NULL) {
+        g_task_return_new_error(task, G_IO_ERROR, G_IO_ERROR_NOT_SUPPORTED,
+                                "Nothing to race, a single address was found");
+        g_resolver_free_addresses(addresses);
+        g_object_unref(task);
+        return;
+    }
+
+    he->addresses = virt_viewer_happy_eyeballs_sort_addresses(addresses);
+    he->next = he->addresses;
+    happy_eyeballs_start_next(task);
+    g_object_unref(task);
+}
+
+/**
+ * virt_viewer_happy_eyeballs_connect_async:
+ * @host: the host name or address to connect to
+ * @port: the TCP port
+ * @race_only: fail with %G_IO_ERROR_NOT_SUPPORTED instead of connecting
+ *   if @host resolves to a single address
+ * @cancellable: (allow-none): a #GCancellable
+ * @callback: called once connected, or once all the addresses failed
+ * @user_data: the data passed to @callback
+ */
+void
+virt_viewer_happy_eyeballs_connect_async(const gchar *host,
+                                         guint16 port,
+                                         gboolean race_only,
+                                         GCancellable *cancellable,
+                                         GAsyncReadyCallback callback,
+                                         gpointer user_data)
+{
+    HappyEyeballs *he;
+    GResolver *resolver;
+    GTask *task;
+
+    g_return_if_fail(host != NULL);
+
+    he = g_new0(HappyEyeballs, 1);
+    he->port = port;
+    he->race_only = race_only;
+    he->attempts = g_cancellable_new();
+    if (cancellable) {
+        he->cancellable = g_object_ref(cancellable);
+        he->cancelled_id = g_cancellable_connect(cancellable,
+                                                 G_CALLBACK(happy_eyeballs_cancelled),
+                                                 g_object_ref(he->attempts),
+                                                 g_object_unref);
+    }
+
+    task = g_task_new(NULL, cancellable, callback, user_data);
+    g_task_set_task_data(task, he, (GDestroyNotify)happy_eyeballs_free);
+
+    resolver = g_resolver_get_default();
+    g_resolver_lookup_by_name_async(resolver, host, cancellable,
+                                    happy_eyeballs_resolved, task);
+    g_object_unref(resolver);
+}
+
+/**
+ * virt_viewer_happy_eyeballs_connect_finish:
+ * @result: the #GAsyncResult passed to the callback
+ * @error: return location for a #GError, or NULL
+ *
+ * Returns: (transfer full): the winning connection, or NULL with
+ * @error set
+ */
+GSocketConnection *
+virt_viewer_happy_eyeballs_connect_finish(GAsyncResult *result,
+                                          GError **error)
+{
+    g_return_val_if_fail(g_task_is_valid(result, NULL), NULL);
+
+    return g_task_propagate_pointer(G_TASK(result), error);
+}
+
+/*
+ * Local variables:
+ *  c-indent-level: 4
+ *  c-basic-offset: 4
+ *  indent-tabs-mode: nil
+ * End:
+ */
@@ -0,0 +1,52 @@
+/*
+ * Virt Viewer: A virtual machine console viewer
+ *
+ * Copyright (C) 2016 Red Hat, Inc.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#ifndef VIRT_VIEWER_HAPPY_EYEBALLS_H
+#define VIRT_VIEWER_HAPPY_EYEBALLS_H
+
+#include <gio/gio.h>
+
+G_BEGIN_DECLS
+
+/* ms between two connection attempts, RFC 8305 recommends 250 */
+#define VIRT_VIEWER_HAPPY_EYEBALLS_ATTEMPT_DELAY 250
+
+GList *virt_viewer_happy_eyeballs_sort_addresses(GList *addresses);
+
+void virt_viewer_happy_eyeballs_connect_async(const gchar *host,
+                                              guint16 port,
+                                              gboolean race_only,
+                                              GCancellable *cancellable,
+                                              GAsyncReadyCallback callback,
+                                              gpointer user_data);
+GSocketConnection *virt_viewer_happy_eyeballs_connect_finish(GAsyncResult *result,
+                                                             GError **error);
+
+G_END_DECLS
+
+#endif /* VIRT_VIEWER_HAPPY_EYEBALLS_H */
+
+/*
+ * Local variables:
+ *  c-indent-level: 4
+ *  c-basic-offset: 4
+ *  indent-tabs-mode: nil
+ * End:
+ */
@@ -29,12 +29,14 @@
 
 #include "virt-viewer.h"
 #include "virt-viewer-util.h"
+#include "virt-viewer-timeline.h"
 
 int main(int argc, char **argv)
 {
     int ret = 1;
     GApplication *app= NULL;
 
+    virt_viewer_timeline_startup();
     virt_viewer_util_init(_("Virt Viewer"));
     app = G_APPLICATION(virt_viewer_new());
 
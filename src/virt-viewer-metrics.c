@@ -0,0 +1,251 @@
+/*
+ * Virt Viewer: A virtual machine console viewer
+ *
+ * Copyright (C) 2016 Red Hat, Inc.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#include <config.h>
+
+#include "virt-viewer-metrics.h"
+
+/*
+ * A snapshot of the session counters in the Prometheus text exposition
+ * format. The snapshot is built from scratch each time the metrics are
+ * exported, so that nothing is accounted for when they are not.
+ */
+
+typedef struct {
+    gchar *name;
+    VirtViewerMetricType type;
+    gchar *help;
+    GPtrArray *series;       /* of MetricSeries, in insertion order */
+} Metric;
+
+typedef struct {
+    gchar *labels;           /* formatted, without the braces */
+    gdouble value;
+} MetricSeries;
+
+struct _VirtViewerMetrics {
+    GPtrArray *metrics;      /* of Metric, in description order */
+    GHashTable *by_name;     /* name -> Metric */
+};
+
+static void
+metric_series_free(MetricSeries *series)
+{
+    g_free(series->labels);
+    g_free(series);
+}
+
+static void
+metric_free(Metric *metric)
+{
+    g_free(metric->name);
+    g_free(metric->help);
+    g_ptr_array_unref(metric->series);
+    g_free(metric);
+}
+
+VirtViewerMetrics *
+virt_viewer_metrics_new(void)
+{
+    VirtViewerMetrics *metrics = g_new0(VirtViewerMetrics, 1);
+
+    metrics->metrics = g_ptr_array_new_with_free_func((GDestroyNotify)metric_free);
+    metrics->by_name = g_hash_table_new(g_str_hash, g_str_equal);
+
+    return metrics;
+}
+
+void
+virt_viewer_metrics_free(VirtViewerMetrics *metrics)
+{
+    if (metrics == NULL)
+        return;
+
+    g_hash_table_unref(metrics->by_name);
+    g_ptr_array_unref(metrics->metrics);
+    g_free(metrics);
+}
+
+/* Backslashes, double quotes and line feeds must be escaped in label
+ * values, and backslashes and line feeds in help texts */
+static void
+append_escaped(GString *str, const gchar *text, gboolean quotes)
+{
+    for (; *text != '\0'; text++) {
+        switch (*text) {
+        case '\\':
+            g_string_append(str, "\\\\");
+            break;
+        case '\n':
+            g_string_append(str, "\\n");
+            break;
+        case '"':
+            g_string_append(str, quotes ? "\\\"" : "\"");
+            break;
+        default:
+            g_string_append_c(str, *text);
+        }
+    }
+}
+
+void
+virt_viewer_metrics_describe(VirtViewerMetrics *metrics,
+                             const gchar *name,
+                             VirtViewerMetricType type,
+                             const gchar *help)
+{
+    Metric *metric;
+
+    g_return_if_fail(metrics != NULL);
+    g_return_if_fail(name != NULL);
+    g_return_if_fail(g_hash_table_lookup(metrics->by_name, name) == NULL);
+
+    metric = g_new0(Metric, 1);
+    metric->name = g_strdup(name);
+    metric->type = type;
+    metric->help = g_strdup(help);
+    metric->series = g_ptr_array_new_with_free_func((GDestroyNotify)metric_series_free);
+
+    g_ptr_array_add(metrics->metrics, metric);
+    g_hash_table_insert(metrics->by_name, metric->name, metric);
+}
+
+/**
+ * virt_viewer_metrics_set:
+ * @metrics: a #VirtViewerMetrics
+ * @name: the name of a metric given to virt_viewer_metrics_describe()
+ * @value: the value of the series
+ * @...: the label names and values of the series, terminated by NULL
+ *
+ * Sets the value of one series of @name, replacing the previous value
+ * of the series with the same labels.
+ */
+void
+virt_viewer_metrics_set(VirtViewerMetrics *metrics,
+                        const gchar *name,
+                        gdouble value,
+                        ...)
+{
+    Metric *metric;
+    MetricSeries *series;
+    GString *labels;
+    const gchar *key;
+    va_list args;
+    guint i;
+
+    g_return_if_fail(metrics != NULL);
+    g_return_if_fail(name != NULL);
+
+    metric = g_hash_table_lookup(metrics->by_name, name);
+    g_return_if_fail(metric != NULL);
+
+    labels = g_string_new(NULL);
+    va_start(args, value);
+    while ((key = va_arg(args, const gchar *)) != NULL) {
+        const gchar *label_value = va_arg(args, const gchar *);
+
+        if (labels->len > 0)
+            g_string_append_c(labels, ',');
+        g_string_append_printf(labels, "%s=\"", key);
+        append_escaped(labels, label_value ? label_value : "", TRUE);
+        g_string_append_c(labels, '"');
+    }
+    va_end(args);
+
+    for (i = 0; i < metric->series->len; i++) {
+        series = g_ptr_array_index(metric->series, i);
+        if (g_str_equal(series->labels, labels->str)) {
+            series->value = value;
+            g_string_free(labels, TRUE);
+            return;
+        }
+    }
+
+    series = g_new0(MetricSeries, 1);
+    series->labels = g_string_free(labels, FALSE);
+    series->value = value;
+    g_ptr_array_add(metric->series, series);
+}
+
+gchar *
+virt_viewer_metrics_format(VirtViewerMetrics *metrics)
+{
+    GString *str;
+    guint i, j;
+
+    g_return_val_if_fail(metrics != NULL, NULL);
+
+    str = g_string_new(NULL);
+    for (i = 0; i < metrics->metrics->len; i++) {
+        Metric *metric = g_ptr_array_index(metrics->metrics, i);
+
+        if (metric->help != NULL) {
+            g_string_append_printf(str, "# HELP %s ", metric->name);
+            append_escaped(str, metric->help, FALSE);
+            g_string_append_c(str, '\n');
+        }
+        g_string_append_printf(str, "# TYPE %s %s\n", metric->name,
+                               metric->type == VIRT_VIEWER_METRIC_COUNTER ? "counter" : "gauge");
+
+        for (j = 0; j < metric->series->len; j++) {
+            MetricSeries *series = g_ptr_array_index(metric->series, j);
+            gchar value[G_ASCII_DTOSTR_BUF_SIZE];
+
+            g_ascii_formatd(value, sizeof(value), "%.15g", series->value);
+            if (series->labels[0] != '\0')
+                g_string_append_printf(str, "%s{%s} %s\n",
+                                       metric->name, series->labels, value);
+            else
+                g_string_append_printf(str, "%s %s\n", metric->name, value);
+        }
+    }
+
+    return g_string_free(str, FALSE);
+}
+
+/*
+ * The file is replaced atomically, so that it can be picked up at any
+ * time by a collector, such as the textfile collector of node_exporter.
+ */
+gboolean
+virt_viewer_metrics_write(VirtViewerMetrics *metrics,
+                          const gchar *filename,
+                          GError **error)
+{
+    gchar *text;
+    gboolean ret;
+
+    g_return_val_if_fail(metrics != NULL, FALSE);
+    g_return_val_if_fail(filename != NULL, FALSE);
+
+    text = virt_viewer_metrics_format(metrics);
+    ret = g_file_set_contents(filename, text, -1, error);
+    g_free(text);
+
+    return ret;
+}
+
+/*
+ * Local variables:
+ *  c-indent-level: 4
+ *  c-basic-offset: 4
+ *  indent-tabs-mode: nil
+ * End:
+ */
@@ -0,0 +1,62 @@
+/*
+ * Virt Viewer: A virtual machine console viewer
+ *
+ * Copyright (C) 2016 Red Hat, Inc.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#ifndef VIRT_VIEWER_METRICS_H
+#define VIRT_VIEWER_METRICS_H
+
+#include <glib.h>
+
+G_BEGIN_DECLS
+
+typedef enum {
+    VIRT_VIEWER_METRIC_COUNTER,
+    VIRT_VIEWER_METRIC_GAUGE,
+} VirtViewerMetricType;
+
+typedef struct _VirtViewerMetrics VirtViewerMetrics;
+
+VirtViewerMetrics *virt_viewer_metrics_new(void);
+void virt_viewer_metrics_free(VirtViewerMetrics *metrics);
+
+void virt_viewer_metrics_describe(VirtViewerMetrics *metrics,
+                                  const gchar *name,
+                                  VirtViewerMetricType type,
+                                  const gchar *help);
+void virt_viewer_metrics_set(VirtViewerMetrics *metrics,
+                             const gchar *name,
+                             gdouble value,
+                             ...) G_GNUC_NULL_TERMINATED;
+
+gchar *virt_viewer_metrics_format(VirtViewerMetrics *metrics);
+gboolean virt_viewer_metrics_write(VirtViewerMetrics *metrics,
+                                   const gchar *filename,
+                                   GError **error);
+
+G_END_DECLS
+
+#endif /* VIRT_VIEWER_METRICS_H */
+
+/*
+ * Local variables:
+ *  c-indent-level: 4
+ *  c-basic-offset: 4
+ *  indent-tabs-mode: nil
+ * End:
+ */
@@ -0,0 +1,800 @@
+/*
+ * Virt Viewer: A virtual machine console viewer
+ *
+ * Copyright (C) 2016 Red Hat, Inc.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#include <config.h>
+
+#include <errno.h>
+#include <stdio.h>
+#include <string.h>
+#include <glib.h>
+#include <glib/gstdio.h>
+#include <glib/gi18n.h>
+#include <gio/gio.h>
+
+#include "virt-viewer-util.h"
+#include "virt-viewer-recording.h"
+
+/*
+ * Session recordings store what the displays showed as a sequence of
+ * events, only the regions which changed since the previous frame of a
+ * display being written. The file starts with the 8 bytes of
+ * VIRT_VIEWER_RECORDING_MAGIC, followed by the events, each being a
+ * RecordingHeader in little-endian order and its payload, padded to a
+ * multiple of 8 bytes. The payload of REGION events is the packed RGB
+ * rows of the region, deflated when the COMPRESSED flag is set.
+ *
+ * Events are only ever appended and flushed frame by frame, a recording
+ * cut short by a crash is readable up to its last complete event. With
+ * the fixed size headers and aligned payloads, the file can be read in
+ * place once memory-mapped.
+ *
+ * The frames are compared and written by a worker thread. At most
+ * RECORDER_MAX_PENDING frames wait for it, the ones coming while it's
+ * busy are dropped, so that the memory used by the recorder stays the
+ * same however long the session is.
+ */
+
+#define RECORDER_TILE_SIZE 64
+#define RECORDER_MAX_PENDING 2
+#define RECORDING_MAX_DIMENSION 65536
+/* deflate can't compress more than 1032:1 */
+#define RECORDING_MAX_INFLATE_RATIO 1032
+
+enum {
+    RECORDING_FLAG_COMPRESSED = 1 << 0,
+};
+
+typedef struct {
+    guint32 type;
+    guint32 display;
+    gint64 time;
+    guint32 x;
+    guint32 y;
+    guint32 width;
+    guint32 height;
+    guint32 flags;
+    guint32 length; /* of the payload, without the padding */
+} RecordingHeader;
+
+G_STATIC_ASSERT(sizeof(RecordingHeader) == 40);
+
+static gsize
+recording_padding(gsize length)
+{
+    return (8 - (length % 8)) % 8;
+}
+
+void
+virt_viewer_recording_event_clear(VirtViewerRecordingEvent *event)
+{
+    g_clear_object(&event->pixels);
+}
+
+struct _VirtViewerRecorder {
+    FILE *file;
+    gchar *filename;
+    gint64 start;
+    GThreadPool *pool; /* a single worker, frames are processed in order */
+    volatile gint pending;
+    GHashTable *displays; /* nth -> GdkPixbuf, the last frame, worker only */
+    GByteArray *buffer; /* worker only */
+    gboolean failed; /* worker only */
+
+    GMutex lock; /* protects the stats */
+    guint frames;
+    guint dropped;
+    guint64 bytes;
+};
+
+typedef struct {
+    guint display;
+    gint64 time;
+    GdkPixbuf *frame;
+} RecorderFrame;
+
+static gboolean
+recorder_write(VirtViewerRecorder *recorder,
+               const RecordingHeader *header,
+               const guint8 *payload)
+{
+    static const guint8 zeros[8] = { 0, };
+    RecordingHeader le;
+    gsize padding = recording_padding(header->length);
+
+    le.type = GUINT32_TO_LE(header->type);
+    le.display = GUINT32_TO_LE(header->display);
+    le.time = GINT64_TO_LE(header->time);
+    le.x = GUINT32_TO_LE(header->x);
+    le.y = GUINT32_TO_LE(header->y);
+    le.width = GUINT32_TO_LE(header->width);
+    le.height = GUINT32_TO_LE(header->height);
+    le.flags = GUINT32_TO_LE(header->flags);
+    le.length = GUINT32_TO_LE(header->length);
+
+    if (fwrite(&le, sizeof(le), 1, recorder->file) != 1 ||
+        (header->length > 0 &&
+         fwrite(payload, header->length, 1, recorder->file) != 1) ||
+        (padding > 0 && fwrite(zeros, padding, 1, recorder->file) != 1))
+        return FALSE;
+
+    g_mutex_lock(&recorder->lock);
+    recorder->bytes += sizeof(le) + header->length + padding;
+    g_mutex_unlock(&recorder->lock);
+
+    return TRUE;
+}
+
+static gboolean
+recording_deflate(const guint8 *data, gsize size, GByteArray *out)
+{
+    GConverter *compressor;
+    GConverterResult res;
+    gsize chunk = size / 4 + 4096;
+    gboolean ret = TRUE;
+
+    compressor = G_CONVERTER(g_zlib_compressor_new(G_ZLIB_COMPRESSOR_FORMAT_RAW, 1));
+    g_byte_array_set_size(out, 0);
+
+    do {
+        GError *error = NULL;
+        gsize offset = out->len;
+        gsize bytes_read = 0, bytes_written = 0;
+
+        g_byte_array_set_size(out, offset + chunk);
+        res = g_converter_convert(compressor, data, size,
+                                  out->data + offset, chunk,
+                                  G_CONVERTER_INPUT_AT_END,
+                                  &bytes_read, &bytes_written, &error);
+        g_byte_array_set_size(out, offset + bytes_written);
+        if (res == G_CONVERTER_ERROR) {
+            if (!g_error_matches(error, G_IO_ERROR, G_IO_ERROR_NO_SPACE)) {
+                g_warning("Unable to compress recording: %s", error->message);
+                ret = FALSE;
+            }
+            g_error_free(error);
+            if (!ret)
+                break;
+        }
+        data += bytes_read;
+        size -= bytes_read;
+    } while (res != G_CONVERTER_FINISHED);
+
+    g_object_unref(compressor);
+
+    return ret;
+}
+
+static gboolean
+recorder_write_region(VirtViewerRecorder *recorder,
+                      guint display,
+                      gint64 time,
+                      GdkPixbuf *frame,
+                      const GdkRectangle *rect)
+{
+    RecordingHeader header = { 0, };
+    const guint8 *pixels = gdk_pixbuf_get_pixels(frame);
+    gint rowstride = gdk_pixbuf_get_rowstride(frame);
+    gint n_channels = gdk_pixbuf_get_n_channels(frame);
+    guint8 *packed, *p;
+    gsize size = (gsize)rect->width * rect->height * 3;
+    gboolean ret;
+    gint x, y;
+
+    /* packed RGB rows */
+    packed = p = g_malloc(size);
+    for (y = rect->y; y < rect->y + rect->height; y++) {
+        const guint8 *row = pixels + (gsize)y * rowstride + (gsize)rect->x * n_channels;
+
+        if (n_channels == 3) {
+            memcpy(p, row, rect->width * 3);
+            p += rect->width * 3;
+            continue;
+        }
+        for (x = 0; x < rect->width; x++, row += n_channels) {
+            *p++ = row[0];
+            *p++ = row[1];
+            *p++ = row[2];
+        }
+    }
+
+    header.type = VIRT_VIEWER_RECORDING_EVENT_REGION;
+    header.display = display;
+    header.time = time;
+    header.x = rect->x;
+    header.y = rect->y;
+    header.width = rect->width;
+    header.height = rect->height;
+
+    if (recording_deflate(packed, size, recorder->buffer) &&
+        recorder->buffer->len < size) {
+        header.flags = RECORDING_FLAG_COMPRESSED;
+        header.length = recorder->buffer->len;
+        ret = recorder_write(recorder, &header, recorder->buffer->data);
+    } else {
+        header.length = size;
+        ret = recorder_write(recorder, &header, packed);
+    }
+
+    g_free(packed);
+
+    return ret;
+}
+
+static gboolean
+recorder_tile_changed(GdkPixbuf *previous, GdkPixbuf *frame,
+                      gint x, gint y, gint width, gint height)
+{
+    const guint8 *p1 = gdk_pixbuf_get_pixels(previous);
+    const guint8 *p2 = gdk_pixbuf_get_pixels(frame);
+    gint stride1 = gdk_pixbuf_get_rowstride(previous);
+    gint stride2 = gdk_pixbuf_get_rowstride(frame);
+    gint n_channels = gdk_pixbuf_get_n_channels(frame);
+    gsize offset = (gsize)x * n_channels;
+    gsize length = (gsize)width * n_channels;
+    gint row;
+
+    for (row = y; row < y + height; row++) {
+        if (memcmp(p1 + (gsize)row * stride1 + offset,
+                   p2 + (gsize)row * stride2 + offset, length) != 0)
+            return TRUE;
+    }
+
+    return FALSE;
+}
+
+/* Writes the tiles which differ from the previous frame, the adjacent
+ * changed tiles of a row of tiles being merged into a single region */
+static gboolean
+recorder_write_changes(VirtViewerRecorder *recorder,
+                       RecorderFrame *frame,
+                       GdkPixbuf *previous)
+{
+    gint width = gdk_pixbuf_get_width(frame->frame);
+    gint height = gdk_pixbuf_get_height(frame->frame);
+    gint n_columns = (width + RECORDER_TILE_SIZE - 1) / RECORDER_TILE_SIZE;
+    gint column, y;
+
+    for (y = 0; y < height; y += RECORDER_TILE_SIZE) {
+        gint tile_height = MIN(RECORDER_TILE_SIZE, height - y);
+        gint start = -1;
+
+        /* one column past the last one, to write the last region */
+        for (column = 0; column <= n_columns; column++) {
+            gint x = column * RECORDER_TILE_SIZE;
+            gboolean changed = FALSE;
+
+            if (column < n_columns)
+                changed = previous == NULL ||
+                    recorder_tile_changed(previous, frame->frame, x, y,
+                                          MIN(RECORDER_TILE_SIZE, width - x),
+                                          tile_height);
+
+            if (changed && start < 0) {
+                start = x;
+            } else if (!changed && start >= 0) {
+                GdkRectangle rect = { start, y, MIN(x, width) - start, tile_height };
+
+                if (!recorder_write_region(recorder, frame->display, frame->time,
+                                           frame->frame, &rect))
+                    return FALSE;
+                start = -1;
+            }
+        }
+    }
+
+    return TRUE;
+}
+
+static void
+recorder_process(gpointer data, gpointer user_data)
+{
+    RecorderFrame *frame = data;
+    VirtViewerRecorder *recorder = user_data;
+    GdkPixbuf *previous;
+    gboolean ok = TRUE;
+
+    if (recorder->failed)
+        goto end;
+
+    previous = g_hash_table_lookup(recorder->displays, GUINT_TO_POINTER(frame->display));
+    if (previous == NULL ||
+        gdk_pixbuf_get_width(previous) != gdk_pixbuf_get_width(frame->frame) ||
+        gdk_pixbuf_get_height(previous) != gdk_pixbuf_get_height(frame->frame) ||
+        gdk_pixbuf_get_n_channels(previous) != gdk_pixbuf_get_n_channels(frame->frame)) {
+        RecordingHeader header = { 0, };
+
+        header.type = VIRT_VIEWER_RECORDING_EVENT_SIZE;
+        header.display = frame->display;
+        header.time = frame->time;
+        header.width = gdk_pixbuf_get_width(frame->frame);
+        header.height = gdk_pixbuf_get_height(frame->frame);
+        ok = recorder_write(recorder, &header, NULL);
+        previous = NULL;
+    }
+
+    if (ok)
+        ok = recorder_write_changes(recorder, frame, previous);
+
+    if (ok && fflush(recorder->file) != 0)
+        ok = FALSE;
+
+    if (!ok) {
+        g_warning("Unable to write recording %s: %s, stopping",
+                  recorder->filename, g_strerror(errno));
+        recorder->failed = TRUE;
+        goto end;
+    }
+
+    /* the frame is a snapshot which is never modified, keep it as is */
+    g_hash_table_replace(recorder->displays, GUINT_TO_POINTER(frame->display),
+                         g_object_ref(frame->frame));
+
+    g_mutex_lock(&recorder->lock);
+    recorder->frames++;
+    g_mutex_unlock(&recorder->lock);
+
+end:
+    g_object_unref(frame->frame);
+    g_free(frame);
+    g_atomic_int_add(&recorder->pending, -1);
+}
+
+/**
+ * virt_viewer_recorder_new:
+ * @filename: the file to record to, it is truncated
+ * @error: return location for a #GError
+ */
+VirtViewerRecorder *
+virt_viewer_recorder_new(const gchar *filename, GError **error)
+{
+    VirtViewerRecorder *recorder;
+    FILE *file;
+
+    g_return_val_if_fail(filename != NULL, NULL);
+
+    file = g_fopen(filename, "wb");
+    if (file == NULL ||
+        fwrite(VIRT_VIEWER_RECORDING_MAGIC, 8, 1, file) != 1 ||
+        fflush(file) != 0) {
+        g_set_error(error, VIRT_VIEWER_ERROR, VIRT_VIEWER_ERROR_FAILED,
+                    _("Unable to write recording %s: %s"), filename, g_strerror(errno));
+        if (file != NULL)
+            fclose(file);
+        return NULL;
+    }
+
+    recorder = g_new0(VirtViewerRecorder, 1);
+    recorder->file = file;
+    recorder->filename = g_strdup(filename);
+    recorder->start = g_get_monotonic_time();
+    recorder->displays = g_hash_table_new_full(g_direct_hash, g_direct_equal,
+                                               NULL, g_object_unref);
+    recorder->buffer = g_byte_array_new();
+    g_mutex_init(&recorder->lock);
+    recorder->pool = g_thread_pool_new(recorder_process, recorder, 1, FALSE, NULL);
+
+    return recorder;
+}
+
+/* Waits for the frames still pending to be written */
+void
+virt_viewer_recorder_free(VirtViewerRecorder *recorder)
+{
+    if (recorder == NULL)
+        return;
+
+    g_thread_pool_free(recorder->pool, FALSE, TRUE);
+    fclose(recorder->file);
+    g_hash_table_unref(recorder->displays);
+    g_byte_array_unref(recorder->buffer);
+    g_mutex_clear(&recorder->lock);
+    g_free(recorder->filename);
+    g_free(recorder);
+}
+
+/* Whether new frames would be dropped, the caller can then skip taking
+ * them */
+gboolean
+virt_viewer_recorder_is_busy(VirtViewerRecorder *recorder)
+{
+    g_return_val_if_fail(recorder != NULL, TRUE);
+
+    return g_atomic_int_get(&recorder->pending) >= RECORDER_MAX_PENDING;
+}
+
+/**
+ * virt_viewer_recorder_add_frame:
+ * @recorder: a #VirtViewerRecorder
+ * @display: the display the frame comes from
+ * @frame: the frame, it must not be modified afterwards
+ *
+ * Queues @frame to be compared to the previous frame of @display, and
+ * its changes written.
+ *
+ * Returns: FALSE if the frame was dropped because the recorder is busy
+ */
+gboolean
+virt_viewer_recorder_add_frame(VirtViewerRecorder *recorder,
+                               guint display,
+                               GdkPixbuf *frame)
+{
+    RecorderFrame *data;
+
+    g_return_val_if_fail(recorder != NULL, FALSE);
+    g_return_val_if_fail(GDK_IS_PIXBUF(frame), FALSE);
+    g_return_val_if_fail(gdk_pixbuf_get_bits_per_sample(frame) == 8, FALSE);
+
+    if (virt_viewer_recorder_is_busy(recorder)) {
+        g_mutex_lock(&recorder->lock);
+        recorder->dropped++;
+        g_mutex_unlock(&recorder->lock);
+        return FALSE;
+    }
+
+    data = g_new0(RecorderFrame, 1);
+    data->display = display;
+    data->time = g_get_monotonic_time() - recorder->start;
+    data->frame = g_object_ref(frame);
+
+    g_atomic_int_inc(&recorder->pending);
+    g_thread_pool_push(recorder->pool, data, NULL);
+
+    return TRUE;
+}
+
+void
+virt_viewer_recorder_get_stats(VirtViewerRecorder *recorder,
+                               guint *frames,
+                               guint *dropped,
+                               guint64 *bytes)
+{
+    g_return_if_fail(recorder != NULL);
+
+    g_mutex_lock(&recorder->lock);
+    if (frames)
+        *frames = recorder->frames;
+    if (dropped)
+        *dropped = recorder->dropped;
+    if (bytes)
+        *bytes = recorder->bytes + 8;
+    g_mutex_unlock(&recorder->lock);
+}
+
+struct _VirtViewerRecordingReader {
+    GMappedFile *file;
+    const guint8 *data;
+    gsize length;
+    gsize offset;
+};
+
+VirtViewerRecordingReader *
+virt_viewer_recording_reader_new(const gchar *filename, GError **error)
+{
+    VirtViewerRecordingReader *reader;
+    GMappedFile *file;
+
+    g_return_val_if_fail(filename != NULL, NULL);
+
+    file = g_mapped_file_new(filename, FALSE, error);
+    if (file == NULL)
+        return NULL;
+
+    if (g_mapped_file_get_length(file) < 8 ||
+        memcmp(g_mapped_file_get_contents(file), VIRT_VIEWER_RECORDING_MAGIC, 8) != 0) {
+        g_set_error(error, VIRT_VIEWER_ERROR, VIRT_VIEWER_ERROR_FAILED,
+                    _("%s is not a session recording"), filename);
+        g_mapped_file_unref(file);
+        return NULL;
+    }
+
+    reader = g_new0(VirtViewerRecordingReader, 1);
+    reader->file = file;
+    reader->data = (const guint8 *)g_mapped_file_get_contents(file);
+    reader->length = g_mapped_file_get_length(file);
+    reader->offset = 8;
+
+    return reader;
+}
+
+void
+virt_viewer_recording_reader_free(VirtViewerRecordingReader *reader)
+{
+    if (reader == NULL)
+        return;
+
+    g_mapped_file_unref(reader->file);
+    g_free(reader);
+}
+
+static gboolean
+recording_inflate(const guint8 *data, gsize size, guint8 *out, gsize out_size)
+{
+    GConverter *decompressor;
+    GConverterResult res;
+    gsize bytes_read = 0, bytes_written = 0;
+    gsize written = 0;
+    GError *error = NULL;
+
+    decompressor = G_CONVERTER(g_zlib_decompressor_new(G_ZLIB_COMPRESSOR_FORMAT_RAW));
+    do {
+        res = g_converter_convert(decompressor, data, size,
+                                  out + written, out_size - written,
+                                  G_CONVERTER_INPUT_AT_END,
+                                  &bytes_read, &bytes_written, &error);
+        data += bytes_read;
+        size -= bytes_read;
+        written += bytes_written;
+    } while (res == G_CONVERTER_CONVERTED);
+    g_object_unref(decompressor);
+
+    if (res == G_CONVERTER_ERROR) {
+        g_debug("Corrupted recording data: %s", error->message);
+        g_error_free(error);
+        return FALSE;
+    }
+
+    return res == G_CONVERTER_FINISHED && written == out_size;
+}
+
+/**
+ * virt_viewer_recording_reader_next:
+ * @reader: a #VirtViewerRecordingReader
+ * @event: (out caller-allocates): the next event, to be cleared with
+ * virt_viewer_recording_event_clear()
+ * @error: return location for a #GError
+ *
+ * Returns: FALSE at the end of the recording, or on error. A last event
+ * which was not completely written is silently ignored.
+ */
+gboolean
+virt_viewer_recording_reader_next(VirtViewerRecordingReader *reader,
+                                  VirtViewerRecordingEvent *event,
+                                  GError **error)
+{
+    RecordingHeader header;
+    const guint8 *payload;
+    gsize size;
+
+    g_return_val_if_fail(reader != NULL, FALSE);
+    g_return_val_if_fail(event != NULL, FALSE);
+
+    memset(event, 0, sizeof(*event));
+
+    if (reader->length - reader->offset < sizeof(header))
+        return FALSE;
+
+    memcpy(&header, reader->data + reader->offset, sizeof(header));
+    header.type = GUINT32_FROM_LE(header.type);
+    header.display = GUINT32_FROM_LE(header.display);
+    header.time = GINT64_FROM_LE(header.time);
+    header.x = GUINT32_FROM_LE(header.x);
+    header.y = GUINT32_FROM_LE(header.y);
+    header.width = GUINT32_FROM_LE(header.width);
+    header.height = GUINT32_FROM_LE(header.height);
+    header.flags = GUINT32_FROM_LE(header.flags);
+    header.length = GUINT32_FROM_LE(header.length);
+
+    if (reader->length - reader->offset - sizeof(header) <
+        header.length + recording_padding(header.length)) {
+        g_debug("Truncated recording event at offset %" G_GSIZE_FORMAT, reader->offset);
+        return FALSE;
+    }
+
+    payload = reader->data + reader->offset + sizeof(header);
+
+    if (header.width > RECORDING_MAX_DIMENSION ||
+        header.height > RECORDING_MAX_DIMENSION ||
+        header.x > RECORDING_MAX_DIMENSION ||
+        header.y > RECORDING_MAX_DIMENSION)
+        goto invalid;
+
+    event->type = header.type;
+    event->display = header.display;
+    event->time = header.time;
+    event->rect.x = header.x;
+    event->rect.y = header.y;
+    event->rect.width = header.width;
+    event->rect.height = header.height;
+
+    switch (header.type) {
+    case VIRT_VIEWER_RECORDING_EVENT_SIZE:
+        break;
+
+    case VIRT_VIEWER_RECORDING_EVENT_REGION: {
+        guint8 *pixels;
+
+        if (header.width == 0 || header.height == 0)
+            goto invalid;
+
+        /* the size comes from the file, check it against the payload
+         * before allocating */
+        size = (gsize)header.width * header.height * 3;
+        if (header.flags & RECORDING_FLAG_COMPRESSED) {
+            if (size / RECORDING_MAX_INFLATE_RATIO > header.length)
+                goto invalid;
+        } else if (header.length != size) {
+            goto invalid;
+        }
+
+        pixels = g_try_malloc(size);
+        if (pixels == NULL) {
+            g_set_error(error, VIRT_VIEWER_ERROR, VIRT_VIEWER_ERROR_FAILED,
+                        _("Not enough memory for the recording event at offset %lu"),
+                        (gulong)reader->offset);
+            return FALSE;
+        }
+
+        if (header.flags & RECORDING_FLAG_COMPRESSED) {
+            if (!recording_inflate(payload, header.length, pixels, size)) {
+                g_free(pixels);
+                goto invalid;
+            }
+        } else {
+            memcpy(pixels, payload, size);
+        }
+
+        event->pixels = gdk_pixbuf_new_from_data(pixels, GDK_COLORSPACE_RGB, FALSE, 8,
+                                                 header.width, header.height,
+                                                 header.width * 3,
+                                                 (GdkPixbufDestroyNotify)g_free, NULL);
+        break;
+    }
+
+    default:
+        goto invalid;
+    }
+
+    reader->offset += sizeof(header) + header.length + recording_padding(header.length);
+
+    return TRUE;
+
+invalid:
+    g_set_error(error, VIRT_VIEWER_ERROR, VIRT_VIEWER_ERROR_FAILED,
+                _("Invalid recording event at offset %lu"), (gulong)reader->offset);
+    return FALSE;
+}
+
+static gboolean
+recording_export_frames(GHashTable *canvases,
+                        GHashTable *changed,
+                        const gchar *directory,
+                        gint64 time,
+                        GError **error)
+{
+    GHashTableIter iter;
+    gpointer key;
+
+    g_hash_table_iter_init(&iter, changed);
+    while (g_hash_table_iter_next(&iter, &key, NULL)) {
+        GdkPixbuf *canvas = g_hash_table_lookup(canvases, key);
+        gchar *name, *path;
+        gboolean ok;
+
+        if (canvas == NULL)
+            continue;
+
+        name = g_strdup_printf("display-%u-%010" G_GINT64_FORMAT ".png",
+                               GPOINTER_TO_UINT(key), time / 1000);
+        path = g_build_filename(directory, name, NULL);
+        ok = gdk_pixbuf_save(canvas, path, "png", error, NULL);
+        g_free(path);
+        g_free(name);
+        if (!ok)
+            return FALSE;
+    }
+    g_hash_table_remove_all(changed);
+
+    return TRUE;
+}
+
+/**
+ * virt_viewer_recording_export:
+ * @filename: the recording
+ * @directory: where to write the pictures
+ * @error: return location for a #GError
+ *
+ * Replays a recording, writing a PNG picture of each display every
+ * time it changed, named display-<nth>-<milliseconds>.png.
+ */
+gboolean
+virt_viewer_recording_export(const gchar *filename,
+                             const gchar *directory,
+                             GError **error)
+{
+    VirtViewerRecordingReader *reader;
+    VirtViewerRecordingEvent event;
+    GHashTable *canvases, *changed;
+    GError *err = NULL;
+    gint64 time = -1;
+    gboolean ret = TRUE;
+
+    reader = virt_viewer_recording_reader_new(filename, error);
+    if (reader == NULL)
+        return FALSE;
+
+    canvases = g_hash_table_new_full(g_direct_hash, g_direct_equal, NULL, g_object_unref);
+    changed = g_hash_table_new(g_direct_hash, g_direct_equal);
+
+    while (virt_viewer_recording_reader_next(reader, &event, &err)) {
+        gpointer key = GUINT_TO_POINTER(event.display);
+        GdkPixbuf *canvas;
+
+        /* all the events of a frame have the same time */
+        if (event.time != time && g_hash_table_size(changed) > 0) {
+            ret = recording_export_frames(canvases, changed, directory, time, error);
+            if (!ret) {
+                virt_viewer_recording_event_clear(&event);
+                goto end;
+            }
+        }
+        time = event.time;
+
+        if (event.type == VIRT_VIEWER_RECORDING_EVENT_SIZE) {
+            canvas = gdk_pixbuf_new(GDK_COLORSPACE_RGB, FALSE, 8,
+                                    MAX(event.rect.width, 1), MAX(event.rect.height, 1));
+            if (canvas == NULL) {
+                g_set_error(error, VIRT_VIEWER_ERROR, VIRT_VIEWER_ERROR_FAILED,
+                            _("Unable to allocate a %dx%d picture of display %u"),
+                            event.rect.width, event.rect.height, event.display);
+                virt_viewer_recording_event_clear(&event);
+                ret = FALSE;
+                goto end;
+            }
+            gdk_pixbuf_fill(canvas, 0x000000ff);
+            g_hash_table_replace(canvases, key, canvas);
+        } else {
+            canvas = g_hash_table_lookup(canvases, key);
+            if (canvas != NULL &&
+                event.rect.x + event.rect.width <= gdk_pixbuf_get_width(canvas) &&
+                event.rect.y + event.rect.height <= gdk_pixbuf_get_height(canvas)) {
+                gdk_pixbuf_copy_area(event.pixels, 0, 0,
+                                     event.rect.width, event.rect.height,
+                                     canvas, event.rect.x, event.rect.y);
+                g_hash_table_add(changed, key);
+            } else {
+                g_debug("Ignoring region outside of display %u", event.display);
+            }
+        }
+        virt_viewer_recording_event_clear(&event);
+    }
+
+    if (err != NULL) {
+        g_propagate_error(error, err);
+        ret = FALSE;
+        goto end;
+    }
+
+    ret = recording_export_frames(canvases, changed, directory, time, error);
+
+end:
+    g_hash_table_unref(changed);
+    g_hash_table_unref(canvases);
+    virt_viewer_recording_reader_free(reader);
+
+    return ret;
+}
+
+/*
+ * Local variables:
+ *  c-indent-level: 4
+ *  c-basic-offset: 4
+ *  indent-tabs-mode: nil
+ * End:
+ */
@@ -0,0 +1,82 @@
+/*
+ * Virt Viewer: A virtual machine console viewer
+ *
+ * Copyright (C) 2016 Red Hat, Inc.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+
+#ifndef VIRT_VIEWER_RECORDING_H
+#define VIRT_VIEWER_RECORDING_H
+
+#include <gdk/gdk.h>
+
+G_BEGIN_DECLS
+
+#define VIRT_VIEWER_RECORDING_MAGIC "VVREC01\n"
+
+typedef enum {
+    VIRT_VIEWER_RECORDING_EVENT_SIZE = 1,   /* the display was (re)sized */
+    VIRT_VIEWER_RECORDING_EVENT_REGION = 2, /* a region of the display changed */
+} VirtViewerRecordingEventType;
+
+typedef struct {
+    VirtViewerRecordingEventType type;
+    guint display;
+    gint64 time; /* microseconds since the recording started */
+    GdkRectangle rect; /* the region, or the size of the display */
+    GdkPixbuf *pixels; /* the content of the region, NULL for SIZE */
+} VirtViewerRecordingEvent;
+
+void virt_viewer_recording_event_clear(VirtViewerRecordingEvent *event);
+
+typedef struct _VirtViewerRecorder VirtViewerRecorder;
+
+VirtViewerRecorder *virt_viewer_recorder_new(const gchar *filename, GError **error);
+void virt_viewer_recorder_free(VirtViewerRecorder *recorder);
+gboolean virt_viewer_recorder_is_busy(VirtViewerRecorder *recorder);
+gboolean virt_viewer_recorder_add_frame(VirtViewerRecorder *recorder,
+                                        guint display,
+                                        GdkPixbuf *frame);
+void virt_viewer_recorder_get_stats(VirtViewerRecorder *recorder,
+                                    guint *frames,
+                                    guint *dropped,
+                                    guint64 *bytes);
+
+typedef struct _VirtViewerRecordingReader VirtViewerRecordingReader;
+
+VirtViewerRecordingReader *virt_viewer_recording_reader_new(const gchar *filename,
+                                                            GError **error);
+void virt_viewer_recording_reader_free(VirtViewerRecordingReader *reader);
+gboolean virt_viewer_recording_reader_next(VirtViewerRecordingReader *reader,
+                                           VirtViewerRecordingEvent *event,
+                                           GError **error);
+
+gboolean virt_viewer_recording_export(const gchar *filename,
+                                      const gchar *directory,
+                                      GError **error);
+
+G_END_DECLS
+
+#endif /* VIRT_VIEWER_RECORDING_H */
+
+/*
+ * Local variables:
+ *  c-indent-level: 4
+ *  c-basic-offset: 4
+ *  indent-tabs-mode: nil
+ * End:
+ */
@@ -0,0 +1,327 @@
+/*
+ * Virt Viewer: A virtual machine console viewer
+ *
+ * Copyright (C) 2016 Red Hat, Inc.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#include <config.h>
+
+#include "virt-viewer-scaler.h"
+
+/*
+ * Draws a guest framebuffer scaled to the size of its widget, with a
+ * filter chosen for its cost rather than left to the widget.
+ *
+ * Bilinear filtering samples at most 4 source pixels per destination
+ * pixel, so large downscales alias. The box mode avoids that without
+ * the cost of a full convolution: it keeps a pyramid of 2x2 box
+ * filtered copies of the framebuffer, and bilinearly scales the level
+ * just larger than the destination. The levels are only recomputed
+ * where the framebuffer was invalidated.
+ */
+
+#define SCALER_MAX_LEVELS 8
+
+struct _VirtViewerScaler {
+    cairo_surface_t *levels[SCALER_MAX_LEVELS]; /* levels[0] is the source */
+    cairo_region_t *dirty[SCALER_MAX_LEVELS];   /* areas to recompute */
+    guint n_levels;
+};
+
+static const gchar *scaling_modes[] = {
+    [VIRT_VIEWER_SCALING_AUTO] = "auto",
+    [VIRT_VIEWER_SCALING_NEAREST] = "nearest",
+    [VIRT_VIEWER_SCALING_BILINEAR] = "bilinear",
+    [VIRT_VIEWER_SCALING_BOX] = "box",
+};
+
+gboolean
+virt_viewer_scaling_mode_from_string(const gchar *str,
+                                     VirtViewerScalingMode *mode)
+{
+    guint i;
+
+    g_return_val_if_fail(str != NULL, FALSE);
+    g_return_val_if_fail(mode != NULL, FALSE);
+
+    for (i = 0; i < G_N_ELEMENTS(scaling_modes); i++) {
+        if (g_str_equal(str, scaling_modes[i])) {
+            *mode = i;
+            return TRUE;
+        }
+    }
+
+    return FALSE;
+}
+
+const gchar *
+virt_viewer_scaling_mode_to_string(VirtViewerScalingMode mode)
+{
+    g_return_val_if_fail(mode < G_N_ELEMENTS(scaling_modes), NULL);
+
+    return scaling_modes[mode];
+}
+
+VirtViewerScaler *
+virt_viewer_scaler_new(void)
+{
+    return g_new0(VirtViewerScaler, 1);
+}
+
+static void
+scaler_clear_levels(VirtViewerScaler *scaler)
+{
+    guint i;
+
+    for (i = 0; i < scaler->n_levels; i++) {
+        g_clear_pointer(&scaler->levels[i], cairo_surface_destroy);
+        g_clear_pointer(&scaler->dirty[i], cairo_region_destroy);
+    }
+    scaler->n_levels = 0;
+}
+
+void
+virt_viewer_scaler_free(VirtViewerScaler *scaler)
+{
+    if (scaler == NULL)
+        return;
+
+    scaler_clear_levels(scaler);
+    g_free(scaler);
+}
+
+/**
+ * virt_viewer_scaler_set_source:
+ * @source: (allow-none): a RGB24 or ARGB32 image surface, whose
+ * content changes are reported with virt_viewer_scaler_invalidate()
+ */
+void
+virt_viewer_scaler_set_source(VirtViewerScaler *scaler,
+                              cairo_surface_t *source)
+{
+    g_return_if_fail(scaler != NULL);
+    g_return_if_fail(source == NULL ||
+                     cairo_image_surface_get_format(source) == CAIRO_FORMAT_RGB24 ||
+                     cairo_image_surface_get_format(source) == CAIRO_FORMAT_ARGB32);
+
+    scaler_clear_levels(scaler);
+    if (source == NULL)
+        return;
+
+    scaler->levels[0] = cairo_surface_reference(source);
+    scaler->n_levels = 1;
+}
+
+cairo_surface_t *
+virt_viewer_scaler_get_source(VirtViewerScaler *scaler)
+{
+    g_return_val_if_fail(scaler != NULL, NULL);
+
+    return scaler->levels[0];
+}
+
+void
+virt_viewer_scaler_invalidate(VirtViewerScaler *scaler,
+                              const GdkRectangle *area)
+{
+    guint i;
+
+    g_return_if_fail(scaler != NULL);
+    g_return_if_fail(area != NULL);
+
+    if (scaler->n_levels == 0)
+        return;
+
+    cairo_surface_mark_dirty_rectangle(scaler->levels[0], area->x, area->y,
+                                       area->width, area->height);
+
+    for (i = 1; i < scaler->n_levels; i++) {
+        cairo_rectangle_int_t rect;
+        gint x1 = (area->x + area->width + (1 << i) - 1) >> i;
+        gint y1 = (area->y + area->height + (1 << i) - 1) >> i;
+
+        rect.x = MAX(area->x, 0) >> i;
+        rect.y = MAX(area->y, 0) >> i;
+        rect.width = MIN(x1, cairo_image_surface_get_width(scaler->levels[i])) - rect.x;
+        rect.height = MIN(y1, cairo_image_surface_get_height(scaler->levels[i])) - rect.y;
+        if (rect.width > 0 && rect.height > 0)
+            cairo_region_union_rectangle(scaler->dirty[i], &rect);
+    }
+}
+
+/* Averages each 2x2 block of @src covered by @rect of @dst. The four
+ * 8-bit channels are summed two at a time in 16-bit lanes. */
+static void
+scaler_downscale(cairo_surface_t *src,
+                 cairo_surface_t *dst,
+                 const cairo_rectangle_int_t *rect)
+{
+    const guchar *src_data = cairo_image_surface_get_data(src);
+    guchar *dst_data = cairo_image_surface_get_data(dst);
+    gint src_stride = cairo_image_surface_get_stride(src);
+    gint dst_stride = cairo_image_surface_get_stride(dst);
+    gint src_width = cairo_image_surface_get_width(src);
+    gint src_height = cairo_image_surface_get_height(src);
+    gint x, y;
+
+    for (y = rect->y; y < rect->y + rect->height; y++) {
+        const guint32 *row0 = (const guint32 *)(src_data + 2 * y * src_stride);
+        const guint32 *row1 = (const guint32 *)(src_data + MIN(2 * y + 1, src_height - 1) * src_stride);
+        guint32 *out = (guint32 *)(dst_data + y * dst_stride);
+
+        for (x = rect->x; x < rect->x + rect->width; x++) {
+            gint x0 = 2 * x, x1 = MIN(2 * x + 1, src_width - 1);
+            guint32 p0 = row0[x0], p1 = row0[x1], p2 = row1[x0], p3 = row1[x1];
+            guint32 rb = (p0 & 0x00ff00ff) + (p1 & 0x00ff00ff) +
+                (p2 & 0x00ff00ff) + (p3 & 0x00ff00ff) + 0x00020002;
+            guint32 ag = ((p0 >> 8) & 0x00ff00ff) + ((p1 >> 8) & 0x00ff00ff) +
+                ((p2 >> 8) & 0x00ff00ff) + ((p3 >> 8) & 0x00ff00ff) + 0x00020002;
+
+            out[x] = ((rb >> 2) & 0x00ff00ff) | (((ag >> 2) & 0x00ff00ff) << 8);
+        }
+    }
+}
+
+/**
+ * virt_viewer_scaler_get_level:
+ * @level: the mip level, 0 being the source
+ *
+ * Returns: (transfer none): the source downscaled @level times by two,
+ * up to date, or NULL if there is no source or @level is too large
+ */
+cairo_surface_t *
+virt_viewer_scaler_get_level(VirtViewerScaler *scaler, guint level)
+{
+    guint i;
+
+    g_return_val_if_fail(scaler != NULL, NULL);
+
+    if (scaler->n_levels == 0 || level >= SCALER_MAX_LEVELS)
+        return NULL;
+
+    while (scaler->n_levels <= level) {
+        cairo_surface_t *prev = scaler->levels[scaler->n_levels - 1];
+        cairo_rectangle_int_t all = { 0, 0, 0, 0 };
+
+        all.width = (cairo_image_surface_get_width(prev) + 1) / 2;
+        all.height = (cairo_image_surface_get_height(prev) + 1) / 2;
+        scaler->levels[scaler->n_levels] =
+            cairo_image_surface_create(cairo_image_surface_get_format(prev),
+                                       all.width, all.height);
+        scaler->dirty[scaler->n_levels] = cairo_region_create_rectangle(&all);
+        scaler->n_levels++;
+    }
+
+    for (i = 1; i <= level; i++) {
+        gint n, j;
+
+        if (cairo_region_is_empty(scaler->dirty[i]))
+            continue;
+
+        cairo_surface_flush(scaler->levels[i - 1]);
+        cairo_surface_flush(scaler->levels[i]);
+        n = cairo_region_num_rectangles(scaler->dirty[i]);
+        for (j = 0; j < n; j++) {
+            cairo_rectangle_int_t rect;
+
+            cairo_region_get_rectangle(scaler->dirty[i], j, &rect);
+            scaler_downscale(scaler->levels[i - 1], scaler->levels[i], &rect);
+            cairo_surface_mark_dirty_rectangle(scaler->levels[i], rect.x, rect.y,
+                                               rect.width, rect.height);
+        }
+        cairo_region_destroy(scaler->dirty[i]);
+        scaler->dirty[i] = cairo_region_create();
+    }
+
+    return scaler->levels[level];
+}
+
+/* Draws the source scaled to @dest, which is in user space of @cr */
+void
+virt_viewer_scaler_draw(VirtViewerScaler *scaler,
+                        cairo_t *cr,
+                        VirtViewerScalingMode mode,
+                        const GdkRectangle *dest)
+{
+    cairo_surface_t *surface;
+    cairo_filter_t filter;
+    double device_width, device_height;
+    guint level = 0;
+    gint width, height;
+
+    g_return_if_fail(scaler != NULL);
+    g_return_if_fail(cr != NULL);
+    g_return_if_fail(dest != NULL);
+
+    if (scaler->n_levels == 0 || dest->width <= 0 || dest->height <= 0)
+        return;
+
+    width = cairo_image_surface_get_width(scaler->levels[0]);
+    height = cairo_image_surface_get_height(scaler->levels[0]);
+
+    switch (mode) {
+    case VIRT_VIEWER_SCALING_NEAREST:
+        filter = CAIRO_FILTER_NEAREST;
+        break;
+    case VIRT_VIEWER_SCALING_BILINEAR:
+        filter = CAIRO_FILTER_BILINEAR;
+        break;
+    case VIRT_VIEWER_SCALING_BOX:
+        filter = CAIRO_FILTER_BILINEAR;
+        while (level + 1 < SCALER_MAX_LEVELS &&
+               (width >> (level + 1)) >= dest->width &&
+               (height >> (level + 1)) >= dest->height)
+            level++;
+        break;
+    case VIRT_VIEWER_SCALING_AUTO:
+    default:
+        filter = CAIRO_FILTER_GOOD;
+        break;
+    }
+
+    surface = virt_viewer_scaler_get_level(scaler, level);
+    width = cairo_image_surface_get_width(surface);
+    height = cairo_image_surface_get_height(surface);
+
+    /* unscaled, as with integer scaling when the display fits: no need
+     * to filter, which lets pixman use a plain blit */
+    device_width = dest->width;
+    device_height = dest->height;
+    cairo_user_to_device_distance(cr, &device_width, &device_height);
+    if (device_width == width && device_height == height)
+        filter = CAIRO_FILTER_NEAREST;
+
+    cairo_save(cr);
+    gdk_cairo_rectangle(cr, dest);
+    cairo_clip(cr);
+    cairo_translate(cr, dest->x, dest->y);
+    cairo_scale(cr, (double)dest->width / width, (double)dest->height / height);
+    cairo_set_source_surface(cr, surface, 0, 0);
+    cairo_pattern_set_filter(cairo_get_source(cr), filter);
+    cairo_pattern_set_extend(cairo_get_source(cr), CAIRO_EXTEND_PAD);
+    cairo_set_operator(cr, CAIRO_OPERATOR_SOURCE);
+    cairo_paint(cr);
+    cairo_restore(cr);
+}
+
+/*
+ * Local variables:
+ *  c-indent-level: 4
+ *  c-basic-offset: 4
+ *  indent-tabs-mode: nil
+ * End:
+ */
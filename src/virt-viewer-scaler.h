@@ -0,0 +1,66 @@
+/*
+ * Virt Viewer: A virtual machine console viewer
+ *
+ * Copyright (C) 2016 Red Hat, Inc.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#ifndef VIRT_VIEWER_SCALER_H
+#define VIRT_VIEWER_SCALER_H
+
+#include <gdk/gdk.h>
+
+G_BEGIN_DECLS
+
+typedef enum {
+    VIRT_VIEWER_SCALING_AUTO,     /* left to the display widget */
+    VIRT_VIEWER_SCALING_NEAREST,
+    VIRT_VIEWER_SCALING_BILINEAR,
+    VIRT_VIEWER_SCALING_BOX,      /* bilinear from a box-filtered mip level */
+} VirtViewerScalingMode;
+
+gboolean virt_viewer_scaling_mode_from_string(const gchar *str,
+                                              VirtViewerScalingMode *mode);
+const gchar *virt_viewer_scaling_mode_to_string(VirtViewerScalingMode mode);
+
+typedef struct _VirtViewerScaler VirtViewerScaler;
+
+VirtViewerScaler *virt_viewer_scaler_new(void);
+void virt_viewer_scaler_free(VirtViewerScaler *scaler);
+
+void virt_viewer_scaler_set_source(VirtViewerScaler *scaler,
+                                   cairo_surface_t *source);
+cairo_surface_t *virt_viewer_scaler_get_source(VirtViewerScaler *scaler);
+void virt_viewer_scaler_invalidate(VirtViewerScaler *scaler,
+                                   const GdkRectangle *area);
+cairo_surface_t *virt_viewer_scaler_get_level(VirtViewerScaler *scaler,
+                                              guint level);
+void virt_viewer_scaler_draw(VirtViewerScaler *scaler,
+                             cairo_t *cr,
+                             VirtViewerScalingMode mode,
+                             const GdkRectangle *dest);
+
+G_END_DECLS
+
+#endif /* VIRT_VIEWER_SCALER_H */
+
+/*
+ * Local variables:
+ *  c-indent-level: 4
+ *  c-basic-offset: 4
+ *  indent-tabs-mode: nil
+ * End:
+ */
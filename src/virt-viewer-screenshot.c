@@ -0,0 +1,391 @@
+/*
+ * Virt Viewer: A virtual machine console viewer
+ *
+ * Copyright (C) 2016 Red Hat, Inc.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#include <config.h>
+
+#include <string.h>
+#include <glib.h>
+#include <glib/gi18n.h>
+
+#include "virt-viewer-screenshot.h"
+
+/*
+ * Encoding a screenshot of a large display, a 4K PNG for instance, takes
+ * long enough to be noticed when done on the main loop: display updates
+ * and input would be stalled meanwhile. The caller takes the pixel
+ * snapshot, which is cheap, and the encoding and the file write are done
+ * in a worker thread. The pixbuf must not be modified until the save
+ * completes.
+ */
+
+typedef struct {
+    GdkPixbuf *pixbuf;
+    GPtrArray *tiles; /* composited into pixbuf by the worker */
+    GArray *origins;
+    gchar *filename;
+    gchar *type;
+} ScreenshotSave;
+
+static void
+screenshot_save_free(ScreenshotSave *save)
+{
+    g_clear_object(&save->pixbuf);
+    if (save->tiles)
+        g_ptr_array_unref(save->tiles);
+    if (save->origins)
+        g_array_unref(save->origins);
+    g_free(save->filename);
+    g_free(save->type);
+    g_free(save);
+}
+
+static void add_if_writable (GdkPixbufFormat *data, GHashTable *formats)
+{
+    if (gdk_pixbuf_format_is_writable(data)) {
+        gchar **extensions;
+        gchar **it;
+        extensions = gdk_pixbuf_format_get_extensions(data);
+        for (it = extensions; *it != NULL; it++) {
+            g_hash_table_insert(formats, g_strdup(*it), data);
+        }
+        g_strfreev(extensions);
+    }
+}
+
+static GHashTable *init_image_formats(void)
+{
+    GHashTable *format_map;
+    GSList *formats = gdk_pixbuf_get_formats();
+
+    format_map = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, NULL);
+    g_slist_foreach(formats, (GFunc)add_if_writable, format_map);
+    g_slist_free (formats);
+
+    return format_map;
+}
+
+/**
+ * virt_viewer_screenshot_get_format:
+ * @filename: the name of the file to save to
+ *
+ * Returns: (transfer none): the writable image format matching the
+ * extension of @filename, or NULL
+ */
+GdkPixbufFormat *
+virt_viewer_screenshot_get_format(const gchar *filename)
+{
+    static GOnce image_formats_once = G_ONCE_INIT;
+    const char *ext;
+
+    g_once(&image_formats_once, (GThreadFunc)init_image_formats, NULL);
+
+    ext = strrchr(filename, '.');
+    if (ext == NULL)
+        return NULL;
+
+    ext++; /* skip '.' */
+
+    return g_hash_table_lookup(image_formats_once.retval, ext);
+}
+
+typedef struct {
+    GdkPixbuf *tile;
+    GdkPixbuf *dest;
+    gint x;
+    gint y;
+} CompositeTile;
+
+static void
+composite_tile(gpointer data, gpointer user_data G_GNUC_UNUSED)
+{
+    CompositeTile *tile = data;
+
+    gdk_pixbuf_copy_area(tile->tile, 0, 0,
+                         gdk_pixbuf_get_width(tile->tile),
+                         gdk_pixbuf_get_height(tile->tile),
+                         tile->dest, tile->x, tile->y);
+}
+
+static gboolean
+composite_tiles_overlap(const CompositeTile *tiles, guint n_tiles)
+{
+    guint i, j;
+
+    for (i = 0; i < n_tiles; i++) {
+        GdkRectangle r1 = {
+            tiles[i].x, tiles[i].y,
+            gdk_pixbuf_get_width(tiles[i].tile), gdk_pixbuf_get_height(tiles[i].tile)
+        };
+
+        for (j = i + 1; j < n_tiles; j++) {
+            GdkRectangle r2 = {
+                tiles[j].x, tiles[j].y,
+                gdk_pixbuf_get_width(tiles[j].tile), gdk_pixbuf_get_height(tiles[j].tile)
+            };
+
+            if (gdk_rectangle_intersect(&r1, &r2, NULL))
+                return TRUE;
+        }
+    }
+
+    return FALSE;
+}
+
+/**
+ * virt_viewer_screenshot_composite:
+ * @tiles: (array length=n_tiles): the snapshots of the displays
+ * @origins: (array length=n_tiles): the position of each display
+ * @n_tiles: the number of displays
+ * @error: return location for a #GError, or NULL
+ *
+ * Puts the displays together in a single picture of the whole guest
+ * desktop, the areas not covered by any display being black. The
+ * displays are copied in parallel when they don't overlap, several 4K
+ * displays are more than 100MB to move around.
+ *
+ * Returns: (transfer full): the composite picture, or NULL if it is too
+ * large, the displays being far apart for instance
+ */
+GdkPixbuf *
+virt_viewer_screenshot_composite(GdkPixbuf * const *tiles,
+                                 const GdkPoint *origins,
+                                 guint n_tiles,
+                                 GError **error)
+{
+    CompositeTile *composite;
+    GdkPixbuf *dest = NULL;
+    gint min_x = G_MAXINT, min_y = G_MAXINT;
+    gint64 width = 0, height = 0;
+    guint n_threads;
+    guint i;
+
+    g_return_val_if_fail(tiles != NULL, NULL);
+    g_return_val_if_fail(origins != NULL, NULL);
+    g_return_val_if_fail(n_tiles > 0, NULL);
+
+    for (i = 0; i < n_tiles; i++) {
+        min_x = MIN(min_x, origins[i].x);
+        min_y = MIN(min_y, origins[i].y);
+    }
+
+    composite = g_new0(CompositeTile, n_tiles);
+    for (i = 0; i < n_tiles; i++) {
+        composite[i].tile = tiles[i];
+        width = MAX(width, (gint64)origins[i].x - min_x + gdk_pixbuf_get_width(tiles[i]));
+        height = MAX(height, (gint64)origins[i].y - min_y + gdk_pixbuf_get_height(tiles[i]));
+        composite[i].x = origins[i].x - min_x;
+        composite[i].y = origins[i].y - min_y;
+    }
+
+    if (width <= G_MAXINT && height <= G_MAXINT)
+        dest = gdk_pixbuf_new(GDK_COLORSPACE_RGB, FALSE, 8, width, height);
+    if (dest == NULL) {
+        g_set_error(error, G_FILE_ERROR, G_FILE_ERROR_NOMEM,
+                    _("Unable to allocate a %" G_GINT64_FORMAT "x%" G_GINT64_FORMAT
+                      " screenshot of the displays"), width, height);
+        g_free(composite);
+        return NULL;
+    }
+    gdk_pixbuf_fill(dest, 0x000000ff);
+    for (i = 0; i < n_tiles; i++)
+        composite[i].dest = dest;
+
+    n_threads = MIN(n_tiles, (guint)g_get_num_processors());
+    if (n_threads > 1 && !composite_tiles_overlap(composite, n_tiles)) {
+        GThreadPool *pool = g_thread_pool_new(composite_tile, NULL, n_threads, FALSE, NULL);
+
+        for (i = 0; i < n_tiles; i++)
+            g_thread_pool_push(pool, &composite[i], NULL);
+        /* waits for the copies to be done */
+        g_thread_pool_free(pool, FALSE, TRUE);
+    } else {
+        for (i = 0; i < n_tiles; i++)
+            composite_tile(&composite[i], NULL);
+    }
+
+    g_free(composite);
+
+    return dest;
+}
+
+static void
+screenshot_save_thread(GTask *task,
+                       gpointer source_object G_GNUC_UNUSED,
+                       gpointer task_data,
+                       GCancellable *cancellable)
+{
+    ScreenshotSave *save = task_data;
+    GError *error = NULL;
+    gchar *buffer = NULL;
+    gsize size = 0;
+    gint64 start = g_get_monotonic_time();
+
+    if (save->tiles != NULL) {
+        save->pixbuf = virt_viewer_screenshot_composite((GdkPixbuf **)save->tiles->pdata,
+                                                        (GdkPoint *)save->origins->data,
+                                                        save->tiles->len,
+                                                        &error);
+        if (save->pixbuf == NULL) {
+            g_task_return_error(task, error);
+            return;
+        }
+        g_debug("Composited %u displays in %" G_GINT64_FORMAT " ms",
+                save->tiles->len, (g_get_monotonic_time() - start) / 1000);
+    }
+
+    if (!gdk_pixbuf_save_to_buffer(save->pixbuf, &buffer, &size,
+                                   save->type, &error, NULL)) {
+        g_task_return_error(task, error);
+        return;
+    }
+
+    if (g_cancellable_set_error_if_cancelled(cancellable, &error)) {
+        g_free(buffer);
+        g_task_return_error(task, error);
+        return;
+    }
+
+    /* written to a temporary file and renamed, so that a failed save
+     * does not leave a truncated image behind */
+    if (!g_file_set_contents(save->filename, buffer, size, &error)) {
+        g_free(buffer);
+        g_task_return_error(task, error);
+        return;
+    }
+
+    g_debug("Saved %s screenshot %s (%" G_GSIZE_FORMAT " bytes) in %" G_GINT64_FORMAT " ms",
+            save->type, save->filename, size,
+            (g_get_monotonic_time() - start) / 1000);
+    g_free(buffer);
+    g_task_return_boolean(task, TRUE);
+}
+
+static void
+screenshot_save_start(ScreenshotSave *save,
+                      const gchar *filename,
+                      GCancellable *cancellable,
+                      GAsyncReadyCallback callback,
+                      gpointer user_data)
+{
+    GdkPixbufFormat *format;
+    GTask *task;
+
+    task = g_task_new(NULL, cancellable, callback, user_data);
+    g_task_set_task_data(task, save, (GDestroyNotify)screenshot_save_free);
+
+    format = virt_viewer_screenshot_get_format(filename);
+    if (format == NULL) {
+        g_task_return_new_error(task, G_FILE_ERROR, G_FILE_ERROR_FAILED,
+                                _("Unable to determine image format for file '%s'"),
+                                filename);
+        g_object_unref(task);
+        return;
+    }
+
+    save->filename = g_strdup(filename);
+    save->type = gdk_pixbuf_format_get_name(format);
+
+    g_task_run_in_thread(task, screenshot_save_thread);
+    g_object_unref(task);
+}
+
+/**
+ * virt_viewer_screenshot_save_async:
+ * @pixbuf: the snapshot to save
+ * @filename: the file to save to, its extension gives the image format
+ * @cancellable: (allow-none): a #GCancellable
+ * @callback: called in the thread-default main context of the caller
+ * @user_data: data for @callback
+ *
+ * Encodes @pixbuf and writes it to @filename in a worker thread.
+ */
+void
+virt_viewer_screenshot_save_async(GdkPixbuf *pixbuf,
+                                  const gchar *filename,
+                                  GCancellable *cancellable,
+                                  GAsyncReadyCallback callback,
+                                  gpointer user_data)
+{
+    ScreenshotSave *save;
+
+    g_return_if_fail(GDK_IS_PIXBUF(pixbuf));
+    g_return_if_fail(filename != NULL);
+
+    save = g_new0(ScreenshotSave, 1);
+    save->pixbuf = g_object_ref(pixbuf);
+    screenshot_save_start(save, filename, cancellable, callback, user_data);
+}
+
+/**
+ * virt_viewer_screenshot_save_composite_async:
+ * @tiles: (array length=n_tiles): the snapshots of the displays
+ * @origins: (array length=n_tiles): the position of each display
+ * @n_tiles: the number of displays
+ * @filename: the file to save to, its extension gives the image format
+ * @cancellable: (allow-none): a #GCancellable
+ * @callback: called in the thread-default main context of the caller
+ * @user_data: data for @callback
+ *
+ * Like virt_viewer_screenshot_save_async(), for a picture of several
+ * displays put together with virt_viewer_screenshot_composite() in the
+ * worker thread. Complete with virt_viewer_screenshot_save_finish().
+ */
+void
+virt_viewer_screenshot_save_composite_async(GdkPixbuf * const *tiles,
+                                            const GdkPoint *origins,
+                                            guint n_tiles,
+                                            const gchar *filename,
+                                            GCancellable *cancellable,
+                                            GAsyncReadyCallback callback,
+                                            gpointer user_data)
+{
+    ScreenshotSave *save;
+    guint i;
+
+    g_return_if_fail(tiles != NULL);
+    g_return_if_fail(origins != NULL);
+    g_return_if_fail(n_tiles > 0);
+    g_return_if_fail(filename != NULL);
+
+    save = g_new0(ScreenshotSave, 1);
+    save->tiles = g_ptr_array_new_with_free_func(g_object_unref);
+    save->origins = g_array_sized_new(FALSE, FALSE, sizeof(GdkPoint), n_tiles);
+    for (i = 0; i < n_tiles; i++)
+        g_ptr_array_add(save->tiles, g_object_ref(tiles[i]));
+    g_array_append_vals(save->origins, origins, n_tiles);
+    screenshot_save_start(save, filename, cancellable, callback, user_data);
+}
+
+gboolean
+virt_viewer_screenshot_save_finish(GAsyncResult *result,
+                                   GError **error)
+{
+    g_return_val_if_fail(g_task_is_valid(result, NULL), FALSE);
+
+    return g_task_propagate_boolean(G_TASK(result), error);
+}
+
+/*
+ * Local variables:
+ *  c-indent-level: 4
+ *  c-basic-offset: 4
+ *  indent-tabs-mode: nil
+ * End:
+ */
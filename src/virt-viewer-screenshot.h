@@ -0,0 +1,61 @@
+/*
+ * Virt Viewer: A virtual machine console viewer
+ *
+ * Copyright (C) 2016 Red Hat, Inc.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+
+#ifndef VIRT_VIEWER_SCREENSHOT_H
+#define VIRT_VIEWER_SCREENSHOT_H
+
+#include <gio/gio.h>
+#include <gdk/gdk.h>
+
+G_BEGIN_DECLS
+
+GdkPixbufFormat *virt_viewer_screenshot_get_format(const gchar *filename);
+GdkPixbuf *virt_viewer_screenshot_composite(GdkPixbuf * const *tiles,
+                                            const GdkPoint *origins,
+                                            guint n_tiles,
+                                            GError **error);
+
+void virt_viewer_screenshot_save_async(GdkPixbuf *pixbuf,
+                                       const gchar *filename,
+                                       GCancellable *cancellable,
+                                       GAsyncReadyCallback callback,
+                                       gpointer user_data);
+void virt_viewer_screenshot_save_composite_async(GdkPixbuf * const *tiles,
+                                                 const GdkPoint *origins,
+                                                 guint n_tiles,
+                                                 const gchar *filename,
+                                                 GCancellable *cancellable,
+                                                 GAsyncReadyCallback callback,
+                                                 gpointer user_data);
+gboolean virt_viewer_screenshot_save_finish(GAsyncResult *result,
+                                            GError **error);
+
+G_END_DECLS
+
+#endif /* VIRT_VIEWER_SCREENSHOT_H */
+
+/*
+ * Local variables:
+ *  c-indent-level: 4
+ *  c-basic-offset: 4
+ *  indent-tabs-mode: nil
+ * End:
+ */
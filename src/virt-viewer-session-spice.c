@@ -32,6 +32,7 @@
 #include "virt-viewer-file.h"
 #include "virt-viewer-file-transfer-dialog.h"
 #include "virt-viewer-util.h"
+#include "virt-viewer-timeline.h"
 #include "virt-viewer-session-spice.h"
 #include "virt-viewer-display-spice.h"
 #include "virt-viewer-auth.h"
@@ -52,6 +53,10 @@ struct _VirtViewerSessionSpicePrivate {
     gboolean did_auto_conf;
     VirtViewerFileTransferDialog *file_transfer_dialog;
 
+    GHashTable *usb_redirected; /* SpiceUsbDevice set, as last seen */
+    guint usb_connected;
+    guint usb_disconnected;
+    guint usb_errors;
 };
 
 #define VIRT_VIEWER_SESSION_SPICE_GET_PRIVATE(o) (G_TYPE_INSTANCE_GET_PRIVATE((o), VIRT_VIEWER_TYPE_SESSION_SPICE, VirtViewerSessionSpicePrivate))
@@ -79,7 +84,7 @@ static void virt_viewer_session_spice_channel_destroy(SpiceSession *s,
 static void virt_viewer_session_spice_smartcard_insert(VirtViewerSession *session);
 static void virt_viewer_session_spice_smartcard_remove(VirtViewerSession *session);
 static gboolean virt_viewer_session_spice_fullscreen_auto_conf(VirtViewerSessionSpice *self);
-static void virt_viewer_session_spice_apply_monitor_geometry(VirtViewerSession *self, GHashTable *monitors);
+static void virt_viewer_session_spice_apply_monitor_geometry(VirtViewerSession *self, const VirtViewerMonitorLayout *monitors);
 
 static void virt_viewer_session_spice_clear_displays(VirtViewerSessionSpice *self)
 {
@@ -149,6 +154,7 @@ virt_viewer_session_spice_dispose(GObject *obj)
     spice->priv->audio = NULL;
 
     g_clear_object(&spice->priv->main_window);
+    g_clear_pointer(&spice->priv->usb_redirected, g_hash_table_unref);
     if (spice->priv->file_transfer_dialog) {
         gtk_widget_destroy(GTK_WIDGET(spice->priv->file_transfer_dialog));
         spice->priv->file_transfer_dialog = NULL;
@@ -178,6 +184,95 @@ virt_viewer_session_spice_can_retry_auth(VirtViewerSession *session G_GNUC_UNUSE
     return TRUE;
 }
 
+static gboolean
+virt_viewer_session_spice_get_bytes_received(VirtViewerSession *session,
+                                             guint64 *bytes)
+{
+    VirtViewerSessionSpice *self = VIRT_VIEWER_SESSION_SPICE(session);
+    GList *l, *channels;
+
+    *bytes = 0;
+    channels = spice_session_get_channels(self->priv->session);
+    for (l = channels; l != NULL; l = l->next) {
+        gulong read_bytes = 0;
+
+        g_object_get(l->data, "total-read-bytes", &read_bytes, NULL);
+        *bytes += read_bytes;
+    }
+    g_list_free(channels);
+
+    return TRUE;
+}
+
+static void usb_update_redirected(VirtViewerSessionSpice *self);
+
+static void
+virt_viewer_session_spice_collect_metrics(VirtViewerSession *session,
+                                          VirtViewerMetrics *metrics)
+{
+    VirtViewerSessionSpice *self = VIRT_VIEWER_SESSION_SPICE(session);
+    GList *l, *channels;
+    guint files, failed;
+    guint64 bytes;
+    gdouble seconds;
+
+    virt_viewer_metrics_describe(metrics, "virt_viewer_channel_received_bytes_total",
+                                 VIRT_VIEWER_METRIC_COUNTER,
+                                 "Bytes received on each SPICE channel");
+    channels = spice_session_get_channels(self->priv->session);
+    for (l = channels; l != NULL; l = l->next) {
+        gulong read_bytes = 0;
+        gint type, id;
+        gchar *id_str;
+
+        g_object_get(l->data,
+                     "channel-type", &type,
+                     "channel-id", &id,
+                     "total-read-bytes", &read_bytes,
+                     NULL);
+        id_str = g_strdup_printf("%d", id);
+        virt_viewer_metrics_set(metrics, "virt_viewer_channel_received_bytes_total",
+                                read_bytes,
+                                "channel", spice_channel_type_to_string(type),
+                                "id", id_str,
+                                NULL);
+        g_free(id_str);
+    }
+    g_list_free(channels);
+
+    usb_update_redirected(self);
+    virt_viewer_metrics_describe(metrics, "virt_viewer_usb_redirections_total",
+                                 VIRT_VIEWER_METRIC_COUNTER,
+                                 "USB devices redirected to the guest, released, and failed redirections");
+    virt_viewer_metrics_set(metrics, "virt_viewer_usb_redirections_total",
+                            self->priv->usb_connected, "result", "connected", NULL);
+    virt_viewer_metrics_set(metrics, "virt_viewer_usb_redirections_total",
+                            self->priv->usb_disconnected, "result", "disconnected", NULL);
+    virt_viewer_metrics_set(metrics, "virt_viewer_usb_redirections_total",
+                            self->priv->usb_errors, "result", "failed", NULL);
+
+    if (self->priv->file_transfer_dialog == NULL)
+        return;
+
+    virt_viewer_file_transfer_dialog_get_stats(self->priv->file_transfer_dialog,
+                                               &files, &failed, &bytes, &seconds);
+    virt_viewer_metrics_describe(metrics, "virt_viewer_file_transfers_total",
+                                 VIRT_VIEWER_METRIC_COUNTER,
+                                 "Files transferred to the guest");
+    virt_viewer_metrics_set(metrics, "virt_viewer_file_transfers_total",
+                            files, "result", "completed", NULL);
+    virt_viewer_metrics_set(metrics, "virt_viewer_file_transfers_total",
+                            failed, "result", "failed", NULL);
+    virt_viewer_metrics_describe(metrics, "virt_viewer_file_transfer_bytes_total",
+                                 VIRT_VIEWER_METRIC_COUNTER,
+                                 "Bytes of files transferred to the guest");
+    virt_viewer_metrics_set(metrics, "virt_viewer_file_transfer_bytes_total", bytes, NULL);
+    virt_viewer_metrics_describe(metrics, "virt_viewer_file_transfer_seconds_total",
+                                 VIRT_VIEWER_METRIC_COUNTER,
+                                 "Time spent with file transfers in progress");
+    virt_viewer_metrics_set(metrics, "virt_viewer_file_transfer_seconds_total", seconds, NULL);
+}
+
 static void
 create_spice_session(VirtViewerSessionSpice *self);
 
@@ -230,9 +325,6 @@ virt_viewer_session_spice_constructed(GObject *obj)
                                       G_CALLBACK(update_share_folder), self,
                                       G_CONNECT_SWAPPED);
 
-    self->priv->file_transfer_dialog =
-        virt_viewer_file_transfer_dialog_new(self->priv->main_window);
-
     G_OBJECT_CLASS(virt_viewer_session_spice_parent_class)->constructed(obj);
 }
 
@@ -259,6 +351,8 @@ virt_viewer_session_spice_class_init(VirtViewerSessionSpiceClass *klass)
     dclass->apply_monitor_geometry = virt_viewer_session_spice_apply_monitor_geometry;
     dclass->can_share_folder = virt_viewer_session_spice_can_share_folder;
     dclass->can_retry_auth = virt_viewer_session_spice_can_retry_auth;
+    dclass->get_bytes_received = virt_viewer_session_spice_get_bytes_received;
+    dclass->collect_metrics = virt_viewer_session_spice_collect_metrics;
 
     g_type_class_add_private(klass, sizeof(VirtViewerSessionSpicePrivate));
 
@@ -289,6 +383,62 @@ virt_viewer_session_spice_init(VirtViewerSessionSpice *self G_GNUC_UNUSED)
     self->priv = VIRT_VIEWER_SESSION_SPICE_GET_PRIVATE(self);
 }
 
+static void
+usb_device_free(gpointer device)
+{
+    g_boxed_free(SPICE_TYPE_USB_DEVICE, device);
+}
+
+/*
+ * The redirections are started by spice-gtk, from auto-connect or from
+ * the device widget, and their completions are not ours: the devices
+ * connected since the last call and the ones released are counted by
+ * comparing with the devices the manager reports connected now.
+ */
+static void
+usb_update_redirected(VirtViewerSessionSpice *self)
+{
+    VirtViewerSessionSpicePrivate *priv = self->priv;
+    SpiceUsbDeviceManager *manager;
+    GHashTable *redirected;
+    GHashTableIter iter;
+    GPtrArray *devices;
+    gpointer device;
+    guint i;
+
+    if (priv->session == NULL)
+        return;
+
+    manager = spice_usb_device_manager_get(priv->session, NULL);
+    if (manager == NULL)
+        return;
+
+    redirected = g_hash_table_new_full(g_direct_hash, g_direct_equal,
+                                       usb_device_free, NULL);
+    devices = spice_usb_device_manager_get_devices(manager);
+    for (i = 0; i < devices->len; i++) {
+        device = g_ptr_array_index(devices, i);
+        if (!spice_usb_device_manager_is_device_connected(manager, device))
+            continue;
+
+        g_hash_table_add(redirected, g_boxed_copy(SPICE_TYPE_USB_DEVICE, device));
+        if (priv->usb_redirected == NULL ||
+            !g_hash_table_contains(priv->usb_redirected, device))
+            priv->usb_connected++;
+    }
+    g_ptr_array_unref(devices);
+
+    if (priv->usb_redirected != NULL) {
+        g_hash_table_iter_init(&iter, priv->usb_redirected);
+        while (g_hash_table_iter_next(&iter, &device, NULL)) {
+            if (!g_hash_table_contains(redirected, device))
+                priv->usb_disconnected++;
+        }
+        g_hash_table_unref(priv->usb_redirected);
+    }
+    priv->usb_redirected = redirected;
+}
+
 static void
 usb_connect_failed(GObject *object G_GNUC_UNUSED,
                    SpiceUsbDevice *device G_GNUC_UNUSED,
@@ -297,9 +447,19 @@ usb_connect_failed(GObject *object G_GNUC_UNUSED,
     if (g_error_matches(error, G_IO_ERROR, G_IO_ERROR_CANCELLED))
         return;
 
+    self->priv->usb_errors++;
+    usb_update_redirected(self);
     g_signal_emit_by_name(self, "session-usb-failed", error->message);
 }
 
+static void
+usb_device_removed(SpiceUsbDeviceManager *manager G_GNUC_UNUSED,
+                   SpiceUsbDevice *device G_GNUC_UNUSED,
+                   VirtViewerSessionSpice *self)
+{
+    usb_update_redirected(self);
+}
+
 static void virt_viewer_session_spice_set_has_sw_reader(VirtViewerSessionSpice *session,
                                                         gboolean has_sw_reader)
 {
@@ -406,6 +566,8 @@ create_spice_session(VirtViewerSessionSpice *self)
                                           G_CALLBACK(usb_connect_failed), self, 0);
         virt_viewer_signal_connect_object(usb_manager, "device-error",
                                           G_CALLBACK(usb_connect_failed), self, 0);
+        virt_viewer_signal_connect_object(usb_manager, "device-removed",
+                                          G_CALLBACK(usb_device_removed), self, 0);
     }
     g_object_bind_property(self, "auto-usbredir",
                            self->priv->gtk_session, "auto-usbredir",
@@ -661,6 +823,25 @@ virt_viewer_session_spice_channel_open_fd_request(SpiceChannel *channel,
     g_signal_emit_by_name(session, "session-channel-open", channel);
 }
 
+/* Each channel makes its own connection, and TLS handshake on a TLS
+ * port, the timeline shows what each of them costs */
+static void
+virt_viewer_session_spice_channel_event(SpiceChannel *channel,
+                                        SpiceChannelEvent event,
+                                        VirtViewerSession *session G_GNUC_UNUSED)
+{
+    gint type, id;
+    gchar *detail;
+
+    if (event != SPICE_CHANNEL_OPENED)
+        return;
+
+    g_object_get(channel, "channel-type", &type, "channel-id", &id, NULL);
+    detail = g_strdup_printf("%s %d", spice_channel_type_to_string(type), id);
+    virt_viewer_timeline_mark("spice-channel-opened", detail);
+    g_free(detail);
+}
+
 static void
 virt_viewer_session_spice_main_channel_event(SpiceChannel *channel,
                                              SpiceChannelEvent event,
@@ -676,6 +857,7 @@ virt_viewer_session_spice_main_channel_event(SpiceChannel *channel,
     switch (event) {
     case SPICE_CHANNEL_OPENED:
         g_debug("main channel: opened");
+        virt_viewer_timeline_mark("spice-main-channel-opened", NULL);
         g_signal_emit_by_name(session, "session-connected");
         break;
     case SPICE_CHANNEL_CLOSED:
@@ -823,6 +1005,8 @@ virt_viewer_session_spice_usb_device_selection(VirtViewerSession *session,
     gtk_widget_show_all(dialog);
     gtk_dialog_run(GTK_DIALOG(dialog));
     gtk_widget_destroy(dialog);
+
+    usb_update_redirected(self);
 }
 
 static void
@@ -947,6 +1131,12 @@ on_new_file_transfer(SpiceMainChannel *channel G_GNUC_UNUSED,
                      gpointer user_data)
 {
     VirtViewerSessionSpice *self = VIRT_VIEWER_SESSION_SPICE(user_data);
+
+    /* built on first use, most sessions never transfer files */
+    if (self->priv->file_transfer_dialog == NULL)
+        self->priv->file_transfer_dialog =
+            virt_viewer_file_transfer_dialog_new(self->priv->main_window);
+
     virt_viewer_file_transfer_dialog_add_task(self->priv->file_transfer_dialog,
                                               task);
 }
@@ -985,6 +1175,9 @@ virt_viewer_session_spice_channel_new(SpiceSession *s,
                                           G_CALLBACK(agent_connected_changed), self, 0);
         virt_viewer_signal_connect_object(channel, "new-file-transfer",
                                           G_CALLBACK(on_new_file_transfer), self, 0);
+    } else {
+        virt_viewer_signal_connect_object(channel, "channel-event",
+                                          G_CALLBACK(virt_viewer_session_spice_channel_event), self, 0);
     }
 
     if (SPICE_IS_DISPLAY_CHANNEL(channel)) {
@@ -1022,9 +1215,7 @@ virt_viewer_session_spice_fullscreen_auto_conf(VirtViewerSessionSpice *self)
     GdkScreen *screen = gdk_screen_get_default();
     SpiceMainChannel* cmain = virt_viewer_session_spice_get_main_channel(self);
     VirtViewerApp *app = NULL;
-    GHashTable *displays;
-    GHashTableIter iter;
-    gpointer key, value;
+    VirtViewerMonitorLayout displays;
     gboolean agent_connected;
     GList *initial_displays, *l;
     guint ndisplays;
@@ -1060,32 +1251,40 @@ virt_viewer_session_spice_fullscreen_auto_conf(VirtViewerSessionSpice *self)
     initial_displays = virt_viewer_app_get_initial_displays(app);
     ndisplays = g_list_length(initial_displays);
     g_debug("Performing full screen auto-conf, %u host monitors", ndisplays);
-    displays = g_hash_table_new_full(g_direct_hash, g_direct_equal, NULL, g_free);
+    virt_viewer_monitor_layout_init(&displays);
 
     for (l = initial_displays; l != NULL; l = l->next) {
-        GdkRectangle* rect = g_new0(GdkRectangle, 1);;
+        GdkRectangle rect;
         gint j = virt_viewer_app_get_initial_monitor_for_display(app, GPOINTER_TO_INT(l->data));
         if (j == -1)
             continue;
 
-        gdk_screen_get_monitor_geometry(screen, j, rect);
-        g_hash_table_insert(displays, l->data, rect);
+        if (GPOINTER_TO_INT(l->data) >= VIRT_VIEWER_MONITOR_LAYOUT_MAX) {
+            g_warning("Cannot configure display %d, only the first %d displays can be",
+                      GPOINTER_TO_INT(l->data), VIRT_VIEWER_MONITOR_LAYOUT_MAX);
+            continue;
+        }
+
+        gdk_screen_get_monitor_geometry(screen, j, &rect);
+        virt_viewer_monitor_layout_set(&displays, GPOINTER_TO_INT(l->data), &rect);
     }
 
-    virt_viewer_shift_monitors_to_origin(displays);
+    virt_viewer_shift_monitors_to_origin(&displays);
 
-    g_hash_table_iter_init(&iter, displays);
-    while (g_hash_table_iter_next(&iter, &key, &value)) {
-        GdkRectangle *rect = value;
-        gint j = GPOINTER_TO_INT(key);
+    for (l = initial_displays; l != NULL; l = l->next) {
+        gint j = GPOINTER_TO_INT(l->data);
+        const GdkRectangle *rect;
 
+        if (!virt_viewer_monitor_layout_has(&displays, j))
+            continue;
+
+        rect = &displays.rects[j];
         spice_main_set_display(cmain, j, rect->x, rect->y, rect->width, rect->height);
         spice_main_set_display_enabled(cmain, j, TRUE);
         g_debug("Set SPICE display %d to (%d,%d)-(%dx%d)",
                   j, rect->x, rect->y, rect->width, rect->height);
     }
     g_list_free(initial_displays);
-    g_hash_table_unref(displays);
 
     spice_main_send_monitor_config(cmain);
     self->priv->did_auto_conf = TRUE;
@@ -1169,16 +1368,16 @@ virt_viewer_session_spice_smartcard_remove(VirtViewerSession *session G_GNUC_UNU
 }
 
 static void
-virt_viewer_session_spice_apply_monitor_geometry(VirtViewerSession *session, GHashTable *monitors)
+virt_viewer_session_spice_apply_monitor_geometry(VirtViewerSession *session, const VirtViewerMonitorLayout *monitors)
 {
-    GHashTableIter iter;
-    gpointer key = NULL, value = NULL;
     VirtViewerSessionSpice *self = VIRT_VIEWER_SESSION_SPICE(session);
+    guint i;
 
-    g_hash_table_iter_init(&iter, monitors);
-    while (g_hash_table_iter_next(&iter, &key, &value)) {
-        gint i = GPOINTER_TO_INT(key);
-        GdkRectangle* rect = value;
+    for (i = 0; i < monitors->n_slots; i++) {
+        const GdkRectangle *rect = &monitors->rects[i];
+
+        if (!virt_viewer_monitor_layout_has(monitors, i))
+            continue;
 
         spice_main_set_display(self->priv->main_channel, i, rect->x,
                                rect->y, rect->width, rect->height);
@@ -119,17 +119,12 @@ static void
 virt_viewer_session_vnc_disconnected(VncDisplay *vnc G_GNUC_UNUSED,
                                      VirtViewerSessionVnc *session)
 {
-    GtkWidget *display;
     if (session->priv->auth_dialog_cancelled)
         return;
 
     virt_viewer_session_clear_displays(VIRT_VIEWER_SESSION(session));
-    display = virt_viewer_display_vnc_new(session, session->priv->vnc);
     g_debug("Disconnected");
     g_signal_emit_by_name(session, "session-disconnected", NULL);
-    virt_viewer_display_set_enabled(VIRT_VIEWER_DISPLAY(display), FALSE);
-    virt_viewer_display_set_show_hint(VIRT_VIEWER_DISPLAY(display),
-                                      VIRT_VIEWER_DISPLAY_SHOW_HINT_READY, FALSE);
 }
 
 static void
@@ -188,6 +183,21 @@ virt_viewer_session_vnc_open_fd(VirtViewerSession* session,
     return vnc_display_open_fd(self->priv->vnc, fd);
 }
 
+#ifdef HAVE_VNC_DISPLAY_OPEN_FD_WITH_HOSTNAME
+/* @hostname: the name the connection on @fd was opened to, which the
+ * VeNCrypt x509 authentication checks the server certificate against */
+gboolean
+virt_viewer_session_vnc_open_fd_with_hostname(VirtViewerSessionVnc *self,
+                                              int fd,
+                                              const gchar *hostname)
+{
+    g_return_val_if_fail(VIRT_VIEWER_IS_SESSION_VNC(self), FALSE);
+    g_return_val_if_fail(self->priv->vnc != NULL, FALSE);
+
+    return vnc_display_open_fd_with_hostname(self->priv->vnc, fd, hostname);
+}
+#endif
+
 static gboolean
 virt_viewer_session_vnc_channel_open_fd(VirtViewerSession* session G_GNUC_UNUSED,
                                         VirtViewerSessionChannel* channel G_GNUC_UNUSED,
@@ -65,6 +65,11 @@ struct _VirtViewerSessionVncClass {
 GType virt_viewer_session_vnc_get_type(void);
 
 VirtViewerSession *virt_viewer_session_vnc_new(VirtViewerApp *app, GtkWindow *main_window);
+#ifdef HAVE_VNC_DISPLAY_OPEN_FD_WITH_HOSTNAME
+gboolean virt_viewer_session_vnc_open_fd_with_hostname(VirtViewerSessionVnc *self,
+                                                       int fd,
+                                                       const gchar *hostname);
+#endif
 
 G_END_DECLS
 
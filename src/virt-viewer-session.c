@@ -44,8 +44,20 @@ struct _VirtViewerSessionPrivate
     gboolean share_folder;
     gchar *shared_folder;
     gboolean share_folder_ro;
+
+    guint monitor_geometry_id; /* pending update, source id */
+    gboolean monitor_geometry_force;
+    gboolean has_last_monitors;
+    VirtViewerMonitorLayout last_monitors; /* the layout last applied */
+    guint monitor_geometry_applied;
+    guint monitor_geometry_suppressed;
 };
 
+/* Displays report geometry changes for each configure event while a
+ * window is dragged or goes fullscreen, the changes arriving within
+ * this many ms (about a frame) are applied at once */
+#define MONITOR_GEOMETRY_DELAY 16
+
 G_DEFINE_ABSTRACT_TYPE(VirtViewerSession, virt_viewer_session, G_TYPE_OBJECT)
 
 enum {
@@ -73,6 +85,8 @@ virt_viewer_session_finalize(GObject *obj)
     }
     g_list_free(session->priv->displays);
 
+    if (session->priv->monitor_geometry_id)
+        g_source_remove(session->priv->monitor_geometry_id);
     g_free(session->priv->uri);
     g_clear_object(&session->priv->file);
     g_free(session->priv->shared_folder);
@@ -398,43 +412,140 @@ virt_viewer_session_init(VirtViewerSession *session)
     session->priv = VIRT_VIEWER_SESSION_GET_PRIVATE(session);
 }
 
-static void
-virt_viewer_session_on_monitor_geometry_changed(VirtViewerSession* self,
-                                                VirtViewerDisplay* display G_GNUC_UNUSED)
+static gboolean
+virt_viewer_session_apply_monitor_geometry(gpointer user_data)
 {
-    VirtViewerSessionClass *klass;
+    VirtViewerSession *self = user_data;
+    VirtViewerSessionClass *klass = VIRT_VIEWER_SESSION_GET_CLASS(self);
     gboolean all_fullscreen = TRUE;
-    /* GHashTable<gint, GdkRectangle*> */
-    GHashTable *monitors;
+    VirtViewerMonitorLayout monitors;
     GList *l;
 
-    klass = VIRT_VIEWER_SESSION_GET_CLASS(self);
-    if (!klass->apply_monitor_geometry)
-        return;
+    self->priv->monitor_geometry_id = 0;
 
-    monitors = g_hash_table_new_full(g_direct_hash, g_direct_equal, NULL, g_free);
+    virt_viewer_monitor_layout_init(&monitors);
 
     for (l = self->priv->displays; l; l = l->next) {
         VirtViewerDisplay *d = VIRT_VIEWER_DISPLAY(l->data);
         guint nth = 0;
-        GdkRectangle *rect = g_new0(GdkRectangle, 1);
+        GdkRectangle rect = { 0, };
 
         g_object_get(d, "nth-display", &nth, NULL);
-        virt_viewer_display_get_preferred_monitor_geometry(d, rect);
+        if (nth >= VIRT_VIEWER_MONITOR_LAYOUT_MAX) {
+            g_debug("Not aligning display %u, only the first %d displays are",
+                    nth, VIRT_VIEWER_MONITOR_LAYOUT_MAX);
+            continue;
+        }
+        virt_viewer_display_get_preferred_monitor_geometry(d, &rect);
 
         if (virt_viewer_display_get_enabled(d) &&
             !virt_viewer_display_get_fullscreen(d))
             all_fullscreen = FALSE;
-        g_hash_table_insert(monitors, GINT_TO_POINTER(nth), rect);
+        virt_viewer_monitor_layout_set(&monitors, nth, &rect);
+    }
+
+    if (!all_fullscreen) {
+        if (self->priv->app != NULL &&
+            virt_viewer_app_get_monitor_layout_mode(self->priv->app) == VIRT_VIEWER_MONITOR_LAYOUT_GRID)
+            virt_viewer_align_monitors_grid(&monitors);
+        else
+            virt_viewer_align_monitors_linear(&monitors);
+    }
+
+    virt_viewer_shift_monitors_to_origin(&monitors);
+
+    if (!self->priv->monitor_geometry_force &&
+        self->priv->has_last_monitors &&
+        virt_viewer_monitor_layout_equal(&monitors, &self->priv->last_monitors)) {
+        self->priv->monitor_geometry_suppressed++;
+        g_debug("Monitor geometry unchanged, not sending it (%u updates suppressed)",
+                self->priv->monitor_geometry_suppressed);
+        return G_SOURCE_REMOVE;
+    }
+
+    self->priv->monitor_geometry_force = FALSE;
+    self->priv->monitor_geometry_applied++;
+    klass->apply_monitor_geometry(self, &monitors);
+
+    self->priv->last_monitors = monitors;
+    self->priv->has_last_monitors = TRUE;
+
+    return G_SOURCE_REMOVE;
+}
+
+static void
+virt_viewer_session_on_monitor_geometry_changed(VirtViewerSession* self,
+                                                VirtViewerDisplay* display G_GNUC_UNUSED)
+{
+    VirtViewerSessionClass *klass;
+
+    klass = VIRT_VIEWER_SESSION_GET_CLASS(self);
+    if (!klass->apply_monitor_geometry)
+        return;
+
+    if (self->priv->monitor_geometry_id != 0) {
+        self->priv->monitor_geometry_suppressed++;
+        return;
     }
 
-    if (!all_fullscreen)
-        virt_viewer_align_monitors_linear(monitors);
+    self->priv->monitor_geometry_id = g_timeout_add(MONITOR_GEOMETRY_DELAY,
+                                                    virt_viewer_session_apply_monitor_geometry,
+                                                    self);
+}
+
+/**
+ * virt_viewer_session_get_monitor_geometry_stats:
+ * @session: a #VirtViewerSession
+ * @applied: (out) (allow-none): the number of layouts sent to the guest
+ * @suppressed: (out) (allow-none): the number of geometry changes which
+ * were coalesced with another one, or left the layout unchanged
+ */
+void
+virt_viewer_session_get_monitor_geometry_stats(VirtViewerSession *session,
+                                               guint *applied,
+                                               guint *suppressed)
+{
+    g_return_if_fail(VIRT_VIEWER_IS_SESSION(session));
+
+    if (applied)
+        *applied = session->priv->monitor_geometry_applied;
+    if (suppressed)
+        *suppressed = session->priv->monitor_geometry_suppressed;
+}
+
+/**
+ * virt_viewer_session_get_monitor_layout:
+ * @session: a #VirtViewerSession
+ * @layout: (out): where to store the layout
+ *
+ * Returns: TRUE if a layout was sent to the guest, and stored in @layout
+ */
+gboolean
+virt_viewer_session_get_monitor_layout(VirtViewerSession *session,
+                                       VirtViewerMonitorLayout *layout)
+{
+    g_return_val_if_fail(VIRT_VIEWER_IS_SESSION(session), FALSE);
+    g_return_val_if_fail(layout != NULL, FALSE);
+
+    if (!session->priv->has_last_monitors)
+        return FALSE;
+
+    *layout = session->priv->last_monitors;
+    return TRUE;
+}
 
-    virt_viewer_shift_monitors_to_origin(monitors);
+/**
+ * virt_viewer_session_get_displays:
+ * @session: a #VirtViewerSession
+ *
+ * Returns: (transfer container): the displays of @session
+ */
+GList *
+virt_viewer_session_get_displays(VirtViewerSession *session)
+{
+    g_return_val_if_fail(VIRT_VIEWER_IS_SESSION(session), NULL);
 
-    klass->apply_monitor_geometry(self, monitors);
-    g_hash_table_unref(monitors);
+    return g_list_copy(session->priv->displays);
 }
 
 void virt_viewer_session_add_display(VirtViewerSession *session,
@@ -477,10 +588,13 @@ void virt_viewer_session_clear_displays(VirtViewerSession *session)
     }
     g_list_free(session->priv->displays);
     session->priv->displays = NULL;
+    session->priv->has_last_monitors = FALSE;
 }
 
+/* Sends the layout even if it did not change, the guest may have lost it */
 void virt_viewer_session_update_displays_geometry(VirtViewerSession *session)
 {
+    session->priv->monitor_geometry_force = TRUE;
     virt_viewer_session_on_monitor_geometry_changed(session, NULL);
 }
 
@@ -677,6 +791,90 @@ gboolean virt_viewer_session_can_retry_auth(VirtViewerSession *self)
     return klass->can_retry_auth ? klass->can_retry_auth(self) : FALSE;
 }
 
+/**
+ * virt_viewer_session_get_bytes_received:
+ * @bytes: (out): the number of bytes read from the server so far
+ *
+ * Returns: FALSE if the session does not keep track of its traffic
+ */
+gboolean virt_viewer_session_get_bytes_received(VirtViewerSession *self, guint64 *bytes)
+{
+    VirtViewerSessionClass *klass;
+
+    g_return_val_if_fail(VIRT_VIEWER_IS_SESSION(self), FALSE);
+    g_return_val_if_fail(bytes != NULL, FALSE);
+
+    klass = VIRT_VIEWER_SESSION_GET_CLASS(self);
+    if (klass->get_bytes_received == NULL)
+        return FALSE;
+
+    return klass->get_bytes_received(self, bytes);
+}
+
+/**
+ * virt_viewer_session_collect_metrics:
+ * @metrics: where to describe and set the session counters
+ *
+ * Adds the monitor configurations and display resizes, and whatever the
+ * protocol implementation keeps track of.
+ */
+void virt_viewer_session_collect_metrics(VirtViewerSession *self, VirtViewerMetrics *metrics)
+{
+    VirtViewerSessionClass *klass;
+    GList *l;
+
+    g_return_if_fail(VIRT_VIEWER_IS_SESSION(self));
+    g_return_if_fail(metrics != NULL);
+
+    virt_viewer_metrics_describe(metrics, "virt_viewer_monitor_configs_total",
+                                 VIRT_VIEWER_METRIC_COUNTER,
+                                 "Monitor layouts sent to the guest");
+    virt_viewer_metrics_set(metrics, "virt_viewer_monitor_configs_total",
+                            self->priv->monitor_geometry_applied, NULL);
+    virt_viewer_metrics_describe(metrics, "virt_viewer_monitor_configs_suppressed_total",
+                                 VIRT_VIEWER_METRIC_COUNTER,
+                                 "Monitor geometry changes coalesced or left unsent");
+    virt_viewer_metrics_set(metrics, "virt_viewer_monitor_configs_suppressed_total",
+                            self->priv->monitor_geometry_suppressed, NULL);
+
+    virt_viewer_metrics_describe(metrics, "virt_viewer_display_resizes_total",
+                                 VIRT_VIEWER_METRIC_COUNTER,
+                                 "Guest display size changes");
+    virt_viewer_metrics_describe(metrics, "virt_viewer_display_resizes_coalesced_total",
+                                 VIRT_VIEWER_METRIC_COUNTER,
+                                 "Guest display size changes merged with the previous relayout");
+    virt_viewer_metrics_describe(metrics, "virt_viewer_display_allocations_total",
+                                 VIRT_VIEWER_METRIC_COUNTER,
+                                 "Size allocations of the displays");
+    virt_viewer_metrics_describe(metrics, "virt_viewer_display_allocation_seconds_total",
+                                 VIRT_VIEWER_METRIC_COUNTER,
+                                 "Time spent allocating the size of the displays");
+    for (l = self->priv->displays; l != NULL; l = l->next) {
+        VirtViewerDisplay *display = VIRT_VIEWER_DISPLAY(l->data);
+        gchar *nth = g_strdup_printf("%d", virt_viewer_display_get_nth(display));
+        guint allocations, coalesced;
+        gint64 allocation_time;
+
+        virt_viewer_display_get_relayout_stats(display, &allocations, &allocation_time,
+                                               NULL, &coalesced);
+        virt_viewer_metrics_set(metrics, "virt_viewer_display_resizes_total",
+                                virt_viewer_display_get_resize_count(display),
+                                "display", nth, NULL);
+        virt_viewer_metrics_set(metrics, "virt_viewer_display_resizes_coalesced_total",
+                                coalesced, "display", nth, NULL);
+        virt_viewer_metrics_set(metrics, "virt_viewer_display_allocations_total",
+                                allocations, "display", nth, NULL);
+        virt_viewer_metrics_set(metrics, "virt_viewer_display_allocation_seconds_total",
+                                (gdouble)allocation_time / G_USEC_PER_SEC,
+                                "display", nth, NULL);
+        g_free(nth);
+    }
+
+    klass = VIRT_VIEWER_SESSION_GET_CLASS(self);
+    if (klass->collect_metrics)
+        klass->collect_metrics(self, metrics);
+}
+
 /*
  * Local variables:
  *  c-indent-level: 4
@@ -29,6 +29,8 @@
 #include "virt-viewer-app.h"
 #include "virt-viewer-file.h"
 #include "virt-viewer-display.h"
+#include "virt-viewer-metrics.h"
+#include "virt-viewer-util.h"
 
 G_BEGIN_DECLS
 
@@ -94,10 +96,12 @@ struct _VirtViewerSessionClass {
     void (*session_cut_text)(VirtViewerSession *session, const gchar *str);
     void (*session_bell)(VirtViewerSession *session);
     void (*session_cancelled)(VirtViewerSession *session);
-    /* monitors = GHashTable<int, GdkRectangle*> */
-    void (*apply_monitor_geometry)(VirtViewerSession *session, GHashTable* monitors);
+    /* monitors: the aligned geometry of the displays, by display id */
+    void (*apply_monitor_geometry)(VirtViewerSession *session, const VirtViewerMonitorLayout *monitors);
     gboolean (*can_share_folder)(VirtViewerSession *session);
     gboolean (*can_retry_auth)(VirtViewerSession *session);
+    gboolean (*get_bytes_received)(VirtViewerSession *session, guint64 *bytes);
+    void (*collect_metrics)(VirtViewerSession *session, VirtViewerMetrics *metrics);
 };
 
 GType virt_viewer_session_get_type(void);
@@ -111,6 +115,12 @@ void virt_viewer_session_remove_display(VirtViewerSession *session,
                                         VirtViewerDisplay *display);
 void virt_viewer_session_clear_displays(VirtViewerSession *session);
 void virt_viewer_session_update_displays_geometry(VirtViewerSession *session);
+GList *virt_viewer_session_get_displays(VirtViewerSession *session);
+gboolean virt_viewer_session_get_monitor_layout(VirtViewerSession *session,
+                                               VirtViewerMonitorLayout *layout);
+void virt_viewer_session_get_monitor_geometry_stats(VirtViewerSession *session,
+                                                    guint *applied,
+                                                    guint *suppressed);
 
 void virt_viewer_session_close(VirtViewerSession* session);
 gboolean virt_viewer_session_open_fd(VirtViewerSession* session, int fd);
@@ -135,6 +145,8 @@ void virt_viewer_session_set_file(VirtViewerSession *self, VirtViewerFile *file)
 VirtViewerFile* virt_viewer_session_get_file(VirtViewerSession *self);
 gboolean virt_viewer_session_can_share_folder(VirtViewerSession *self);
 gboolean virt_viewer_session_can_retry_auth(VirtViewerSession *self);
+gboolean virt_viewer_session_get_bytes_received(VirtViewerSession *self, guint64 *bytes);
+void virt_viewer_session_collect_metrics(VirtViewerSession *self, VirtViewerMetrics *metrics);
 
 G_END_DECLS
 
@@ -0,0 +1,268 @@
+/*
+ * Virt Viewer: A virtual machine console viewer
+ *
+ * Copyright (C) 2016 Red Hat, Inc.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#include <config.h>
+
+#include <glib.h>
+#include <glib/gstdio.h>
+
+#include "virt-viewer-ssh-mux.h"
+
+/*
+ * Keeps track of the OpenSSH ControlMaster connections used to
+ * multiplex the graphics channels of a session over a single SSH
+ * connection per host.
+ *
+ * The first tunnel opened to a given host becomes the master
+ * (ControlMaster=auto) and stays around for a while after its own
+ * channel is closed (ControlPersist); all the following tunnels to that
+ * host only open a new session on the existing connection, skipping the
+ * TCP, key exchange and authentication round trips.
+ *
+ * The control sockets live in a private temporary directory, and the
+ * masters are asked to exit by virt_viewer_ssh_mux_close_all(). The
+ * persist delay bounds how long they outlive a viewer which was killed
+ * before that.
+ */
+
+struct _VirtViewerSshMux {
+    gchar *dir;
+    /* "user@host:port" -> MuxMaster */
+    GHashTable *masters;
+    guint next_id;
+    guint persist; /* seconds */
+};
+
+typedef struct {
+    gchar *control_path;
+    gchar **exit_cmd;
+} MuxMaster;
+
+static void virt_viewer_ssh_mux_close(VirtViewerSshMux *mux, gboolean wait);
+
+static void
+mux_master_free(MuxMaster *master)
+{
+    g_free(master->control_path);
+    g_strfreev(master->exit_cmd);
+    g_free(master);
+}
+
+/**
+ * virt_viewer_ssh_mux_new:
+ * @persist: how many seconds a master connection stays around once its
+ * last tunnel is closed, at least 1
+ */
+VirtViewerSshMux *
+virt_viewer_ssh_mux_new(guint persist)
+{
+    VirtViewerSshMux *mux = g_new0(VirtViewerSshMux, 1);
+
+    mux->persist = MAX(persist, 1);
+    mux->masters = g_hash_table_new_full(g_str_hash, g_str_equal, g_free,
+                                         (GDestroyNotify)mux_master_free);
+
+    return mux;
+}
+
+void
+virt_viewer_ssh_mux_free(VirtViewerSshMux *mux)
+{
+    if (mux == NULL)
+        return;
+
+    /* the main loop may not run anymore to reap the ssh processes */
+    virt_viewer_ssh_mux_close(mux, TRUE);
+    g_hash_table_unref(mux->masters);
+    if (mux->dir != NULL && g_rmdir(mux->dir) < 0)
+        g_debug("Failed to remove ssh control directory %s", mux->dir);
+    g_free(mux->dir);
+    g_free(mux);
+}
+
+static MuxMaster *
+virt_viewer_ssh_mux_lookup(VirtViewerSshMux *mux,
+                           const gchar *sshhost,
+                           gint sshport,
+                           const gchar *sshuser)
+{
+    MuxMaster *master;
+    GPtrArray *exit_cmd;
+    gchar *key;
+
+    key = g_strdup_printf("%s@%s:%d", sshuser ? sshuser : "", sshhost, sshport);
+    master = g_hash_table_lookup(mux->masters, key);
+    if (master != NULL) {
+        g_free(key);
+        return master;
+    }
+
+    if (mux->dir == NULL) {
+        GError *error = NULL;
+
+        mux->dir = g_dir_make_tmp("virt-viewer-ssh-XXXXXX", &error);
+        if (mux->dir == NULL) {
+            g_warning("Cannot create ssh control directory: %s", error->message);
+            g_clear_error(&error);
+            g_free(key);
+            return NULL;
+        }
+    }
+
+    master = g_new0(MuxMaster, 1);
+    /* keep it short, unix socket paths are limited to ~100 bytes */
+    master->control_path = g_strdup_printf("%s/%u", mux->dir, mux->next_id++);
+
+    exit_cmd = g_ptr_array_new();
+    g_ptr_array_add(exit_cmd, g_strdup("ssh"));
+    g_ptr_array_add(exit_cmd, g_strdup("-o"));
+    g_ptr_array_add(exit_cmd, g_strdup_printf("ControlPath=%s", master->control_path));
+    g_ptr_array_add(exit_cmd, g_strdup("-O"));
+    g_ptr_array_add(exit_cmd, g_strdup("exit"));
+    if (sshport) {
+        g_ptr_array_add(exit_cmd, g_strdup("-p"));
+        g_ptr_array_add(exit_cmd, g_strdup_printf("%d", sshport));
+    }
+    if (sshuser) {
+        g_ptr_array_add(exit_cmd, g_strdup("-l"));
+        g_ptr_array_add(exit_cmd, g_strdup(sshuser));
+    }
+    g_ptr_array_add(exit_cmd, g_strdup(sshhost));
+    g_ptr_array_add(exit_cmd, NULL);
+    master->exit_cmd = (gchar **)g_ptr_array_free(exit_cmd, FALSE);
+
+    g_debug("Using ssh control socket %s for %s", master->control_path, key);
+    g_hash_table_insert(mux->masters, key, master);
+
+    return master;
+}
+
+/**
+ * virt_viewer_ssh_mux_add_options:
+ * @mux: a #VirtViewerSshMux
+ * @cmd: the ssh command being built, with g_free() as element free function
+ * @sshhost: the host to connect to
+ * @sshport: the ssh port, or 0 for the default
+ * @sshuser: (allow-none): the remote user
+ *
+ * Appends the options needed to share a single master connection to
+ * @sshhost between all the ssh commands built through @mux.
+ */
+void
+virt_viewer_ssh_mux_add_options(VirtViewerSshMux *mux,
+                                GPtrArray *cmd,
+                                const gchar *sshhost,
+                                gint sshport,
+                                const gchar *sshuser)
+{
+    MuxMaster *master;
+
+    g_return_if_fail(mux != NULL);
+    g_return_if_fail(cmd != NULL);
+    g_return_if_fail(sshhost != NULL);
+
+    master = virt_viewer_ssh_mux_lookup(mux, sshhost, sshport, sshuser);
+    if (master == NULL)
+        return;
+
+    g_ptr_array_add(cmd, g_strdup("-o"));
+    g_ptr_array_add(cmd, g_strdup("ControlMaster=auto"));
+    g_ptr_array_add(cmd, g_strdup("-o"));
+    g_ptr_array_add(cmd, g_strdup_printf("ControlPath=%s", master->control_path));
+    g_ptr_array_add(cmd, g_strdup("-o"));
+    g_ptr_array_add(cmd, g_strdup_printf("ControlPersist=%u", mux->persist));
+}
+
+guint
+virt_viewer_ssh_mux_get_n_masters(VirtViewerSshMux *mux)
+{
+    g_return_val_if_fail(mux != NULL, 0);
+
+    return g_hash_table_size(mux->masters);
+}
+
+static void
+mux_exit_done(GPid pid, gint status G_GNUC_UNUSED, gpointer user_data)
+{
+    gchar *control_path = user_data;
+
+    /* the socket is gone if the master was running, but make sure */
+    g_unlink(control_path);
+    g_spawn_close_pid(pid);
+    g_free(control_path);
+}
+
+static void
+virt_viewer_ssh_mux_close(VirtViewerSshMux *mux, gboolean wait)
+{
+    GHashTableIter iter;
+    gpointer key, value;
+
+    g_hash_table_iter_init(&iter, mux->masters);
+    while (g_hash_table_iter_next(&iter, &key, &value)) {
+        MuxMaster *master = value;
+        GSpawnFlags flags = G_SPAWN_SEARCH_PATH |
+            G_SPAWN_STDOUT_TO_DEV_NULL | G_SPAWN_STDERR_TO_DEV_NULL;
+        GError *error = NULL;
+        GPid pid;
+
+        g_debug("Closing ssh master connection for %s", (const gchar *)key);
+        if (wait) {
+            if (!g_spawn_sync(NULL, master->exit_cmd, NULL, flags,
+                              NULL, NULL, NULL, NULL, NULL, &error)) {
+                g_debug("Failed to stop ssh master: %s", error->message);
+                g_clear_error(&error);
+            }
+            g_unlink(master->control_path);
+        } else if (g_spawn_async(NULL, master->exit_cmd, NULL,
+                                 flags | G_SPAWN_DO_NOT_REAP_CHILD,
+                                 NULL, NULL, &pid, &error)) {
+            g_child_watch_add(pid, mux_exit_done, g_strdup(master->control_path));
+        } else {
+            g_debug("Failed to stop ssh master: %s", error->message);
+            g_clear_error(&error);
+            g_unlink(master->control_path);
+        }
+        g_hash_table_iter_remove(&iter);
+    }
+}
+
+/**
+ * virt_viewer_ssh_mux_close_all:
+ * @mux: a #VirtViewerSshMux
+ *
+ * Asks all the master connections to exit, without waiting for them.
+ * Tunnels still running over them are torn down as well.
+ */
+void
+virt_viewer_ssh_mux_close_all(VirtViewerSshMux *mux)
+{
+    g_return_if_fail(mux != NULL);
+
+    virt_viewer_ssh_mux_close(mux, FALSE);
+}
+
+/*
+ * Local variables:
+ *  c-indent-level: 4
+ *  c-basic-offset: 4
+ *  indent-tabs-mode: nil
+ * End:
+ */
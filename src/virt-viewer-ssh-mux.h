@@ -0,0 +1,51 @@
+/*
+ * Virt Viewer: A virtual machine console viewer
+ *
+ * Copyright (C) 2016 Red Hat, Inc.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#ifndef VIRT_VIEWER_SSH_MUX_H
+#define VIRT_VIEWER_SSH_MUX_H
+
+#include <glib.h>
+
+G_BEGIN_DECLS
+
+typedef struct _VirtViewerSshMux VirtViewerSshMux;
+
+VirtViewerSshMux *virt_viewer_ssh_mux_new(guint persist);
+void virt_viewer_ssh_mux_free(VirtViewerSshMux *mux);
+
+void virt_viewer_ssh_mux_add_options(VirtViewerSshMux *mux,
+                                     GPtrArray *cmd,
+                                     const gchar *sshhost,
+                                     gint sshport,
+                                     const gchar *sshuser);
+guint virt_viewer_ssh_mux_get_n_masters(VirtViewerSshMux *mux);
+void virt_viewer_ssh_mux_close_all(VirtViewerSshMux *mux);
+
+G_END_DECLS
+
+#endif /* VIRT_VIEWER_SSH_MUX_H */
+
+/*
+ * Local variables:
+ *  c-indent-level: 4
+ *  c-basic-offset: 4
+ *  indent-tabs-mode: nil
+ * End:
+ */
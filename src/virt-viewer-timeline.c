@@ -0,0 +1,258 @@
+/*
+ * Virt Viewer: A virtual machine console viewer
+ *
+ * Copyright (C) 2016 Red Hat, Inc.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#include <config.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <errno.h>
+#include <glib.h>
+#include <glib/gstdio.h>
+#include <glib/gi18n.h>
+
+#include "virt-viewer-util.h"
+#include "virt-viewer-timeline.h"
+
+/*
+ * The timeline is a stream of JSON objects, one per line, describing
+ * the stages a viewer goes through between startup and the first
+ * frame being displayed. Timestamps are taken from the monotonic
+ * clock and are relative to the startup of the program, or to the
+ * moment the timeline was opened if it was not recorded:
+ *
+ *   {"ts":1234,"stage":"libvirt-connect","phase":"begin"}
+ *   {"ts":5678,"stage":"libvirt-connect","phase":"end","dur":4444,"detail":"qemu:///system"}
+ *   {"ts":9012,"stage":"first-frame","phase":"mark"}
+ */
+
+G_LOCK_DEFINE_STATIC(timeline);
+static FILE *timeline_out = NULL;
+static gint64 timeline_origin = 0;
+static gint64 timeline_startup = 0;
+
+static void
+timeline_append_json_string(GString *str, const gchar *value)
+{
+    const gchar *p;
+
+    g_string_append_c(str, '"');
+    for (p = value; *p != '\0'; p++) {
+        switch (*p) {
+        case '"':
+            g_string_append(str, "\\\"");
+            break;
+        case '\\':
+            g_string_append(str, "\\\\");
+            break;
+        case '\n':
+            g_string_append(str, "\\n");
+            break;
+        case '\r':
+            g_string_append(str, "\\r");
+            break;
+        case '\t':
+            g_string_append(str, "\\t");
+            break;
+        default:
+            if ((guchar)*p < 0x20)
+                g_string_append_printf(str, "\\u%04x", (guchar)*p);
+            else
+                g_string_append_c(str, *p);
+        }
+    }
+    g_string_append_c(str, '"');
+}
+
+static void
+timeline_write(const gchar *stage, const gchar *phase,
+               gint64 now, gint64 duration, const gchar *detail)
+{
+    GString *line;
+
+    line = g_string_new(NULL);
+    g_string_append_printf(line, "{\"ts\":%" G_GINT64_FORMAT ",\"stage\":",
+                           now - timeline_origin);
+    timeline_append_json_string(line, stage);
+    g_string_append_printf(line, ",\"phase\":\"%s\"", phase);
+    if (duration >= 0)
+        g_string_append_printf(line, ",\"dur\":%" G_GINT64_FORMAT, duration);
+    if (detail != NULL) {
+        g_string_append(line, ",\"detail\":");
+        timeline_append_json_string(line, detail);
+    }
+    g_string_append(line, "}\n");
+
+    G_LOCK(timeline);
+    if (timeline_out != NULL) {
+        fputs(line->str, timeline_out);
+        fflush(timeline_out);
+    }
+    G_UNLOCK(timeline);
+
+    g_string_free(line, TRUE);
+}
+
+/**
+ * virt_viewer_timeline_startup:
+ *
+ * Records the startup of the program, to be called first in main() so
+ * that the timeline covers the initialization before the options are
+ * parsed.
+ */
+void
+virt_viewer_timeline_startup(void)
+{
+    timeline_startup = g_get_monotonic_time();
+}
+
+/**
+ * virt_viewer_timeline_open:
+ * @spec: a file name, or "fd:N" to use an already open file descriptor
+ * @error: return location for a #GError
+ *
+ * Starts recording the connection timeline to @spec. Timestamps of
+ * subsequent events are relative to virt_viewer_timeline_startup(), or
+ * to this call if it was not called.
+ *
+ * Returns: %TRUE on success
+ */
+gboolean
+virt_viewer_timeline_open(const gchar *spec, GError **error)
+{
+    FILE *out;
+
+    g_return_val_if_fail(spec != NULL, FALSE);
+
+    if (g_str_has_prefix(spec, "fd:")) {
+        gchar *end = NULL;
+        gint64 fd = g_ascii_strtoll(spec + 3, &end, 10);
+
+        if (end == spec + 3 || *end != '\0' || fd < 0 || fd > G_MAXINT) {
+            g_set_error(error, VIRT_VIEWER_ERROR, VIRT_VIEWER_ERROR_FAILED,
+                        _("Invalid timeline file descriptor: %s"), spec);
+            return FALSE;
+        }
+        out = fdopen((int)fd, "a");
+    } else {
+        out = g_fopen(spec, "w");
+    }
+
+    if (out == NULL) {
+        int errsv = errno;
+        g_set_error(error, VIRT_VIEWER_ERROR, VIRT_VIEWER_ERROR_FAILED,
+                    _("Cannot open timeline output %s: %s"), spec, g_strerror(errsv));
+        return FALSE;
+    }
+
+    virt_viewer_timeline_close();
+
+    G_LOCK(timeline);
+    timeline_out = out;
+    timeline_origin = timeline_startup != 0 ? timeline_startup : g_get_monotonic_time();
+    G_UNLOCK(timeline);
+
+    virt_viewer_timeline_mark("start", g_get_prgname());
+
+    return TRUE;
+}
+
+void
+virt_viewer_timeline_close(void)
+{
+    G_LOCK(timeline);
+    if (timeline_out != NULL) {
+        fclose(timeline_out);
+        timeline_out = NULL;
+    }
+    G_UNLOCK(timeline);
+}
+
+gboolean
+virt_viewer_timeline_enabled(void)
+{
+    return timeline_out != NULL;
+}
+
+/**
+ * virt_viewer_timeline_begin:
+ * @stage: the name of the stage
+ *
+ * Records the beginning of @stage.
+ *
+ * Returns: the start timestamp to be passed to virt_viewer_timeline_end(),
+ * or 0 if the timeline is not enabled
+ */
+gint64
+virt_viewer_timeline_begin(const gchar *stage)
+{
+    gint64 now;
+
+    if (!virt_viewer_timeline_enabled())
+        return 0;
+
+    now = g_get_monotonic_time();
+    timeline_write(stage, "begin", now, -1, NULL);
+
+    return now;
+}
+
+/**
+ * virt_viewer_timeline_end:
+ * @stage: the name of the stage
+ * @start: the value returned by virt_viewer_timeline_begin()
+ * @detail: (allow-none): additional information about the outcome
+ *
+ * Records the end of @stage along with its duration in microseconds.
+ */
+void
+virt_viewer_timeline_end(const gchar *stage, gint64 start, const gchar *detail)
+{
+    gint64 now;
+
+    if (start == 0 || !virt_viewer_timeline_enabled())
+        return;
+
+    now = g_get_monotonic_time();
+    timeline_write(stage, "end", now, now - start, detail);
+}
+
+/**
+ * virt_viewer_timeline_mark:
+ * @stage: the name of the event
+ * @detail: (allow-none): additional information about the event
+ *
+ * Records a single point in time.
+ */
+void
+virt_viewer_timeline_mark(const gchar *stage, const gchar *detail)
+{
+    if (!virt_viewer_timeline_enabled())
+        return;
+
+    timeline_write(stage, "mark", g_get_monotonic_time(), -1, detail);
+}
+
+/*
+ * Local variables:
+ *  c-indent-level: 4
+ *  c-basic-offset: 4
+ *  indent-tabs-mode: nil
+ * End:
+ */
@@ -0,0 +1,47 @@
+/*
+ * Virt Viewer: A virtual machine console viewer
+ *
+ * Copyright (C) 2016 Red Hat, Inc.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#ifndef VIRT_VIEWER_TIMELINE_H
+#define VIRT_VIEWER_TIMELINE_H
+
+#include <glib.h>
+
+G_BEGIN_DECLS
+
+void virt_viewer_timeline_startup(void);
+gboolean virt_viewer_timeline_open(const gchar *spec, GError **error);
+void virt_viewer_timeline_close(void);
+gboolean virt_viewer_timeline_enabled(void);
+
+gint64 virt_viewer_timeline_begin(const gchar *stage);
+void virt_viewer_timeline_end(const gchar *stage, gint64 start, const gchar *detail);
+void virt_viewer_timeline_mark(const gchar *stage, const gchar *detail);
+
+G_END_DECLS
+
+#endif /* VIRT_VIEWER_TIMELINE_H */
+
+/*
+ * Local variables:
+ *  c-indent-level: 4
+ *  c-basic-offset: 4
+ *  indent-tabs-mode: nil
+ * End:
+ */
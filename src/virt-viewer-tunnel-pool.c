@@ -0,0 +1,387 @@
+/*
+ * Virt Viewer: A virtual machine console viewer
+ *
+ * Copyright (C) 2016 Red Hat, Inc.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#include <config.h>
+
+#include <glib.h>
+
+#if defined(HAVE_SOCKETPAIR) && defined(HAVE_FORK)
+
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <signal.h>
+#include <unistd.h>
+
+#include "virt-viewer-tunnel-pool.h"
+
+#ifndef MSG_NOSIGNAL
+#define MSG_NOSIGNAL 0
+#endif
+
+/*
+ * A pool of tunnel processes (usually ssh), keyed by their command
+ * line.
+ *
+ * The tunnel commands are expected to wait for a line on their
+ * standard input before connecting to the remote end. This allows
+ * spawning them ahead of time, paying for the process creation and
+ * the ssh handshake while the tunnel is idle, and "activating" them
+ * by writing a newline when a channel is actually opened.
+ *
+ * Every time a tunnel is handed out, a replacement is spawned for the
+ * same command, so the next channel (or the next connection after a
+ * guest reboot with --reconnect) finds a warm tunnel. At most
+ * max_idle tunnels are kept around, the oldest ones being evicted
+ * first, and idle tunnels are terminated after idle_timeout seconds.
+ *
+ * With max_idle set to 0 no tunnel is spawned ahead of time, and the
+ * pool only spawns and reaps the tunnel processes. The commands then
+ * don't need to wait for their activation, and are not sent anything.
+ */
+
+struct _VirtViewerTunnelPool {
+    guint max_idle;
+    guint idle_timeout;
+    GQueue idle; /* PoolTunnel, oldest first */
+    guint hits;
+    guint misses;
+};
+
+typedef struct {
+    VirtViewerTunnelPool *pool; /* NULL once out of the pool */
+    gchar *key;
+    GPid pid;
+    int fd;
+    guint expire_id;
+} PoolTunnel;
+
+static void
+tunnel_exited(GPid pid, gint status G_GNUC_UNUSED, gpointer user_data)
+{
+    PoolTunnel *tunnel = user_data;
+
+    g_debug("Tunnel process %d exited", (int)pid);
+
+    if (tunnel->pool != NULL) {
+        /* died while idle */
+        g_queue_remove(&tunnel->pool->idle, tunnel);
+        if (tunnel->expire_id)
+            g_source_remove(tunnel->expire_id);
+    }
+    if (tunnel->fd >= 0)
+        close(tunnel->fd);
+
+    g_spawn_close_pid(pid);
+    g_free(tunnel->key);
+    g_free(tunnel);
+}
+
+static PoolTunnel *
+tunnel_spawn(const gchar *key, const gchar *const *cmd)
+{
+    PoolTunnel *tunnel;
+    int fd[2];
+    pid_t pid;
+
+    if (socketpair(PF_UNIX, SOCK_STREAM, 0, fd) < 0)
+        return NULL;
+
+    pid = fork();
+    if (pid == -1) {
+        close(fd[0]);
+        close(fd[1]);
+        return NULL;
+    }
+
+    if (pid == 0) { /* child */
+        close(fd[0]);
+        close(0);
+        close(1);
+        if (dup(fd[1]) < 0)
+            _exit(1);
+        if (dup(fd[1]) < 0)
+            _exit(1);
+        close(fd[1]);
+        execvp(cmd[0], (char *const*)cmd);
+        _exit(1);
+    }
+    close(fd[1]);
+
+    tunnel = g_new0(PoolTunnel, 1);
+    tunnel->key = g_strdup(key);
+    tunnel->pid = pid;
+    tunnel->fd = fd[0];
+    g_child_watch_add(pid, tunnel_exited, tunnel);
+
+    return tunnel;
+}
+
+/* Takes the tunnel out of the pool and terminates it, the child watch
+ * will free it once the process is gone */
+static void
+tunnel_retire(PoolTunnel *tunnel)
+{
+    if (tunnel->pool != NULL) {
+        g_queue_remove(&tunnel->pool->idle, tunnel);
+        tunnel->pool = NULL;
+    }
+    if (tunnel->expire_id) {
+        g_source_remove(tunnel->expire_id);
+        tunnel->expire_id = 0;
+    }
+    if (tunnel->fd >= 0) {
+        close(tunnel->fd);
+        tunnel->fd = -1;
+    }
+    kill(tunnel->pid, SIGTERM);
+}
+
+static gboolean
+tunnel_expire(gpointer user_data)
+{
+    PoolTunnel *tunnel = user_data;
+
+    g_debug("Idle tunnel process %d expired", (int)tunnel->pid);
+    tunnel->expire_id = 0;
+    tunnel_retire(tunnel);
+
+    return G_SOURCE_REMOVE;
+}
+
+static gboolean
+tunnel_activate(PoolTunnel *tunnel)
+{
+    GPollFD pfd = { tunnel->fd, G_IO_IN | G_IO_HUP | G_IO_ERR, 0 };
+
+    /* nothing can be readable before the tunnel is activated, unless
+     * the other end went away */
+    if (g_poll(&pfd, 1, 0) != 0)
+        return FALSE;
+
+    return send(tunnel->fd, "\n", 1, MSG_NOSIGNAL) == 1;
+}
+
+static PoolTunnel *
+virt_viewer_tunnel_pool_take_idle(VirtViewerTunnelPool *pool, const gchar *key)
+{
+    GList *l;
+
+    for (l = pool->idle.head; l != NULL; l = l->next) {
+        PoolTunnel *tunnel = l->data;
+
+        if (g_str_equal(tunnel->key, key)) {
+            g_queue_delete_link(&pool->idle, l);
+            tunnel->pool = NULL;
+            if (tunnel->expire_id) {
+                g_source_remove(tunnel->expire_id);
+                tunnel->expire_id = 0;
+            }
+            return tunnel;
+        }
+    }
+
+    return NULL;
+}
+
+static void
+virt_viewer_tunnel_pool_trim(VirtViewerTunnelPool *pool, guint max)
+{
+    while (g_queue_get_length(&pool->idle) > max)
+        tunnel_retire(g_queue_peek_head(&pool->idle));
+}
+
+static void
+virt_viewer_tunnel_pool_prewarm(VirtViewerTunnelPool *pool,
+                                const gchar *key,
+                                const gchar *const *cmd)
+{
+    PoolTunnel *tunnel;
+    GList *l;
+
+    if (pool->max_idle == 0)
+        return;
+
+    for (l = pool->idle.head; l != NULL; l = l->next) {
+        if (g_str_equal(((PoolTunnel *)l->data)->key, key))
+            return;
+    }
+
+    virt_viewer_tunnel_pool_trim(pool, pool->max_idle - 1);
+
+    tunnel = tunnel_spawn(key, cmd);
+    if (tunnel == NULL)
+        return;
+
+    g_debug("Spawned idle tunnel process %d", (int)tunnel->pid);
+    tunnel->pool = pool;
+    if (pool->idle_timeout)
+        tunnel->expire_id = g_timeout_add_seconds(pool->idle_timeout, tunnel_expire, tunnel);
+    g_queue_push_tail(&pool->idle, tunnel);
+}
+
+/**
+ * virt_viewer_tunnel_pool_new:
+ * @max_idle: the maximum number of idle tunnels kept around
+ * @idle_timeout: the number of seconds after which an unused tunnel is
+ * terminated, or 0 to keep them until the pool is cleared
+ *
+ * Returns: a new #VirtViewerTunnelPool
+ */
+VirtViewerTunnelPool *
+virt_viewer_tunnel_pool_new(guint max_idle, guint idle_timeout)
+{
+    VirtViewerTunnelPool *pool = g_new0(VirtViewerTunnelPool, 1);
+
+    pool->max_idle = max_idle;
+    pool->idle_timeout = idle_timeout;
+    g_queue_init(&pool->idle);
+
+    return pool;
+}
+
+void
+virt_viewer_tunnel_pool_free(VirtViewerTunnelPool *pool)
+{
+    if (pool == NULL)
+        return;
+
+    virt_viewer_tunnel_pool_clear(pool);
+    g_free(pool);
+}
+
+void
+virt_viewer_tunnel_pool_set_max_idle(VirtViewerTunnelPool *pool, guint max_idle)
+{
+    g_return_if_fail(pool != NULL);
+
+    pool->max_idle = max_idle;
+    virt_viewer_tunnel_pool_trim(pool, max_idle);
+}
+
+guint
+virt_viewer_tunnel_pool_get_max_idle(VirtViewerTunnelPool *pool)
+{
+    g_return_val_if_fail(pool != NULL, 0);
+
+    return pool->max_idle;
+}
+
+/**
+ * virt_viewer_tunnel_pool_open:
+ * @pool: a #VirtViewerTunnelPool
+ * @cmd: (array zero-terminated=1): the tunnel command, searched in PATH
+ *
+ * Returns a connected tunnel running @cmd, reusing an idle one if
+ * possible. Unless the pool is disabled, the command must wait for a
+ * line on its standard input before connecting to the remote end, see
+ * the description above.
+ *
+ * Returns: the socket connected to the tunnel standard input and
+ * output, or -1 on failure
+ */
+int
+virt_viewer_tunnel_pool_open(VirtViewerTunnelPool *pool,
+                             const gchar *const *cmd)
+{
+    PoolTunnel *tunnel;
+    gchar *key;
+    int fd = -1;
+
+    g_return_val_if_fail(pool != NULL, -1);
+    g_return_val_if_fail(cmd != NULL && cmd[0] != NULL, -1);
+
+    key = g_strjoinv("\x1f", (gchar **)cmd);
+
+    while ((tunnel = virt_viewer_tunnel_pool_take_idle(pool, key)) != NULL) {
+        if (tunnel_activate(tunnel)) {
+            g_debug("Reusing idle tunnel process %d", (int)tunnel->pid);
+            pool->hits++;
+            goto done;
+        }
+        g_debug("Idle tunnel process %d is gone", (int)tunnel->pid);
+        tunnel_retire(tunnel);
+    }
+
+    pool->misses++;
+    tunnel = tunnel_spawn(key, cmd);
+    if (tunnel == NULL)
+        goto end;
+    if (pool->max_idle > 0 && !tunnel_activate(tunnel)) {
+        tunnel_retire(tunnel);
+        goto end;
+    }
+
+done:
+    /* the tunnel now belongs to the caller, it is only kept to be
+     * reaped by tunnel_exited() */
+    fd = tunnel->fd;
+    tunnel->fd = -1;
+    virt_viewer_tunnel_pool_prewarm(pool, key, cmd);
+
+end:
+    g_free(key);
+    return fd;
+}
+
+/**
+ * virt_viewer_tunnel_pool_clear:
+ * @pool: a #VirtViewerTunnelPool
+ *
+ * Terminates all the idle tunnels. The tunnels which were handed out
+ * are not affected.
+ */
+void
+virt_viewer_tunnel_pool_clear(VirtViewerTunnelPool *pool)
+{
+    g_return_if_fail(pool != NULL);
+
+    virt_viewer_tunnel_pool_trim(pool, 0);
+}
+
+guint
+virt_viewer_tunnel_pool_get_n_idle(VirtViewerTunnelPool *pool)
+{
+    g_return_val_if_fail(pool != NULL, 0);
+
+    return g_queue_get_length(&pool->idle);
+}
+
+void
+virt_viewer_tunnel_pool_get_stats(VirtViewerTunnelPool *pool,
+                                  guint *hits,
+                                  guint *misses)
+{
+    g_return_if_fail(pool != NULL);
+
+    if (hits)
+        *hits = pool->hits;
+    if (misses)
+        *misses = pool->misses;
+}
+
+#endif /* defined(HAVE_SOCKETPAIR) && defined(HAVE_FORK) */
+
+/*
+ * Local variables:
+ *  c-indent-level: 4
+ *  c-basic-offset: 4
+ *  indent-tabs-mode: nil
+ * End:
+ */
@@ -0,0 +1,56 @@
+/*
+ * Virt Viewer: A virtual machine console viewer
+ *
+ * Copyright (C) 2016 Red Hat, Inc.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#ifndef VIRT_VIEWER_TUNNEL_POOL_H
+#define VIRT_VIEWER_TUNNEL_POOL_H
+
+#include <glib.h>
+
+G_BEGIN_DECLS
+
+typedef struct _VirtViewerTunnelPool VirtViewerTunnelPool;
+
+VirtViewerTunnelPool *virt_viewer_tunnel_pool_new(guint max_idle,
+                                                  guint idle_timeout);
+void virt_viewer_tunnel_pool_free(VirtViewerTunnelPool *pool);
+
+void virt_viewer_tunnel_pool_set_max_idle(VirtViewerTunnelPool *pool,
+                                          guint max_idle);
+guint virt_viewer_tunnel_pool_get_max_idle(VirtViewerTunnelPool *pool);
+int virt_viewer_tunnel_pool_open(VirtViewerTunnelPool *pool,
+                                 const gchar *const *cmd);
+void virt_viewer_tunnel_pool_clear(VirtViewerTunnelPool *pool);
+
+guint virt_viewer_tunnel_pool_get_n_idle(VirtViewerTunnelPool *pool);
+void virt_viewer_tunnel_pool_get_stats(VirtViewerTunnelPool *pool,
+                                       guint *hits,
+                                       guint *misses);
+
+G_END_DECLS
+
+#endif /* VIRT_VIEWER_TUNNEL_POOL_H */
+
+/*
+ * Local variables:
+ *  c-indent-level: 4
+ *  c-basic-offset: 4
+ *  indent-tabs-mode: nil
+ * End:
+ */
@@ -510,75 +510,178 @@ end:
     return ret;
 }
 
-/* simple sorting of monitors. Primary sort left-to-right, secondary sort from
- * top-to-bottom, finally by monitor id */
-static int
-displays_cmp(const void *p1, const void *p2, gpointer user_data)
+void
+virt_viewer_monitor_layout_init(VirtViewerMonitorLayout *layout)
 {
-    guint diff;
-    GHashTable *displays = user_data;
-    guint i = *(guint*)p1;
-    guint j = *(guint*)p2;
-    GdkRectangle *m1 = g_hash_table_lookup(displays, GINT_TO_POINTER(i));
-    GdkRectangle *m2 = g_hash_table_lookup(displays, GINT_TO_POINTER(j));
-    g_return_val_if_fail(m1 != NULL && m2 != NULL, 0);
-    diff = m1->x - m2->x;
-    if (diff == 0)
-        diff = m1->y - m2->y;
-    if (diff == 0)
-        diff = i - j;
-
-    return diff;
+    g_return_if_fail(layout != NULL);
+
+    layout->n_slots = 0;
+    layout->present = 0;
 }
 
-static void find_max_id(gpointer key,
-                        gpointer value G_GNUC_UNUSED,
-                        gpointer user_data)
+/* Sets the geometry of display @nth, returns FALSE if @nth is out of
+ * the layout capacity */
+gboolean
+virt_viewer_monitor_layout_set(VirtViewerMonitorLayout *layout,
+                               guint nth,
+                               const GdkRectangle *rect)
 {
-    guint *max_id = user_data;
-    guint id = GPOINTER_TO_INT(key);
-    *max_id = MAX(*max_id, id);
+    g_return_val_if_fail(layout != NULL, FALSE);
+    g_return_val_if_fail(rect != NULL, FALSE);
+    g_return_val_if_fail(nth < VIRT_VIEWER_MONITOR_LAYOUT_MAX, FALSE);
+
+    layout->rects[nth] = *rect;
+    layout->present |= 1u << nth;
+    layout->n_slots = MAX(layout->n_slots, nth + 1);
+
+    return TRUE;
 }
 
-void
-virt_viewer_align_monitors_linear(GHashTable *displays)
+gboolean
+virt_viewer_monitor_layout_has(const VirtViewerMonitorLayout *layout, guint nth)
 {
-    guint i;
-    gint x = 0;
-    guint *sorted_displays;
-    guint max_id = 0;
-    guint ndisplays = 0;
-    GHashTableIter iter;
-    gpointer key;
-
-    g_return_if_fail(displays != NULL);
+    return nth < VIRT_VIEWER_MONITOR_LAYOUT_MAX && (layout->present & (1u << nth)) != 0;
+}
 
-    if (g_hash_table_size(displays) == 0)
-        return;
+/* simple sorting of monitors. Primary sort left-to-right, secondary sort from
+ * top-to-bottom, finally by monitor id */
+static gboolean
+displays_before(const VirtViewerMonitorLayout *layout, guint i, guint j)
+{
+    const GdkRectangle *m1 = &layout->rects[i];
+    const GdkRectangle *m2 = &layout->rects[j];
+
+    if (m1->x != m2->x)
+        return m1->x < m2->x;
+    if (m1->y != m2->y)
+        return m1->y < m2->y;
+    return i < j;
+}
 
-    g_hash_table_foreach(displays, find_max_id, &max_id);
-    ndisplays = max_id + 1;
+void
+virt_viewer_align_monitors_linear(VirtViewerMonitorLayout *layout)
+{
+    guint sorted_displays[VIRT_VIEWER_MONITOR_LAYOUT_MAX];
+    guint ndisplays = 0;
+    guint i, j;
+    gint x = 0;
 
-    sorted_displays = g_new0(guint, ndisplays);
+    g_return_if_fail(layout != NULL);
 
-    g_hash_table_iter_init(&iter, displays);
-    while (g_hash_table_iter_next(&iter, &key, NULL))
-        sorted_displays[GPOINTER_TO_INT(key)] = GPOINTER_TO_INT(key);
+    /* insertion sort, there are only a handful of displays */
+    for (i = 0; i < layout->n_slots; i++) {
+        if (!virt_viewer_monitor_layout_has(layout, i))
+            continue;
 
-    g_qsort_with_data(sorted_displays, ndisplays, sizeof(guint), displays_cmp, displays);
+        for (j = ndisplays; j > 0 && displays_before(layout, i, sorted_displays[j - 1]); j--)
+            sorted_displays[j] = sorted_displays[j - 1];
+        sorted_displays[j] = i;
+        ndisplays++;
+    }
 
     /* adjust monitor positions so that there's no gaps or overlap between
      * monitors */
     for (i = 0; i < ndisplays; i++) {
-        guint nth = sorted_displays[i];
-        g_assert(nth < ndisplays);
-        GdkRectangle *rect = g_hash_table_lookup(displays, GINT_TO_POINTER(nth));
-        g_return_if_fail(rect != NULL);
+        GdkRectangle *rect = &layout->rects[sorted_displays[i]];
         rect->x = x;
         rect->y = 0;
         x += rect->width;
     }
-    g_free(sorted_displays);
+}
+
+/* sorting of monitors for the grid layout. Primary sort top-to-bottom,
+ * secondary sort left-to-right, finally by monitor id */
+static gboolean
+displays_above(const VirtViewerMonitorLayout *layout, guint i, guint j)
+{
+    const GdkRectangle *m1 = &layout->rects[i];
+    const GdkRectangle *m2 = &layout->rects[j];
+
+    if (m1->y != m2->y)
+        return m1->y < m2->y;
+    if (m1->x != m2->x)
+        return m1->x < m2->x;
+    return i < j;
+}
+
+/* Arranges the monitors in rows and columns following their current
+ * positions, for example the ones of the client monitors they are shown
+ * on, and packs them so that there's no gaps or overlap. A 2x2 wall of
+ * 1920x1080 monitors needs a 3840x2160 guest screen instead of the
+ * 7680x1080 one of the linear layout.
+ *
+ * A monitor starts a new row when its top is below the middle of the
+ * first monitor of the current row. */
+void
+virt_viewer_align_monitors_grid(VirtViewerMonitorLayout *layout)
+{
+    guint sorted_displays[VIRT_VIEWER_MONITOR_LAYOUT_MAX];
+    guint ndisplays = 0;
+    guint i, j, row;
+    gint y = 0;
+
+    g_return_if_fail(layout != NULL);
+
+    for (i = 0; i < layout->n_slots; i++) {
+        if (!virt_viewer_monitor_layout_has(layout, i))
+            continue;
+
+        for (j = ndisplays; j > 0 && displays_above(layout, i, sorted_displays[j - 1]); j--)
+            sorted_displays[j] = sorted_displays[j - 1];
+        sorted_displays[j] = i;
+        ndisplays++;
+    }
+
+    for (row = 0; row < ndisplays; ) {
+        const GdkRectangle *first = &layout->rects[sorted_displays[row]];
+        gint row_middle = first->y + first->height / 2;
+        guint end;
+        gint x = 0;
+        gint height = 0;
+
+        for (end = row + 1; end < ndisplays; end++) {
+            if (layout->rects[sorted_displays[end]].y >= row_middle)
+                break;
+        }
+
+        /* sort the row left-to-right */
+        for (i = row + 1; i < end; i++) {
+            guint nth = sorted_displays[i];
+
+            for (j = i; j > row && displays_before(layout, nth, sorted_displays[j - 1]); j--)
+                sorted_displays[j] = sorted_displays[j - 1];
+            sorted_displays[j] = nth;
+        }
+
+        for (i = row; i < end; i++) {
+            GdkRectangle *rect = &layout->rects[sorted_displays[i]];
+            rect->x = x;
+            rect->y = y;
+            x += rect->width;
+            height = MAX(height, rect->height);
+        }
+
+        y += height;
+        row = end;
+    }
+}
+
+gboolean
+virt_viewer_monitor_layout_mode_from_string(const gchar *str,
+                                            VirtViewerMonitorLayoutMode *mode)
+{
+    g_return_val_if_fail(str != NULL, FALSE);
+    g_return_val_if_fail(mode != NULL, FALSE);
+
+    if (g_str_equal(str, "linear")) {
+        *mode = VIRT_VIEWER_MONITOR_LAYOUT_LINEAR;
+    } else if (g_str_equal(str, "grid")) {
+        *mode = VIRT_VIEWER_MONITOR_LAYOUT_GRID;
+    } else {
+        return FALSE;
+    }
+
+    return TRUE;
 }
 
 /* Shift all displays so that the monitor origin is at (0,0). This reduces the
@@ -593,32 +696,35 @@ virt_viewer_align_monitors_linear(GHashTable *displays)
  * screen of that size.
  */
 void
-virt_viewer_shift_monitors_to_origin(GHashTable *displays)
+virt_viewer_shift_monitors_to_origin(VirtViewerMonitorLayout *layout)
 {
     gint xmin = G_MAXINT;
     gint ymin = G_MAXINT;
-    GHashTableIter iter;
-    gpointer value;
+    guint i;
 
-    if (g_hash_table_size(displays) == 0)
-        return;
+    g_return_if_fail(layout != NULL);
+
+    for (i = 0; i < layout->n_slots; i++) {
+        const GdkRectangle *display = &layout->rects[i];
 
-    g_hash_table_iter_init(&iter, displays);
-    while (g_hash_table_iter_next(&iter, NULL, &value)) {
-        GdkRectangle *display = value;
-        g_return_if_fail(display != NULL);
+        if (!virt_viewer_monitor_layout_has(layout, i))
+            continue;
         if (display->width > 0 && display->height > 0) {
             xmin = MIN(xmin, display->x);
             ymin = MIN(ymin, display->y);
         }
     }
-    g_return_if_fail(xmin < G_MAXINT && ymin < G_MAXINT);
+
+    if (xmin == G_MAXINT || ymin == G_MAXINT)
+        return;
 
     if (xmin > 0 || ymin > 0) {
         g_debug("%s: Shifting all monitors by (%i, %i)", G_STRFUNC, xmin, ymin);
-        g_hash_table_iter_init(&iter, displays);
-        while (g_hash_table_iter_next(&iter, NULL, &value)) {
-            GdkRectangle *display = value;
+        for (i = 0; i < layout->n_slots; i++) {
+            GdkRectangle *display = &layout->rects[i];
+
+            if (!virt_viewer_monitor_layout_has(layout, i))
+                continue;
             if (display->width > 0 && display->height > 0) {
                 display->x -= xmin;
                 display->y -= ymin;
@@ -627,6 +733,32 @@ virt_viewer_shift_monitors_to_origin(GHashTable *displays)
     }
 }
 
+/* Whether two layouts hold the same monitors with the same geometries */
+gboolean
+virt_viewer_monitor_layout_equal(const VirtViewerMonitorLayout *layout1,
+                                 const VirtViewerMonitorLayout *layout2)
+{
+    guint i;
+
+    g_return_val_if_fail(layout1 != NULL && layout2 != NULL, FALSE);
+
+    if (layout1->present != layout2->present)
+        return FALSE;
+
+    for (i = 0; i < layout1->n_slots; i++) {
+        const GdkRectangle *rect = &layout1->rects[i];
+        const GdkRectangle *other = &layout2->rects[i];
+
+        if (!virt_viewer_monitor_layout_has(layout1, i))
+            continue;
+        if (rect->x != other->x || rect->y != other->y ||
+            rect->width != other->width || rect->height != other->height)
+            return FALSE;
+    }
+
+    return TRUE;
+}
+
 /**
  * virt_viewer_parse_monitor_mappings:
  * @mappings: (array zero-terminated=1) values for the "monitor-mapping" key
@@ -718,6 +850,117 @@ configerror:
     return NULL;
 }
 
+/**
+ * virt_viewer_fit_desktop:
+ * @desktop_width: the width of the guest desktop, in guest pixels
+ * @desktop_height: the height of the guest desktop, in guest pixels
+ * @width: the available width, in logical pixels
+ * @height: the available height, in logical pixels
+ * @scale_factor: the number of device pixels per logical pixel
+ * @integer: whether to only scale by whole numbers of device pixels per
+ * guest pixel, or whole numbers of guest pixels per device pixel
+ * @fit_width: (out): the width to show the desktop with
+ * @fit_height: (out): the height to show the desktop with
+ *
+ * Computes the largest size with the aspect ratio of the desktop which
+ * fits in the available size. Integer scale factors are cheaper to
+ * render, and draw 1:1 whenever the desktop fits, but they are only
+ * used if one of them gives exact logical dimensions.
+ */
+void
+virt_viewer_fit_desktop(guint desktop_width, guint desktop_height,
+                        guint width, guint height,
+                        gint scale_factor, gboolean integer,
+                        gint *fit_width, gint *fit_height)
+{
+    guint64 device_width = (guint64)width * scale_factor;
+    guint64 device_height = (guint64)height * scale_factor;
+
+    g_return_if_fail(desktop_width > 0 && desktop_height > 0);
+    g_return_if_fail(scale_factor > 0);
+
+    if (integer && width > 0 && height > 0) {
+        guint64 k, n, max_n;
+
+        if (desktop_width <= device_width && desktop_height <= device_height) {
+            for (k = MIN(device_width / desktop_width, device_height / desktop_height); k > 0; k--) {
+                if ((k * desktop_width) % scale_factor == 0 &&
+                    (k * desktop_height) % scale_factor == 0) {
+                    *fit_width = k * desktop_width / scale_factor;
+                    *fit_height = k * desktop_height / scale_factor;
+                    return;
+                }
+            }
+        } else {
+            n = MAX((desktop_width + device_width - 1) / device_width,
+                    (desktop_height + device_height - 1) / device_height);
+            for (max_n = 2 * n; n <= max_n; n++) {
+                if (desktop_width % (n * scale_factor) == 0 &&
+                    desktop_height % (n * scale_factor) == 0) {
+                    *fit_width = desktop_width / (n * scale_factor);
+                    *fit_height = desktop_height / (n * scale_factor);
+                    return;
+                }
+            }
+        }
+    }
+
+    /* Keep the aspect ratio of the desktop, comparing and rounding the
+     * ratios in integers */
+    if ((guint64)width * desktop_height > (guint64)height * desktop_width) {
+        *fit_width = ((guint64)height * desktop_width + desktop_height / 2) / desktop_height;
+        *fit_height = height;
+    } else {
+        *fit_width = width;
+        *fit_height = ((guint64)width * desktop_height + desktop_width / 2) / desktop_width;
+    }
+}
+
+/**
+ * virt_viewer_snap_zoom_level:
+ * @zoom: a zoom level, in percents of the logical size
+ * @scale_factor: the number of device pixels per logical pixel
+ * @direction: snap to the next level above @zoom if positive, below if
+ * negative, or to the nearest one
+ *
+ * Returns: the zoom level, rounded to a percent, which scales by a whole
+ * number of device pixels per guest pixel or guest pixels per device
+ * pixel, closest to @zoom in @direction, or @zoom if there is none
+ */
+gint
+virt_viewer_snap_zoom_level(gint zoom, gint scale_factor, gint direction)
+{
+    gint best = zoom;
+    gint best_distance = G_MAXINT;
+    gint k;
+
+    g_return_val_if_fail(scale_factor > 0, zoom);
+
+    /* the upscales are 100 * k / scale_factor, the downscales
+     * 100 / (k * scale_factor), up to 10x */
+    for (k = 1; k <= 10 * scale_factor; k++) {
+        gint levels[2] = {
+            (200 * k + scale_factor) / (2 * scale_factor),
+            (200 + k * scale_factor) / (2 * k * scale_factor),
+        };
+        guint i;
+
+        for (i = 0; i < G_N_ELEMENTS(levels); i++) {
+            gint distance = ABS(levels[i] - zoom);
+
+            if (levels[i] <= 0 ||
+                (direction > 0 && levels[i] < zoom) ||
+                (direction < 0 && levels[i] > zoom) ||
+                distance >= best_distance)
+                continue;
+            best = levels[i];
+            best_distance = distance;
+        }
+    }
+
+    return best;
+}
+
 /*
  * Local variables:
  *  c-indent-level: 4
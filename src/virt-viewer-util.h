@@ -58,8 +58,41 @@ gchar* spice_hotkey_to_gtk_accelerator(const gchar *key);
 gint virt_viewer_compare_buildid(const gchar *s1, const gchar *s2);
 
 /* monitor alignment */
-void virt_viewer_align_monitors_linear(GHashTable *displays);
-void virt_viewer_shift_monitors_to_origin(GHashTable *displays);
+#define VIRT_VIEWER_MONITOR_LAYOUT_MAX 16
+
+/* The geometry of the guest displays, indexed by display id. Only the
+ * rects whose bit is set in present are meaningful. */
+typedef struct {
+    guint n_slots; /* highest display id + 1 */
+    guint32 present;
+    GdkRectangle rects[VIRT_VIEWER_MONITOR_LAYOUT_MAX];
+} VirtViewerMonitorLayout;
+
+typedef enum {
+    VIRT_VIEWER_MONITOR_LAYOUT_LINEAR, /* left-to-right */
+    VIRT_VIEWER_MONITOR_LAYOUT_GRID, /* rows and columns, as on the client */
+} VirtViewerMonitorLayoutMode;
+
+gboolean virt_viewer_monitor_layout_mode_from_string(const gchar *str,
+                                                     VirtViewerMonitorLayoutMode *mode);
+
+void virt_viewer_monitor_layout_init(VirtViewerMonitorLayout *layout);
+gboolean virt_viewer_monitor_layout_set(VirtViewerMonitorLayout *layout,
+                                        guint nth,
+                                        const GdkRectangle *rect);
+gboolean virt_viewer_monitor_layout_has(const VirtViewerMonitorLayout *layout, guint nth);
+gboolean virt_viewer_monitor_layout_equal(const VirtViewerMonitorLayout *layout1,
+                                          const VirtViewerMonitorLayout *layout2);
+void virt_viewer_align_monitors_linear(VirtViewerMonitorLayout *layout);
+void virt_viewer_align_monitors_grid(VirtViewerMonitorLayout *layout);
+void virt_viewer_shift_monitors_to_origin(VirtViewerMonitorLayout *layout);
+
+/* zoom */
+void virt_viewer_fit_desktop(guint desktop_width, guint desktop_height,
+                             guint width, guint height,
+                             gint scale_factor, gboolean integer,
+                             gint *fit_width, gint *fit_height);
+gint virt_viewer_snap_zoom_level(gint zoom, gint scale_factor, gint direction);
 
 /* monitor mapping */
 GHashTable* virt_viewer_parse_monitor_mappings(gchar **mappings,
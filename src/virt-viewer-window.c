@@ -42,6 +42,7 @@
 #include "virt-viewer-app.h"
 #include "virt-viewer-util.h"
 #include "virt-viewer-timed-revealer.h"
+#include "virt-viewer-screenshot.h"
 
 #include "remote-viewer-iso-list-dialog.h"
 
@@ -51,6 +52,7 @@
 void virt_viewer_window_menu_view_zoom_out(GtkWidget *menu, VirtViewerWindow *self);
 void virt_viewer_window_menu_view_zoom_in(GtkWidget *menu, VirtViewerWindow *self);
 void virt_viewer_window_menu_view_zoom_reset(GtkWidget *menu, VirtViewerWindow *self);
+void virt_viewer_window_menu_view_zoom_integer(GtkWidget *menu, VirtViewerWindow *self);
 gboolean virt_viewer_window_delete(GtkWidget *src, void *dummy, VirtViewerWindow *self);
 void virt_viewer_window_menu_file_quit(GtkWidget *src, VirtViewerWindow *self);
 void virt_viewer_window_guest_details_response(GtkDialog *dialog, gint response_id, gpointer user_data);
@@ -59,10 +61,13 @@ void virt_viewer_window_menu_help_guest_details(GtkWidget *menu, VirtViewerWindo
 void virt_viewer_window_menu_view_fullscreen(GtkWidget *menu, VirtViewerWindow *self);
 void virt_viewer_window_menu_send(GtkWidget *menu, VirtViewerWindow *self);
 void virt_viewer_window_menu_file_screenshot(GtkWidget *menu, VirtViewerWindow *self);
+void virt_viewer_window_menu_file_screenshot_all(GtkWidget *menu, VirtViewerWindow *self);
 void virt_viewer_window_menu_file_usb_device_selection(GtkWidget *menu, VirtViewerWindow *self);
 void virt_viewer_window_menu_file_smartcard_insert(GtkWidget *menu, VirtViewerWindow *self);
 void virt_viewer_window_menu_file_smartcard_remove(GtkWidget *menu, VirtViewerWindow *self);
 void virt_viewer_window_menu_view_release_cursor(GtkWidget *menu, VirtViewerWindow *self);
+void virt_viewer_window_menu_view_hud(GtkWidget *menu, VirtViewerWindow *self);
+void virt_viewer_window_menu_view_scaling(GtkWidget *menu, VirtViewerWindow *self);
 void virt_viewer_window_menu_preferences_cb(GtkWidget *menu, VirtViewerWindow *self);
 void virt_viewer_window_menu_change_cd_activate(GtkWidget *menu, VirtViewerWindow *self);
 
@@ -89,6 +94,19 @@ enum {
     PROP_APP,
 };
 
+enum {
+    SIGNAL_SCREENSHOT_SAVING,
+    SIGNAL_SCREENSHOT_SAVED,
+    LAST_SIGNAL
+};
+
+static guint signals[LAST_SIGNAL];
+
+typedef struct {
+    VirtViewerWindow *window;
+    gchar *filename;
+} ScreenshotSave;
+
 struct _VirtViewerWindowPrivate {
     VirtViewerApp *app;
 
@@ -97,6 +115,7 @@ struct _VirtViewerWindowPrivate {
     GtkWidget *toolbar;
     GtkWidget *toolbar_usb_device_selection;
     GtkWidget *toolbar_send_key;
+    gboolean usb_options_sensitive;
     GtkAccelGroup *accel_group;
     VirtViewerNotebook *notebook;
     VirtViewerDisplay *display;
@@ -285,6 +304,31 @@ virt_viewer_window_class_init (VirtViewerWindowClass *klass)
                                                         G_PARAM_WRITABLE |
                                                         G_PARAM_CONSTRUCT_ONLY |
                                                         G_PARAM_STATIC_STRINGS));
+
+    /* a screenshot is being encoded and written to the file */
+    signals[SIGNAL_SCREENSHOT_SAVING] =
+        g_signal_new("screenshot-saving",
+                     G_OBJECT_CLASS_TYPE(object_class),
+                     G_SIGNAL_RUN_FIRST,
+                     0,
+                     NULL, NULL,
+                     g_cclosure_marshal_VOID__STRING,
+                     G_TYPE_NONE,
+                     1,
+                     G_TYPE_STRING);
+
+    /* the screenshot was saved, or failed to be if the GError is set */
+    signals[SIGNAL_SCREENSHOT_SAVED] =
+        g_signal_new("screenshot-saved",
+                     G_OBJECT_CLASS_TYPE(object_class),
+                     G_SIGNAL_RUN_FIRST,
+                     0,
+                     NULL, NULL,
+                     NULL,
+                     G_TYPE_NONE,
+                     2,
+                     G_TYPE_STRING,
+                     G_TYPE_ERROR);
 }
 
 static gboolean
@@ -306,6 +350,7 @@ virt_viewer_window_init (VirtViewerWindow *self)
     priv = self->priv;
 
     priv->fullscreen_monitor = -1;
+    priv->usb_options_sensitive = TRUE;
     g_value_init(&priv->accel_setting, G_TYPE_STRING);
 
     priv->notebook = virt_viewer_notebook_new();
@@ -316,6 +361,7 @@ virt_viewer_window_init (VirtViewerWindow *self)
     gtk_widget_set_sensitive(GTK_WIDGET(gtk_builder_get_object(self->priv->builder, "menu-send")), FALSE);
     gtk_widget_set_sensitive(GTK_WIDGET(gtk_builder_get_object(self->priv->builder, "menu-view-zoom")), FALSE);
     gtk_widget_set_sensitive(GTK_WIDGET(gtk_builder_get_object(self->priv->builder, "menu-file-screenshot")), FALSE);
+    gtk_widget_set_sensitive(GTK_WIDGET(gtk_builder_get_object(self->priv->builder, "menu-file-screenshot-all")), FALSE);
     gtk_widget_set_sensitive(GTK_WIDGET(gtk_builder_get_object(self->priv->builder, "menu-preferences")), FALSE);
 
     gtk_builder_connect_signals(priv->builder, self);
@@ -331,6 +377,8 @@ virt_viewer_window_init (VirtViewerWindow *self)
                      "can-activate-accel", G_CALLBACK(can_activate_cb), self);
     g_signal_connect(gtk_builder_get_object(priv->builder, "menu-view-release-cursor"),
                      "can-activate-accel", G_CALLBACK(can_activate_cb), self);
+    g_signal_connect(gtk_builder_get_object(priv->builder, "menu-view-hud"),
+                     "can-activate-accel", G_CALLBACK(can_activate_cb), self);
     g_signal_connect(gtk_builder_get_object(priv->builder, "menu-view-zoom-reset"),
                      "can-activate-accel", G_CALLBACK(can_activate_cb), self);
     g_signal_connect(gtk_builder_get_object(priv->builder, "menu-view-zoom-in"),
@@ -339,7 +387,6 @@ virt_viewer_window_init (VirtViewerWindow *self)
                      "can-activate-accel", G_CALLBACK(can_activate_cb), self);
 
     vbox = GTK_WIDGET(gtk_builder_get_object(priv->builder, "viewer-box"));
-    virt_viewer_window_toolbar_setup(self);
 
     gtk_box_pack_end(GTK_BOX(vbox), GTK_WIDGET(priv->notebook), TRUE, TRUE, 0);
 
@@ -360,10 +407,33 @@ virt_viewer_window_init (VirtViewerWindow *self)
     priv->zoomlevel = NORMAL_ZOOM_LEVEL;
 }
 
+/* The cost of laying out the display of the window so far */
+static void
+virt_viewer_window_report_relayout(VirtViewerWindow *self)
+{
+    VirtViewerDisplay *display = self->priv->display;
+    guint allocations, coalesced;
+    gint64 allocation_time, allocation_time_max;
+
+    if (display == NULL)
+        return;
+
+    virt_viewer_display_get_relayout_stats(display, &allocations, &allocation_time,
+                                           &allocation_time_max, &coalesced);
+    g_debug("Display %d relayout: %u allocations, %.3f ms on average, %.3f ms at most, "
+            "%u of %u desktop resizes coalesced",
+            virt_viewer_display_get_nth(display), allocations,
+            allocations ? allocation_time / 1000.0 / allocations : 0.0,
+            allocation_time_max / 1000.0,
+            coalesced, virt_viewer_display_get_resize_count(display));
+}
+
 static void
 virt_viewer_window_desktop_resize(VirtViewerDisplay *display G_GNUC_UNUSED,
                                   VirtViewerWindow *self)
 {
+    virt_viewer_window_report_relayout(self);
+
     if (!gtk_widget_get_visible(self->priv->window)) {
         self->priv->desktop_resize_pending = TRUE;
         return;
@@ -385,20 +455,64 @@ virt_viewer_window_get_real_zoom_level(VirtViewerWindow *self)
     return round((double) NORMAL_ZOOM_LEVEL * allocation.width / width);
 }
 
+/* With integer scaling, the zoom level steps between the scales which
+ * are whole numbers of device pixels per guest pixel or the reverse */
+static gboolean
+virt_viewer_window_get_integer_scaling(VirtViewerWindow *self)
+{
+    return self->priv->display != NULL &&
+        virt_viewer_display_get_integer_scaling(self->priv->display);
+}
+
+static gint
+virt_viewer_window_snap_zoom_level(VirtViewerWindow *self, gint zoom_level, gint direction)
+{
+    if (!virt_viewer_window_get_integer_scaling(self))
+        return zoom_level;
+
+    return virt_viewer_snap_zoom_level(zoom_level,
+                                       gtk_widget_get_scale_factor(GTK_WIDGET(self->priv->display)),
+                                       direction);
+}
+
 G_MODULE_EXPORT void
 virt_viewer_window_menu_view_zoom_out(GtkWidget *menu G_GNUC_UNUSED,
                                       VirtViewerWindow *self)
 {
-    virt_viewer_window_set_zoom_level(self,
-                                      virt_viewer_window_get_real_zoom_level(self) - ZOOM_STEP);
+    gint zoom_level = virt_viewer_window_get_real_zoom_level(self);
+
+    if (virt_viewer_window_get_integer_scaling(self))
+        zoom_level = virt_viewer_window_snap_zoom_level(self, zoom_level - 1, -1);
+    else
+        zoom_level -= ZOOM_STEP;
+    virt_viewer_window_set_zoom_level(self, zoom_level);
 }
 
 G_MODULE_EXPORT void
 virt_viewer_window_menu_view_zoom_in(GtkWidget *menu G_GNUC_UNUSED,
                                      VirtViewerWindow *self)
 {
-    virt_viewer_window_set_zoom_level(self,
-                                      virt_viewer_window_get_real_zoom_level(self) + ZOOM_STEP);
+    gint zoom_level = virt_viewer_window_get_real_zoom_level(self);
+
+    if (virt_viewer_window_get_integer_scaling(self))
+        zoom_level = virt_viewer_window_snap_zoom_level(self, zoom_level + 1, 1);
+    else
+        zoom_level += ZOOM_STEP;
+    virt_viewer_window_set_zoom_level(self, zoom_level);
+}
+
+G_MODULE_EXPORT void
+virt_viewer_window_menu_view_zoom_integer(GtkWidget *menu,
+                                          VirtViewerWindow *self)
+{
+    gboolean integer = gtk_check_menu_item_get_active(GTK_CHECK_MENU_ITEM(menu));
+
+    if (self->priv->display == NULL)
+        return;
+
+    virt_viewer_display_set_integer_scaling(self->priv->display, integer);
+    virt_viewer_app_set_integer_scaling(self->priv->app, integer);
+    virt_viewer_window_set_zoom_level(self, self->priv->zoomlevel);
 }
 
 G_MODULE_EXPORT void
@@ -482,9 +596,11 @@ virt_viewer_window_leave_fullscreen(VirtViewerWindow *self)
         virt_viewer_display_set_monitor(priv->display, -1);
         virt_viewer_display_set_fullscreen(priv->display, FALSE);
     }
-    virt_viewer_timed_revealer_force_reveal(priv->revealer, FALSE);
+    if (priv->toolbar != NULL) {
+        virt_viewer_timed_revealer_force_reveal(priv->revealer, FALSE);
+        gtk_widget_hide(priv->toolbar);
+    }
     gtk_widget_show(menu);
-    gtk_widget_hide(priv->toolbar);
     gtk_widget_set_size_request(priv->window, -1, -1);
     gtk_window_unfullscreen(GTK_WINDOW(priv->window));
 
@@ -520,6 +636,7 @@ virt_viewer_window_enter_fullscreen(VirtViewerWindow *self, gint monitor)
     gtk_widget_hide(menu);
 
     if (!priv->kiosk) {
+        virt_viewer_window_toolbar_setup(self);
         gtk_widget_show(priv->toolbar);
         virt_viewer_timed_revealer_force_reveal(priv->revealer, TRUE);
     }
@@ -897,81 +1014,132 @@ virt_viewer_window_menu_view_fullscreen(GtkWidget *menu,
     virt_viewer_window_set_fullscreen(self, fullscreen);
 }
 
-static void add_if_writable (GdkPixbufFormat *data, GHashTable *formats)
-{
-    if (gdk_pixbuf_format_is_writable(data)) {
-        gchar **extensions;
-        gchar **it;
-        extensions = gdk_pixbuf_format_get_extensions(data);
-        for (it = extensions; *it != NULL; it++) {
-            g_hash_table_insert(formats, g_strdup(*it), data);
-        }
-        g_strfreev(extensions);
+static void
+virt_viewer_window_screenshot_saved(GObject *source G_GNUC_UNUSED,
+                                    GAsyncResult *result,
+                                    gpointer user_data)
+{
+    ScreenshotSave *save = user_data;
+    VirtViewerWindow *self = save->window;
+    GError *error = NULL;
+
+    virt_viewer_screenshot_save_finish(result, &error);
+    g_signal_emit(self, signals[SIGNAL_SCREENSHOT_SAVED], 0, save->filename, error);
+    if (error != NULL) {
+        virt_viewer_app_simple_message_dialog(self->priv->app, error->message);
+        g_error_free(error);
     }
+
+    g_object_unref(self);
+    g_free(save->filename);
+    g_free(save);
 }
 
-static GHashTable *init_image_formats(void)
+/* The pixels are grabbed right away, the encoding and the file write are
+ * done in a worker thread so that the display keeps being updated */
+static void
+virt_viewer_window_save_screenshot(VirtViewerWindow *self,
+                                   const char *file)
 {
-    GHashTable *format_map;
-    GSList *formats = gdk_pixbuf_get_formats();
+    VirtViewerWindowPrivate *priv = self->priv;
+    GdkPixbuf *pix = virt_viewer_display_get_pixbuf(VIRT_VIEWER_DISPLAY(priv->display));
+    ScreenshotSave *save;
 
-    format_map = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, NULL);
-    g_slist_foreach(formats, (GFunc)add_if_writable, format_map);
-    g_slist_free (formats);
+    save = g_new0(ScreenshotSave, 1);
+    save->window = g_object_ref(self);
+    save->filename = g_strdup(file);
 
-    return format_map;
+    g_signal_emit(self, signals[SIGNAL_SCREENSHOT_SAVING], 0, file);
+    virt_viewer_screenshot_save_async(pix, file, NULL,
+                                      virt_viewer_window_screenshot_saved, save);
+    g_object_unref(pix);
 }
 
-static GdkPixbufFormat *get_image_format(const char *filename)
-{
-    static GOnce image_formats_once = G_ONCE_INIT;
-    const char *ext;
+/* All the displays of the guest, put together following the monitor
+ * layout sent to the guest, or side by side when there's none */
+static void
+virt_viewer_window_save_composite_screenshot(VirtViewerWindow *self,
+                                             const char *file)
+{
+    VirtViewerSession *session = virt_viewer_app_get_session(self->priv->app);
+    VirtViewerMonitorLayout layout;
+    gboolean has_layout;
+    GList *displays, *l;
+    GPtrArray *tiles;
+    GArray *origins;
+    ScreenshotSave *save;
+    gint x = 0;
+    guint i;
 
-    g_once(&image_formats_once, (GThreadFunc)init_image_formats, NULL);
+    g_return_if_fail(session != NULL);
 
-    ext = strrchr(filename, '.');
-    if (ext == NULL)
-        return NULL;
+    has_layout = virt_viewer_session_get_monitor_layout(session, &layout);
+    tiles = g_ptr_array_new_with_free_func(g_object_unref);
+    origins = g_array_new(FALSE, FALSE, sizeof(GdkPoint));
 
-    ext++; /* skip '.' */
+    displays = virt_viewer_session_get_displays(session);
+    for (l = displays; l != NULL; l = l->next) {
+        VirtViewerDisplay *display = VIRT_VIEWER_DISPLAY(l->data);
+        GdkPoint origin = { 0, };
+        GdkPixbuf *pix;
+        gint nth;
 
-    return g_hash_table_lookup(image_formats_once.retval, ext);
-}
+        if (!virt_viewer_display_get_enabled(display) ||
+            !(virt_viewer_display_get_show_hint(display) & VIRT_VIEWER_DISPLAY_SHOW_HINT_READY))
+            continue;
 
-static gboolean
-virt_viewer_window_save_screenshot(VirtViewerWindow *self,
-                                   const char *file,
-                                   GError **error)
-{
-    VirtViewerWindowPrivate *priv = self->priv;
-    GdkPixbuf *pix = virt_viewer_display_get_pixbuf(VIRT_VIEWER_DISPLAY(priv->display));
-    GdkPixbufFormat *format = get_image_format(file);
-    gboolean result;
+        pix = virt_viewer_display_get_pixbuf(display);
+        if (pix == NULL)
+            continue;
 
-    if (format == NULL) {
-        g_set_error(error, G_FILE_ERROR, G_FILE_ERROR_FAILED,
-                    _("Unable to determine image format for file '%s'"), file);
-        result = FALSE;
-    } else {
-        char *type = gdk_pixbuf_format_get_name(format);
-        g_debug("saving to %s", type);
-        result = gdk_pixbuf_save(pix, file, type, error, NULL);
-        g_free(type);
+        g_object_get(display, "nth-display", &nth, NULL);
+        if (has_layout && virt_viewer_monitor_layout_has(&layout, nth)) {
+            origin.x = layout.rects[nth].x;
+            origin.y = layout.rects[nth].y;
+        } else {
+            has_layout = FALSE;
+        }
+        g_ptr_array_add(tiles, pix);
+        g_array_append_val(origins, origin);
     }
+    g_list_free(displays);
 
-    g_object_unref(pix);
-    return result;
+    if (tiles->len == 0) {
+        virt_viewer_app_simple_message_dialog(self->priv->app,
+                                              _("No display to take a screenshot of"));
+        goto end;
+    }
+
+    if (!has_layout) {
+        for (i = 0; i < tiles->len; i++) {
+            GdkPoint *origin = &g_array_index(origins, GdkPoint, i);
+            origin->x = x;
+            origin->y = 0;
+            x += gdk_pixbuf_get_width(g_ptr_array_index(tiles, i));
+        }
+    }
+
+    save = g_new0(ScreenshotSave, 1);
+    save->window = g_object_ref(self);
+    save->filename = g_strdup(file);
+
+    g_signal_emit(self, signals[SIGNAL_SCREENSHOT_SAVING], 0, file);
+    virt_viewer_screenshot_save_composite_async((GdkPixbuf **)tiles->pdata,
+                                                (GdkPoint *)origins->data,
+                                                tiles->len, file, NULL,
+                                                virt_viewer_window_screenshot_saved, save);
+
+end:
+    g_ptr_array_unref(tiles);
+    g_array_unref(origins);
 }
 
-G_MODULE_EXPORT void
-virt_viewer_window_menu_file_screenshot(GtkWidget *menu G_GNUC_UNUSED,
-                                        VirtViewerWindow *self)
+static char *
+virt_viewer_window_choose_screenshot_file(VirtViewerWindow *self)
 {
     GtkWidget *dialog;
-    VirtViewerWindowPrivate *priv = self->priv;
     const char *image_dir;
-
-    g_return_if_fail(priv->display != NULL);
+    char *filename = NULL;
 
     dialog = gtk_file_chooser_dialog_new("Save screenshot",
                                          NULL,
@@ -987,20 +1155,39 @@ virt_viewer_window_menu_file_screenshot(GtkWidget *menu G_GNUC_UNUSED,
         gtk_file_chooser_set_current_folder(GTK_FILE_CHOOSER (dialog), image_dir);
     gtk_file_chooser_set_current_name(GTK_FILE_CHOOSER (dialog), _("Screenshot.png"));
 
-    if (gtk_dialog_run(GTK_DIALOG (dialog)) == GTK_RESPONSE_ACCEPT) {
-        char *filename;
-        GError *error = NULL;
-
+    if (gtk_dialog_run(GTK_DIALOG (dialog)) == GTK_RESPONSE_ACCEPT)
         filename = gtk_file_chooser_get_filename(GTK_FILE_CHOOSER (dialog));
-        if (!virt_viewer_window_save_screenshot(self, filename, &error)) {
-            virt_viewer_app_simple_message_dialog(self->priv->app,
-                                                  error->message);
-            g_error_free(error);
-        }
-        g_free(filename);
-    }
 
     gtk_widget_destroy(dialog);
+
+    return filename;
+}
+
+G_MODULE_EXPORT void
+virt_viewer_window_menu_file_screenshot(GtkWidget *menu G_GNUC_UNUSED,
+                                        VirtViewerWindow *self)
+{
+    VirtViewerWindowPrivate *priv = self->priv;
+    char *filename;
+
+    g_return_if_fail(priv->display != NULL);
+
+    filename = virt_viewer_window_choose_screenshot_file(self);
+    if (filename != NULL)
+        virt_viewer_window_save_screenshot(self, filename);
+    g_free(filename);
+}
+
+G_MODULE_EXPORT void
+virt_viewer_window_menu_file_screenshot_all(GtkWidget *menu G_GNUC_UNUSED,
+                                            VirtViewerWindow *self)
+{
+    char *filename;
+
+    filename = virt_viewer_window_choose_screenshot_file(self);
+    if (filename != NULL)
+        virt_viewer_window_save_composite_screenshot(self, filename);
+    g_free(filename);
 }
 
 G_MODULE_EXPORT void
@@ -1040,6 +1227,68 @@ virt_viewer_window_menu_view_release_cursor(GtkWidget *menu G_GNUC_UNUSED,
     virt_viewer_display_release_cursor(VIRT_VIEWER_DISPLAY(self->priv->display));
 }
 
+G_MODULE_EXPORT void
+virt_viewer_window_menu_view_hud(GtkWidget *menu,
+                                 VirtViewerWindow *self)
+{
+    gboolean hud = gtk_check_menu_item_get_active(GTK_CHECK_MENU_ITEM(menu));
+
+    if (self->priv->display == NULL)
+        return;
+
+    virt_viewer_display_set_hud(VIRT_VIEWER_DISPLAY(self->priv->display), hud);
+}
+
+G_MODULE_EXPORT void
+virt_viewer_window_menu_view_scaling(GtkWidget *menu,
+                                     VirtViewerWindow *self)
+{
+    VirtViewerWindowPrivate *priv = self->priv;
+    const gchar *name = gtk_buildable_get_name(GTK_BUILDABLE(menu));
+    VirtViewerScalingMode mode;
+    VirtViewerDisplay *display;
+
+    if (priv->display == NULL ||
+        !gtk_check_menu_item_get_active(GTK_CHECK_MENU_ITEM(menu)))
+        return;
+
+    g_return_if_fail(g_str_has_prefix(name, "menu-view-scaling-"));
+    if (!virt_viewer_scaling_mode_from_string(name + strlen("menu-view-scaling-"), &mode))
+        g_return_if_reached();
+
+    display = VIRT_VIEWER_DISPLAY(priv->display);
+    virt_viewer_display_set_scaling_mode(display, mode);
+    virt_viewer_app_set_scaling_mode(priv->app, virt_viewer_display_get_nth(display), mode);
+}
+
+static void
+virt_viewer_window_sync_scaling(VirtViewerWindow *self)
+{
+    VirtViewerWindowPrivate *priv = self->priv;
+    VirtViewerDisplay *display = VIRT_VIEWER_DISPLAY(priv->display);
+    VirtViewerScalingMode mode;
+    GtkCheckMenuItem *item, *check;
+    gboolean integer;
+    gchar *name;
+
+    integer = virt_viewer_app_get_integer_scaling(priv->app);
+    virt_viewer_display_set_integer_scaling(display, integer);
+    check = GTK_CHECK_MENU_ITEM(gtk_builder_get_object(priv->builder, "menu-view-zoom-integer"));
+    g_signal_handlers_block_by_func(check, virt_viewer_window_menu_view_zoom_integer, self);
+    gtk_check_menu_item_set_active(check, integer);
+    g_signal_handlers_unblock_by_func(check, virt_viewer_window_menu_view_zoom_integer, self);
+
+    mode = virt_viewer_app_get_scaling_mode(priv->app, virt_viewer_display_get_nth(display));
+    virt_viewer_display_set_scaling_mode(display, mode);
+
+    name = g_strdup_printf("menu-view-scaling-%s", virt_viewer_scaling_mode_to_string(mode));
+    item = GTK_CHECK_MENU_ITEM(gtk_builder_get_object(priv->builder, name));
+    g_signal_handlers_block_by_func(item, virt_viewer_window_menu_view_scaling, self);
+    gtk_check_menu_item_set_active(item, TRUE);
+    g_signal_handlers_unblock_by_func(item, virt_viewer_window_menu_view_scaling, self);
+    g_free(name);
+}
+
 G_MODULE_EXPORT void
 virt_viewer_window_menu_help_guest_details(GtkWidget *menu G_GNUC_UNUSED,
                                            VirtViewerWindow *self)
@@ -1157,6 +1406,7 @@ virt_viewer_window_menu_change_cd_activate(GtkWidget *menu G_GNUC_UNUSED,
 #endif
 }
 
+/* The fullscreen toolbar, built when first entering fullscreen */
 static void
 virt_viewer_window_toolbar_setup(VirtViewerWindow *self)
 {
@@ -1164,6 +1414,9 @@ virt_viewer_window_toolbar_setup(VirtViewerWindow *self)
     GtkWidget *overlay;
     VirtViewerWindowPrivate *priv = self->priv;
 
+    if (priv->toolbar != NULL)
+        return;
+
     priv->toolbar = gtk_toolbar_new();
     gtk_toolbar_set_show_arrow(GTK_TOOLBAR(priv->toolbar), FALSE);
     gtk_widget_set_no_show_all(priv->toolbar, TRUE);
@@ -1186,6 +1439,7 @@ virt_viewer_window_toolbar_setup(VirtViewerWindow *self)
     g_signal_connect(button, "clicked", G_CALLBACK(virt_viewer_window_menu_file_usb_device_selection), self);
     priv->toolbar_usb_device_selection = button;
     gtk_widget_show_all(button);
+    gtk_widget_set_visible(button, priv->usb_options_sensitive);
 
     /* Send key */
     button = GTK_WIDGET(gtk_tool_button_new(NULL, NULL));
@@ -1194,7 +1448,7 @@ virt_viewer_window_toolbar_setup(VirtViewerWindow *self)
     gtk_widget_show(button);
     gtk_toolbar_insert(GTK_TOOLBAR(priv->toolbar), GTK_TOOL_ITEM(button), 0);
     g_signal_connect(button, "clicked", G_CALLBACK(virt_viewer_window_toolbar_send_key), self);
-    gtk_widget_set_sensitive(button, FALSE);
+    gtk_widget_set_sensitive(button, priv->display != NULL);
     priv->toolbar_send_key = button;
 
     /* Leave fullscreen */
@@ -1328,7 +1582,9 @@ virt_viewer_window_set_usb_options_sensitive(VirtViewerWindow *self, gboolean se
     priv = self->priv;
     menu = GTK_WIDGET(gtk_builder_get_object(priv->builder, "menu-file-usb-device-selection"));
     gtk_widget_set_sensitive(menu, sensitive);
-    gtk_widget_set_visible(priv->toolbar_usb_device_selection, sensitive);
+    priv->usb_options_sensitive = sensitive;
+    if (priv->toolbar != NULL)
+        gtk_widget_set_visible(priv->toolbar_usb_device_selection, sensitive);
 }
 
 void
@@ -1347,6 +1603,9 @@ virt_viewer_window_set_menus_sensitive(VirtViewerWindow *self, gboolean sensitiv
     menu = GTK_WIDGET(gtk_builder_get_object(priv->builder, "menu-file-screenshot"));
     gtk_widget_set_sensitive(menu, sensitive);
 
+    menu = GTK_WIDGET(gtk_builder_get_object(priv->builder, "menu-file-screenshot-all"));
+    gtk_widget_set_sensitive(menu, sensitive);
+
     menu = GTK_WIDGET(gtk_builder_get_object(priv->builder, "menu-view-zoom"));
     gtk_widget_set_sensitive(menu, sensitive);
 
@@ -1371,6 +1630,7 @@ display_show_hint(VirtViewerDisplay *display,
     }
 
     gtk_widget_set_sensitive(GTK_WIDGET(gtk_builder_get_object(self->priv->builder, "menu-file-screenshot")), hint);
+    gtk_widget_set_sensitive(GTK_WIDGET(gtk_builder_get_object(self->priv->builder, "menu-file-screenshot-all")), hint);
 }
 static gboolean
 window_key_pressed (GtkWidget *widget G_GNUC_UNUSED,
@@ -1391,6 +1651,16 @@ virt_viewer_window_set_display(VirtViewerWindow *self, VirtViewerDisplay *displa
 
     priv = self->priv;
     if (priv->display) {
+        GtkCheckMenuItem *check = GTK_CHECK_MENU_ITEM(gtk_builder_get_object(priv->builder, "menu-view-hud"));
+
+        virt_viewer_window_report_relayout(self);
+
+        /* the HUD does not follow the display to another window */
+        virt_viewer_display_set_hud(VIRT_VIEWER_DISPLAY(priv->display), FALSE);
+        g_signal_handlers_block_by_func(check, virt_viewer_window_menu_view_hud, self);
+        gtk_check_menu_item_set_active(check, FALSE);
+        g_signal_handlers_unblock_by_func(check, virt_viewer_window_menu_view_hud, self);
+
         gtk_notebook_remove_page(GTK_NOTEBOOK(priv->notebook), 1);
         g_object_unref(priv->display);
         priv->display = NULL;
@@ -1401,6 +1671,7 @@ virt_viewer_window_set_display(VirtViewerWindow *self, VirtViewerDisplay *displa
 
         virt_viewer_display_set_monitor(VIRT_VIEWER_DISPLAY(priv->display), priv->fullscreen_monitor);
         virt_viewer_display_set_fullscreen(VIRT_VIEWER_DISPLAY(priv->display), priv->fullscreen);
+        virt_viewer_window_sync_scaling(self);
 
         gtk_widget_show_all(GTK_WIDGET(display));
         gtk_notebook_append_page(GTK_NOTEBOOK(priv->notebook), GTK_WIDGET(display), NULL);
@@ -1435,7 +1706,8 @@ virt_viewer_window_set_display(VirtViewerWindow *self, VirtViewerDisplay *displa
         gtk_widget_set_sensitive(GTK_WIDGET(gtk_builder_get_object(self->priv->builder, "menu-preferences")), TRUE);
         gtk_widget_set_sensitive(GTK_WIDGET(gtk_builder_get_object(self->priv->builder, "menu-view-zoom")), TRUE);
         gtk_widget_set_sensitive(GTK_WIDGET(gtk_builder_get_object(self->priv->builder, "menu-send")), TRUE);
-        gtk_widget_set_sensitive(self->priv->toolbar_send_key, TRUE);
+        if (self->priv->toolbar != NULL)
+            gtk_widget_set_sensitive(self->priv->toolbar_send_key, TRUE);
     }
 }
 
@@ -1447,7 +1719,8 @@ virt_viewer_window_enable_kiosk(VirtViewerWindow *self)
     g_return_if_fail(VIRT_VIEWER_IS_WINDOW(self));
     priv = self->priv;
 
-    virt_viewer_timed_revealer_force_reveal(priv->revealer, FALSE);
+    if (priv->toolbar != NULL)
+        virt_viewer_timed_revealer_force_reveal(priv->revealer, FALSE);
 
     /* You probably also want X11 Option "DontVTSwitch" "true" */
     /* and perhaps more distro/desktop-specific options */
@@ -1508,6 +1781,7 @@ virt_viewer_window_set_zoom_level(VirtViewerWindow *self, gint zoom_level)
     if (!priv->display)
         return;
 
+    priv->zoomlevel = virt_viewer_window_snap_zoom_level(self, priv->zoomlevel, 0);
     min_zoom = virt_viewer_window_get_minimal_zoom_level(self);
     if (min_zoom > priv->zoomlevel) {
         g_debug("Cannot set zoom level %d, using %d", priv->zoomlevel, min_zoom);
@@ -1595,7 +1869,8 @@ virt_viewer_window_get_minimal_dimensions(VirtViewerWindow *self,
  *
  * Calculates the zoom level with respect to the desktop dimensions
  *
- * Returns: minimal possible zoom level (multiple of ZOOM_STEP)
+ * Returns: minimal possible zoom level (multiple of ZOOM_STEP, or the
+ * next integer scale with integer scaling)
  */
 static gint
 virt_viewer_window_get_minimal_zoom_level(VirtViewerWindow *self)
@@ -1619,7 +1894,9 @@ virt_viewer_window_get_minimal_zoom_level(VirtViewerWindow *self)
     zoom = ceil(10 * MAX(width_ratio, height_ratio));
 
     /* make sure that the returned zoom level is in the range from MIN_ZOOM_LEVEL to NORMAL_ZOOM_LEVEL */
-    return CLAMP(zoom * ZOOM_STEP, MIN_ZOOM_LEVEL, NORMAL_ZOOM_LEVEL);
+    zoom = CLAMP(zoom * ZOOM_STEP, MIN_ZOOM_LEVEL, NORMAL_ZOOM_LEVEL);
+
+    return virt_viewer_window_snap_zoom_level(self, zoom, 1);
 }
 
 /*
@@ -39,8 +39,6 @@
 #include <libvirt/libvirt.h>
 #include <libvirt/virterror.h>
 #include <libvirt-glib/libvirt-glib.h>
-#include <libxml/xpath.h>
-#include <libxml/uri.h>
 
 #if defined(HAVE_SOCKETPAIR)
 #include <sys/socket.h>
@@ -51,6 +49,9 @@
 #include "virt-viewer-vm-connection.h"
 #include "virt-viewer-auth.h"
 #include "virt-viewer-util.h"
+#include "virt-viewer-timeline.h"
+#include "virt-viewer-graphics-info.h"
+#include "virt-viewer-connection-profile.h"
 
 #ifdef HAVE_SPICE_GTK
 #include "virt-viewer-session-spice.h"
@@ -66,8 +67,25 @@ struct _VirtViewerPrivate {
     gboolean auth_cancelled;
     gint domain_event;
     guint reconnect_poll; /* source id */
+    guint reconnect_interval; /* ms, next poll delay */
+    VirtViewerGraphicsInfoCache *graphics_info;
+    GCancellable *cancellable;
+    gboolean connecting; /* a connection or lookup is in progress */
+    gboolean lookup_again; /* the guest changed during the lookup */
+    gboolean initial_lookup; /* failing to find the guest quits */
+    VirtViewerConnectionProfile *profile; /* the display was opened from it,
+                                           * before looking the guest up */
 };
 
+/* When neither libvirt nor domain events can tell us when to reconnect,
+ * poll with an exponential backoff, starting at RECONNECT_POLL_MIN and
+ * doubling up to RECONNECT_POLL_MAX milliseconds. Each delay is randomly
+ * spread by RECONNECT_POLL_JITTER so that many viewers waiting on the
+ * same libvirtd don't hit it at the same time. */
+#define RECONNECT_POLL_MIN 500
+#define RECONNECT_POLL_MAX 30000
+#define RECONNECT_POLL_JITTER 0.2
+
 G_DEFINE_TYPE (VirtViewer, virt_viewer, VIRT_VIEWER_TYPE_APP)
 #define GET_PRIVATE(o)                                                        \
     (G_TYPE_INSTANCE_GET_PRIVATE ((o), VIRT_VIEWER_TYPE, VirtViewerPrivate))
@@ -77,7 +95,9 @@ static gboolean virt_viewer_open_connection(VirtViewerApp *self, int *fd);
 static void virt_viewer_deactivated(VirtViewerApp *self, gboolean connect_error);
 static gboolean virt_viewer_start(VirtViewerApp *self, GError **error);
 static void virt_viewer_dispose (GObject *object);
-static int virt_viewer_connect(VirtViewerApp *app, GError **error);
+static void virt_viewer_connect_async(VirtViewer *self, gboolean fatal);
+static void virt_viewer_lookup_async(VirtViewer *self, gboolean chosen);
+static void virt_viewer_forget_profile(VirtViewer *self);
 
 static gchar **opt_args = NULL;
 static gchar *opt_uri = NULL;
@@ -85,6 +105,8 @@ static gboolean opt_direct = FALSE;
 static gboolean opt_attach = FALSE;
 static gboolean opt_waitvm = FALSE;
 static gboolean opt_reconnect = FALSE;
+static gboolean opt_ssh_multiplex = FALSE;
+static gint opt_ssh_pool = 0;
 
 typedef enum {
     DOMAIN_SELECTION_ID = (1 << 0),
@@ -131,6 +153,10 @@ virt_viewer_add_option_entries(VirtViewerApp *self, GOptionContext *context, GOp
     static const GOptionEntry options[] = {
         { "direct", 'd', 0, G_OPTION_ARG_NONE, &opt_direct,
           N_("Direct connection with no automatic tunnels"), NULL },
+        { "ssh-multiplex", '\0', 0, G_OPTION_ARG_NONE, &opt_ssh_multiplex,
+          N_("Share one SSH connection between all tunnelled display channels"), NULL },
+        { "ssh-pool", '\0', 0, G_OPTION_ARG_INT, &opt_ssh_pool,
+          N_("Keep up to N SSH tunnels started ahead of time"), "N" },
         { "attach", 'a', 0, G_OPTION_ARG_NONE, &opt_attach,
           N_("Attach to the local display using libvirt"), NULL },
         { "connect", 'c', 0, G_OPTION_ARG_STRING, &opt_uri,
@@ -193,6 +219,14 @@ virt_viewer_local_command_line (GApplication   *gapp,
     }
 
     virt_viewer_app_set_direct(app, opt_direct);
+    virt_viewer_app_set_ssh_multiplex(app, opt_ssh_multiplex);
+    if (opt_ssh_pool < 0) {
+        g_printerr(_("\nThe SSH tunnel pool size must be positive\n\n"));
+        ret = TRUE;
+        *status = 1;
+        goto end;
+    }
+    virt_viewer_app_set_tunnel_pool_size(app, opt_ssh_pool);
     virt_viewer_app_set_attach(app, opt_attach);
     self->priv->reconnect = opt_reconnect;
     self->priv->uri = g_strdup(opt_uri);
@@ -231,6 +265,18 @@ virt_viewer_init(VirtViewer *self)
 {
     self->priv = GET_PRIVATE(self);
     self->priv->domain_event = -1;
+    self->priv->reconnect_interval = RECONNECT_POLL_MIN;
+    self->priv->graphics_info = virt_viewer_graphics_info_cache_new();
+    self->priv->cancellable = g_cancellable_new();
+}
+
+static void virt_viewer_schedule_reconnect_poll(VirtViewer *self);
+
+/* Whether lifecycle events will tell us when the guest can be reached */
+static gboolean
+virt_viewer_has_events(VirtViewer *self)
+{
+    return self->priv->conn != NULL && self->priv->domain_event >= 0;
 }
 
 static gboolean
@@ -238,19 +284,39 @@ virt_viewer_connect_timer(void *opaque)
 {
     VirtViewer *self = VIRT_VIEWER(opaque);
     VirtViewerApp *app = VIRT_VIEWER_APP(self);
+    VirtViewerPrivate *priv = self->priv;
 
     g_debug("Connect timer fired");
+    priv->reconnect_poll = 0;
 
-    if (!virt_viewer_app_is_active(app) &&
-        !virt_viewer_app_initial_connect(app, NULL))
-        g_application_quit(G_APPLICATION(app));
+    /* only starts connecting, the outcome is reported asynchronously */
+    if (!virt_viewer_app_is_active(app))
+        virt_viewer_app_initial_connect(app, NULL);
 
-    if (virt_viewer_app_is_active(app)) {
-        self->priv->reconnect_poll = 0;
+    if (virt_viewer_app_is_active(app) || virt_viewer_has_events(self)) {
+        priv->reconnect_interval = RECONNECT_POLL_MIN;
         return FALSE;
     }
 
-    return TRUE;
+    /* connecting may have restarted the poll already */
+    if (priv->reconnect_poll == 0)
+        virt_viewer_schedule_reconnect_poll(self);
+
+    return FALSE;
+}
+
+static void
+virt_viewer_schedule_reconnect_poll(VirtViewer *self)
+{
+    VirtViewerPrivate *priv = self->priv;
+    guint delay;
+
+    delay = priv->reconnect_interval *
+        g_random_double_range(1.0 - RECONNECT_POLL_JITTER, 1.0 + RECONNECT_POLL_JITTER);
+    g_debug("Next reconnect attempt in %u ms", delay);
+
+    priv->reconnect_poll = g_timeout_add(delay, virt_viewer_connect_timer, self);
+    priv->reconnect_interval = MIN(priv->reconnect_interval * 2, RECONNECT_POLL_MAX);
 }
 
 static void
@@ -263,7 +329,8 @@ virt_viewer_start_reconnect_poll(VirtViewer *self)
     if (priv->reconnect_poll != 0)
         return;
 
-    priv->reconnect_poll = g_timeout_add(500, virt_viewer_connect_timer, self);
+    priv->reconnect_interval = RECONNECT_POLL_MIN;
+    virt_viewer_schedule_reconnect_poll(self);
 }
 
 static void
@@ -273,6 +340,8 @@ virt_viewer_stop_reconnect_poll(VirtViewer *self)
 
     g_debug("reconnect_poll: %d", priv->reconnect_poll);
 
+    priv->reconnect_interval = RECONNECT_POLL_MIN;
+
     if (priv->reconnect_poll == 0)
         return;
 
@@ -291,8 +360,17 @@ virt_viewer_deactivated(VirtViewerApp *app, gboolean connect_error)
         priv->dom = NULL;
     }
 
+    if (priv->profile) {
+        g_debug("The display of guest %s has moved since the previous connection",
+                priv->domkey);
+        virt_viewer_forget_profile(self);
+        virt_viewer_app_show_status(app, _("Finding guest domain"));
+        virt_viewer_app_initial_connect(app, NULL);
+        return;
+    }
+
     if (priv->reconnect && !virt_viewer_app_get_session_cancelled(app)) {
-        if (priv->domain_event < 0) {
+        if (!virt_viewer_has_events(self)) {
             g_debug("No domain events, falling back to polling");
             virt_viewer_start_reconnect_poll(self);
         }
@@ -348,37 +426,42 @@ virt_viewer_parse_uuid(const char *name,
 }
 
 
+/* Called from the lookup thread */
 static virDomainPtr
-virt_viewer_lookup_domain(VirtViewer *self)
+virt_viewer_lookup_domain(virConnectPtr conn, const gchar *domkey)
 {
     char *end;
-    VirtViewerPrivate *priv = self->priv;
     virDomainPtr dom = NULL;
+    gint64 start;
 
-    if (priv->domkey == NULL) {
+    if (domkey == NULL) {
         return NULL;
     }
 
+    start = virt_viewer_timeline_begin("domain-lookup");
+
     if (domain_selection_type & DOMAIN_SELECTION_ID) {
-        long int id = strtol(priv->domkey, &end, 10);
+        long int id = strtol(domkey, &end, 10);
         if (id >= 0 && end && !*end) {
-            dom = virDomainLookupByID(priv->conn, id);
+            dom = virDomainLookupByID(conn, id);
         }
     }
 
     if (domain_selection_type & DOMAIN_SELECTION_UUID) {
         unsigned char uuid[16];
-        if (dom == NULL && virt_viewer_parse_uuid(priv->domkey, uuid) == 0) {
-            dom = virDomainLookupByUUID(priv->conn, uuid);
+        if (dom == NULL && virt_viewer_parse_uuid(domkey, uuid) == 0) {
+            dom = virDomainLookupByUUID(conn, uuid);
         }
     }
 
     if (domain_selection_type & DOMAIN_SELECTION_NAME) {
         if (dom == NULL) {
-            dom = virDomainLookupByName(priv->conn, priv->domkey);
+            dom = virDomainLookupByName(conn, domkey);
         }
     }
 
+    virt_viewer_timeline_end("domain-lookup", start, dom ? domkey : NULL);
+
     return dom;
 }
 
@@ -410,49 +493,6 @@ virt_viewer_matches_domain(VirtViewer *self,
     return 0;
 }
 
-static char *
-virt_viewer_extract_xpath_string(const gchar *xmldesc,
-                                 const gchar *xpath)
-{
-    xmlDocPtr xml = NULL;
-    xmlParserCtxtPtr pctxt = NULL;
-    xmlXPathContextPtr ctxt = NULL;
-    xmlXPathObjectPtr obj = NULL;
-    char *port = NULL;
-
-    pctxt = xmlNewParserCtxt();
-    if (!pctxt || !pctxt->sax)
-        goto error;
-
-    xml = xmlCtxtReadDoc(pctxt, (const xmlChar *)xmldesc, "domain.xml", NULL,
-                         XML_PARSE_NOENT | XML_PARSE_NONET |
-                         XML_PARSE_NOWARNING);
-    if (!xml)
-        goto error;
-
-    ctxt = xmlXPathNewContext(xml);
-    if (!ctxt)
-        goto error;
-
-    obj = xmlXPathEval((const xmlChar *)xpath, ctxt);
-    if (!obj || obj->type != XPATH_STRING || !obj->stringval || !obj->stringval[0])
-        goto error;
-    if (!strcmp((const char*)obj->stringval, "-1"))
-        goto error;
-
-    port = g_strdup((const char*)obj->stringval);
-    xmlXPathFreeObject(obj);
-    obj = NULL;
-
- error:
-    xmlXPathFreeObject(obj);
-    xmlXPathFreeContext(ctxt);
-    xmlFreeDoc(xml);
-    xmlFreeParserCtxt(pctxt);
-    return port;
-}
-
-
 static gboolean
 virt_viewer_replace_host(const gchar *host)
 {
@@ -524,15 +564,19 @@ virt_viewer_is_reachable(const gchar *host,
 }
 
 
-static gboolean
-virt_viewer_extract_connect_info(VirtViewer *self,
-                                 virDomainPtr dom,
-                                 GError **error)
+/*
+ * Returns how to reach the display of @dom, with only its type set when
+ * it can only be reached through libvirt
+ */
+static VirtViewerConnectionProfile *
+virt_viewer_get_connection_profile(VirtViewer *self,
+                                   virDomainPtr dom,
+                                   const gchar *domxml,
+                                   GError **error)
 {
-    char *type = NULL;
-    char *xpath = NULL;
-    gboolean retval = FALSE;
-    char *xmldesc = virDomainGetXMLDesc(dom, 0);
+    VirtViewerGraphicsInfo *info = NULL;
+    VirtViewerConnectionProfile *profile = NULL;
+    char *xmldesc = domxml ? g_strdup(domxml) : virDomainGetXMLDesc(dom, 0);
     VirtViewerPrivate *priv = self->priv;
     VirtViewerApp *app = VIRT_VIEWER_APP(self);
     gchar *gport = NULL;
@@ -544,11 +588,13 @@ virt_viewer_extract_connect_info(VirtViewer *self,
     gchar *user = NULL;
     gint port = 0;
     gchar *uri = NULL;
+    char uuid[VIR_UUID_STRING_BUFLEN];
+    const gchar *key = virDomainGetUUIDString(dom, uuid) == 0 ? uuid : NULL;
     gboolean direct = virt_viewer_app_get_direct(app);
 
-    virt_viewer_app_free_connect_info(app);
-
-    if ((type = virt_viewer_extract_xpath_string(xmldesc, "string(/domain/devices/graphics/@type)")) == NULL) {
+    if (xmldesc != NULL)
+        info = virt_viewer_graphics_info_cache_get(priv->graphics_info, key, xmldesc);
+    if (info == NULL) {
         g_set_error(error,
                     VIRT_VIEWER_ERROR, VIRT_VIEWER_ERROR_FAILED,
                     _("Cannot determine the graphic type for the guest %s"), priv->domkey);
@@ -556,35 +602,14 @@ virt_viewer_extract_connect_info(VirtViewer *self,
         goto cleanup;
     }
 
-    if (!virt_viewer_app_create_session(app, type, error))
-        goto cleanup;
-
-    xpath = g_strdup_printf("string(/domain/devices/graphics[@type='%s']/@port)", type);
-    gport = virt_viewer_extract_xpath_string(xmldesc, xpath);
-    g_free(xpath);
-    if (g_str_equal(type, "spice")) {
-        xpath = g_strdup_printf("string(/domain/devices/graphics[@type='%s']/@tlsPort)", type);
-        gtlsport = virt_viewer_extract_xpath_string(xmldesc, xpath);
-        g_free(xpath);
-    }
+    gport = g_strdup(info->port);
+    if (g_str_equal(info->type, "spice"))
+        gtlsport = g_strdup(info->tls_port);
 
-    if (gport || gtlsport) {
-        xpath = g_strdup_printf("string(/domain/devices/graphics[@type='%s']/listen/@address)", type);
-        ghost = virt_viewer_extract_xpath_string(xmldesc, xpath);
-        if (ghost == NULL) { /* try old xml format - listen attribute in the graphics node */
-            g_free(xpath);
-            xpath = g_strdup_printf("string(/domain/devices/graphics[@type='%s']/@listen)", type);
-            ghost = virt_viewer_extract_xpath_string(xmldesc, xpath);
-        }
-    } else {
-        xpath = g_strdup_printf("string(/domain/devices/graphics[@type='%s']/listen/@socket)", type);
-        unixsock = virt_viewer_extract_xpath_string(xmldesc, xpath);
-        if (unixsock == NULL) { /* try old xml format - socket attribute in the graphics node */
-            g_free(xpath);
-            xpath = g_strdup_printf("string(/domain/devices/graphics[@type='%s']/@socket)", type);
-            unixsock = virt_viewer_extract_xpath_string(xmldesc, xpath);
-        }
-    }
+    if (gport || gtlsport)
+        ghost = g_strdup(info->listen);
+    else
+        unixsock = g_strdup(info->socket);
 
     if (ghost && gport) {
         g_debug("Guest graphics address is %s:%s", ghost, gport);
@@ -592,7 +617,9 @@ virt_viewer_extract_connect_info(VirtViewer *self,
         g_debug("Guest graphics address is %s", unixsock);
     } else {
         g_debug("Using direct libvirt connection");
-        retval = TRUE;
+        profile = g_new0(VirtViewerConnectionProfile, 1);
+        profile->uuid = g_strdup(key);
+        profile->type = g_strdup(info->type);
         goto cleanup;
     }
 
@@ -636,9 +663,20 @@ virt_viewer_extract_connect_info(VirtViewer *self,
         goto cleanup;
     }
 
-    virt_viewer_app_set_connect_info(app, host, ghost, gport, gtlsport,transport, unixsock, user, port, NULL);
-
-    retval = TRUE;
+    profile = g_new0(VirtViewerConnectionProfile, 1);
+    profile->uuid = g_strdup(key);
+    profile->name = g_strdup(virDomainGetName(dom));
+    profile->uri = g_strdup(priv->uri);
+    profile->type = g_strdup(info->type);
+    profile->ghost = ghost;
+    profile->gport = gport;
+    profile->gtlsport = gtlsport;
+    profile->unixsock = unixsock;
+    profile->host = host;
+    profile->transport = transport;
+    profile->user = user;
+    profile->port = port;
+    ghost = gport = gtlsport = unixsock = host = transport = user = NULL;
 
  cleanup:
     g_free(gport);
@@ -648,15 +686,203 @@ virt_viewer_extract_connect_info(VirtViewer *self,
     g_free(host);
     g_free(transport);
     g_free(user);
-    g_free(type);
-    g_free(xpath);
+    virt_viewer_graphics_info_free(info);
     g_free(xmldesc);
     g_free(uri);
+    return profile;
+}
+
+static gboolean
+virt_viewer_profile_has_address(const VirtViewerConnectionProfile *profile)
+{
+    return (profile->ghost && profile->gport) || profile->unixsock;
+}
+
+/*
+ * Whether the display is opened through the local libvirt connection
+ * once the guest is looked up, without authentication: the address of
+ * a profile must not be used instead, it would ask for the display
+ * credentials, and could give them to another guest by then.
+ */
+static gboolean
+virt_viewer_profile_opens_graphics(const VirtViewerConnectionProfile *profile)
+{
+#if defined(HAVE_VIR_DOMAIN_OPEN_GRAPHICS_FD) || defined(HAVE_SOCKETPAIR)
+    return g_strcmp0(profile->host, "localhost") == 0 &&
+        (profile->transport == NULL || g_str_equal(profile->transport, "unix"));
+#else
+    return FALSE;
+#endif
+}
+
+static void
+virt_viewer_set_connect_info_from_profile(VirtViewer *self,
+                                          const VirtViewerConnectionProfile *profile)
+{
+    virt_viewer_app_set_connect_info(VIRT_VIEWER_APP(self), profile->host,
+                                     profile->ghost, profile->gport, profile->gtlsport,
+                                     profile->transport, profile->unixsock,
+                                     profile->user, profile->port, NULL);
+}
+
+static gboolean
+virt_viewer_extract_connect_info(VirtViewer *self,
+                                 virDomainPtr dom,
+                                 const gchar *domxml,
+                                 GError **error)
+{
+    VirtViewerApp *app = VIRT_VIEWER_APP(self);
+    VirtViewerConnectionProfile *profile;
+    gboolean retval = FALSE;
+    gint64 start = virt_viewer_timeline_begin("extract-connect-info");
+
+    virt_viewer_app_free_connect_info(app);
+
+    profile = virt_viewer_get_connection_profile(self, dom, domxml, error);
+    if (profile == NULL)
+        goto cleanup;
+
+    if (!virt_viewer_app_create_session(app, profile->type, error))
+        goto cleanup;
+
+    if (virt_viewer_profile_has_address(profile))
+        virt_viewer_set_connect_info_from_profile(self, profile);
+
+    if (profile->uuid != NULL && virt_viewer_profile_has_address(profile) &&
+        !virt_viewer_profile_opens_graphics(profile)) {
+        virt_viewer_app_set_connection_profile(app, profile);
+    } else {
+        /* opened through libvirt, or can't be reached without
+         * looking the guest up */
+        virt_viewer_app_set_connection_profile(app, NULL);
+    }
+
+    retval = TRUE;
+
+ cleanup:
+    virt_viewer_connection_profile_free(profile);
+    virt_viewer_timeline_end("extract-connect-info", start, retval ? "ok" : "failed");
     return retval;
 }
 
+/*
+ * The display of the guest is opened the way it was reached on the
+ * previous connection, without waiting for libvirt to find the guest
+ * and describe its graphics. The lookup still happens meanwhile, and
+ * virt_viewer_check_profile() closes the display if it turns out to have
+ * moved, which virt_viewer_deactivated() then looks up again. Until then
+ * the session is tentative: the handshake is done, but the display is
+ * neither shown nor given any input.
+ */
+static void
+virt_viewer_open_profile(VirtViewer *self)
+{
+    VirtViewerApp *app = VIRT_VIEWER_APP(self);
+    VirtViewerPrivate *priv = self->priv;
+    VirtViewerConnectionProfile *profile;
+    GError *error = NULL;
+
+    /* --attach opens the display through libvirt */
+    if (priv->domkey == NULL || virt_viewer_app_get_attach(app))
+        return;
+
+    profile = virt_viewer_app_get_connection_profile(app, priv->uri, priv->domkey);
+    if (profile == NULL)
+        return;
+
+    /* saved before local connections were left to libvirt */
+    if (virt_viewer_profile_opens_graphics(profile)) {
+        virt_viewer_connection_profile_free(profile);
+        return;
+    }
+
+    virt_viewer_timeline_mark("connection-profile", profile->uuid);
+    virt_viewer_app_trace(app, "Opening the display of guest %s as on the previous connection",
+                          priv->domkey);
+    g_object_set(app, "uuid", profile->uuid, "guest-name", profile->name, NULL);
+
+    if (!virt_viewer_app_create_session(app, profile->type, &error)) {
+        g_debug("%s", error->message);
+        g_clear_error(&error);
+        virt_viewer_connection_profile_free(profile);
+        return;
+    }
+
+    virt_viewer_set_connect_info_from_profile(self, profile);
+    virt_viewer_app_set_tentative(app, TRUE);
+    priv->profile = profile;
+
+    if (!VIRT_VIEWER_APP_CLASS(virt_viewer_parent_class)->initial_connect(app, &error)) {
+        g_debug("Cannot open the display from the connection profile: %s",
+                error ? error->message : "unknown error");
+        g_clear_error(&error);
+        virt_viewer_forget_profile(self);
+    }
+}
+
+static void
+virt_viewer_forget_profile(VirtViewer *self)
+{
+    VirtViewerApp *app = VIRT_VIEWER_APP(self);
+
+    g_clear_pointer(&self->priv->profile, virt_viewer_connection_profile_free);
+    virt_viewer_app_set_tentative(app, FALSE);
+    virt_viewer_app_free_connect_info(app);
+}
+
+/*
+ * Compares the outcome of the domain lookup with the profile the
+ * display was opened from. @dom is NULL if the guest was not found.
+ */
+static void
+virt_viewer_check_profile(VirtViewer *self, virDomainPtr dom,
+                          int state, const gchar *xmldesc)
+{
+    VirtViewerApp *app = VIRT_VIEWER_APP(self);
+    VirtViewerPrivate *priv = self->priv;
+    VirtViewerConnectionProfile *profile = NULL;
+    GError *error = NULL;
+    gint64 start = virt_viewer_timeline_begin("check-connection-profile");
+    gboolean valid;
+
+    if (dom != NULL && state >= 0 && state != VIR_DOMAIN_SHUTOFF) {
+        profile = virt_viewer_get_connection_profile(self, dom, xmldesc, &error);
+        if (error != NULL) {
+            g_debug("%s", error->message);
+            g_clear_error(&error);
+        }
+    }
+
+    valid = virt_viewer_connection_profile_equal(profile, priv->profile);
+    virt_viewer_timeline_end("check-connection-profile", start, valid ? "valid" : "stale");
+    if (!valid) {
+        /* virt_viewer_deactivated() looks the display up again */
+        if (virt_viewer_app_is_active(app))
+            virt_viewer_app_close_session(app);
+        else
+            virt_viewer_deactivated(app, FALSE);
+        virt_viewer_connection_profile_free(profile);
+        return;
+    }
+
+    g_debug("The display of guest %s did not move", priv->domkey);
+    if (priv->dom)
+        virDomainFree(priv->dom);
+    priv->dom = dom;
+    virDomainRef(priv->dom);
+    g_object_set(app, "guest-name", virDomainGetName(dom), NULL);
+
+    g_clear_pointer(&priv->profile, virt_viewer_connection_profile_free);
+    virt_viewer_app_set_tentative(app, FALSE);
+    /* the guest may have been renamed */
+    virt_viewer_app_set_connection_profile(app, profile);
+    virt_viewer_connection_profile_free(profile);
+}
+
+/* @xmldesc is the domain XML if it was already fetched, or NULL */
 static gboolean
-virt_viewer_update_display(VirtViewer *self, virDomainPtr dom, GError **error)
+virt_viewer_update_display(VirtViewer *self, virDomainPtr dom,
+                           const gchar *xmldesc, GError **error)
 {
     VirtViewerPrivate *priv = self->priv;
     VirtViewerApp *app = VIRT_VIEWER_APP(self);
@@ -672,7 +898,7 @@ virt_viewer_update_display(VirtViewer *self, virDomainPtr dom, GError **error)
     if (virt_viewer_app_has_session(app))
         return TRUE;
 
-    return virt_viewer_extract_connect_info(self, dom, error);
+    return virt_viewer_extract_connect_info(self, dom, xmldesc, error);
 }
 
 static gboolean
@@ -753,16 +979,9 @@ virt_viewer_domain_event(virConnectPtr conn G_GNUC_UNUSED,
         break;
 
     case VIR_DOMAIN_EVENT_STARTED:
-        virt_viewer_update_display(self, dom, &error);
-        if (error) {
-            virt_viewer_app_simple_message_dialog(app, error->message);
-            g_clear_error(&error);
-        }
-
-        virt_viewer_app_activate(app, &error);
-        if (error) {
-            /* we may want to consolidate error reporting in
-               app_activate() instead */
+        /* the display is looked up and activated asynchronously, errors
+         * are reported once done */
+        if (!virt_viewer_app_initial_connect(app, &error)) {
             g_warning("%s", error->message);
             g_clear_error(&error);
         }
@@ -782,6 +1001,9 @@ virt_viewer_conn_event(virConnectPtr conn G_GNUC_UNUSED,
 
     g_debug("Got connection event %d", reason);
 
+    /* the domain event callback went away with the connection, and
+     * nothing will tell us when libvirtd is back */
+    priv->domain_event = -1;
     virConnectClose(priv->conn);
     priv->conn = NULL;
 
@@ -813,95 +1035,196 @@ virt_viewer_dispose (GObject *object)
     priv->uri = NULL;
     g_free(priv->domkey);
     priv->domkey = NULL;
+    virt_viewer_stop_reconnect_poll(self);
+    if (priv->cancellable) {
+        g_cancellable_cancel(priv->cancellable);
+        g_clear_object(&priv->cancellable);
+    }
+    g_clear_pointer(&priv->graphics_info, virt_viewer_graphics_info_cache_free);
+    g_clear_pointer(&priv->profile, virt_viewer_connection_profile_free);
     G_OBJECT_CLASS(virt_viewer_parent_class)->dispose (object);
 }
 
-static virDomainPtr
+/* @running: the names of the running domains */
+static gchar *
 choose_vm(GtkWindow *main_window,
-          char **vm_name,
-          virConnectPtr conn,
+          gchar **running,
           GError **error)
 {
     GtkListStore *model;
     GtkTreeIter iter;
-    virDomainPtr *domains, dom = NULL;
-    int i, vms_running;
-    unsigned int flags = VIR_CONNECT_LIST_DOMAINS_RUNNING;
-
-    g_return_val_if_fail(vm_name != NULL, NULL);
-    free(*vm_name);
+    gchar *vm_name;
+    guint i;
 
     model = gtk_list_store_new(1, G_TYPE_STRING);
 
-    vms_running = virConnectListAllDomains(conn, &domains, flags);
-    for (i = 0; i < vms_running; i++) {
+    for (i = 0; running != NULL && running[i] != NULL; i++) {
         gtk_list_store_append(model, &iter);
-        gtk_list_store_set(model, &iter, 0, virDomainGetName(domains[i]), -1);
-        virDomainFree(domains[i]);
+        gtk_list_store_set(model, &iter, 0, running[i], -1);
     }
-    free(domains);
 
-    *vm_name = virt_viewer_vm_connection_choose_name_dialog(main_window,
-                                                            GTK_TREE_MODEL(model),
-                                                            error);
+    vm_name = virt_viewer_vm_connection_choose_name_dialog(main_window,
+                                                           GTK_TREE_MODEL(model),
+                                                           error);
     g_object_unref(G_OBJECT(model));
-    if (*vm_name == NULL)
-        return NULL;
 
-    dom = virDomainLookupByName(conn, *vm_name);
-    if (dom == NULL) {
+    return vm_name;
+}
+
+/* @fatal: whether this was the initial connection, and the viewer quits */
+static void
+virt_viewer_connect_failed(VirtViewer *self, GError *error, gboolean fatal)
+{
+    VirtViewerApp *app = VIRT_VIEWER_APP(self);
+
+    if (!g_error_matches(error, VIRT_VIEWER_ERROR, VIRT_VIEWER_ERROR_CANCELLED))
+        virt_viewer_app_simple_message_dialog(app, error->message);
+
+    if (fatal)
+        g_application_quit(G_APPLICATION(app));
+}
+
+/*
+ * The domain lookup, its state and its XML description all need
+ * round-trips to libvirtd, which can take seconds over a remote
+ * connection. They are done in a thread so that the main loop keeps
+ * running and the status messages are drawn meanwhile. So is listing
+ * the running domains to choose from when the domain is not found.
+ */
+typedef struct {
+    virConnectPtr conn;
+    gchar *domkey;
+    virDomainPtr dom;
+    int state; /* virDomainState, or -1 if it could not be retrieved */
+    gchar *xmldesc;
+    gboolean list_running; /* if domkey is not found */
+    gchar **running; /* the names of the running domains */
+    gboolean chosen; /* domkey was picked among the running domains */
+    gchar *error; /* why the chosen domain was not found */
+} DomainLookup;
+
+static void
+domain_lookup_free(DomainLookup *lookup)
+{
+    if (lookup->dom)
+        virDomainFree(lookup->dom);
+    virConnectClose(lookup->conn);
+    g_free(lookup->domkey);
+    g_free(lookup->xmldesc);
+    g_strfreev(lookup->running);
+    g_free(lookup->error);
+    g_free(lookup);
+}
+
+static void
+virt_viewer_lookup_thread(GTask *task,
+                          gpointer source G_GNUC_UNUSED,
+                          gpointer task_data,
+                          GCancellable *cancellable G_GNUC_UNUSED)
+{
+    DomainLookup *lookup = task_data;
+    virDomainInfo info;
+
+    if (lookup->chosen)
+        lookup->dom = virDomainLookupByName(lookup->conn, lookup->domkey);
+    else
+        lookup->dom = virt_viewer_lookup_domain(lookup->conn, lookup->domkey);
+
+    if (lookup->dom == NULL && lookup->chosen) {
         virErrorPtr err = virGetLastError();
-        g_set_error_literal(error,
-                            VIRT_VIEWER_ERROR, VIRT_VIEWER_ERROR_FAILED,
-                            err && err->message ? err->message : "unknown libvirt error");
-    } else if (virDomainGetState(dom, &i, NULL, 0) < 0 || i != VIR_DOMAIN_RUNNING) {
-        g_set_error(error,
-                    VIRT_VIEWER_ERROR, VIRT_VIEWER_ERROR_FAILED,
-                    _("Virtual machine %s is not running"), *vm_name);
-        virDomainFree(dom);
-        dom = NULL;
+        lookup->error = g_strdup(err && err->message ? err->message : "unknown libvirt error");
+    } else if (lookup->dom == NULL && lookup->list_running) {
+        virDomainPtr *domains;
+        int i, n;
+
+        n = virConnectListAllDomains(lookup->conn, &domains,
+                                     VIR_CONNECT_LIST_DOMAINS_RUNNING);
+        lookup->running = g_new0(gchar *, MAX(n, 0) + 1);
+        for (i = 0; i < n; i++) {
+            lookup->running[i] = g_strdup(virDomainGetName(domains[i]));
+            virDomainFree(domains[i]);
+        }
+        if (n >= 0)
+            free(domains);
+    } else if (lookup->dom != NULL) {
+        if (virDomainGetInfo(lookup->dom, &info) < 0) {
+            lookup->state = -1;
+        } else {
+            lookup->state = info.state;
+            if (info.state != VIR_DOMAIN_SHUTOFF)
+                lookup->xmldesc = virDomainGetXMLDesc(lookup->dom, 0);
+        }
     }
 
-    return dom;
+    g_task_return_boolean(task, TRUE);
 }
 
-static gboolean
-virt_viewer_initial_connect(VirtViewerApp *app, GError **error)
+static void
+virt_viewer_lookup_ready(GObject *source,
+                         GAsyncResult *result,
+                         gpointer user_data G_GNUC_UNUSED)
 {
-    virDomainPtr dom = NULL;
-    virDomainInfo info;
-    gboolean ret = FALSE;
-    VirtViewer *self = VIRT_VIEWER(app);
+    VirtViewer *self = VIRT_VIEWER(source);
+    VirtViewerApp *app = VIRT_VIEWER_APP(self);
     VirtViewerPrivate *priv = self->priv;
+    DomainLookup *lookup = g_task_get_task_data(G_TASK(result));
+    virDomainPtr dom;
     char uuid_string[VIR_UUID_STRING_BUFLEN];
     const char *guest_name;
     GError *err = NULL;
 
-    g_debug("initial connect");
+    priv->connecting = FALSE;
 
-    if (!priv->conn &&
-        virt_viewer_connect(app, &err) < 0) {
-        virt_viewer_app_show_status(app, _("Waiting for libvirt to start"));
-        goto wait;
+    if (!g_task_propagate_boolean(G_TASK(result), &err)) {
+        /* cancelled, we are going away */
+        g_debug("Domain lookup: %s", err->message);
+        g_clear_error(&err);
+        return;
+    }
+
+    /* e.g. the guest started after the thread found it shut off, and
+     * the event telling so was left to this lookup */
+    if (priv->lookup_again) {
+        g_debug("Guest %s changed during the lookup, looking it up again", priv->domkey);
+        priv->lookup_again = FALSE;
+        virt_viewer_lookup_async(self, lookup->chosen);
+        return;
+    }
+
+    dom = lookup->dom;
+    lookup->dom = NULL;
+    if (priv->profile) {
+        virt_viewer_check_profile(self, dom, lookup->state, lookup->xmldesc);
+        goto cleanup;
     }
 
-    virt_viewer_app_show_status(app, _("Finding guest domain"));
-    dom = virt_viewer_lookup_domain(self);
     if (!dom) {
         if (priv->waitvm) {
             virt_viewer_app_show_status(app, _("Waiting for guest domain to be created"));
             goto wait;
+        } else if (lookup->chosen) {
+            g_set_error_literal(&err, VIRT_VIEWER_ERROR, VIRT_VIEWER_ERROR_FAILED,
+                                lookup->error);
+            goto cleanup;
         } else {
             VirtViewerWindow *main_window = virt_viewer_app_get_main_window(app);
+            gchar *vm_name;
+
             if (priv->domkey != NULL)
                 g_debug("Cannot find guest %s", priv->domkey);
-            dom = choose_vm(virt_viewer_window_get_window(main_window),
-                            &priv->domkey,
-                            priv->conn,
-                            &err);
-            if (dom == NULL) {
+            vm_name = choose_vm(virt_viewer_window_get_window(main_window),
+                                lookup->running,
+                                &err);
+            if (vm_name == NULL) {
                 goto cleanup;
             }
+
+            /* the chosen domain is looked up asynchronously as well */
+            g_free(priv->domkey);
+            priv->domkey = vm_name;
+            virt_viewer_app_show_status(app, _("Finding guest domain"));
+            virt_viewer_lookup_async(self, TRUE);
+            goto cleanup;
         }
     }
 
@@ -915,37 +1238,96 @@ virt_viewer_initial_connect(VirtViewerApp *app, GError **error)
         g_object_set(app, "guest-name", guest_name, NULL);
     }
 
-    virt_viewer_app_show_status(app, _("Checking guest domain status"));
-    if (virDomainGetInfo(dom, &info) < 0) {
+    if (lookup->state < 0) {
         g_set_error_literal(&err, VIRT_VIEWER_ERROR, VIRT_VIEWER_ERROR_FAILED,
                             _("Cannot get guest state"));
         g_debug("%s", err->message);
         goto cleanup;
     }
 
-    if (info.state == VIR_DOMAIN_SHUTOFF) {
+    if (lookup->chosen && lookup->state != VIR_DOMAIN_RUNNING) {
+        g_set_error(&err, VIRT_VIEWER_ERROR, VIRT_VIEWER_ERROR_FAILED,
+                    _("Virtual machine %s is not running"), priv->domkey);
+        goto cleanup;
+    }
+
+    if (lookup->state == VIR_DOMAIN_SHUTOFF) {
         virt_viewer_app_show_status(app, _("Waiting for guest domain to start"));
         goto wait;
     }
 
-    if (!virt_viewer_update_display(self, dom, &err))
+    if (!virt_viewer_update_display(self, dom, lookup->xmldesc, &err))
         goto cleanup;
 
-    ret = VIRT_VIEWER_APP_CLASS(virt_viewer_parent_class)->initial_connect(app, &err);
-    if (ret || err)
+    if (VIRT_VIEWER_APP_CLASS(virt_viewer_parent_class)->initial_connect(app, &err) || err)
         goto cleanup;
 
 wait:
     virt_viewer_app_trace(app, "Guest %s has not activated its display yet, waiting "
                           "for it to start", priv->domkey);
-    ret = TRUE;
 
 cleanup:
-    if (err != NULL)
-        g_propagate_error(error, err);
+    if (err != NULL) {
+        g_prefix_error(&err, _("Failed to connect: "));
+        virt_viewer_connect_failed(self, err, priv->initial_lookup);
+        g_clear_error(&err);
+    }
+    /* unless the guest is being looked up again, from its profile
+     * having gone stale or from being chosen */
+    if (!priv->connecting && priv->profile == NULL)
+        priv->initial_lookup = FALSE;
     if (dom)
         virDomainFree(dom);
-    return ret;
+}
+
+/* @chosen: whether the domain was picked in choose_vm() */
+static void
+virt_viewer_lookup_async(VirtViewer *self, gboolean chosen)
+{
+    VirtViewerPrivate *priv = self->priv;
+    DomainLookup *lookup = g_new0(DomainLookup, 1);
+    GTask *task;
+
+    lookup->conn = priv->conn;
+    virConnectRef(lookup->conn);
+    lookup->domkey = g_strdup(priv->domkey);
+    lookup->list_running = !priv->waitvm;
+    lookup->chosen = chosen;
+
+    priv->connecting = TRUE;
+    task = g_task_new(self, priv->cancellable, virt_viewer_lookup_ready, NULL);
+    g_task_set_task_data(task, lookup, (GDestroyNotify)domain_lookup_free);
+    g_task_run_in_thread(task, virt_viewer_lookup_thread);
+    g_object_unref(task);
+}
+
+/* Only starts connecting, the outcome is handled by
+ * virt_viewer_connect_ready() and virt_viewer_lookup_ready() */
+static gboolean
+virt_viewer_initial_connect(VirtViewerApp *app, GError **error G_GNUC_UNUSED)
+{
+    VirtViewer *self = VIRT_VIEWER(app);
+    VirtViewerPrivate *priv = self->priv;
+
+    g_debug("initial connect");
+
+    if (priv->connecting) {
+        g_debug("Already connecting");
+        /* the lookup in progress may have missed what changed */
+        if (priv->conn)
+            priv->lookup_again = TRUE;
+        return TRUE;
+    }
+
+    if (!priv->conn) {
+        virt_viewer_connect_async(self, FALSE);
+        return TRUE;
+    }
+
+    virt_viewer_app_show_status(app, _("Finding guest domain"));
+    virt_viewer_lookup_async(self, FALSE);
+
+    return TRUE;
 }
 
 static void
@@ -958,9 +1340,9 @@ virt_viewer_error_func (void *data G_GNUC_UNUSED,
 
 
 static int
-virt_viewer_auth_libvirt_credentials(virConnectCredentialPtr cred,
-                                     unsigned int ncred,
-                                     void *cbdata)
+virt_viewer_collect_libvirt_credentials(virConnectCredentialPtr cred,
+                                        unsigned int ncred,
+                                        void *cbdata)
 {
     char **username = NULL, **password = NULL;
     VirtViewer *app = cbdata;
@@ -1030,6 +1412,57 @@ virt_viewer_auth_libvirt_credentials(virConnectCredentialPtr cred,
     return ret;
 }
 
+typedef struct {
+    VirtViewer *self;
+    virConnectCredentialPtr cred;
+    unsigned int ncred;
+    int ret;
+    gboolean done;
+    GMutex lock;
+    GCond cond;
+} AuthRequest;
+
+static gboolean
+virt_viewer_auth_request_run(gpointer opaque)
+{
+    AuthRequest *req = opaque;
+    int ret = virt_viewer_collect_libvirt_credentials(req->cred, req->ncred, req->self);
+
+    g_mutex_lock(&req->lock);
+    req->ret = ret;
+    req->done = TRUE;
+    g_cond_signal(&req->cond);
+    g_mutex_unlock(&req->lock);
+
+    return G_SOURCE_REMOVE;
+}
+
+/* virConnectOpenAuth() runs in the connection thread: hand the
+ * credential request over to the main loop, which owns the dialogs,
+ * and wait for the answer */
+static int
+virt_viewer_auth_libvirt_credentials(virConnectCredentialPtr cred,
+                                     unsigned int ncred,
+                                     void *cbdata)
+{
+    AuthRequest req = { cbdata, cred, ncred, -1, FALSE, };
+
+    g_mutex_init(&req.lock);
+    g_cond_init(&req.cond);
+
+    g_idle_add(virt_viewer_auth_request_run, &req);
+
+    g_mutex_lock(&req.lock);
+    while (!req.done)
+        g_cond_wait(&req.cond, &req.lock);
+    g_mutex_unlock(&req.lock);
+
+    g_mutex_clear(&req.lock);
+    g_cond_clear(&req.cond);
+
+    return req.ret;
+}
+
 static gchar *
 virt_viewer_get_error_message_from_vir_error(VirtViewer *self,
                                              virErrorPtr error)
@@ -1060,10 +1493,19 @@ virt_viewer_get_error_message_from_vir_error(VirtViewer *self,
     return error_message;
 }
 
-static int
-virt_viewer_connect(VirtViewerApp *app, GError **err)
+static void
+virt_viewer_conn_close(gpointer conn)
 {
-    VirtViewer *self = VIRT_VIEWER(app);
+    virConnectClose(conn);
+}
+
+static void
+virt_viewer_connect_thread(GTask *task,
+                           gpointer source,
+                           gpointer task_data,
+                           GCancellable *cancellable G_GNUC_UNUSED)
+{
+    VirtViewer *self = VIRT_VIEWER(source);
     VirtViewerPrivate *priv = self->priv;
     int cred_types[] =
         { VIR_CRED_AUTHNAME, VIR_CRED_PASSPHRASE };
@@ -1071,46 +1513,72 @@ virt_viewer_connect(VirtViewerApp *app, GError **err)
         .credtype = cred_types,
         .ncredtype = G_N_ELEMENTS(cred_types),
         .cb = virt_viewer_auth_libvirt_credentials,
-        .cbdata = app,
+        .cbdata = self,
     };
-    int oflags = 0;
-    GError *error = NULL;
+    int oflags = GPOINTER_TO_INT(task_data);
+    virConnectPtr conn;
+    gint64 start;
+
+    start = virt_viewer_timeline_begin("libvirt-connect");
+    conn = virConnectOpenAuth(priv->uri,
+                              //virConnectAuthPtrDefault,
+                              &auth_libvirt,
+                              oflags);
+    virt_viewer_timeline_end("libvirt-connect", start, conn ? priv->uri : NULL);
+    if (conn) {
+        g_task_return_pointer(task, conn, virt_viewer_conn_close);
+        return;
+    }
 
-    if (!virt_viewer_app_get_attach(app))
-        oflags |= VIR_CONNECT_RO;
+    /* the libvirt error is only available from this thread */
+    if (!priv->auth_cancelled) {
+        gchar *error_message = virt_viewer_get_error_message_from_vir_error(self, virGetLastError());
+        g_task_return_new_error(task,
+                                VIRT_VIEWER_ERROR, VIRT_VIEWER_ERROR_FAILED,
+                                "%s", error_message);
+        g_free(error_message);
+    } else {
+        g_task_return_new_error(task,
+                                VIRT_VIEWER_ERROR, VIRT_VIEWER_ERROR_CANCELLED,
+                                "%s", _("Authentication was cancelled"));
+    }
+}
 
-    g_debug("connecting ...");
+static void
+virt_viewer_connect_ready(GObject *source,
+                          GAsyncResult *result,
+                          gpointer user_data)
+{
+    VirtViewer *self = VIRT_VIEWER(source);
+    VirtViewerApp *app = VIRT_VIEWER_APP(self);
+    VirtViewerPrivate *priv = self->priv;
+    gboolean fatal = GPOINTER_TO_INT(user_data);
+    GError *error = NULL;
 
-    virt_viewer_app_trace(app, "Opening connection to libvirt with URI %s",
-                          priv->uri ? priv->uri : "<null>");
-    priv->conn = virConnectOpenAuth(priv->uri,
-                                    //virConnectAuthPtrDefault,
-                                    &auth_libvirt,
-                                    oflags);
-    if (!priv->conn) {
-        if (!priv->auth_cancelled) {
-            gchar *error_message = virt_viewer_get_error_message_from_vir_error(self, virGetLastError());
-            g_set_error_literal(&error,
-                                VIRT_VIEWER_ERROR, VIRT_VIEWER_ERROR_FAILED,
-                                error_message);
+    priv->connecting = FALSE;
 
-            g_free(error_message);
+    priv->conn = g_task_propagate_pointer(G_TASK(result), &error);
+    if (!priv->conn) {
+        if (g_error_matches(error, G_IO_ERROR, G_IO_ERROR_CANCELLED)) {
+            /* we are going away */
+        } else if (fatal) {
+            virt_viewer_connect_failed(self, error, TRUE);
         } else {
-            g_set_error_literal(&error,
-                                VIRT_VIEWER_ERROR, VIRT_VIEWER_ERROR_CANCELLED,
-                                _("Authentication was cancelled"));
+            g_debug("%s", error->message);
+            virt_viewer_app_show_status(app, _("Waiting for libvirt to start"));
+            virt_viewer_app_trace(app, "Guest %s has not activated its display yet, waiting "
+                                  "for it to start", priv->domkey);
         }
-        g_propagate_error(err, error);
-        return -1;
-    }
-
-    if (!virt_viewer_app_initial_connect(app, &error)) {
-        g_propagate_prefixed_error(err, error, _("Failed to connect: "));
-        return -1;
+        g_clear_error(&error);
+        return;
     }
 
+    /* Rely on lifecycle events to know when the guest (re)starts, and on
+     * the close callback below to know when libvirtd goes away. The
+     * domain may not be known yet, the events are filtered by
+     * virt_viewer_domain_event() */
     priv->domain_event = virConnectDomainEventRegisterAny(priv->conn,
-                                                          priv->dom,
+                                                          NULL,
                                                           VIR_DOMAIN_EVENT_ID_LIFECYCLE,
                                                           VIR_DOMAIN_EVENT_CALLBACK(virt_viewer_domain_event),
                                                           self,
@@ -1136,7 +1604,34 @@ virt_viewer_connect(VirtViewerApp *app, GError **err)
         g_debug("Unable to set keep alive");
     }
 
-    return 0;
+    /* looks up the domain, asynchronously as well */
+    virt_viewer_app_initial_connect(app, NULL);
+}
+
+/* @fatal: whether failing to connect quits, or waits for libvirtd to
+ * come back */
+static void
+virt_viewer_connect_async(VirtViewer *self, gboolean fatal)
+{
+    VirtViewerApp *app = VIRT_VIEWER_APP(self);
+    VirtViewerPrivate *priv = self->priv;
+    int oflags = 0;
+    GTask *task;
+
+    if (!virt_viewer_app_get_attach(app))
+        oflags |= VIR_CONNECT_RO;
+
+    g_debug("connecting ...");
+
+    virt_viewer_app_trace(app, "Opening connection to libvirt with URI %s",
+                          priv->uri ? priv->uri : "<null>");
+
+    priv->connecting = TRUE;
+    task = g_task_new(self, priv->cancellable, virt_viewer_connect_ready,
+                      GINT_TO_POINTER(fatal));
+    g_task_set_task_data(task, GINT_TO_POINTER(oflags), NULL);
+    g_task_run_in_thread(task, virt_viewer_connect_thread);
+    g_object_unref(task);
 }
 
 static gboolean
@@ -1146,10 +1641,17 @@ virt_viewer_start(VirtViewerApp *app, GError **error)
 
     virSetErrorFunc(NULL, virt_viewer_error_func);
 
-    if (virt_viewer_connect(app, error) < 0)
+    /* show the window right away, the connection progress is reported
+     * in it */
+    if (!VIRT_VIEWER_APP_CLASS(virt_viewer_parent_class)->start(app, error))
         return FALSE;
 
-    return VIRT_VIEWER_APP_CLASS(virt_viewer_parent_class)->start(app, error);
+    virt_viewer_app_show_status(app, _("Connecting to libvirt"));
+    VIRT_VIEWER(app)->priv->initial_lookup = TRUE;
+    virt_viewer_connect_async(VIRT_VIEWER(app), TRUE);
+    virt_viewer_open_profile(VIRT_VIEWER(app));
+
+    return TRUE;
 }
 
 VirtViewer *
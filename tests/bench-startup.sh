@@ -0,0 +1,54 @@
+#!/bin/sh
+#
+# Measures the time remote-viewer takes from main() to its first
+# connection attempt, as recorded by its --timeline output.
+#
+# Usage: bench-startup.sh REMOTE-VIEWER [RUNS]
+
+viewer=$1
+runs=${2:-10}
+
+if [ ! -x "$viewer" ]; then
+    echo "$viewer not found, build it first" >&2
+    exit 1
+fi
+
+if [ -z "$DISPLAY" ] && [ -z "$WAYLAND_DISPLAY" ]; then
+    if command -v xvfb-run >/dev/null 2>&1; then
+        exec xvfb-run -a "$0" "$@"
+    fi
+    echo "no display to run $viewer on" >&2
+    exit 77
+fi
+
+dir=$(mktemp -d) || exit 1
+trap 'rm -rf "$dir"' EXIT
+
+i=0
+while [ $i -lt "$runs" ]; do
+    mkfifo "$dir/timeline" || exit 1
+
+    # nothing listens there, the connection attempt is all we wait for
+    "$viewer" --timeline="$dir/timeline" spice://127.0.0.1:1 >/dev/null 2>&1 &
+    pid=$!
+
+    ts=$(awk -F'[:,]' '/"stage":"initial-connect"/ { print $2; exit }' < "$dir/timeline")
+
+    kill $pid 2>/dev/null
+    wait $pid 2>/dev/null
+    rm -f "$dir/timeline"
+
+    if [ -z "$ts" ]; then
+        echo "$viewer did not record a connection attempt" >&2
+        exit 1
+    fi
+    echo "$ts" >> "$dir/times"
+    i=$((i + 1))
+done
+
+sort -n "$dir/times" | awk '
+    { t[NR] = $1 }
+    END {
+        printf "main() to first connection attempt: min %.1f ms, median %.1f ms, max %.1f ms (%d runs)\n",
+               t[1] / 1000, t[int((NR + 1) / 2)] / 1000, t[NR] / 1000, NR
+    }'
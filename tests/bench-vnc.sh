@@ -0,0 +1,108 @@
+#!/bin/sh
+#
+# Connects remote-viewer to fake-vnc-server over a UNIX socket and
+# reports the time to connect, the time to the first frame, the frame
+# throughput and the growth of the viewer memory while it is updating.
+#
+# Usage: bench-vnc.sh REMOTE-VIEWER FAKE-VNC-SERVER [SECONDS]
+
+viewer=$1
+server=$2
+seconds=${3:-10}
+
+for prog in "$viewer" "$server"; do
+    if [ ! -x "$prog" ]; then
+        echo "$prog not found, build it first" >&2
+        exit 1
+    fi
+done
+
+if [ -z "$DISPLAY" ] && [ -z "$WAYLAND_DISPLAY" ] && [ -z "$BENCH_VNC_BROADWAY" ]; then
+    if command -v broadwayd >/dev/null 2>&1; then
+        broadwayd :5 >/dev/null 2>&1 &
+        broadway=$!
+        trap 'kill $broadway 2>/dev/null' EXIT
+        sleep 1
+        BENCH_VNC_BROADWAY=1 GDK_BACKEND=broadway BROADWAY_DISPLAY=:5 "$0" "$@"
+        exit $?
+    fi
+    if command -v xvfb-run >/dev/null 2>&1; then
+        exec xvfb-run -a "$0" "$@"
+    fi
+    echo "no display to run $viewer on" >&2
+    exit 77
+fi
+
+dir=$(mktemp -d) || exit 1
+trap 'rm -rf "$dir"' EXIT
+
+rss() {
+    awk '/^VmRSS:/ { print $2 }' "/proc/$1/status" 2>/dev/null
+}
+
+# waits up to 30s for a stage in the timeline, prints its timestamp
+stage() {
+    i=0
+    while [ $i -lt 300 ]; do
+        ts=$(awk -F'[:,]' '/"stage":"'"$1"'"/ { print $2; exit }' "$dir/timeline" 2>/dev/null)
+        if [ -n "$ts" ]; then
+            echo "$ts"
+            return 0
+        fi
+        kill -0 $pid 2>/dev/null || return 1
+        sleep 0.1
+        i=$((i + 1))
+    done
+    return 1
+}
+
+"$server" --socket="$dir/vnc.sock" --duration="$seconds" > "$dir/server" &
+server_pid=$!
+while [ ! -S "$dir/vnc.sock" ]; do
+    if ! kill -0 $server_pid 2>/dev/null; then
+        echo "$server failed to start" >&2
+        exit 1
+    fi
+    sleep 0.1
+done
+
+"$viewer" --timeline="$dir/timeline" "vnc+unix://$dir/vnc.sock" >/dev/null 2>&1 &
+pid=$!
+
+connected=$(stage session-connected)
+first_frame=$(stage first-frame)
+if [ -z "$connected" ] || [ -z "$first_frame" ]; then
+    echo "$viewer did not display the fake server" >&2
+    kill $pid $server_pid 2>/dev/null
+    exit 1
+fi
+rss_start=$(rss $pid)
+
+wait $server_pid
+status=$?
+rss_end=$(rss $pid)
+kill $pid 2>/dev/null
+wait $pid 2>/dev/null
+
+if [ $status -ne 0 ] || [ -z "$rss_start" ] || [ -z "$rss_end" ]; then
+    echo "the connection was lost before the end of the run" >&2
+    exit 1
+fi
+
+awk -v connected="$connected" -v first_frame="$first_frame" \
+    -v rss_start="$rss_start" -v rss_end="$rss_end" '
+    {
+        for (i = 1; i <= NF; i++) {
+            split($i, kv, "=")
+            v[kv[1]] = kv[2]
+        }
+    }
+    END {
+        printf "time to connect: %.1f ms\n", connected / 1000
+        printf "time to first frame: %.1f ms\n", first_frame / 1000
+        printf "throughput: %.1f frames/s, %.1f MiB/s (%d frames in %.1f s)\n",
+               v["frames"] / v["seconds"], v["bytes"] / v["seconds"] / 1048576,
+               v["frames"], v["seconds"]
+        printf "RSS: %d KiB after the first frame, %d KiB at the end (%+d KiB)\n",
+               rss_start, rss_end, rss_end - rss_start
+    }' "$dir/server"
@@ -0,0 +1,482 @@
+/* -*- Mode: C; c-basic-offset: 4; indent-tabs-mode: nil -*- */
+/*
+ * Virt Viewer: A virtual machine console viewer
+ *
+ * Copyright (C) 2016 Red Hat, Inc.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+/*
+ * A stand-in VNC server for benchmarking the viewer: it accepts a single
+ * client at a time on a UNIX socket, without authentication, and answers
+ * each framebuffer update request with a raw encoded update, as fast as
+ * the client asks for them. The pattern moves at each update so that
+ * every frame differs from the previous one. Each connection is closed
+ * after the given number of seconds from its first update, as a guest
+ * reboot would, and the totals are printed once all the connections
+ * were served.
+ */
+
+#include <config.h>
+#include <glib.h>
+#include <glib/gstdio.h>
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+
+typedef struct {
+    guint8 bpp;
+    guint8 depth;
+    guint8 big_endian;
+    guint8 true_color;
+    guint16 max[3];  /* red, green, blue */
+    guint8 shift[3];
+} PixelFormat;
+
+typedef struct {
+    int fd;
+    guint width;
+    guint height;
+    guint square;
+    PixelFormat format;
+    guint8 *buffer;
+    gsize buffer_size;
+
+    guint frames;
+    guint64 bytes;
+    guint connection_frames;
+    gint64 first_frame;  /* of the current connection */
+} FakeServer;
+
+static gboolean
+read_all(int fd, void *data, gsize len)
+{
+    guint8 *p = data;
+
+    while (len > 0) {
+        gssize n = read(fd, p, len);
+
+        if (n < 0 && errno == EINTR)
+            continue;
+        if (n <= 0)
+            return FALSE;
+        p += n;
+        len -= n;
+    }
+
+    return TRUE;
+}
+
+static gboolean
+write_all(int fd, const void *data, gsize len)
+{
+    const guint8 *p = data;
+
+    while (len > 0) {
+        gssize n = write(fd, p, len);
+
+        if (n < 0 && errno == EINTR)
+            continue;
+        if (n <= 0)
+            return FALSE;
+        p += n;
+        len -= n;
+    }
+
+    return TRUE;
+}
+
+static void
+put_u16(guint8 *p, guint16 v)
+{
+    p[0] = v >> 8;
+    p[1] = v;
+}
+
+static void
+put_u32(guint8 *p, guint32 v)
+{
+    p[0] = v >> 24;
+    p[1] = v >> 16;
+    p[2] = v >> 8;
+    p[3] = v;
+}
+
+static guint16
+get_u16(const guint8 *p)
+{
+    return (p[0] << 8) | p[1];
+}
+
+static guint32
+get_u32(const guint8 *p)
+{
+    return ((guint32)p[0] << 24) | (p[1] << 16) | (p[2] << 8) | p[3];
+}
+
+static void
+format_to_wire(const PixelFormat *format, guint8 *p)
+{
+    memset(p, 0, 16);
+    p[0] = format->bpp;
+    p[1] = format->depth;
+    p[2] = format->big_endian;
+    p[3] = format->true_color;
+    put_u16(p + 4, format->max[0]);
+    put_u16(p + 6, format->max[1]);
+    put_u16(p + 8, format->max[2]);
+    p[10] = format->shift[0];
+    p[11] = format->shift[1];
+    p[12] = format->shift[2];
+}
+
+static void
+format_from_wire(PixelFormat *format, const guint8 *p)
+{
+    format->bpp = p[0];
+    format->depth = p[1];
+    format->big_endian = p[2];
+    format->true_color = p[3];
+    format->max[0] = get_u16(p + 4);
+    format->max[1] = get_u16(p + 6);
+    format->max[2] = get_u16(p + 8);
+    format->shift[0] = p[10];
+    format->shift[1] = p[11];
+    format->shift[2] = p[12];
+}
+
+/* Writes the 8-bit per channel color @rgb in the client pixel format */
+static guint8 *
+put_pixel(const PixelFormat *format, guint8 *p, guint32 rgb)
+{
+    guint32 pixel = 0;
+    guint i, bytes = format->bpp / 8;
+
+    for (i = 0; i < 3; i++) {
+        guint32 channel = (rgb >> (16 - 8 * i)) & 0xff;
+
+        pixel |= (channel * format->max[i] / 255) << format->shift[i];
+    }
+
+    for (i = 0; i < bytes; i++) {
+        guint byte = format->big_endian ? bytes - 1 - i : i;
+
+        p[i] = pixel >> (8 * byte);
+    }
+
+    return p + bytes;
+}
+
+static gboolean
+server_handshake(FakeServer *server)
+{
+    guint8 version[12], buf[24 + 32];
+    const gchar *name = "virt-viewer fake server";
+    guint minor;
+
+    if (!write_all(server->fd, "RFB 003.008\n", 12) ||
+        !read_all(server->fd, version, sizeof(version)))
+        return FALSE;
+
+    if (memcmp(version, "RFB 003.", 8) != 0) {
+        g_printerr("Unsupported client version %.12s\n", version);
+        return FALSE;
+    }
+    minor = atoi((const gchar *)version + 8);
+
+    if (minor >= 7) {
+        guint8 types[2] = { 1, 1 /* None */ };
+        guint8 type;
+
+        if (!write_all(server->fd, types, sizeof(types)) ||
+            !read_all(server->fd, &type, 1) ||
+            type != 1)
+            return FALSE;
+        if (minor >= 8) {
+            put_u32(buf, 0);
+            if (!write_all(server->fd, buf, 4))
+                return FALSE;
+        }
+    } else {
+        put_u32(buf, 1);
+        if (!write_all(server->fd, buf, 4))
+            return FALSE;
+    }
+
+    /* ClientInit, the shared flag does not matter */
+    if (!read_all(server->fd, buf, 1))
+        return FALSE;
+
+    put_u16(buf, server->width);
+    put_u16(buf + 2, server->height);
+    format_to_wire(&server->format, buf + 4);
+    put_u32(buf + 20, strlen(name));
+    memcpy(buf + 24, name, strlen(name));
+
+    return write_all(server->fd, buf, 24 + strlen(name));
+}
+
+/* Where the moving square is at the given frame */
+static void
+square_position(FakeServer *server, guint frame, guint *x, guint *y)
+{
+    *x = frame * 8 % (server->width - server->square + 1);
+    *y = frame * 4 % (server->height - server->square + 1);
+}
+
+static guint32
+pattern_color(FakeServer *server, guint x, guint y, guint sx, guint sy)
+{
+    if (x >= sx && x < sx + server->square && y >= sy && y < sy + server->square)
+        return 0xffffff - ((server->frames * 0x010203) & 0xffffff);
+
+    return ((x * 255 / server->width) << 16) | ((y * 255 / server->height) << 8) | 0x40;
+}
+
+static gboolean
+server_send_update(FakeServer *server, gboolean incremental)
+{
+    guint bytes = server->format.bpp / 8;
+    guint x, y, sx, sy, rx, ry, width, height;
+    gsize size;
+    guint8 *p;
+
+    square_position(server, server->frames, &sx, &sy);
+
+    /* the whole screen, or the area covering the square at its previous
+     * and current positions */
+    if (incremental && server->frames > 0) {
+        guint px, py;
+
+        square_position(server, server->frames - 1, &px, &py);
+        rx = MIN(px, sx);
+        ry = MIN(py, sy);
+        width = MAX(px, sx) + server->square - rx;
+        height = MAX(py, sy) + server->square - ry;
+    } else {
+        rx = ry = 0;
+        width = server->width;
+        height = server->height;
+    }
+
+    size = 16 + (gsize)width * height * bytes;
+    if (size > server->buffer_size) {
+        server->buffer = g_realloc(server->buffer, size);
+        server->buffer_size = size;
+    }
+
+    p = server->buffer;
+    p[0] = 0; /* FramebufferUpdate */
+    p[1] = 0;
+    put_u16(p + 2, 1);
+    put_u16(p + 4, rx);
+    put_u16(p + 6, ry);
+    put_u16(p + 8, width);
+    put_u16(p + 10, height);
+    put_u32(p + 12, 0); /* Raw */
+    p += 16;
+
+    for (y = ry; y < ry + height; y++)
+        for (x = rx; x < rx + width; x++)
+            p = put_pixel(&server->format, p, pattern_color(server, x, y, sx, sy));
+
+    if (!write_all(server->fd, server->buffer, size))
+        return FALSE;
+
+    if (server->connection_frames == 0)
+        server->first_frame = g_get_monotonic_time();
+    server->connection_frames++;
+    server->frames++;
+    server->bytes += size;
+
+    return TRUE;
+}
+
+static gboolean
+server_run(FakeServer *server, gint64 duration)
+{
+    guint8 type, buf[20];
+
+    for (;;) {
+        if (server->connection_frames > 0 &&
+            g_get_monotonic_time() - server->first_frame >= duration)
+            return TRUE;
+
+        if (!read_all(server->fd, &type, 1))
+            return FALSE;
+
+        switch (type) {
+        case 0: /* SetPixelFormat */
+            if (!read_all(server->fd, buf, 19))
+                return FALSE;
+            format_from_wire(&server->format, buf + 3);
+            if (!server->format.true_color ||
+                (server->format.bpp != 8 && server->format.bpp != 16 &&
+                 server->format.bpp != 32)) {
+                g_printerr("Unsupported pixel format, %u bpp\n", server->format.bpp);
+                return FALSE;
+            }
+            break;
+        case 2: { /* SetEncodings */
+            guint n;
+
+            if (!read_all(server->fd, buf, 3))
+                return FALSE;
+            /* only raw is ever used */
+            for (n = get_u16(buf + 1); n > 0; n--)
+                if (!read_all(server->fd, buf, 4))
+                    return FALSE;
+            break;
+        }
+        case 3: /* FramebufferUpdateRequest */
+            if (!read_all(server->fd, buf, 9) ||
+                !server_send_update(server, buf[0]))
+                return FALSE;
+            break;
+        case 4: /* KeyEvent */
+            if (!read_all(server->fd, buf, 7))
+                return FALSE;
+            break;
+        case 5: /* PointerEvent */
+            if (!read_all(server->fd, buf, 5))
+                return FALSE;
+            break;
+        case 6: { /* ClientCutText */
+            guint32 len;
+            guint8 c;
+
+            if (!read_all(server->fd, buf, 7))
+                return FALSE;
+            for (len = get_u32(buf + 3); len > 0; len--)
+                if (!read_all(server->fd, &c, 1))
+                    return FALSE;
+            break;
+        }
+        default:
+            g_printerr("Unsupported client message %u\n", type);
+            return FALSE;
+        }
+    }
+}
+
+static int
+server_listen(const gchar *path)
+{
+    struct sockaddr_un addr;
+    int fd;
+
+    if (strlen(path) + 1 > sizeof(addr.sun_path)) {
+        g_printerr("Socket path too long: %s\n", path);
+        return -1;
+    }
+
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    strcpy(addr.sun_path, path);
+
+    fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd < 0 ||
+        bind(fd, (struct sockaddr *)&addr, sizeof(addr)) < 0 ||
+        listen(fd, 1) < 0) {
+        g_printerr("Cannot listen on %s: %s\n", path, g_strerror(errno));
+        if (fd >= 0)
+            close(fd);
+        return -1;
+    }
+
+    return fd;
+}
+
+int main(int argc, char* argv[])
+{
+    FakeServer server = { 0, };
+    gchar *path = NULL;
+    gint width = 1024, height = 768, square = 128;
+    gint connections = 1;
+    gdouble duration = 5;
+    gdouble seconds = 0;
+    gboolean ret = TRUE;
+    GError *error = NULL;
+    GOptionContext *context;
+    int listen_fd, i;
+    const GOptionEntry options[] = {
+        { "socket", 's', 0, G_OPTION_ARG_FILENAME, &path, "Listen on this UNIX socket", "PATH" },
+        { "width", 'w', 0, G_OPTION_ARG_INT, &width, "Width of the screen", "WIDTH" },
+        { "height", 'h', 0, G_OPTION_ARG_INT, &height, "Height of the screen", "HEIGHT" },
+        { "square", 'q', 0, G_OPTION_ARG_INT, &square, "Size of the moving square", "SIZE" },
+        { "duration", 'd', 0, G_OPTION_ARG_DOUBLE, &duration, "Seconds to send updates for, per connection", "SECONDS" },
+        { "connections", 'c', 0, G_OPTION_ARG_INT, &connections, "Number of connections to serve", "N" },
+        { NULL, 0, 0, G_OPTION_ARG_NONE, NULL, NULL, NULL }
+    };
+
+    context = g_option_context_new(NULL);
+    g_option_context_add_main_entries(context, options, NULL);
+    if (!g_option_context_parse(context, &argc, &argv, &error)) {
+        g_printerr("%s\n", error->message);
+        g_clear_error(&error);
+        return 1;
+    }
+    g_option_context_free(context);
+
+    if (path == NULL || width < 16 || height < 16 || width > 8192 || height > 8192 ||
+        square < 1 || square > MIN(width, height) || connections < 1) {
+        g_printerr("Invalid options, see --help\n");
+        return 1;
+    }
+
+    server.width = width;
+    server.height = height;
+    server.square = square;
+
+    listen_fd = server_listen(path);
+    if (listen_fd < 0)
+        return 1;
+
+    for (i = 0; ret && i < connections; i++) {
+        server.fd = accept(listen_fd, NULL, NULL);
+        if (server.fd < 0) {
+            g_printerr("Cannot accept a client: %s\n", g_strerror(errno));
+            ret = FALSE;
+            break;
+        }
+
+        server.format = (PixelFormat) {
+            32, 24, 0, 1, { 255, 255, 255 }, { 16, 8, 0 }
+        };
+        server.connection_frames = 0;
+
+        ret = server_handshake(&server) &&
+            server_run(&server, duration * G_USEC_PER_SEC);
+        if (server.connection_frames > 0)
+            seconds += (g_get_monotonic_time() - server.first_frame) / (gdouble)G_USEC_PER_SEC;
+
+        close(server.fd);
+    }
+
+    close(listen_fd);
+    g_unlink(path);
+    g_free(server.buffer);
+    g_free(path);
+
+    /* for the benchmark script */
+    g_print("connections=%d frames=%u bytes=%" G_GUINT64_FORMAT " seconds=%.3f\n",
+            i, server.frames, server.bytes, seconds);
+
+    return ret ? 0 : 1;
+}
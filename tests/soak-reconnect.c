@@ -0,0 +1,365 @@
+/* -*- Mode: C; c-basic-offset: 4; indent-tabs-mode: nil -*- */
+/*
+ * Virt Viewer: A virtual machine console viewer
+ *
+ * Copyright (C) 2016 Red Hat, Inc.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+/*
+ * Connects to a graphic server again and again, as a viewer started with
+ * --reconnect does across guest reboots, and checks that the sessions,
+ * displays, windows and channels of each connection go away with it and
+ * that the memory use stays bounded. The server is expected to close
+ * each connection after a little while, fake-vnc-server --connections
+ * does that.
+ */
+
+#include <config.h>
+#include <glib.h>
+#include <glib-object.h>
+#include <gtk/gtk.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "virt-viewer-app.h"
+#include "virt-viewer-session.h"
+#include "virt-viewer-util.h"
+#include "virt-viewer-window.h"
+
+G_BEGIN_DECLS
+
+#define VIRT_VIEWER_SOAK_TYPE virt_viewer_soak_get_type()
+#define VIRT_VIEWER_SOAK(obj) (G_TYPE_CHECK_INSTANCE_CAST ((obj), VIRT_VIEWER_SOAK_TYPE, VirtViewerSoak))
+
+typedef struct {
+    VirtViewerApp parent;
+    gchar *type;
+    guint cycles;         /* connections that went away */
+    gint64 rss_start;     /* KiB, after the warm up */
+    GHashTable *live;     /* tracked GObject -> its type name */
+    gboolean failed;
+} VirtViewerSoak;
+
+typedef struct {
+    VirtViewerAppClass parent_class;
+} VirtViewerSoakClass;
+
+GType virt_viewer_soak_get_type (void);
+
+G_DEFINE_TYPE (VirtViewerSoak, virt_viewer_soak, VIRT_VIEWER_TYPE_APP)
+
+G_END_DECLS
+
+static gchar *opt_uri = NULL;
+static gint opt_cycles = 100;
+static gint opt_warmup = 10;
+static gint opt_max_rss_growth = 4096;
+static gint opt_grace = 1000;
+
+/* Returns the resident memory in KiB, or -1 if it isn't known */
+static gint64
+soak_get_rss(void)
+{
+    gchar *status = NULL;
+    const gchar *line;
+    gint64 rss = -1;
+
+    if (!g_file_get_contents("/proc/self/status", &status, NULL, NULL))
+        return -1;
+
+    line = strstr(status, "\nVmRSS:");
+    if (line != NULL)
+        rss = g_ascii_strtoll(line + strlen("\nVmRSS:"), NULL, 10);
+    g_free(status);
+
+    return rss;
+}
+
+static void
+soak_untrack(gpointer data, GObject *where_the_object_was)
+{
+    VirtViewerSoak *self = data;
+
+    g_hash_table_remove(self->live, where_the_object_was);
+}
+
+static void
+soak_track(VirtViewerSoak *self, gpointer object)
+{
+    if (object == NULL || g_hash_table_contains(self->live, object))
+        return;
+
+    g_hash_table_insert(self->live, object, g_strdup(G_OBJECT_TYPE_NAME(object)));
+    g_object_weak_ref(object, soak_untrack, self);
+}
+
+static void
+soak_channel_new(GObject *session G_GNUC_UNUSED,
+                 GObject *channel,
+                 VirtViewerSoak *self)
+{
+    soak_track(self, channel);
+}
+
+static void
+soak_display_added(VirtViewerSession *session G_GNUC_UNUSED,
+                   VirtViewerDisplay *display,
+                   VirtViewerSoak *self)
+{
+    soak_track(self, display);
+}
+
+static void
+soak_connected(VirtViewerSession *session G_GNUC_UNUSED,
+               VirtViewerSoak *self)
+{
+    VirtViewerApp *app = VIRT_VIEWER_APP(self);
+    GList *l;
+
+    /* the main window lives as long as the app */
+    for (l = virt_viewer_app_get_windows(app); l != NULL; l = l->next) {
+        if (l->data != virt_viewer_app_get_main_window(app))
+            soak_track(self, l->data);
+    }
+}
+
+static gboolean
+soak_connect(VirtViewerSoak *self, GError **error)
+{
+    VirtViewerApp *app = VIRT_VIEWER_APP(self);
+    VirtViewerSession *session;
+
+    if (!virt_viewer_app_create_session(app, self->type, error))
+        return FALSE;
+
+    session = virt_viewer_app_get_session(app);
+    soak_track(self, session);
+    g_signal_connect(session, "session-display-added",
+                     G_CALLBACK(soak_display_added), self);
+    g_signal_connect(session, "session-connected",
+                     G_CALLBACK(soak_connected), self);
+
+    /* spice-gtk sessions announce their channels */
+    if (g_object_class_find_property(G_OBJECT_GET_CLASS(session), "spice-session")) {
+        GObject *spice_session = NULL;
+
+        g_object_get(session, "spice-session", &spice_session, NULL);
+        soak_track(self, spice_session);
+        g_signal_connect(spice_session, "channel-new",
+                         G_CALLBACK(soak_channel_new), self);
+        g_object_unref(spice_session);
+    }
+
+    return virt_viewer_app_initial_connect(app, error);
+}
+
+static gboolean
+soak_check(gpointer user_data)
+{
+    VirtViewerSoak *self = user_data;
+    GHashTable *leaks = g_hash_table_new(g_str_hash, g_str_equal);
+    GHashTableIter iter;
+    gpointer type, count;
+    gint64 rss = soak_get_rss();
+
+    g_hash_table_iter_init(&iter, self->live);
+    while (g_hash_table_iter_next(&iter, NULL, &type)) {
+        count = g_hash_table_lookup(leaks, type);
+        g_hash_table_insert(leaks, type, GUINT_TO_POINTER(GPOINTER_TO_UINT(count) + 1));
+    }
+
+    g_hash_table_iter_init(&iter, leaks);
+    while (g_hash_table_iter_next(&iter, &type, &count)) {
+        g_printerr("%u %s leaked\n", GPOINTER_TO_UINT(count), (const gchar *)type);
+        self->failed = TRUE;
+    }
+    g_hash_table_unref(leaks);
+
+    g_print("cycles=%u rss_start=%" G_GINT64_FORMAT " rss_end=%" G_GINT64_FORMAT "\n",
+            self->cycles, self->rss_start, rss);
+    if (self->rss_start >= 0 && rss >= 0 &&
+        rss - self->rss_start > opt_max_rss_growth) {
+        g_printerr("RSS grew by %" G_GINT64_FORMAT " KiB over %d cycles, more than %d KiB\n",
+                   rss - self->rss_start, opt_cycles - opt_warmup, opt_max_rss_growth);
+        self->failed = TRUE;
+    }
+
+    g_application_quit(G_APPLICATION(self));
+
+    return G_SOURCE_REMOVE;
+}
+
+static gboolean
+soak_reconnect(gpointer user_data)
+{
+    VirtViewerSoak *self = user_data;
+    GError *error = NULL;
+
+    if (!soak_connect(self, &error)) {
+        g_printerr("Cycle %u: %s\n", self->cycles + 1, error ? error->message : "failed");
+        g_clear_error(&error);
+        self->failed = TRUE;
+        g_application_quit(G_APPLICATION(self));
+    }
+
+    return G_SOURCE_REMOVE;
+}
+
+static void
+virt_viewer_soak_deactivated(VirtViewerApp *app, gboolean connect_error)
+{
+    VirtViewerSoak *self = VIRT_VIEWER_SOAK(app);
+
+    if (connect_error) {
+        g_printerr("Cycle %u: unable to connect\n", self->cycles + 1);
+        self->failed = TRUE;
+        g_application_quit(G_APPLICATION(app));
+        return;
+    }
+
+    self->cycles++;
+    if (self->cycles == (guint)opt_warmup)
+        self->rss_start = soak_get_rss();
+
+    if (self->cycles < (guint)opt_cycles) {
+        g_idle_add(soak_reconnect, self);
+        return;
+    }
+
+    /* the session of the last connection was just released, let its
+     * channels and widgets finish going away */
+    g_timeout_add(opt_grace, soak_check, self);
+}
+
+static gboolean
+virt_viewer_soak_start(VirtViewerApp *app, GError **error G_GNUC_UNUSED)
+{
+    VirtViewerSoak *self = VIRT_VIEWER_SOAK(app);
+    gchar *transport = NULL;
+    const gchar *unixsock = NULL;
+    GError *err = NULL;
+
+    VIRT_VIEWER_APP_CLASS(virt_viewer_soak_parent_class)->start(app, NULL);
+
+    if (virt_viewer_util_extract_host(opt_uri, &self->type, NULL, &transport, NULL, NULL) < 0 ||
+        self->type == NULL) {
+        g_printerr("Invalid URI %s\n", opt_uri);
+        g_free(transport);
+        self->failed = TRUE;
+        return FALSE;
+    }
+
+    if (g_strcmp0(transport, "unix") == 0 && strstr(opt_uri, "://") != NULL)
+        unixsock = strstr(opt_uri, "://") + strlen("://");
+    virt_viewer_app_set_connect_info(app, NULL, NULL, NULL, NULL, NULL,
+                                     unixsock, NULL, 0, opt_uri);
+    g_free(transport);
+
+    /* errors are reported here rather than in a dialog nobody would close */
+    if (!soak_connect(self, &err)) {
+        g_printerr("%s\n", err ? err->message : "Unable to connect");
+        g_clear_error(&err);
+        self->failed = TRUE;
+        return FALSE;
+    }
+
+    return TRUE;
+}
+
+static void
+virt_viewer_soak_finalize(GObject *object)
+{
+    VirtViewerSoak *self = VIRT_VIEWER_SOAK(object);
+    GHashTableIter iter;
+    gpointer tracked;
+
+    g_hash_table_iter_init(&iter, self->live);
+    while (g_hash_table_iter_next(&iter, &tracked, NULL))
+        g_object_weak_unref(tracked, soak_untrack, self);
+    g_hash_table_unref(self->live);
+    g_free(self->type);
+
+    G_OBJECT_CLASS(virt_viewer_soak_parent_class)->finalize(object);
+}
+
+static void
+virt_viewer_soak_class_init(VirtViewerSoakClass *klass)
+{
+    GObjectClass *object_class = G_OBJECT_CLASS(klass);
+    VirtViewerAppClass *app_class = VIRT_VIEWER_APP_CLASS(klass);
+
+    object_class->finalize = virt_viewer_soak_finalize;
+
+    app_class->start = virt_viewer_soak_start;
+    app_class->deactivated = virt_viewer_soak_deactivated;
+}
+
+static void
+virt_viewer_soak_init(VirtViewerSoak *self)
+{
+    self->rss_start = -1;
+    self->live = g_hash_table_new_full(g_direct_hash, g_direct_equal, NULL, g_free);
+}
+
+int main(int argc, char* argv[])
+{
+    GApplication *app;
+    GOptionContext *context;
+    GError *error = NULL;
+    gchar **args = NULL;
+    gchar *app_argv[] = { argv[0], NULL };
+    int ret;
+    const GOptionEntry options[] = {
+        { "cycles", 'n', 0, G_OPTION_ARG_INT, &opt_cycles, "Number of connections to go through", "N" },
+        { "warmup", 'w', 0, G_OPTION_ARG_INT, &opt_warmup, "Connections before the reference RSS is taken", "N" },
+        { "max-rss-growth", 'm', 0, G_OPTION_ARG_INT, &opt_max_rss_growth, "Allowed RSS growth after the warm up", "KiB" },
+        { "grace", 'g', 0, G_OPTION_ARG_INT, &opt_grace, "Time given to the last connection to go away", "MS" },
+        { G_OPTION_REMAINING, '\0', 0, G_OPTION_ARG_STRING_ARRAY, &args, NULL, "URI" },
+        { NULL, 0, 0, G_OPTION_ARG_NONE, NULL, NULL, NULL }
+    };
+
+    context = g_option_context_new(NULL);
+    g_option_context_add_main_entries(context, options, NULL);
+    if (!g_option_context_parse(context, &argc, &argv, &error)) {
+        g_printerr("%s\n", error->message);
+        g_clear_error(&error);
+        return 1;
+    }
+    g_option_context_free(context);
+
+    if (args == NULL || g_strv_length(args) != 1 ||
+        opt_cycles < 2 || opt_warmup < 1 || opt_warmup >= opt_cycles) {
+        g_printerr("Invalid options, see --help\n");
+        return 1;
+    }
+    opt_uri = args[0];
+
+    virt_viewer_util_init("Reconnect soak test");
+    app = g_object_new(VIRT_VIEWER_SOAK_TYPE,
+                       "application-id", "org.virt-manager.virt-viewer-soak",
+                       "flags", G_APPLICATION_NON_UNIQUE,
+                       NULL);
+
+    ret = g_application_run(app, 1, app_argv);
+    if (VIRT_VIEWER_SOAK(app)->failed)
+        ret = 1;
+
+    g_object_unref(app);
+    g_strfreev(args);
+
+    return ret;
+}
@@ -0,0 +1,51 @@
+#!/bin/sh
+#
+# Goes through CYCLES connections to fake-vnc-server, each of them closed
+# by the server after a moment, and fails if objects of the connections
+# are leaked or if the memory use keeps growing.
+#
+# Usage: soak-reconnect.sh SOAK-RECONNECT FAKE-VNC-SERVER [CYCLES]
+
+soak=$1
+server=$2
+cycles=${3:-100}
+
+for prog in "$soak" "$server"; do
+    if [ ! -x "$prog" ]; then
+        echo "$prog not found, build it first" >&2
+        exit 1
+    fi
+done
+
+if [ -z "$DISPLAY" ] && [ -z "$WAYLAND_DISPLAY" ]; then
+    if command -v xvfb-run >/dev/null 2>&1; then
+        exec xvfb-run -a "$0" "$@"
+    fi
+    echo "no display to run $soak on" >&2
+    exit 77
+fi
+
+dir=$(mktemp -d) || exit 1
+trap 'rm -rf "$dir"' EXIT
+
+"$server" --socket="$dir/vnc.sock" --connections="$cycles" --duration=0.2 \
+          --width=640 --height=480 >/dev/null &
+server_pid=$!
+while [ ! -S "$dir/vnc.sock" ]; do
+    if ! kill -0 $server_pid 2>/dev/null; then
+        echo "$server failed to start" >&2
+        exit 1
+    fi
+    sleep 0.1
+done
+
+warmup=$((cycles / 10))
+[ $warmup -ge 1 ] || warmup=1
+
+"$soak" --cycles="$cycles" --warmup="$warmup" ${SOAK_MAX_RSS_GROWTH:+--max-rss-growth="$SOAK_MAX_RSS_GROWTH"} \
+        "vnc+unix://$dir/vnc.sock"
+status=$?
+
+kill $server_pid 2>/dev/null
+wait $server_pid 2>/dev/null
+exit $status
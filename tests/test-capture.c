@@ -0,0 +1,177 @@
+/* -*- Mode: C; c-basic-offset: 4; indent-tabs-mode: nil -*- */
+/*
+ * Virt Viewer: A virtual machine console viewer
+ *
+ * Copyright (C) 2016 Red Hat, Inc.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#include <config.h>
+#include <glib.h>
+#include <glib/gstdio.h>
+#include <string.h>
+
+#include <virt-viewer-util.h>
+#include <virt-viewer-capture.h>
+
+gboolean doDebug = FALSE;
+
+static GdkPixbuf *
+new_frame(gint width, gint height, guint32 color)
+{
+    GdkPixbuf *pixbuf = gdk_pixbuf_new(GDK_COLORSPACE_RGB, FALSE, 8, width, height);
+
+    gdk_pixbuf_fill(pixbuf, color);
+
+    return pixbuf;
+}
+
+static void
+test_capture_hash(void)
+{
+    GdkPixbuf *frame1 = new_frame(37, 20, 0x102030ff);
+    GdkPixbuf *frame2 = new_frame(37, 20, 0x102030ff);
+    GdkPixbuf *sub;
+    guint64 hash;
+
+    hash = virt_viewer_capture_hash_pixbuf(frame1);
+    g_assert_cmpuint(hash, ==, virt_viewer_capture_hash_pixbuf(frame2));
+
+    /* the row padding is not hashed */
+    g_assert_cmpint(gdk_pixbuf_get_rowstride(frame1), >, 37 * 3);
+    memset(gdk_pixbuf_get_pixels(frame2) + 37 * 3, 0xff,
+           gdk_pixbuf_get_rowstride(frame2) - 37 * 3);
+    g_assert_cmpuint(hash, ==, virt_viewer_capture_hash_pixbuf(frame2));
+
+    /* a single pixel changed, in the bytes not hashed word-wise */
+    gdk_pixbuf_get_pixels(frame2)[37 * 3 - 1] = 0;
+    g_assert_cmpuint(hash, !=, virt_viewer_capture_hash_pixbuf(frame2));
+
+    sub = gdk_pixbuf_new_subpixbuf(frame1, 0, 0, 37, 10);
+    g_assert_cmpuint(hash, !=, virt_viewer_capture_hash_pixbuf(sub));
+
+    g_object_unref(sub);
+    g_object_unref(frame1);
+    g_object_unref(frame2);
+}
+
+static void
+wait_written(VirtViewerCapture *capture, guint expected)
+{
+    guint written = 0;
+
+    for (;;) {
+        virt_viewer_capture_get_stats(capture, &written, NULL);
+        if (written >= expected)
+            break;
+        g_main_context_iteration(NULL, TRUE);
+    }
+    g_assert_cmpuint(written, ==, expected);
+}
+
+static guint
+count_files(const gchar *path, const gchar *prefix)
+{
+    GDir *dir = g_dir_open(path, 0, NULL);
+    const gchar *name;
+    guint n = 0;
+
+    g_assert(dir != NULL);
+    while ((name = g_dir_read_name(dir)) != NULL) {
+        if (g_str_has_prefix(name, prefix))
+            n++;
+    }
+    g_dir_close(dir);
+
+    return n;
+}
+
+static void
+remove_files(const gchar *path)
+{
+    GDir *dir = g_dir_open(path, 0, NULL);
+    const gchar *name;
+
+    g_assert(dir != NULL);
+    while ((name = g_dir_read_name(dir)) != NULL) {
+        gchar *file = g_build_filename(path, name, NULL);
+        g_unlink(file);
+        g_free(file);
+    }
+    g_dir_close(dir);
+    g_rmdir(path);
+}
+
+static void
+test_capture_frames(void)
+{
+    VirtViewerCapture *capture;
+    GdkPixbuf *frame;
+    GError *error = NULL;
+    guint unchanged;
+    gchar *dir;
+    guint i;
+
+    dir = g_dir_make_tmp("virt-viewer-capture-XXXXXX", &error);
+    g_assert_no_error(error);
+
+    capture = virt_viewer_capture_new(dir, 2);
+
+    frame = new_frame(32, 32, 0x000000ff);
+    g_assert(virt_viewer_capture_add_frame(capture, 0, frame));
+    /* still being written */
+    g_assert(!virt_viewer_capture_add_frame(capture, 0, frame));
+    wait_written(capture, 1);
+
+    /* unchanged */
+    g_assert(!virt_viewer_capture_add_frame(capture, 0, frame));
+    virt_viewer_capture_get_stats(capture, NULL, &unchanged);
+    g_assert_cmpuint(unchanged, ==, 1);
+    g_object_unref(frame);
+
+    /* the displays are compared separately */
+    frame = new_frame(32, 32, 0x000000ff);
+    g_assert(virt_viewer_capture_add_frame(capture, 1, frame));
+    wait_written(capture, 2);
+    g_object_unref(frame);
+
+    /* only the latest frames are kept */
+    for (i = 1; i <= 3; i++) {
+        /* the file names have a millisecond resolution */
+        g_usleep(2000);
+        frame = new_frame(32, 32, i << 8 | 0xff);
+        g_assert(virt_viewer_capture_add_frame(capture, 0, frame));
+        wait_written(capture, 2 + i);
+        g_object_unref(frame);
+    }
+
+    g_assert_cmpuint(count_files(dir, "display-0-"), ==, 2);
+    g_assert_cmpuint(count_files(dir, "display-1-"), ==, 1);
+
+    virt_viewer_capture_free(capture);
+    remove_files(dir);
+    g_free(dir);
+}
+
+int main(int argc, char* argv[])
+{
+    g_test_init(&argc, &argv, NULL);
+
+    g_test_add_func("/virt-viewer-util/capture/hash", test_capture_hash);
+    g_test_add_func("/virt-viewer-util/capture/frames", test_capture_frames);
+
+    return g_test_run();
+}
@@ -0,0 +1,156 @@
+/* -*- Mode: C; c-basic-offset: 4; indent-tabs-mode: nil -*- */
+/*
+ * Virt Viewer: A virtual machine console viewer
+ *
+ * Copyright (C) 2016 Red Hat, Inc.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+
+#include <config.h>
+#include <glib.h>
+
+#include <virt-viewer-util.h>
+#include <virt-viewer-connection-profile.h>
+
+gboolean doDebug = FALSE;
+
+static const gchar uuid1[] = "c7a5fdbd-cdaf-9455-926a-d65c16db1809";
+static const gchar uuid2[] = "0c8fc2a8-2d44-46be-9aa1-3d0b3dd8b8a1";
+
+static VirtViewerConnectionProfile *
+make_profile(const gchar *uuid, const gchar *name, const gchar *uri)
+{
+    VirtViewerConnectionProfile *profile = g_new0(VirtViewerConnectionProfile, 1);
+
+    profile->uuid = g_strdup(uuid);
+    profile->name = g_strdup(name);
+    profile->uri = g_strdup(uri);
+    profile->type = g_strdup("spice");
+    profile->ghost = g_strdup("localhost");
+    profile->gport = g_strdup("5900");
+    profile->gtlsport = g_strdup("5901");
+    profile->host = g_strdup("virt.example.com");
+    profile->transport = g_strdup("ssh");
+    profile->user = g_strdup("root");
+    profile->port = 2222;
+
+    return profile;
+}
+
+static void
+test_connection_profile_save(void)
+{
+    GKeyFile *keyfile = g_key_file_new();
+    VirtViewerConnectionProfile *profile, *loaded;
+
+    profile = make_profile(uuid1, "fedora", "qemu+ssh://root@virt.example.com:2222/system");
+    g_assert(virt_viewer_connection_profile_save(profile, keyfile));
+    /* saving it again doesn't modify the settings */
+    g_assert(!virt_viewer_connection_profile_save(profile, keyfile));
+
+    loaded = virt_viewer_connection_profile_load(keyfile, uuid1);
+    g_assert(loaded != NULL);
+    g_assert(virt_viewer_connection_profile_equal(profile, loaded));
+    g_assert_cmpstr(loaded->name, ==, "fedora");
+    g_assert_cmpstr(loaded->uri, ==, "qemu+ssh://root@virt.example.com:2222/system");
+    g_assert_cmpstr(loaded->unixsock, ==, NULL);
+    g_assert_cmpint(loaded->port, ==, 2222);
+    virt_viewer_connection_profile_free(loaded);
+
+    /* the guest now listens on a UNIX socket */
+    g_clear_pointer(&profile->ghost, g_free);
+    g_clear_pointer(&profile->gport, g_free);
+    g_clear_pointer(&profile->gtlsport, g_free);
+    profile->unixsock = g_strdup("/var/run/spice.sock");
+    loaded = virt_viewer_connection_profile_copy(profile);
+    g_assert(virt_viewer_connection_profile_equal(profile, loaded));
+    virt_viewer_connection_profile_free(loaded);
+
+    g_assert(virt_viewer_connection_profile_save(profile, keyfile));
+    loaded = virt_viewer_connection_profile_load(keyfile, uuid1);
+    g_assert(loaded != NULL);
+    g_assert(virt_viewer_connection_profile_equal(profile, loaded));
+    g_assert_cmpstr(loaded->ghost, ==, NULL);
+    g_assert_cmpstr(loaded->gport, ==, NULL);
+    g_assert_cmpstr(loaded->unixsock, ==, "/var/run/spice.sock");
+    virt_viewer_connection_profile_free(loaded);
+
+    /* the other per-guest settings are left alone */
+    g_key_file_set_string(keyfile, uuid1, "monitor-mapping", "1:2");
+    g_assert(virt_viewer_connection_profile_remove(keyfile, uuid1));
+    g_assert(!virt_viewer_connection_profile_remove(keyfile, uuid1));
+    g_assert(virt_viewer_connection_profile_load(keyfile, uuid1) == NULL);
+    g_assert(g_key_file_has_key(keyfile, uuid1, "monitor-mapping", NULL));
+
+    /* without any display address */
+    g_clear_pointer(&profile->unixsock, g_free);
+    g_assert(virt_viewer_connection_profile_save(profile, keyfile));
+    g_assert(virt_viewer_connection_profile_load(keyfile, uuid1) == NULL);
+
+    virt_viewer_connection_profile_free(profile);
+    g_key_file_free(keyfile);
+}
+
+static void
+test_connection_profile_find(void)
+{
+    GKeyFile *keyfile = g_key_file_new();
+    VirtViewerConnectionProfile *profile;
+
+    profile = make_profile(uuid1, "fedora", NULL);
+    virt_viewer_connection_profile_save(profile, keyfile);
+    virt_viewer_connection_profile_free(profile);
+    g_key_file_set_boolean(keyfile, "fallback", "integer-scaling", TRUE);
+
+    profile = virt_viewer_connection_profile_find(keyfile, NULL, "fedora");
+    g_assert(profile != NULL);
+    g_assert_cmpstr(profile->uuid, ==, uuid1);
+    virt_viewer_connection_profile_free(profile);
+
+    profile = virt_viewer_connection_profile_find(keyfile, NULL, "C7A5FDBD-CDAF-9455-926A-D65C16DB1809");
+    g_assert(profile != NULL);
+    g_assert_cmpstr(profile->uuid, ==, uuid1);
+    virt_viewer_connection_profile_free(profile);
+
+    /* another libvirt connection, or another guest */
+    g_assert(virt_viewer_connection_profile_find(keyfile, "qemu:///session", "fedora") == NULL);
+    g_assert(virt_viewer_connection_profile_find(keyfile, NULL, "debian") == NULL);
+    g_assert(virt_viewer_connection_profile_find(keyfile, NULL, "1") == NULL);
+
+    /* the guest was redefined with the same name */
+    profile = make_profile(uuid2, "fedora", NULL);
+    virt_viewer_connection_profile_save(profile, keyfile);
+    virt_viewer_connection_profile_free(profile);
+    g_assert(virt_viewer_connection_profile_find(keyfile, NULL, "fedora") == NULL);
+
+    profile = virt_viewer_connection_profile_find(keyfile, NULL, uuid2);
+    g_assert(profile != NULL);
+    g_assert_cmpstr(profile->uuid, ==, uuid2);
+    virt_viewer_connection_profile_free(profile);
+
+    g_key_file_free(keyfile);
+}
+
+int main(int argc, char* argv[])
+{
+    g_test_init(&argc, &argv, NULL);
+
+    g_test_add_func("/virt-viewer-util/connection-profile/save", test_connection_profile_save);
+    g_test_add_func("/virt-viewer-util/connection-profile/find", test_connection_profile_find);
+
+    return g_test_run();
+}
@@ -0,0 +1,167 @@
+/* -*- Mode: C; c-basic-offset: 4; indent-tabs-mode: nil -*- */
+/*
+ * Virt Viewer: A virtual machine console viewer
+ *
+ * Copyright (C) 2016 Red Hat, Inc.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#include <config.h>
+#include <glib.h>
+
+#include <virt-viewer-util.h>
+#include <virt-viewer-frame-stats.h>
+
+gboolean doDebug = FALSE;
+
+#define MS(x) ((gint64)(x) * 1000)
+
+static void
+test_frame_stats_fps(void)
+{
+    VirtViewerFrameStats *stats = virt_viewer_frame_stats_new();
+    gint64 now = G_USEC_PER_SEC;
+    guint i;
+
+    g_assert_cmpfloat(virt_viewer_frame_stats_get_fps(stats, now), ==, 0);
+
+    /* 25 frames 40ms apart */
+    for (i = 0; i < 25; i++) {
+        virt_viewer_frame_stats_add_frame(stats, now);
+        now += MS(40);
+    }
+    g_assert_cmpfloat(virt_viewer_frame_stats_get_fps(stats, now - MS(40)), ==, 25);
+
+    /* the guest stopped drawing */
+    g_assert_cmpfloat(virt_viewer_frame_stats_get_fps(stats, now + MS(2000)), ==, 0);
+
+    /* more frames than remembered */
+    for (i = 0; i < 1000; i++) {
+        virt_viewer_frame_stats_add_frame(stats, now);
+        now += 100;
+    }
+    g_assert_cmpfloat(virt_viewer_frame_stats_get_fps(stats, now), ==, 512);
+
+    virt_viewer_frame_stats_free(stats);
+}
+
+static void
+test_frame_stats_histogram(void)
+{
+    VirtViewerFrameStats *stats = virt_viewer_frame_stats_new();
+    const guint *histogram;
+    const guint intervals[] = { 10, 16, 20, 40, 60, 99, 200, 1000 };
+    const guint expected[VIRT_VIEWER_FRAME_STATS_N_BUCKETS] = { 1, 2, 1, 2, 1, 1 };
+    gint64 now = G_USEC_PER_SEC;
+    guint i;
+
+    virt_viewer_frame_stats_add_frame(stats, now);
+    for (i = 0; i < G_N_ELEMENTS(intervals); i++) {
+        now += MS(intervals[i]);
+        virt_viewer_frame_stats_add_frame(stats, now);
+    }
+
+    histogram = virt_viewer_frame_stats_get_histogram(stats);
+    for (i = 0; i < VIRT_VIEWER_FRAME_STATS_N_BUCKETS; i++)
+        g_assert_cmpuint(histogram[i], ==, expected[i]);
+
+    g_assert_cmpuint(virt_viewer_frame_stats_get_bucket_limit(0), ==, 16);
+    g_assert_cmpuint(virt_viewer_frame_stats_get_bucket_limit(VIRT_VIEWER_FRAME_STATS_N_BUCKETS - 1), ==, G_MAXUINT);
+
+    virt_viewer_frame_stats_reset(stats);
+    histogram = virt_viewer_frame_stats_get_histogram(stats);
+    for (i = 0; i < VIRT_VIEWER_FRAME_STATS_N_BUCKETS; i++)
+        g_assert_cmpuint(histogram[i], ==, 0);
+
+    virt_viewer_frame_stats_free(stats);
+}
+
+static void
+test_frame_stats_latency(void)
+{
+    VirtViewerFrameStats *stats = virt_viewer_frame_stats_new();
+    gdouble last, average, max;
+
+    g_assert(!virt_viewer_frame_stats_get_latency(stats, &last, &average, &max));
+
+    /* a frame without key press does not count */
+    virt_viewer_frame_stats_add_frame(stats, MS(1000));
+    g_assert(!virt_viewer_frame_stats_get_latency(stats, &last, &average, &max));
+
+    /* only the first of the key presses before a frame is measured */
+    virt_viewer_frame_stats_key_press(stats, MS(2000));
+    virt_viewer_frame_stats_key_press(stats, MS(2030));
+    virt_viewer_frame_stats_add_frame(stats, MS(2060));
+    g_assert(virt_viewer_frame_stats_get_latency(stats, &last, &average, &max));
+    g_assert_cmpfloat(last, ==, 60);
+    g_assert_cmpfloat(average, ==, 60);
+    g_assert_cmpfloat(max, ==, 60);
+
+    virt_viewer_frame_stats_key_press(stats, MS(3000));
+    virt_viewer_frame_stats_add_frame(stats, MS(3020));
+    virt_viewer_frame_stats_add_frame(stats, MS(3040));
+    g_assert(virt_viewer_frame_stats_get_latency(stats, &last, &average, &max));
+    g_assert_cmpfloat(last, ==, 20);
+    g_assert_cmpfloat(average, ==, 40);
+    g_assert_cmpfloat(max, ==, 60);
+
+    virt_viewer_frame_stats_free(stats);
+}
+
+static void
+test_frame_stats_bytes(void)
+{
+    VirtViewerFrameStats *stats = virt_viewer_frame_stats_new();
+    gchar *text;
+
+    g_assert_cmpfloat(virt_viewer_frame_stats_get_byte_rate(stats), <, 0);
+    text = virt_viewer_frame_stats_format(stats, MS(1000));
+    g_assert(g_str_has_suffix(text, "rx n/a"));
+    g_free(text);
+
+    virt_viewer_frame_stats_set_bytes(stats, 1000, MS(1000));
+    g_assert_cmpfloat(virt_viewer_frame_stats_get_byte_rate(stats), ==, 0);
+
+    /* too close to the previous sample */
+    virt_viewer_frame_stats_set_bytes(stats, 2000, MS(1100));
+    g_assert_cmpfloat(virt_viewer_frame_stats_get_byte_rate(stats), ==, 0);
+
+    virt_viewer_frame_stats_set_bytes(stats, 1000 + 2048, MS(2000));
+    g_assert_cmpfloat(virt_viewer_frame_stats_get_byte_rate(stats), ==, 2048);
+    text = virt_viewer_frame_stats_format(stats, MS(2000));
+    g_assert(g_str_has_suffix(text, "rx 2.0 KiB/s"));
+    g_free(text);
+
+    /* the channels were reconnected */
+    virt_viewer_frame_stats_set_bytes(stats, 10, MS(3000));
+    g_assert_cmpfloat(virt_viewer_frame_stats_get_byte_rate(stats), ==, 2048);
+    virt_viewer_frame_stats_set_bytes(stats, 10 + 1024, MS(4000));
+    g_assert_cmpfloat(virt_viewer_frame_stats_get_byte_rate(stats), ==, 1024);
+
+    virt_viewer_frame_stats_free(stats);
+}
+
+int main(int argc, char* argv[])
+{
+    g_test_init(&argc, &argv, NULL);
+
+    g_test_add_func("/virt-viewer-util/frame-stats/fps", test_frame_stats_fps);
+    g_test_add_func("/virt-viewer-util/frame-stats/histogram", test_frame_stats_histogram);
+    g_test_add_func("/virt-viewer-util/frame-stats/latency", test_frame_stats_latency);
+    g_test_add_func("/virt-viewer-util/frame-stats/bytes", test_frame_stats_bytes);
+
+    return g_test_run();
+}
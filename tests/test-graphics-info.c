@@ -0,0 +1,170 @@
+/* -*- Mode: C; c-basic-offset: 4; indent-tabs-mode: nil -*- */
+/*
+ * Virt Viewer: A virtual machine console viewer
+ *
+ * Copyright (C) 2016 Red Hat, Inc.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#include <config.h>
+#include <glib.h>
+
+#include <virt-viewer-util.h>
+#include <virt-viewer-graphics-info.h>
+
+gboolean doDebug = FALSE;
+
+typedef struct {
+    const gchar *xml;
+    const gchar *type;
+    const gchar *port;
+    const gchar *tls_port;
+    const gchar *listen;
+    const gchar *socket;
+} TestCase;
+
+static const TestCase test_cases[] = {
+    {
+        "<domain><devices>"
+        "<graphics type='spice' port='5900' tlsPort='5901' autoport='yes'>"
+        "<listen type='address' address='192.168.1.10'/>"
+        "</graphics>"
+        "</devices></domain>",
+        "spice", "5900", "5901", "192.168.1.10", NULL
+    }, {
+        /* legacy listen attribute */
+        "<domain><devices>"
+        "<graphics type='vnc' port='5902' listen='10.0.0.1'/>"
+        "</devices></domain>",
+        "vnc", "5902", NULL, "10.0.0.1", NULL
+    }, {
+        /* the listen element wins over the legacy attribute */
+        "<domain><devices>"
+        "<graphics type='vnc' port='5902' listen='10.0.0.1'>"
+        "<listen type='address' address='10.0.0.2'/>"
+        "</graphics>"
+        "</devices></domain>",
+        "vnc", "5902", NULL, "10.0.0.2", NULL
+    }, {
+        /* unix socket, inactive domain ports */
+        "<domain><devices>"
+        "<graphics type='spice' port='-1' tlsPort='-1' autoport='yes'>"
+        "<listen type='socket' socket='/var/run/spice.sock'/>"
+        "</graphics>"
+        "</devices></domain>",
+        "spice", NULL, NULL, NULL, "/var/run/spice.sock"
+    }, {
+        "<domain><devices>"
+        "<graphics type='vnc' socket='/var/run/vnc.sock'/>"
+        "</devices></domain>",
+        "vnc", NULL, NULL, NULL, "/var/run/vnc.sock"
+    }, {
+        /* the first graphics element decides the type */
+        "<domain><devices>"
+        "<disk type='file'/>"
+        "<graphics type='vnc' port='5903'/>"
+        "<graphics type='spice' port='5904' tlsPort='5905'/>"
+        "<graphics type='vnc' port='5906' listen='::1'/>"
+        "</devices></domain>",
+        "vnc", "5903", NULL, "::1", NULL
+    }, {
+        "<domain><devices><disk type='file'/></devices></domain>",
+        NULL, NULL, NULL, NULL, NULL
+    }, {
+        "<domain><devices><graphics type=''/></devices></domain>",
+        NULL, NULL, NULL, NULL, NULL
+    }, {
+        "<domain><devices><graphics",
+        NULL, NULL, NULL, NULL, NULL
+    },
+};
+
+static void
+test_graphics_info_parse(void)
+{
+    guint i;
+
+    for (i = 0; i < G_N_ELEMENTS(test_cases); i++) {
+        const TestCase *test = &test_cases[i];
+        VirtViewerGraphicsInfo *info;
+
+        /* libxml2 complains loudly about the invalid document */
+        info = virt_viewer_graphics_info_parse(test->xml);
+        if (test->type == NULL) {
+            g_assert(info == NULL);
+            continue;
+        }
+
+        g_assert(info != NULL);
+        g_assert_cmpstr(info->type, ==, test->type);
+        g_assert_cmpstr(info->port, ==, test->port);
+        g_assert_cmpstr(info->tls_port, ==, test->tls_port);
+        g_assert_cmpstr(info->listen, ==, test->listen);
+        g_assert_cmpstr(info->socket, ==, test->socket);
+        virt_viewer_graphics_info_free(info);
+    }
+}
+
+static void
+test_graphics_info_cache(void)
+{
+    VirtViewerGraphicsInfoCache *cache = virt_viewer_graphics_info_cache_new();
+    const gchar *uuid = "c7a5fdbd-cdaf-9455-926a-d65c16db1809";
+    VirtViewerGraphicsInfo *info;
+
+    info = virt_viewer_graphics_info_cache_get(cache, uuid, test_cases[0].xml);
+    g_assert(info != NULL);
+    g_assert_cmpstr(info->port, ==, "5900");
+    virt_viewer_graphics_info_free(info);
+
+    /* unchanged XML, served from the cache */
+    info = virt_viewer_graphics_info_cache_get(cache, uuid, test_cases[0].xml);
+    g_assert(info != NULL);
+    g_assert_cmpstr(info->type, ==, "spice");
+    g_assert_cmpstr(info->port, ==, "5900");
+    g_assert_cmpstr(info->tls_port, ==, "5901");
+    g_assert_cmpstr(info->listen, ==, "192.168.1.10");
+    virt_viewer_graphics_info_free(info);
+
+    /* the domain was redefined */
+    info = virt_viewer_graphics_info_cache_get(cache, uuid, test_cases[1].xml);
+    g_assert(info != NULL);
+    g_assert_cmpstr(info->type, ==, "vnc");
+    g_assert_cmpstr(info->port, ==, "5902");
+    virt_viewer_graphics_info_free(info);
+
+    /* and lost its graphics */
+    info = virt_viewer_graphics_info_cache_get(cache, uuid, test_cases[6].xml);
+    g_assert(info == NULL);
+
+    /* no uuid, no caching */
+    info = virt_viewer_graphics_info_cache_get(cache, NULL, test_cases[3].xml);
+    g_assert(info != NULL);
+    g_assert_cmpstr(info->socket, ==, "/var/run/spice.sock");
+    virt_viewer_graphics_info_free(info);
+
+    virt_viewer_graphics_info_cache_free(cache);
+}
+
+int main(int argc, char* argv[])
+{
+    g_test_init(&argc, &argv, NULL);
+
+    g_test_add_func("/virt-viewer-util/graphics-info/parse", test_graphics_info_parse);
+    g_test_add_func("/virt-viewer-util/graphics-info/cache", test_graphics_info_cache);
+
+    return g_test_run();
+}
@@ -0,0 +1,217 @@
+/* -*- Mode: C; c-basic-offset: 4; indent-tabs-mode: nil -*- */
+/*
+ * Virt Viewer: A virtual machine console viewer
+ *
+ * Copyright (C) 2016 Red Hat, Inc.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#include <config.h>
+#include <gio/gio.h>
+
+#include <virt-viewer-util.h>
+#include <virt-viewer-happy-eyeballs.h>
+
+gboolean doDebug = FALSE;
+
+static GList *
+make_addresses(const gchar *const *strs)
+{
+    GList *addresses = NULL;
+
+    for (; *strs != NULL; strs++)
+        addresses = g_list_append(addresses, g_inet_address_new_from_string(*strs));
+
+    return addresses;
+}
+
+static void
+check_addresses(GList *addresses, const gchar *const *expected)
+{
+    GList *l;
+
+    for (l = addresses; l != NULL; l = l->next, expected++) {
+        gchar *str = g_inet_address_to_string(l->data);
+
+        g_assert(*expected != NULL);
+        g_assert_cmpstr(str, ==, *expected);
+        g_free(str);
+    }
+    g_assert(*expected == NULL);
+}
+
+static void
+test_happy_eyeballs_sort(void)
+{
+    const gchar *input[] = {
+        "2001:db8::1", "2001:db8::2", "2001:db8::3", "192.0.2.1", "192.0.2.2", NULL
+    };
+    const gchar *expected[] = {
+        "2001:db8::1", "192.0.2.1", "2001:db8::2", "192.0.2.2", "2001:db8::3", NULL
+    };
+    const gchar *input4[] = {
+        "192.0.2.1", "2001:db8::1", "192.0.2.2", NULL
+    };
+    const gchar *expected4[] = {
+        "192.0.2.1", "2001:db8::1", "192.0.2.2", NULL
+    };
+    GList *addresses;
+
+    addresses = virt_viewer_happy_eyeballs_sort_addresses(make_addresses(input));
+    check_addresses(addresses, expected);
+    g_resolver_free_addresses(addresses);
+
+    addresses = virt_viewer_happy_eyeballs_sort_addresses(make_addresses(input4));
+    check_addresses(addresses, expected4);
+    g_resolver_free_addresses(addresses);
+
+    g_assert(virt_viewer_happy_eyeballs_sort_addresses(NULL) == NULL);
+}
+
+typedef struct {
+    GMainLoop *loop;
+    GSocketConnection *conn;
+    GError *error;
+} ConnectResult;
+
+static void
+connect_done(GObject *source G_GNUC_UNUSED,
+             GAsyncResult *result,
+             gpointer user_data)
+{
+    ConnectResult *res = user_data;
+
+    res->conn = virt_viewer_happy_eyeballs_connect_finish(result, &res->error);
+    g_main_loop_quit(res->loop);
+}
+
+static void
+connect_and_wait(const gchar *host, guint16 port, gboolean race_only, ConnectResult *res)
+{
+    res->loop = g_main_loop_new(NULL, FALSE);
+    res->conn = NULL;
+    res->error = NULL;
+
+    virt_viewer_happy_eyeballs_connect_async(host, port, race_only, NULL, connect_done, res);
+    g_main_loop_run(res->loop);
+    g_main_loop_unref(res->loop);
+}
+
+static guint16
+listen_loopback(GSocketListener **listener)
+{
+    GInetAddress *loopback = g_inet_address_new_loopback(G_SOCKET_FAMILY_IPV4);
+    GSocketAddress *address = g_inet_socket_address_new(loopback, 0);
+    GSocketAddress *effective = NULL;
+    GError *error = NULL;
+    guint16 port;
+
+    *listener = g_socket_listener_new();
+    g_socket_listener_add_address(*listener, address,
+                                  G_SOCKET_TYPE_STREAM, G_SOCKET_PROTOCOL_TCP,
+                                  NULL, &effective, &error);
+    g_assert_no_error(error);
+    port = g_inet_socket_address_get_port(G_INET_SOCKET_ADDRESS(effective));
+
+    g_object_unref(effective);
+    g_object_unref(address);
+    g_object_unref(loopback);
+
+    return port;
+}
+
+static void
+test_happy_eyeballs_connect(void)
+{
+    GSocketListener *listener;
+    GSocketAddress *remote;
+    ConnectResult res;
+    gchar *str;
+    guint16 port;
+
+    port = listen_loopback(&listener);
+
+    /* "localhost" may resolve to ::1 first, which refuses the
+     * connection, the IPv4 address must then win */
+    connect_and_wait("localhost", port, FALSE, &res);
+    g_assert_no_error(res.error);
+    g_assert(res.conn != NULL);
+
+    remote = g_socket_connection_get_remote_address(res.conn, NULL);
+    g_assert(remote != NULL);
+    str = g_inet_address_to_string(g_inet_socket_address_get_address(G_INET_SOCKET_ADDRESS(remote)));
+    g_assert_cmpstr(str, ==, "127.0.0.1");
+    g_assert_cmpuint(g_inet_socket_address_get_port(G_INET_SOCKET_ADDRESS(remote)), ==, port);
+
+    g_free(str);
+    g_object_unref(remote);
+    g_object_unref(res.conn);
+    g_socket_listener_close(listener);
+    g_object_unref(listener);
+}
+
+static void
+test_happy_eyeballs_refused(void)
+{
+    GSocketListener *listener;
+    ConnectResult res;
+    guint16 port;
+
+    port = listen_loopback(&listener);
+    g_socket_listener_close(listener);
+    g_object_unref(listener);
+
+    connect_and_wait("localhost", port, FALSE, &res);
+    g_assert(res.conn == NULL);
+    g_assert(res.error != NULL);
+    g_clear_error(&res.error);
+}
+
+static void
+test_happy_eyeballs_single(void)
+{
+    GSocketListener *listener;
+    ConnectResult res;
+    guint16 port;
+
+    port = listen_loopback(&listener);
+
+    /* nothing to race, the caller connects by itself */
+    connect_and_wait("127.0.0.1", port, TRUE, &res);
+    g_assert(res.conn == NULL);
+    g_assert_error(res.error, G_IO_ERROR, G_IO_ERROR_NOT_SUPPORTED);
+    g_clear_error(&res.error);
+
+    connect_and_wait("127.0.0.1", port, FALSE, &res);
+    g_assert_no_error(res.error);
+    g_assert(res.conn != NULL);
+
+    g_object_unref(res.conn);
+    g_socket_listener_close(listener);
+    g_object_unref(listener);
+}
+
+int main(int argc, char* argv[])
+{
+    g_test_init(&argc, &argv, NULL);
+
+    g_test_add_func("/virt-viewer-util/happy-eyeballs/sort", test_happy_eyeballs_sort);
+    g_test_add_func("/virt-viewer-util/happy-eyeballs/connect", test_happy_eyeballs_connect);
+    g_test_add_func("/virt-viewer-util/happy-eyeballs/refused", test_happy_eyeballs_refused);
+    g_test_add_func("/virt-viewer-util/happy-eyeballs/single", test_happy_eyeballs_single);
+
+    return g_test_run();
+}
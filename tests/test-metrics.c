@@ -0,0 +1,124 @@
+/* -*- Mode: C; c-basic-offset: 4; indent-tabs-mode: nil -*- */
+/*
+ * Virt Viewer: A virtual machine console viewer
+ *
+ * Copyright (C) 2016 Red Hat, Inc.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#include <config.h>
+#include <glib.h>
+#include <glib/gstdio.h>
+
+#include <virt-viewer-util.h>
+#include <virt-viewer-metrics.h>
+
+gboolean doDebug = FALSE;
+
+static void
+test_metrics_format(void)
+{
+    VirtViewerMetrics *metrics = virt_viewer_metrics_new();
+    gchar *text;
+
+    virt_viewer_metrics_describe(metrics, "test_connections_total",
+                                 VIRT_VIEWER_METRIC_COUNTER,
+                                 "Connections");
+    virt_viewer_metrics_set(metrics, "test_connections_total", 3, NULL);
+
+    virt_viewer_metrics_describe(metrics, "test_bytes_total",
+                                 VIRT_VIEWER_METRIC_COUNTER,
+                                 "Bytes\nreceived \\ channel");
+    virt_viewer_metrics_set(metrics, "test_bytes_total", 1024,
+                            "channel", "main", "id", "0", NULL);
+    virt_viewer_metrics_set(metrics, "test_bytes_total", 1,
+                            "channel", "display", "id", "0", NULL);
+    /* replaces the first series */
+    virt_viewer_metrics_set(metrics, "test_bytes_total", 2048,
+                            "channel", "main", "id", "0", NULL);
+
+    virt_viewer_metrics_describe(metrics, "test_connected",
+                                 VIRT_VIEWER_METRIC_GAUGE, NULL);
+    virt_viewer_metrics_set(metrics, "test_connected", 0.5,
+                            "label", "a\"b\\c\nd", NULL);
+
+    /* a metric without series only has its metadata */
+    virt_viewer_metrics_describe(metrics, "test_empty",
+                                 VIRT_VIEWER_METRIC_GAUGE, "Nothing");
+
+    text = virt_viewer_metrics_format(metrics);
+    g_assert_cmpstr(text, ==,
+                    "# HELP test_connections_total Connections\n"
+                    "# TYPE test_connections_total counter\n"
+                    "test_connections_total 3\n"
+                    "# HELP test_bytes_total Bytes\\nreceived \\\\ channel\n"
+                    "# TYPE test_bytes_total counter\n"
+                    "test_bytes_total{channel=\"main\",id=\"0\"} 2048\n"
+                    "test_bytes_total{channel=\"display\",id=\"0\"} 1\n"
+                    "# TYPE test_connected gauge\n"
+                    "test_connected{label=\"a\\\"b\\\\c\\nd\"} 0.5\n"
+                    "# HELP test_empty Nothing\n"
+                    "# TYPE test_empty gauge\n");
+    g_free(text);
+
+    virt_viewer_metrics_free(metrics);
+}
+
+static void
+test_metrics_write(void)
+{
+    VirtViewerMetrics *metrics = virt_viewer_metrics_new();
+    GError *error = NULL;
+    gchar *dir, *filename, *contents;
+
+    dir = g_dir_make_tmp("virt-viewer-metrics-XXXXXX", &error);
+    g_assert_no_error(error);
+    filename = g_build_filename(dir, "virt-viewer.prom", NULL);
+
+    virt_viewer_metrics_describe(metrics, "test_total",
+                                 VIRT_VIEWER_METRIC_COUNTER, NULL);
+    virt_viewer_metrics_set(metrics, "test_total", 1, NULL);
+    g_assert(virt_viewer_metrics_write(metrics, filename, &error));
+    g_assert_no_error(error);
+
+    /* rewritten, not appended */
+    virt_viewer_metrics_set(metrics, "test_total", 2, NULL);
+    g_assert(virt_viewer_metrics_write(metrics, filename, &error));
+    g_assert_no_error(error);
+
+    g_assert(g_file_get_contents(filename, &contents, NULL, &error));
+    g_assert_no_error(error);
+    g_assert_cmpstr(contents, ==,
+                    "# TYPE test_total counter\n"
+                    "test_total 2\n");
+    g_free(contents);
+
+    g_unlink(filename);
+    g_rmdir(dir);
+    g_free(filename);
+    g_free(dir);
+    virt_viewer_metrics_free(metrics);
+}
+
+int main(int argc, char* argv[])
+{
+    g_test_init(&argc, &argv, NULL);
+
+    g_test_add_func("/virt-viewer-util/metrics/format", test_metrics_format);
+    g_test_add_func("/virt-viewer-util/metrics/write", test_metrics_write);
+
+    return g_test_run();
+}
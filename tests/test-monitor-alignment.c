@@ -25,11 +25,6 @@
 
 #include <virt-viewer-util.h>
 
-/* GLIB_CHECK_VERSION(2, 40, 0) */
-#ifndef g_assert_nonnull
-#define g_assert_nonnull g_assert
-#endif
-
 gboolean doDebug = FALSE;
 
 #define MAX_DISPLAYS 4
@@ -38,11 +33,9 @@ typedef struct test_case {
     const guint display_cnt;
     const GdkRectangle *displays_in[MAX_DISPLAYS];
     const GdkRectangle *displays_out[MAX_DISPLAYS];
-    const GLogLevelFlags log_level;
-    const gchar *messages[3];
 } TestCase;
 
-typedef void (*MonitorAlignFunc) (GHashTable *);
+typedef void (*MonitorAlignFunc) (VirtViewerMonitorLayout *);
 
 static void
 test_monitor_align(MonitorAlignFunc monitor_align, const TestCase *test_cases, const guint cases)
@@ -50,36 +43,25 @@ test_monitor_align(MonitorAlignFunc monitor_align, const TestCase *test_cases, c
     guint i;
 
     for (i = 0; i < cases; i++) {
-        GdkRectangle *displays_in[MAX_DISPLAYS];
+        VirtViewerMonitorLayout displays;
         guint j;
-        GHashTable *displays = g_hash_table_new_full(g_direct_hash, g_direct_equal, NULL, g_free);
-        g_assert_nonnull(displays);
+
+        virt_viewer_monitor_layout_init(&displays);
         for (j = 0; j < test_cases[i].display_cnt; j++) {
-            if (test_cases[i].displays_in[j] != NULL) {
-                GdkRectangle *monitor = g_new(GdkRectangle, 1);
-                *monitor = *test_cases[i].displays_in[j];
-                displays_in[j] = monitor;
-            } else {
-                displays_in[j] = NULL;
-            }
-            g_hash_table_insert(displays, GUINT_TO_POINTER(j), displays_in[j]);
+            if (test_cases[i].displays_in[j] != NULL)
+                virt_viewer_monitor_layout_set(&displays, j, test_cases[i].displays_in[j]);
         }
-        for (j = 0; j < G_N_ELEMENTS(test_cases[i].messages) && test_cases[i].messages[j]; j++) {
-            g_test_expect_message(NULL, test_cases[i].log_level, test_cases[i].messages[j]);
-        }
-        monitor_align(displays);
-        g_test_assert_expected_messages();
+        monitor_align(&displays);
         for (j = 0; j < test_cases[i].display_cnt; j++) {
-            if (displays_in[j] == NULL) {
+            if (!virt_viewer_monitor_layout_has(&displays, j)) {
                 g_assert_null(test_cases[i].displays_out[j]);
                 continue;
             }
-            g_assert_cmpint(displays_in[j]->x, ==, test_cases[i].displays_out[j]->x);
-            g_assert_cmpint(displays_in[j]->y, ==, test_cases[i].displays_out[j]->y);
-            g_assert_cmpint(displays_in[j]->width, ==, test_cases[i].displays_out[j]->width);
-            g_assert_cmpint(displays_in[j]->height, ==, test_cases[i].displays_out[j]->height);
+            g_assert_cmpint(displays.rects[j].x, ==, test_cases[i].displays_out[j]->x);
+            g_assert_cmpint(displays.rects[j].y, ==, test_cases[i].displays_out[j]->y);
+            g_assert_cmpint(displays.rects[j].width, ==, test_cases[i].displays_out[j]->width);
+            g_assert_cmpint(displays.rects[j].height, ==, test_cases[i].displays_out[j]->height);
         }
-        g_hash_table_unref(displays);
     }
 }
 
@@ -96,46 +78,35 @@ test_monitor_shift(void)
                                     {4140, 0, 1280, 1024},
                                     {220, 320, 1024, 768},
                                     {320, 680, 1024, 768},
+                                    {0, 0, 1024, 768},
                                  };
     const TestCase test_cases[] = {
         {
-            0, {NULL}, {NULL}, 0, {NULL}
+            0, {NULL}, {NULL}
         },{
             1,
             {NULL},
-            {NULL},
-            G_LOG_LEVEL_CRITICAL,
-            {"*assertion 'display != NULL' failed"}
+            {NULL}
         },{
             2,
             {NULL, &rects[0]},
-            {NULL, &rects[0]},
-            G_LOG_LEVEL_CRITICAL,
-            {"*assertion 'display != NULL' failed"}
+            {NULL, &rects[1]}
         },{
             2,
             {&rects[2], NULL},
-            {&rects[2], NULL},
-            G_LOG_LEVEL_CRITICAL,
-            {"*assertion 'display != NULL' failed"}
+            {&rects[9], NULL}
         },{
             2,
             {&rects[0], &rects[0]},
-            {&rects[1], &rects[1]},
-            0,
-            {NULL}
+            {&rects[1], &rects[1]}
         },{
             2,
             {&rects[0], &rects[1]},
-            {&rects[0], &rects[1]},
-            0,
-            {NULL}
+            {&rects[0], &rects[1]}
         },{
             4,
             {&rects[0], &rects[2], &rects[4], &rects[3]},
-            {&rects[6], &rects[5], &rects[7], &rects[8]},
-            0,
-            {NULL}
+            {&rects[6], &rects[5], &rects[7], &rects[8]}
         },
     };
 
@@ -156,56 +127,187 @@ test_monitor_align_linear(void)
                                  };
     const TestCase test_cases[] = {
         {
-            0, {NULL}, {NULL}, 0, {NULL}
+            0, {NULL}, {NULL}
         },{
             1,
             {NULL},
-            {NULL},
-            G_LOG_LEVEL_CRITICAL,
-            {"*assertion 'rect != NULL' failed"}
+            {NULL}
         },{
             2,
             {NULL, &rects[1]},
-            {NULL, &rects[1]},
-            G_LOG_LEVEL_CRITICAL,
-            {
-                "*displays_cmp: assertion 'm1 != NULL && m2 != NULL' failed",
-                "*assertion 'rect != NULL' failed"
-            }
+            {NULL, &rects[3]}
         },{
             3,
             {&rects[1], NULL, &rects[0]},
-            {&rects[3], NULL, &rects[0]},
-            G_LOG_LEVEL_CRITICAL,
-            {
-                "*displays_cmp: assertion 'm1 != NULL && m2 != NULL' failed",
-                "*displays_cmp: assertion 'm1 != NULL && m2 != NULL' failed",
-                "*assertion 'rect != NULL' failed"
-            }
+            {&rects[2], NULL, &rects[0]}
         },{
             2,
             {&rects[0], &rects[1]},
-            {&rects[0], &rects[2]},
-            0,
-            {NULL}
+            {&rects[0], &rects[2]}
         },{
             2,
             {&rects[1], &rects[0]},
-            {&rects[2], &rects[0]},
-            0,
-            {NULL}
+            {&rects[2], &rects[0]}
         },{
             4,
             {&rects[2], &rects[3], &rects[0], &rects[1]},
-            {&rects[4], &rects[3], &rects[5], &rects[6]},
-            0,
-            {NULL}
+            {&rects[4], &rects[3], &rects[5], &rects[6]}
         },
     };
 
     test_monitor_align(virt_viewer_align_monitors_linear, test_cases, G_N_ELEMENTS(test_cases));
 }
 
+static void
+test_monitor_align_grid(void)
+{
+    const GdkRectangle rects[] = {
+                                    {0, 0, 1920, 1080},
+                                    {1920, 0, 1920, 1080},
+                                    {0, 1080, 1920, 1080},
+                                    {1920, 1080, 1920, 1080},
+                                    {100, 50, 800, 600},
+                                    {1000, 80, 800, 600},
+                                    {120, 900, 1024, 768},
+                                    {0, 0, 800, 600},
+                                    {800, 0, 800, 600},
+                                    {0, 600, 1024, 768},
+                                    {100, 100, 1024, 768},
+                                    {0, 0, 1024, 768},
+                                    {1920, 0, 1024, 768},
+                                 };
+    const TestCase test_cases[] = {
+        {
+            0, {NULL}, {NULL}
+        },{
+            1,
+            {NULL},
+            {NULL}
+        },{
+            2,
+            {NULL, &rects[10]},
+            {NULL, &rects[11]}
+        },{
+            /* a 2x2 wall keeps its shape */
+            4,
+            {&rects[1], &rects[0], &rects[2], &rects[3]},
+            {&rects[1], &rects[0], &rects[2], &rects[3]}
+        },{
+            /* windows are packed in rows */
+            3,
+            {&rects[5], &rects[4], &rects[6]},
+            {&rects[8], &rects[7], &rects[9]}
+        },{
+            /* overlapping displays end up on the same row */
+            2,
+            {&rects[10], &rects[0]},
+            {&rects[12], &rects[0]}
+        },
+    };
+
+    test_monitor_align(virt_viewer_align_monitors_grid, test_cases, G_N_ELEMENTS(test_cases));
+}
+
+static void
+test_monitor_layout_mode(void)
+{
+    VirtViewerMonitorLayoutMode mode = VIRT_VIEWER_MONITOR_LAYOUT_GRID;
+
+    g_assert(virt_viewer_monitor_layout_mode_from_string("linear", &mode));
+    g_assert_cmpint(mode, ==, VIRT_VIEWER_MONITOR_LAYOUT_LINEAR);
+    g_assert(virt_viewer_monitor_layout_mode_from_string("grid", &mode));
+    g_assert_cmpint(mode, ==, VIRT_VIEWER_MONITOR_LAYOUT_GRID);
+    g_assert(!virt_viewer_monitor_layout_mode_from_string("Grid", &mode));
+    g_assert(!virt_viewer_monitor_layout_mode_from_string("", &mode));
+    g_assert_cmpint(mode, ==, VIRT_VIEWER_MONITOR_LAYOUT_GRID);
+}
+
+static void
+test_monitor_layout_equal(void)
+{
+    const GdkRectangle rects[] = {
+                                    {0, 0, 1280, 1024},
+                                    {1280, 0, 1024, 768},
+                                    {1280, 0, 1024, 769},
+                                 };
+    VirtViewerMonitorLayout a, b, c;
+
+    virt_viewer_monitor_layout_init(&a);
+    virt_viewer_monitor_layout_set(&a, 0, &rects[0]);
+    virt_viewer_monitor_layout_set(&a, 1, &rects[1]);
+    b = a;
+    virt_viewer_monitor_layout_init(&c);
+    virt_viewer_monitor_layout_set(&c, 0, &rects[0]);
+
+    g_assert(virt_viewer_monitor_layout_equal(&a, &a));
+    g_assert(virt_viewer_monitor_layout_equal(&a, &b));
+    g_assert(!virt_viewer_monitor_layout_equal(&a, &c));
+    g_assert(!virt_viewer_monitor_layout_equal(&c, &a));
+
+    /* same ids, different geometry */
+    virt_viewer_monitor_layout_set(&c, 1, &rects[2]);
+    g_assert(!virt_viewer_monitor_layout_equal(&a, &c));
+
+    /* different ids */
+    virt_viewer_monitor_layout_init(&c);
+    virt_viewer_monitor_layout_set(&c, 0, &rects[0]);
+    virt_viewer_monitor_layout_set(&c, 2, &rects[1]);
+    g_assert(!virt_viewer_monitor_layout_equal(&a, &c));
+
+    /* out of capacity */
+    g_test_expect_message(NULL, G_LOG_LEVEL_CRITICAL, "*assertion 'nth < VIRT_VIEWER_MONITOR_LAYOUT_MAX' failed");
+    g_assert(!virt_viewer_monitor_layout_set(&c, VIRT_VIEWER_MONITOR_LAYOUT_MAX, &rects[0]));
+    g_test_assert_expected_messages();
+}
+
+/* The whole layout computation done for each geometry change, run in
+ * a loop: reports the time per layout with -m perf */
+static void
+test_monitor_layout_bench(gconstpointer data)
+{
+    const guint ndisplays = GPOINTER_TO_UINT(data);
+    const guint iterations = g_test_perf() ? 1000000 : 1000;
+    VirtViewerMonitorLayout last;
+    GdkRectangle rect;
+    gdouble elapsed;
+    guint i, j, sent = 0;
+
+    virt_viewer_monitor_layout_init(&last);
+
+    g_test_timer_start();
+    for (i = 0; i < iterations; i++) {
+        VirtViewerMonitorLayout layout;
+
+        virt_viewer_monitor_layout_init(&layout);
+        for (j = 0; j < ndisplays; j++) {
+            /* displays in reverse order, dragged around */
+            rect.x = (ndisplays - j) * 1920 + (i % 7);
+            rect.y = (j % 2) * 1080;
+            rect.width = 1920;
+            rect.height = 1080;
+            virt_viewer_monitor_layout_set(&layout, j, &rect);
+        }
+        virt_viewer_align_monitors_linear(&layout);
+        virt_viewer_shift_monitors_to_origin(&layout);
+        if (!virt_viewer_monitor_layout_equal(&layout, &last)) {
+            last = layout;
+            sent++;
+        }
+    }
+    elapsed = g_test_timer_elapsed();
+
+    /* the aligned layout does not depend on the drag offset */
+    g_assert_cmpuint(sent, ==, 1);
+    for (j = 0; j < ndisplays; j++) {
+        g_assert_cmpint(last.rects[j].x, ==, (ndisplays - 1 - j) * 1920);
+        g_assert_cmpint(last.rects[j].y, ==, 0);
+    }
+
+    g_test_minimized_result(elapsed * 1e9 / iterations,
+                            "%u displays: %.1f ns per layout",
+                            ndisplays, elapsed * 1e9 / iterations);
+}
+
 int main(int argc, char* argv[])
 {
     gtk_init_check(&argc, &argv);
@@ -213,6 +315,13 @@ int main(int argc, char* argv[])
 
     g_test_add_func("/virt-viewer-util/monitor-shift", test_monitor_shift);
     g_test_add_func("/virt-viewer-util/monitor-align-linear", test_monitor_align_linear);
+    g_test_add_func("/virt-viewer-util/monitor-align-grid", test_monitor_align_grid);
+    g_test_add_func("/virt-viewer-util/monitor-layout-mode", test_monitor_layout_mode);
+    g_test_add_func("/virt-viewer-util/monitor-layout-equal", test_monitor_layout_equal);
+    g_test_add_data_func("/virt-viewer-util/monitor-layout-bench/4",
+                         GUINT_TO_POINTER(4), test_monitor_layout_bench);
+    g_test_add_data_func("/virt-viewer-util/monitor-layout-bench/16",
+                         GUINT_TO_POINTER(VIRT_VIEWER_MONITOR_LAYOUT_MAX), test_monitor_layout_bench);
 
     return g_test_run();
 }
@@ -0,0 +1,323 @@
+/* -*- Mode: C; c-basic-offset: 4; indent-tabs-mode: nil -*- */
+/*
+ * Virt Viewer: A virtual machine console viewer
+ *
+ * Copyright (C) 2016 Red Hat, Inc.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#include <config.h>
+#include <glib.h>
+#include <glib/gstdio.h>
+#include <string.h>
+
+#include <virt-viewer-util.h>
+#include <virt-viewer-recording.h>
+
+gboolean doDebug = FALSE;
+
+static GdkPixbuf *
+new_frame(gint width, gint height, guint32 color)
+{
+    GdkPixbuf *pixbuf = gdk_pixbuf_new(GDK_COLORSPACE_RGB, FALSE, 8, width, height);
+
+    gdk_pixbuf_fill(pixbuf, color);
+
+    return pixbuf;
+}
+
+static void
+wait_frames(VirtViewerRecorder *recorder, guint expected)
+{
+    guint frames = 0;
+
+    for (;;) {
+        virt_viewer_recorder_get_stats(recorder, &frames, NULL, NULL);
+        if (frames >= expected)
+            break;
+        g_usleep(1000);
+    }
+}
+
+static gchar *
+record_session(const gchar *dir)
+{
+    VirtViewerRecorder *recorder;
+    GdkPixbuf *frame;
+    GError *error = NULL;
+    gchar *filename;
+    GdkPixbuf *copy;
+    guint frames, dropped;
+    guint64 bytes;
+    GStatBuf st;
+
+    filename = g_build_filename(dir, "session.vvr", NULL);
+    recorder = virt_viewer_recorder_new(filename, &error);
+    g_assert_no_error(error);
+
+    /* the whole display */
+    frame = new_frame(200, 100, 0x204060ff);
+    g_assert(virt_viewer_recorder_add_frame(recorder, 0, frame));
+    wait_frames(recorder, 1);
+    g_usleep(2000);
+
+    /* a single pixel changed, in the middle of a tile */
+    copy = gdk_pixbuf_copy(frame);
+    g_object_unref(frame);
+    frame = copy;
+    gdk_pixbuf_get_pixels(frame)[70 * gdk_pixbuf_get_rowstride(frame) + 150 * 3] = 0xff;
+    g_assert(virt_viewer_recorder_add_frame(recorder, 0, frame));
+    wait_frames(recorder, 2);
+    g_usleep(2000);
+
+    /* unchanged */
+    g_assert(virt_viewer_recorder_add_frame(recorder, 0, frame));
+    g_object_unref(frame);
+    wait_frames(recorder, 3);
+
+    virt_viewer_recorder_get_stats(recorder, &frames, &dropped, &bytes);
+    virt_viewer_recorder_free(recorder);
+
+    g_assert_cmpuint(frames, ==, 3);
+    g_assert_cmpuint(dropped, ==, 0);
+    g_assert_cmpint(g_stat(filename, &st), ==, 0);
+    g_assert_cmpuint(bytes, ==, st.st_size);
+    g_assert_cmpint(st.st_size % 8, ==, 0);
+
+    return filename;
+}
+
+static void
+remove_dir(const gchar *path)
+{
+    GDir *dir = g_dir_open(path, 0, NULL);
+    const gchar *name;
+
+    g_assert(dir != NULL);
+    while ((name = g_dir_read_name(dir)) != NULL) {
+        gchar *file = g_build_filename(path, name, NULL);
+        g_unlink(file);
+        g_free(file);
+    }
+    g_dir_close(dir);
+    g_rmdir(path);
+}
+
+static void
+test_recording_events(void)
+{
+    VirtViewerRecordingReader *reader;
+    VirtViewerRecordingEvent event;
+    GError *error = NULL;
+    gchar *dir, *filename;
+    const guchar *p;
+    gint64 time;
+
+    dir = g_dir_make_tmp("virt-viewer-recording-XXXXXX", &error);
+    g_assert_no_error(error);
+    filename = record_session(dir);
+
+    reader = virt_viewer_recording_reader_new(filename, &error);
+    g_assert_no_error(error);
+
+    g_assert(virt_viewer_recording_reader_next(reader, &event, &error));
+    g_assert_cmpint(event.type, ==, VIRT_VIEWER_RECORDING_EVENT_SIZE);
+    g_assert_cmpint(event.rect.width, ==, 200);
+    g_assert_cmpint(event.rect.height, ==, 100);
+    time = event.time;
+
+    /* the first frame is written a row of tiles at a time */
+    g_assert(virt_viewer_recording_reader_next(reader, &event, &error));
+    g_assert_cmpint(event.type, ==, VIRT_VIEWER_RECORDING_EVENT_REGION);
+    g_assert_cmpint(event.time, ==, time);
+    g_assert_cmpint(event.rect.x, ==, 0);
+    g_assert_cmpint(event.rect.y, ==, 0);
+    g_assert_cmpint(event.rect.width, ==, 200);
+    g_assert_cmpint(event.rect.height, ==, 64);
+    p = gdk_pixbuf_get_pixels(event.pixels);
+    g_assert_cmphex(p[0] << 16 | p[1] << 8 | p[2], ==, 0x204060);
+    virt_viewer_recording_event_clear(&event);
+
+    g_assert(virt_viewer_recording_reader_next(reader, &event, &error));
+    g_assert_cmpint(event.rect.y, ==, 64);
+    g_assert_cmpint(event.rect.height, ==, 36);
+    virt_viewer_recording_event_clear(&event);
+
+    /* then only the tile which changed */
+    g_assert(virt_viewer_recording_reader_next(reader, &event, &error));
+    g_assert_cmpint(event.type, ==, VIRT_VIEWER_RECORDING_EVENT_REGION);
+    g_assert_cmpint(event.time, >, time);
+    g_assert_cmpint(event.rect.x, ==, 128);
+    g_assert_cmpint(event.rect.y, ==, 64);
+    g_assert_cmpint(event.rect.width, ==, 64);
+    g_assert_cmpint(event.rect.height, ==, 36);
+    p = gdk_pixbuf_get_pixels(event.pixels) + 6 * gdk_pixbuf_get_rowstride(event.pixels) + 22 * 3;
+    g_assert_cmphex(p[0] << 16 | p[1] << 8 | p[2], ==, 0xff4060);
+    virt_viewer_recording_event_clear(&event);
+
+    /* and nothing for the unchanged frame */
+    g_assert(!virt_viewer_recording_reader_next(reader, &event, &error));
+    g_assert_no_error(error);
+
+    virt_viewer_recording_reader_free(reader);
+    remove_dir(dir);
+    g_free(filename);
+    g_free(dir);
+}
+
+static void
+test_recording_truncated(void)
+{
+    VirtViewerRecordingReader *reader;
+    VirtViewerRecordingEvent event;
+    GError *error = NULL;
+    gchar *dir, *filename, *contents;
+    gsize length;
+    guint n = 0;
+
+    dir = g_dir_make_tmp("virt-viewer-recording-XXXXXX", &error);
+    g_assert_no_error(error);
+    filename = record_session(dir);
+
+    /* cut in the middle of the last event */
+    g_assert(g_file_get_contents(filename, &contents, &length, &error));
+    g_assert(g_file_set_contents(filename, contents, length - 10, &error));
+    g_free(contents);
+
+    reader = virt_viewer_recording_reader_new(filename, &error);
+    g_assert_no_error(error);
+    while (virt_viewer_recording_reader_next(reader, &event, &error)) {
+        virt_viewer_recording_event_clear(&event);
+        n++;
+    }
+    g_assert_no_error(error);
+    g_assert_cmpuint(n, ==, 3);
+    virt_viewer_recording_reader_free(reader);
+
+    g_assert(g_file_set_contents(filename, "not a recording", -1, &error));
+    reader = virt_viewer_recording_reader_new(filename, &error);
+    g_assert(reader == NULL);
+    g_assert_error(error, VIRT_VIEWER_ERROR, VIRT_VIEWER_ERROR_FAILED);
+    g_clear_error(&error);
+
+    remove_dir(dir);
+    g_free(filename);
+    g_free(dir);
+}
+
+/* a region event claiming a display far larger than its payload */
+static void
+write_oversized_event(const gchar *filename, guint32 flags)
+{
+    guint32 header[10] = { 0, };
+    GString *contents = g_string_new(VIRT_VIEWER_RECORDING_MAGIC);
+    GError *error = NULL;
+
+    header[0] = GUINT32_TO_LE(VIRT_VIEWER_RECORDING_EVENT_REGION);
+    header[6] = GUINT32_TO_LE(60000); /* width */
+    header[7] = GUINT32_TO_LE(60000); /* height */
+    header[8] = GUINT32_TO_LE(flags);
+    header[9] = GUINT32_TO_LE(8); /* length */
+    g_string_append_len(contents, (const gchar *)header, sizeof(header));
+    g_string_append_len(contents, "\0\0\0\0\0\0\0\0", 8);
+
+    g_assert(g_file_set_contents(filename, contents->str, contents->len, &error));
+    g_assert_no_error(error);
+    g_string_free(contents, TRUE);
+}
+
+static void
+test_recording_oversized(void)
+{
+    VirtViewerRecordingReader *reader;
+    VirtViewerRecordingEvent event;
+    GError *error = NULL;
+    gchar *dir, *filename;
+    guint32 flags;
+
+    dir = g_dir_make_tmp("virt-viewer-recording-XXXXXX", &error);
+    g_assert_no_error(error);
+    filename = g_build_filename(dir, "oversized.vvr", NULL);
+
+    /* uncompressed, then compressed */
+    for (flags = 0; flags <= 1; flags++) {
+        write_oversized_event(filename, flags);
+        reader = virt_viewer_recording_reader_new(filename, &error);
+        g_assert_no_error(error);
+        g_assert(!virt_viewer_recording_reader_next(reader, &event, &error));
+        g_assert_error(error, VIRT_VIEWER_ERROR, VIRT_VIEWER_ERROR_FAILED);
+        g_clear_error(&error);
+        virt_viewer_recording_reader_free(reader);
+    }
+
+    remove_dir(dir);
+    g_free(filename);
+    g_free(dir);
+}
+
+static void
+test_recording_export(void)
+{
+    GError *error = NULL;
+    gchar *dir, *out, *filename;
+    GDir *files;
+    const gchar *name;
+    guint n = 0;
+
+    dir = g_dir_make_tmp("virt-viewer-recording-XXXXXX", &error);
+    g_assert_no_error(error);
+    filename = record_session(dir);
+    out = g_build_filename(dir, "export", NULL);
+    g_assert_cmpint(g_mkdir(out, 0755), ==, 0);
+
+    g_assert(virt_viewer_recording_export(filename, out, &error));
+    g_assert_no_error(error);
+
+    /* one picture for each frame which changed something */
+    files = g_dir_open(out, 0, NULL);
+    while ((name = g_dir_read_name(files)) != NULL) {
+        gchar *path = g_build_filename(out, name, NULL);
+        GdkPixbuf *pixbuf = gdk_pixbuf_new_from_file(path, &error);
+
+        g_assert_no_error(error);
+        g_assert(g_str_has_prefix(name, "display-0-"));
+        g_assert_cmpint(gdk_pixbuf_get_width(pixbuf), ==, 200);
+        g_assert_cmpint(gdk_pixbuf_get_height(pixbuf), ==, 100);
+        g_object_unref(pixbuf);
+        g_free(path);
+        n++;
+    }
+    g_dir_close(files);
+    g_assert_cmpuint(n, ==, 2);
+
+    remove_dir(out);
+    remove_dir(dir);
+    g_free(filename);
+    g_free(out);
+    g_free(dir);
+}
+
+int main(int argc, char* argv[])
+{
+    g_test_init(&argc, &argv, NULL);
+
+    g_test_add_func("/virt-viewer-util/recording/events", test_recording_events);
+    g_test_add_func("/virt-viewer-util/recording/truncated", test_recording_truncated);
+    g_test_add_func("/virt-viewer-util/recording/oversized", test_recording_oversized);
+    g_test_add_func("/virt-viewer-util/recording/export", test_recording_export);
+
+    return g_test_run();
+}
@@ -0,0 +1,211 @@
+/* -*- Mode: C; c-basic-offset: 4; indent-tabs-mode: nil -*- */
+/*
+ * Virt Viewer: A virtual machine console viewer
+ *
+ * Copyright (C) 2016 Red Hat, Inc.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#include <config.h>
+#include <glib.h>
+
+#include <virt-viewer-util.h>
+#include <virt-viewer-scaler.h>
+
+gboolean doDebug = FALSE;
+
+static void
+test_scaler_modes(void)
+{
+    VirtViewerScalingMode mode = VIRT_VIEWER_SCALING_AUTO;
+    const gchar *names[] = { "auto", "nearest", "bilinear", "box" };
+    guint i;
+
+    for (i = 0; i < G_N_ELEMENTS(names); i++) {
+        g_assert(virt_viewer_scaling_mode_from_string(names[i], &mode));
+        g_assert_cmpint(mode, ==, i);
+        g_assert_cmpstr(virt_viewer_scaling_mode_to_string(mode), ==, names[i]);
+    }
+
+    mode = VIRT_VIEWER_SCALING_BOX;
+    g_assert(!virt_viewer_scaling_mode_from_string("lanczos", &mode));
+    g_assert(!virt_viewer_scaling_mode_from_string("", &mode));
+    g_assert_cmpint(mode, ==, VIRT_VIEWER_SCALING_BOX);
+}
+
+static guint32
+get_pixel(cairo_surface_t *surface, gint x, gint y)
+{
+    const guchar *data;
+
+    cairo_surface_flush(surface);
+    data = cairo_image_surface_get_data(surface);
+
+    return ((const guint32 *)(data + y * cairo_image_surface_get_stride(surface)))[x];
+}
+
+static void
+set_pixel(cairo_surface_t *surface, gint x, gint y, guint32 pixel)
+{
+    guchar *data;
+
+    cairo_surface_flush(surface);
+    data = cairo_image_surface_get_data(surface);
+    ((guint32 *)(data + y * cairo_image_surface_get_stride(surface)))[x] = pixel;
+}
+
+static cairo_surface_t *
+create_source(gint width, gint height, guint32 pixel)
+{
+    cairo_surface_t *surface = cairo_image_surface_create(CAIRO_FORMAT_ARGB32, width, height);
+    gint x, y;
+
+    for (y = 0; y < height; y++)
+        for (x = 0; x < width; x++)
+            set_pixel(surface, x, y, pixel);
+    cairo_surface_mark_dirty(surface);
+
+    return surface;
+}
+
+static void
+test_scaler_levels(void)
+{
+    VirtViewerScaler *scaler = virt_viewer_scaler_new();
+    cairo_surface_t *source = create_source(5, 4, 0xff000000);
+    cairo_surface_t *level;
+
+    g_assert(virt_viewer_scaler_get_level(scaler, 0) == NULL);
+
+    set_pixel(source, 0, 0, 0xff804020);
+    set_pixel(source, 1, 0, 0xff000000);
+    set_pixel(source, 0, 1, 0xff402010);
+    set_pixel(source, 1, 1, 0xffc06030);
+    set_pixel(source, 4, 3, 0xffffffff);
+    cairo_surface_mark_dirty(source);
+    virt_viewer_scaler_set_source(scaler, source);
+    g_assert(virt_viewer_scaler_get_source(scaler) == source);
+    g_assert(virt_viewer_scaler_get_level(scaler, 0) == source);
+
+    level = virt_viewer_scaler_get_level(scaler, 1);
+    g_assert(level != NULL);
+    g_assert_cmpint(cairo_image_surface_get_width(level), ==, 3);
+    g_assert_cmpint(cairo_image_surface_get_height(level), ==, 2);
+    /* each channel is the rounded average of the 2x2 block */
+    g_assert_cmphex(get_pixel(level, 0, 0), ==, 0xff603018);
+    g_assert_cmphex(get_pixel(level, 1, 0), ==, 0xff000000);
+    /* the odd column is repeated */
+    g_assert_cmphex(get_pixel(level, 2, 1), ==, 0xff808080);
+
+    level = virt_viewer_scaler_get_level(scaler, 2);
+    g_assert(level != NULL);
+    g_assert_cmpint(cairo_image_surface_get_width(level), ==, 2);
+    g_assert_cmpint(cairo_image_surface_get_height(level), ==, 1);
+
+    g_assert(virt_viewer_scaler_get_level(scaler, 8) == NULL);
+
+    virt_viewer_scaler_set_source(scaler, NULL);
+    g_assert(virt_viewer_scaler_get_source(scaler) == NULL);
+    g_assert(virt_viewer_scaler_get_level(scaler, 1) == NULL);
+
+    cairo_surface_destroy(source);
+    virt_viewer_scaler_free(scaler);
+}
+
+static void
+test_scaler_invalidate(void)
+{
+    VirtViewerScaler *scaler = virt_viewer_scaler_new();
+    cairo_surface_t *source = create_source(8, 8, 0xff000000);
+    GdkRectangle area = { 6, 6, 2, 2 };
+    cairo_surface_t *level;
+
+    virt_viewer_scaler_set_source(scaler, source);
+    level = virt_viewer_scaler_get_level(scaler, 1);
+    g_assert_cmphex(get_pixel(level, 3, 3), ==, 0xff000000);
+
+    /* unreported changes are not picked up */
+    set_pixel(source, 0, 0, 0xffffffff);
+    set_pixel(source, 1, 0, 0xffffffff);
+    set_pixel(source, 0, 1, 0xffffffff);
+    set_pixel(source, 1, 1, 0xffffffff);
+    set_pixel(source, 6, 6, 0xffffffff);
+    set_pixel(source, 7, 6, 0xffffffff);
+    set_pixel(source, 6, 7, 0xffffffff);
+    set_pixel(source, 7, 7, 0xffffffff);
+    virt_viewer_scaler_invalidate(scaler, &area);
+
+    level = virt_viewer_scaler_get_level(scaler, 1);
+    g_assert_cmphex(get_pixel(level, 3, 3), ==, 0xffffffff);
+    g_assert_cmphex(get_pixel(level, 0, 0), ==, 0xff000000);
+
+    /* new levels are built from the previous one, still stale */
+    level = virt_viewer_scaler_get_level(scaler, 2);
+    g_assert_cmphex(get_pixel(level, 0, 0), ==, 0xff000000);
+    g_assert_cmphex(get_pixel(level, 1, 1), ==, 0xff404040);
+
+    cairo_surface_destroy(source);
+    virt_viewer_scaler_free(scaler);
+}
+
+static void
+test_scaler_draw(void)
+{
+    VirtViewerScaler *scaler = virt_viewer_scaler_new();
+    cairo_surface_t *source = create_source(2, 2, 0xff000000);
+    cairo_surface_t *target = create_source(4, 4, 0xff00ff00);
+    GdkRectangle dest = { 0, 0, 4, 4 };
+    cairo_t *cr;
+
+    set_pixel(source, 1, 1, 0xffffffff);
+    cairo_surface_mark_dirty(source);
+    virt_viewer_scaler_set_source(scaler, source);
+
+    cr = cairo_create(target);
+    virt_viewer_scaler_draw(scaler, cr, VIRT_VIEWER_SCALING_NEAREST, &dest);
+    cairo_destroy(cr);
+
+    g_assert_cmphex(get_pixel(target, 0, 0), ==, 0xff000000);
+    g_assert_cmphex(get_pixel(target, 1, 1), ==, 0xff000000);
+    g_assert_cmphex(get_pixel(target, 2, 2), ==, 0xffffffff);
+    g_assert_cmphex(get_pixel(target, 3, 3), ==, 0xffffffff);
+    g_assert_cmphex(get_pixel(target, 3, 0), ==, 0xff000000);
+
+    /* a downscale to one pixel averages the whole source */
+    dest.width = dest.height = 1;
+    cr = cairo_create(target);
+    virt_viewer_scaler_draw(scaler, cr, VIRT_VIEWER_SCALING_BOX, &dest);
+    cairo_destroy(cr);
+
+    g_assert_cmphex(get_pixel(target, 0, 0), ==, 0xff404040);
+    g_assert_cmphex(get_pixel(target, 1, 0), ==, 0xff000000);
+
+    cairo_surface_destroy(target);
+    cairo_surface_destroy(source);
+    virt_viewer_scaler_free(scaler);
+}
+
+int main(int argc, char* argv[])
+{
+    g_test_init(&argc, &argv, NULL);
+
+    g_test_add_func("/virt-viewer-util/scaler/modes", test_scaler_modes);
+    g_test_add_func("/virt-viewer-util/scaler/levels", test_scaler_levels);
+    g_test_add_func("/virt-viewer-util/scaler/invalidate", test_scaler_invalidate);
+    g_test_add_func("/virt-viewer-util/scaler/draw", test_scaler_draw);
+
+    return g_test_run();
+}
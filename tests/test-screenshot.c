@@ -0,0 +1,190 @@
+/* -*- Mode: C; c-basic-offset: 4; indent-tabs-mode: nil -*- */
+/*
+ * Virt Viewer: A virtual machine console viewer
+ *
+ * Copyright (C) 2016 Red Hat, Inc.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#include <config.h>
+#include <glib.h>
+#include <glib/gstdio.h>
+
+#include <virt-viewer-util.h>
+#include <virt-viewer-screenshot.h>
+
+gboolean doDebug = FALSE;
+
+typedef struct {
+    GMainLoop *loop;
+    gboolean result;
+    GError *error;
+} SaveResult;
+
+static void
+save_ready(GObject *source G_GNUC_UNUSED,
+           GAsyncResult *result,
+           gpointer user_data)
+{
+    SaveResult *res = user_data;
+
+    res->result = virt_viewer_screenshot_save_finish(result, &res->error);
+    g_main_loop_quit(res->loop);
+}
+
+static gboolean
+save_pixbuf(GdkPixbuf *pixbuf, const gchar *filename, GError **error)
+{
+    SaveResult res = { NULL, };
+
+    res.loop = g_main_loop_new(NULL, FALSE);
+    virt_viewer_screenshot_save_async(pixbuf, filename, NULL, save_ready, &res);
+    g_main_loop_run(res.loop);
+    g_main_loop_unref(res.loop);
+
+    if (res.error != NULL)
+        g_propagate_error(error, res.error);
+
+    return res.result;
+}
+
+static void
+test_screenshot_save(void)
+{
+    GdkPixbuf *pixbuf, *loaded;
+    GError *error = NULL;
+    gchar *dir, *filename;
+
+    dir = g_dir_make_tmp("virt-viewer-screenshot-XXXXXX", &error);
+    g_assert_no_error(error);
+    filename = g_build_filename(dir, "screenshot.png", NULL);
+
+    pixbuf = gdk_pixbuf_new(GDK_COLORSPACE_RGB, FALSE, 8, 64, 48);
+    gdk_pixbuf_fill(pixbuf, 0x336699ff);
+
+    g_assert(save_pixbuf(pixbuf, filename, &error));
+    g_assert_no_error(error);
+
+    loaded = gdk_pixbuf_new_from_file(filename, &error);
+    g_assert_no_error(error);
+    g_assert_cmpint(gdk_pixbuf_get_width(loaded), ==, 64);
+    g_assert_cmpint(gdk_pixbuf_get_height(loaded), ==, 48);
+    g_assert_cmpint(gdk_pixbuf_get_pixels(loaded)[0], ==, 0x33);
+    g_assert_cmpint(gdk_pixbuf_get_pixels(loaded)[2], ==, 0x99);
+    g_object_unref(loaded);
+
+    g_unlink(filename);
+    g_rmdir(dir);
+    g_object_unref(pixbuf);
+    g_free(filename);
+    g_free(dir);
+}
+
+static void
+test_screenshot_errors(void)
+{
+    GdkPixbuf *pixbuf;
+    GError *error = NULL;
+
+    pixbuf = gdk_pixbuf_new(GDK_COLORSPACE_RGB, FALSE, 8, 16, 16);
+    gdk_pixbuf_fill(pixbuf, 0);
+
+    g_assert(virt_viewer_screenshot_get_format("screenshot.png") != NULL);
+    g_assert(virt_viewer_screenshot_get_format("screenshot") == NULL);
+    g_assert(virt_viewer_screenshot_get_format("screenshot.unknown") == NULL);
+
+    g_assert(!save_pixbuf(pixbuf, "screenshot.unknown", &error));
+    g_assert_error(error, G_FILE_ERROR, G_FILE_ERROR_FAILED);
+    g_clear_error(&error);
+
+    g_assert(!save_pixbuf(pixbuf, "/nonexistent/directory/screenshot.png", &error));
+    g_assert(error != NULL);
+    g_clear_error(&error);
+
+    g_object_unref(pixbuf);
+}
+
+static void
+assert_pixel(GdkPixbuf *pixbuf, gint x, gint y, guint32 rgb)
+{
+    const guchar *p = gdk_pixbuf_get_pixels(pixbuf) +
+        y * gdk_pixbuf_get_rowstride(pixbuf) + x * gdk_pixbuf_get_n_channels(pixbuf);
+
+    g_assert_cmphex(p[0] << 16 | p[1] << 8 | p[2], ==, rgb);
+}
+
+static void
+test_screenshot_composite(void)
+{
+    GdkPixbuf *tiles[3];
+    const GdkPoint origins[] = { { 100, 50 }, { 120, 60 }, { 100, 60 } };
+    const GdkPoint overlapping[] = { { 0, 0 }, { 10, 5 } };
+    const GdkPoint far_apart[] = { { 0, 0 }, { 1 << 30, 0 } };
+    GdkPixbuf *composite;
+    GError *error = NULL;
+
+    tiles[0] = gdk_pixbuf_new(GDK_COLORSPACE_RGB, FALSE, 8, 20, 10);
+    gdk_pixbuf_fill(tiles[0], 0xff0000ff);
+    tiles[1] = gdk_pixbuf_new(GDK_COLORSPACE_RGB, TRUE, 8, 10, 10);
+    gdk_pixbuf_fill(tiles[1], 0x00ff00ff);
+    tiles[2] = gdk_pixbuf_new(GDK_COLORSPACE_RGB, FALSE, 8, 20, 5);
+    gdk_pixbuf_fill(tiles[2], 0x0000ffff);
+
+    /* a display on the first row, two on the second */
+    composite = virt_viewer_screenshot_composite(tiles, origins, 3, &error);
+    g_assert_no_error(error);
+    g_assert_cmpint(gdk_pixbuf_get_width(composite), ==, 30);
+    g_assert_cmpint(gdk_pixbuf_get_height(composite), ==, 20);
+    assert_pixel(composite, 0, 0, 0xff0000);
+    assert_pixel(composite, 19, 9, 0xff0000);
+    assert_pixel(composite, 25, 15, 0x00ff00);
+    assert_pixel(composite, 0, 10, 0x0000ff);
+    /* not covered */
+    assert_pixel(composite, 25, 5, 0x000000);
+    assert_pixel(composite, 5, 19, 0x000000);
+    g_object_unref(composite);
+
+    /* the last display wins */
+    composite = virt_viewer_screenshot_composite(tiles, overlapping, 2, &error);
+    g_assert_no_error(error);
+    g_assert_cmpint(gdk_pixbuf_get_width(composite), ==, 20);
+    g_assert_cmpint(gdk_pixbuf_get_height(composite), ==, 15);
+    assert_pixel(composite, 5, 5, 0xff0000);
+    assert_pixel(composite, 15, 5, 0x00ff00);
+    assert_pixel(composite, 5, 12, 0x000000);
+    g_object_unref(composite);
+
+    /* too large to be allocated */
+    composite = virt_viewer_screenshot_composite(tiles, far_apart, 2, &error);
+    g_assert(composite == NULL);
+    g_assert_error(error, G_FILE_ERROR, G_FILE_ERROR_NOMEM);
+    g_clear_error(&error);
+
+    g_object_unref(tiles[0]);
+    g_object_unref(tiles[1]);
+    g_object_unref(tiles[2]);
+}
+
+int main(int argc, char* argv[])
+{
+    g_test_init(&argc, &argv, NULL);
+
+    g_test_add_func("/virt-viewer-util/screenshot/save", test_screenshot_save);
+    g_test_add_func("/virt-viewer-util/screenshot/errors", test_screenshot_errors);
+    g_test_add_func("/virt-viewer-util/screenshot/composite", test_screenshot_composite);
+
+    return g_test_run();
+}
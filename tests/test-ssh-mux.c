@@ -0,0 +1,227 @@
+/* -*- Mode: C; c-basic-offset: 4; indent-tabs-mode: nil -*- */
+/*
+ * Virt Viewer: A virtual machine console viewer
+ *
+ * Copyright (C) 2016 Red Hat, Inc.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#include <config.h>
+#include <glib.h>
+#include <glib/gstdio.h>
+#include <string.h>
+
+#include <virt-viewer-util.h>
+#include <virt-viewer-ssh-mux.h>
+
+gboolean doDebug = FALSE;
+
+/* Stands in for ssh(1): records its arguments, one invocation per line */
+static const gchar fake_ssh[] =
+    "#!/bin/sh\n"
+    "echo \"$*\" >> \"$FAKE_SSH_LOG\"\n";
+
+static gchar *fake_dir = NULL;
+static gchar *fake_log = NULL;
+
+static void
+setup_fake_ssh(void)
+{
+    GError *error = NULL;
+    gchar *script;
+    gchar *path;
+
+    fake_dir = g_dir_make_tmp("virt-viewer-fake-ssh-XXXXXX", &error);
+    g_assert_no_error(error);
+
+    script = g_build_filename(fake_dir, "ssh", NULL);
+    g_assert(g_file_set_contents(script, fake_ssh, -1, &error));
+    g_assert_no_error(error);
+    g_assert_cmpint(g_chmod(script, 0755), ==, 0);
+
+    fake_log = g_build_filename(fake_dir, "log", NULL);
+    g_setenv("FAKE_SSH_LOG", fake_log, TRUE);
+
+    path = g_strdup_printf("%s%c%s", fake_dir, G_SEARCHPATH_SEPARATOR, g_getenv("PATH"));
+    g_setenv("PATH", path, TRUE);
+
+    g_free(path);
+    g_free(script);
+}
+
+static void
+teardown_fake_ssh(void)
+{
+    gchar *script = g_build_filename(fake_dir, "ssh", NULL);
+
+    g_unlink(fake_log);
+    g_unlink(script);
+    g_rmdir(fake_dir);
+
+    g_free(script);
+    g_clear_pointer(&fake_log, g_free);
+    g_clear_pointer(&fake_dir, g_free);
+}
+
+static gchar **
+read_fake_ssh_log(void)
+{
+    gchar *contents = NULL;
+    gchar **lines;
+
+    if (!g_file_get_contents(fake_log, &contents, NULL, NULL))
+        return g_new0(gchar *, 1);
+
+    g_strchomp(contents);
+    lines = g_strsplit(contents, "\n", -1);
+    g_free(contents);
+
+    return lines;
+}
+
+static gchar **
+wait_fake_ssh_log(guint n_lines)
+{
+    gint64 deadline = g_get_monotonic_time() + 5 * G_USEC_PER_SEC;
+    gchar **lines = read_fake_ssh_log();
+
+    while (g_strv_length(lines) < n_lines && g_get_monotonic_time() < deadline) {
+        g_strfreev(lines);
+        g_main_context_iteration(NULL, FALSE);
+        g_usleep(10 * 1000);
+        lines = read_fake_ssh_log();
+    }
+
+    return lines;
+}
+
+static const gchar *
+find_control_path(GPtrArray *cmd)
+{
+    guint i;
+
+    for (i = 0; i < cmd->len; i++) {
+        const gchar *arg = g_ptr_array_index(cmd, i);
+        if (arg && g_str_has_prefix(arg, "ControlPath="))
+            return arg + strlen("ControlPath=");
+    }
+
+    return NULL;
+}
+
+static GPtrArray *
+build_cmd(VirtViewerSshMux *mux, const gchar *host, gint port, const gchar *user)
+{
+    GPtrArray *cmd = g_ptr_array_new_with_free_func(g_free);
+
+    g_ptr_array_add(cmd, g_strdup("ssh"));
+    virt_viewer_ssh_mux_add_options(mux, cmd, host, port, user);
+    g_ptr_array_add(cmd, g_strdup(host));
+    g_ptr_array_add(cmd, g_strdup("true"));
+    g_ptr_array_add(cmd, NULL);
+
+    return cmd;
+}
+
+static void
+test_ssh_mux_one_master_per_host(void)
+{
+    VirtViewerSshMux *mux = virt_viewer_ssh_mux_new(60);
+    GPtrArray *cmd1, *cmd2, *cmd3;
+    gchar *dir;
+
+    setup_fake_ssh();
+
+    cmd1 = build_cmd(mux, "host1.example.com", 2222, "root");
+    cmd2 = build_cmd(mux, "host1.example.com", 2222, "root");
+    cmd3 = build_cmd(mux, "host2.example.com", 0, NULL);
+
+    g_assert_cmpuint(virt_viewer_ssh_mux_get_n_masters(mux), ==, 2);
+    g_assert(find_control_path(cmd1) != NULL);
+    g_assert_cmpstr(find_control_path(cmd1), ==, find_control_path(cmd2));
+    g_assert_cmpstr(find_control_path(cmd1), !=, find_control_path(cmd3));
+
+    dir = g_path_get_dirname(find_control_path(cmd1));
+    g_assert(g_file_test(dir, G_FILE_TEST_IS_DIR));
+
+    virt_viewer_ssh_mux_free(mux);
+    g_assert(!g_file_test(dir, G_FILE_TEST_EXISTS));
+
+    g_free(dir);
+    g_ptr_array_unref(cmd1);
+    g_ptr_array_unref(cmd2);
+    g_ptr_array_unref(cmd3);
+    teardown_fake_ssh();
+}
+
+static void
+test_ssh_mux_close(void)
+{
+    VirtViewerSshMux *mux = virt_viewer_ssh_mux_new(60);
+    GPtrArray *cmd;
+    GError *error = NULL;
+    gchar **lines;
+    gchar *expected;
+    gint status;
+
+    setup_fake_ssh();
+
+    cmd = build_cmd(mux, "host1.example.com", 2222, "root");
+    g_assert(g_spawn_sync(NULL, (gchar **)cmd->pdata, NULL, G_SPAWN_SEARCH_PATH,
+                          NULL, NULL, NULL, NULL, &status, &error));
+    g_assert_no_error(error);
+
+    lines = read_fake_ssh_log();
+    g_assert_cmpuint(g_strv_length(lines), ==, 1);
+    expected = g_strdup_printf("-o ControlMaster=auto -o ControlPath=%s -o ControlPersist=60 host1.example.com true",
+                               find_control_path(cmd));
+    g_assert_cmpstr(lines[0], ==, expected);
+    g_free(expected);
+    g_strfreev(lines);
+
+    virt_viewer_ssh_mux_close_all(mux);
+    g_assert_cmpuint(virt_viewer_ssh_mux_get_n_masters(mux), ==, 0);
+
+    /* ssh -O exit runs in the background */
+    lines = wait_fake_ssh_log(2);
+    g_assert_cmpuint(g_strv_length(lines), ==, 2);
+    expected = g_strdup_printf("-o ControlPath=%s -O exit -p 2222 -l root host1.example.com",
+                               find_control_path(cmd));
+    g_assert_cmpstr(lines[1], ==, expected);
+    g_free(expected);
+    g_strfreev(lines);
+
+    /* nothing left to close */
+    virt_viewer_ssh_mux_free(mux);
+    lines = read_fake_ssh_log();
+    g_assert_cmpuint(g_strv_length(lines), ==, 2);
+    g_strfreev(lines);
+
+    g_ptr_array_unref(cmd);
+    teardown_fake_ssh();
+}
+
+int main(int argc, char* argv[])
+{
+    g_test_init(&argc, &argv, NULL);
+
+#ifndef G_OS_WIN32
+    g_test_add_func("/virt-viewer-util/ssh-mux/one-master-per-host", test_ssh_mux_one_master_per_host);
+    g_test_add_func("/virt-viewer-util/ssh-mux/close", test_ssh_mux_close);
+#endif
+
+    return g_test_run();
+}
@@ -0,0 +1,152 @@
+/* -*- Mode: C; c-basic-offset: 4; indent-tabs-mode: nil -*- */
+/*
+ * Virt Viewer: A virtual machine console viewer
+ *
+ * Copyright (C) 2016 Red Hat, Inc.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#include <config.h>
+#include <glib.h>
+#include <glib/gstdio.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <virt-viewer-util.h>
+#include <virt-viewer-timeline.h>
+
+gboolean doDebug = FALSE;
+
+static void
+test_timeline_disabled(void)
+{
+    g_assert(!virt_viewer_timeline_enabled());
+    g_assert_cmpint(virt_viewer_timeline_begin("stage"), ==, 0);
+    /* must be no-ops */
+    virt_viewer_timeline_end("stage", 0, NULL);
+    virt_viewer_timeline_mark("stage", NULL);
+}
+
+static void
+test_timeline_invalid_fd(void)
+{
+    GError *error = NULL;
+
+    g_assert(!virt_viewer_timeline_open("fd:", &error));
+    g_assert_error(error, VIRT_VIEWER_ERROR, VIRT_VIEWER_ERROR_FAILED);
+    g_clear_error(&error);
+
+    g_assert(!virt_viewer_timeline_open("fd:abc", &error));
+    g_assert_error(error, VIRT_VIEWER_ERROR, VIRT_VIEWER_ERROR_FAILED);
+    g_clear_error(&error);
+
+    g_assert(!virt_viewer_timeline_enabled());
+}
+
+static void
+test_timeline_output(void)
+{
+    GError *error = NULL;
+    gchar *path;
+    gchar *contents = NULL;
+    gchar **lines;
+    gint fd;
+    gint64 start;
+
+    fd = g_file_open_tmp("virt-viewer-timeline-XXXXXX", &path, &error);
+    g_assert_no_error(error);
+    close(fd);
+
+    g_assert(virt_viewer_timeline_open(path, &error));
+    g_assert_no_error(error);
+    g_assert(virt_viewer_timeline_enabled());
+
+    start = virt_viewer_timeline_begin("libvirt-connect");
+    g_assert_cmpint(start, >, 0);
+    virt_viewer_timeline_end("libvirt-connect", start, "qemu:///system");
+    virt_viewer_timeline_mark("first-frame", "quote \" backslash \\ newline \n");
+    virt_viewer_timeline_close();
+    g_assert(!virt_viewer_timeline_enabled());
+
+    g_assert(g_file_get_contents(path, &contents, NULL, &error));
+    g_assert_no_error(error);
+
+    lines = g_strsplit(contents, "\n", -1);
+    g_assert_cmpuint(g_strv_length(lines), ==, 5);
+
+    g_assert(g_str_has_prefix(lines[0], "{\"ts\":"));
+    g_assert(strstr(lines[0], "\"stage\":\"start\",\"phase\":\"mark\"") != NULL);
+
+    g_assert(strstr(lines[1], "\"stage\":\"libvirt-connect\",\"phase\":\"begin\"") != NULL);
+    g_assert(strstr(lines[1], "\"dur\"") == NULL);
+
+    g_assert(strstr(lines[2], "\"stage\":\"libvirt-connect\",\"phase\":\"end\",\"dur\":") != NULL);
+    g_assert(g_str_has_suffix(lines[2], ",\"detail\":\"qemu:///system\"}"));
+
+    g_assert(strstr(lines[3], "\"stage\":\"first-frame\",\"phase\":\"mark\"") != NULL);
+    g_assert(g_str_has_suffix(lines[3], "\"detail\":\"quote \\\" backslash \\\\ newline \\n\"}"));
+
+    g_assert_cmpstr(lines[4], ==, "");
+
+    g_strfreev(lines);
+    g_free(contents);
+    g_unlink(path);
+    g_free(path);
+}
+
+/* run last, the startup time is kept for the following timelines */
+static void
+test_timeline_startup(void)
+{
+    GError *error = NULL;
+    gchar *path;
+    gchar *contents = NULL;
+    gint fd;
+
+    fd = g_file_open_tmp("virt-viewer-timeline-XXXXXX", &path, &error);
+    g_assert_no_error(error);
+    close(fd);
+
+    virt_viewer_timeline_startup();
+    g_usleep(2000);
+
+    g_assert(virt_viewer_timeline_open(path, &error));
+    g_assert_no_error(error);
+    virt_viewer_timeline_close();
+
+    g_assert(g_file_get_contents(path, &contents, NULL, &error));
+    g_assert_no_error(error);
+
+    /* the start mark is relative to the startup, not to the opening */
+    g_assert(g_str_has_prefix(contents, "{\"ts\":"));
+    g_assert_cmpint(g_ascii_strtoll(contents + strlen("{\"ts\":"), NULL, 10), >=, 2000);
+
+    g_free(contents);
+    g_unlink(path);
+    g_free(path);
+}
+
+int main(int argc, char* argv[])
+{
+    g_test_init(&argc, &argv, NULL);
+
+    g_test_add_func("/virt-viewer-util/timeline/disabled", test_timeline_disabled);
+    g_test_add_func("/virt-viewer-util/timeline/invalid-fd", test_timeline_invalid_fd);
+    g_test_add_func("/virt-viewer-util/timeline/output", test_timeline_output);
+    g_test_add_func("/virt-viewer-util/timeline/startup", test_timeline_startup);
+
+    return g_test_run();
+}
@@ -0,0 +1,227 @@
+/* -*- Mode: C; c-basic-offset: 4; indent-tabs-mode: nil -*- */
+/*
+ * Virt Viewer: A virtual machine console viewer
+ *
+ * Copyright (C) 2016 Red Hat, Inc.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#include <config.h>
+#include <glib.h>
+#include <glib/gstdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#include <virt-viewer-util.h>
+#include <virt-viewer-tunnel-pool.h>
+
+gboolean doDebug = FALSE;
+
+#if defined(HAVE_SOCKETPAIR) && defined(HAVE_FORK)
+
+/* Stands in for an ssh tunnel: waits to be activated, then reports its
+ * pid and consumes its input until the other end is closed */
+static const gchar fake_tunnel[] =
+    "#!/bin/sh\n"
+    "read -r x || exit 1\n"
+    "echo $$\n"
+    "exec cat >/dev/null\n";
+
+/* The same, for a disabled pool which doesn't activate its tunnels */
+static const gchar fake_tunnel_unpooled[] =
+    "#!/bin/sh\n"
+    "echo $$\n"
+    "exec cat >/dev/null\n";
+
+static gchar *fake_dir = NULL;
+static gchar *fake_cmd = NULL;
+
+static void
+setup_fake_tunnel(const gchar *script)
+{
+    GError *error = NULL;
+
+    fake_dir = g_dir_make_tmp("virt-viewer-fake-tunnel-XXXXXX", &error);
+    g_assert_no_error(error);
+
+    fake_cmd = g_build_filename(fake_dir, "tunnel", NULL);
+    g_assert(g_file_set_contents(fake_cmd, script, -1, &error));
+    g_assert_no_error(error);
+    g_assert_cmpint(g_chmod(fake_cmd, 0755), ==, 0);
+}
+
+static void
+teardown_fake_tunnel(void)
+{
+    g_unlink(fake_cmd);
+    g_rmdir(fake_dir);
+
+    g_clear_pointer(&fake_cmd, g_free);
+    g_clear_pointer(&fake_dir, g_free);
+}
+
+static gint
+read_tunnel_pid(int fd)
+{
+    gchar buf[32];
+    gsize len = 0;
+
+    while (len < sizeof(buf) - 1) {
+        gssize n = read(fd, buf + len, 1);
+        g_assert_cmpint(n, ==, 1);
+        if (buf[len] == '\n')
+            break;
+        len++;
+    }
+    buf[len] = '\0';
+
+    return atoi(buf);
+}
+
+static void
+test_tunnel_pool_reuse(void)
+{
+    VirtViewerTunnelPool *pool;
+    const gchar *cmd1[] = { NULL, "host1", NULL };
+    const gchar *cmd2[] = { NULL, "host2", NULL };
+    guint hits, misses;
+    gint pid1, pid2;
+    int fd1, fd2, fd3;
+
+    setup_fake_tunnel(fake_tunnel);
+    cmd1[0] = cmd2[0] = fake_cmd;
+
+    pool = virt_viewer_tunnel_pool_new(2, 0);
+    g_assert_cmpuint(virt_viewer_tunnel_pool_get_max_idle(pool), ==, 2);
+
+    fd1 = virt_viewer_tunnel_pool_open(pool, cmd1);
+    g_assert_cmpint(fd1, >=, 0);
+    pid1 = read_tunnel_pid(fd1);
+    g_assert_cmpint(pid1, >, 0);
+    g_assert_cmpuint(virt_viewer_tunnel_pool_get_n_idle(pool), ==, 1);
+    virt_viewer_tunnel_pool_get_stats(pool, &hits, &misses);
+    g_assert_cmpuint(hits, ==, 0);
+    g_assert_cmpuint(misses, ==, 1);
+
+    /* the second channel gets the tunnel spawned in advance */
+    fd2 = virt_viewer_tunnel_pool_open(pool, cmd1);
+    g_assert_cmpint(fd2, >=, 0);
+    pid2 = read_tunnel_pid(fd2);
+    g_assert_cmpint(pid2, >, 0);
+    g_assert_cmpint(pid2, !=, pid1);
+    g_assert_cmpuint(virt_viewer_tunnel_pool_get_n_idle(pool), ==, 1);
+    virt_viewer_tunnel_pool_get_stats(pool, &hits, &misses);
+    g_assert_cmpuint(hits, ==, 1);
+    g_assert_cmpuint(misses, ==, 1);
+
+    /* idle tunnels are per command */
+    fd3 = virt_viewer_tunnel_pool_open(pool, cmd2);
+    g_assert_cmpint(fd3, >=, 0);
+    g_assert_cmpint(read_tunnel_pid(fd3), >, 0);
+    g_assert_cmpuint(virt_viewer_tunnel_pool_get_n_idle(pool), ==, 2);
+    virt_viewer_tunnel_pool_get_stats(pool, &hits, &misses);
+    g_assert_cmpuint(hits, ==, 1);
+    g_assert_cmpuint(misses, ==, 2);
+
+    virt_viewer_tunnel_pool_set_max_idle(pool, 1);
+    g_assert_cmpuint(virt_viewer_tunnel_pool_get_n_idle(pool), ==, 1);
+
+    virt_viewer_tunnel_pool_clear(pool);
+    g_assert_cmpuint(virt_viewer_tunnel_pool_get_n_idle(pool), ==, 0);
+
+    close(fd1);
+    close(fd2);
+    close(fd3);
+    virt_viewer_tunnel_pool_free(pool);
+    teardown_fake_tunnel();
+}
+
+static void
+test_tunnel_pool_disabled(void)
+{
+    VirtViewerTunnelPool *pool;
+    const gchar *cmd[] = { NULL, NULL };
+    guint hits, misses;
+    int fd;
+
+    setup_fake_tunnel(fake_tunnel_unpooled);
+    cmd[0] = fake_cmd;
+
+    pool = virt_viewer_tunnel_pool_new(0, 0);
+
+    fd = virt_viewer_tunnel_pool_open(pool, cmd);
+    g_assert_cmpint(fd, >=, 0);
+    g_assert_cmpint(read_tunnel_pid(fd), >, 0);
+    g_assert_cmpuint(virt_viewer_tunnel_pool_get_n_idle(pool), ==, 0);
+    virt_viewer_tunnel_pool_get_stats(pool, &hits, &misses);
+    g_assert_cmpuint(hits, ==, 0);
+    g_assert_cmpuint(misses, ==, 1);
+
+    close(fd);
+    virt_viewer_tunnel_pool_free(pool);
+    teardown_fake_tunnel();
+}
+
+static gboolean
+quit_loop(gpointer user_data)
+{
+    g_main_loop_quit(user_data);
+    return G_SOURCE_REMOVE;
+}
+
+static void
+test_tunnel_pool_expire(void)
+{
+    VirtViewerTunnelPool *pool;
+    const gchar *cmd[] = { NULL, NULL };
+    GMainLoop *loop;
+    int fd;
+
+    setup_fake_tunnel(fake_tunnel);
+    cmd[0] = fake_cmd;
+
+    pool = virt_viewer_tunnel_pool_new(1, 1);
+
+    fd = virt_viewer_tunnel_pool_open(pool, cmd);
+    g_assert_cmpint(fd, >=, 0);
+    g_assert_cmpuint(virt_viewer_tunnel_pool_get_n_idle(pool), ==, 1);
+
+    loop = g_main_loop_new(NULL, FALSE);
+    g_timeout_add(1500, quit_loop, loop);
+    g_main_loop_run(loop);
+    g_main_loop_unref(loop);
+
+    g_assert_cmpuint(virt_viewer_tunnel_pool_get_n_idle(pool), ==, 0);
+
+    close(fd);
+    virt_viewer_tunnel_pool_free(pool);
+    teardown_fake_tunnel();
+}
+
+#endif
+
+int main(int argc, char* argv[])
+{
+    g_test_init(&argc, &argv, NULL);
+
+#if defined(HAVE_SOCKETPAIR) && defined(HAVE_FORK)
+    g_test_add_func("/virt-viewer-util/tunnel-pool/reuse", test_tunnel_pool_reuse);
+    g_test_add_func("/virt-viewer-util/tunnel-pool/disabled", test_tunnel_pool_disabled);
+    g_test_add_func("/virt-viewer-util/tunnel-pool/expire", test_tunnel_pool_expire);
+#endif
+
+    return g_test_run();
+}
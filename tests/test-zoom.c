@@ -0,0 +1,104 @@
+/* -*- Mode: C; c-basic-offset: 4; indent-tabs-mode: nil -*- */
+/*
+ * Virt Viewer: A virtual machine console viewer
+ *
+ * Copyright (C) 2016 Red Hat, Inc.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#include <config.h>
+#include <glib.h>
+
+#include <virt-viewer-util.h>
+
+gboolean doDebug = FALSE;
+
+typedef struct {
+    guint desktop_width, desktop_height;
+    guint width, height;
+    gint scale_factor;
+    gboolean integer;
+    gint fit_width, fit_height;
+} FitTestCase;
+
+static const FitTestCase fit_cases[] = {
+    /* free scaling keeps the aspect ratio */
+    { 1024, 768, 1500, 1000, 1, FALSE, 1333, 1000 },
+    { 1024, 768, 800, 800, 1, FALSE, 800, 600 },
+    /* integer scaling is 1:1 while the desktop fits */
+    { 1024, 768, 1500, 1000, 1, TRUE, 1024, 768 },
+    { 1024, 768, 2100, 1600, 1, TRUE, 2048, 1536 },
+    /* 4K guest shrunk by 3 on a laptop panel */
+    { 3840, 2160, 1900, 1000, 1, TRUE, 1280, 720 },
+    { 1920, 1080, 1000, 1000, 1, TRUE, 960, 540 },
+    /* no integer scale gives exact dimensions */
+    { 1025, 769, 800, 600, 1, TRUE, 800, 600 },
+    /* HiDPI, in logical pixels: 1:1 in device pixels, then 2:1 */
+    { 1024, 768, 600, 400, 2, TRUE, 512, 384 },
+    { 1024, 768, 1500, 1000, 2, TRUE, 1024, 768 },
+    /* odd width only scaled by even numbers of device pixels, or freely */
+    { 1025, 768, 1500, 1000, 2, TRUE, 1025, 768 },
+    { 1025, 768, 1000, 700, 2, TRUE, 934, 700 },
+};
+
+static void
+test_zoom_fit(void)
+{
+    guint i;
+
+    for (i = 0; i < G_N_ELEMENTS(fit_cases); i++) {
+        const FitTestCase *test = &fit_cases[i];
+        gint width = -1, height = -1;
+
+        virt_viewer_fit_desktop(test->desktop_width, test->desktop_height,
+                                test->width, test->height,
+                                test->scale_factor, test->integer,
+                                &width, &height);
+        g_assert_cmpint(width, ==, test->fit_width);
+        g_assert_cmpint(height, ==, test->fit_height);
+    }
+}
+
+static void
+test_zoom_snap(void)
+{
+    /* already an integer scale */
+    g_assert_cmpint(virt_viewer_snap_zoom_level(100, 1, 0), ==, 100);
+    g_assert_cmpint(virt_viewer_snap_zoom_level(200, 1, 1), ==, 200);
+    g_assert_cmpint(virt_viewer_snap_zoom_level(50, 1, -1), ==, 50);
+
+    g_assert_cmpint(virt_viewer_snap_zoom_level(101, 1, 1), ==, 200);
+    g_assert_cmpint(virt_viewer_snap_zoom_level(99, 1, -1), ==, 50);
+    g_assert_cmpint(virt_viewer_snap_zoom_level(40, 1, 1), ==, 50);
+    g_assert_cmpint(virt_viewer_snap_zoom_level(40, 1, -1), ==, 33);
+    g_assert_cmpint(virt_viewer_snap_zoom_level(140, 1, 0), ==, 100);
+    g_assert_cmpint(virt_viewer_snap_zoom_level(160, 1, 0), ==, 200);
+
+    /* halves of logical pixels with a scale factor of 2 */
+    g_assert_cmpint(virt_viewer_snap_zoom_level(101, 2, 1), ==, 150);
+    g_assert_cmpint(virt_viewer_snap_zoom_level(49, 2, -1), ==, 25);
+    g_assert_cmpint(virt_viewer_snap_zoom_level(120, 2, 0), ==, 100);
+}
+
+int main(int argc, char* argv[])
+{
+    g_test_init(&argc, &argv, NULL);
+
+    g_test_add_func("/virt-viewer-util/zoom/fit", test_zoom_fit);
+    g_test_add_func("/virt-viewer-util/zoom/snap", test_zoom_snap);
+
+    return g_test_run();
+}